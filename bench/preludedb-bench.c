@@ -0,0 +1,1073 @@
+/*****
+*
+* Copyright (C) 2020 CS GROUP - France. All Rights Reserved.
+*
+* This file is part of the PreludeDB library.
+*
+* This program is free software; you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation; either version 2, or (at your option)
+* any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License along
+* with this program; if not, write to the Free Software Foundation, Inc.,
+* 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+*
+*****/
+
+/*
+ * Benchmark driver for the library: synthetic alerts and heartbeats are
+ * inserted, fetched back, aggregated and deleted through the public API,
+ * and the throughput or latency of each step is reported.
+ *
+ * By default, a fresh SQLite database is created in the current directory
+ * from the classic schema. Other backends are used through -d, on a
+ * database that already holds the schema, or loads it with -s.
+ *
+ * Messages only depend on the seed (-r), so that runs can be compared.
+ * Plugins are loaded from their installation directory.
+ */
+
+#include "config.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdarg.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <time.h>
+#include <sys/time.h>
+
+#include <libprelude/prelude.h>
+#include <libprelude/idmef-message-helpers.h>
+
+#include "preludedb.h"
+#include "preludedb-sql.h"
+#include "preludedb-sql-settings.h"
+
+
+#define BENCH_DEFAULT_SETTINGS "type=sqlite3 file=preludedb-bench.sqlite"
+
+/*
+ * Messages are spread over one day, starting from this date
+ * (2020-01-01 00:00:00 UTC), so that the retention test deletes
+ * a known share of them.
+ */
+#define BENCH_START_TIME 1577836800
+#define BENCH_TIME_SPAN  86400
+
+
+typedef struct {
+        const char *settings;
+        const char *schema;
+        unsigned int alerts;
+        unsigned int batch;
+        unsigned int gets;
+        unsigned int queries;
+        unsigned int join_paths;
+        uint64_t seed;
+        prelude_bool_t metrics;
+} bench_options_t;
+
+
+typedef struct {
+        uint64_t *samples;
+        unsigned int count;
+} bench_latency_t;
+
+
+static uint64_t rand_state;
+
+
+static const char *classifications[] = {
+        "Remote buffer overflow attempt",
+        "Local buffer overflow attempt",
+        "SSH brute force",
+        "SQL injection attempt",
+        "Cross site scripting attempt",
+        "Port scan",
+        "Suspicious DNS query",
+        "Malware download",
+        "Privilege escalation",
+        "Integrity check failed",
+        "Login failure",
+        "Denial of service",
+};
+
+static const char *severities[] = { "info", "low", "medium", "high" };
+static const char *protocols[] = { "tcp", "udp", "icmp" };
+static const char *analyzers[] = { "snort", "suricata", "ossec", "auditd", "samhain" };
+
+
+
+/*
+ * xorshift64*: fast and good enough for data generation, with a
+ * sequence that only depends on the seed.
+ */
+static uint64_t bench_rand(void)
+{
+        rand_state ^= rand_state >> 12;
+        rand_state ^= rand_state << 25;
+        rand_state ^= rand_state >> 27;
+
+        return rand_state * 2685821657736338717ULL;
+}
+
+
+
+static unsigned int bench_rand_range(unsigned int max)
+{
+        return (unsigned int) ((bench_rand() >> 32) % max);
+}
+
+
+
+static uint64_t bench_now(void)
+{
+        struct timeval tv;
+
+        gettimeofday(&tv, NULL);
+
+        return (uint64_t) tv.tv_sec * 1000000 + tv.tv_usec;
+}
+
+
+
+static void bench_die(const char *what, int error)
+{
+        fprintf(stderr, "%s: %s.\n", what, preludedb_strerror(error));
+        exit(1);
+}
+
+
+
+static void bench_format_time(time_t t, char *buf, size_t size)
+{
+        struct tm tm;
+
+        gmtime_r(&t, &tm);
+        strftime(buf, size, "%Y-%m-%dT%H:%M:%SZ", &tm);
+}
+
+
+
+static int set_string(idmef_message_t *message, const char *value, const char *fmt, ...)
+{
+        va_list ap;
+        char path[256];
+
+        va_start(ap, fmt);
+        vsnprintf(path, sizeof(path), fmt, ap);
+        va_end(ap);
+
+        return idmef_message_set_string(message, path, value);
+}
+
+
+
+static int set_number(idmef_message_t *message, double value, const char *fmt, ...)
+{
+        va_list ap;
+        char path[256];
+
+        va_start(ap, fmt);
+        vsnprintf(path, sizeof(path), fmt, ap);
+        va_end(ap);
+
+        return idmef_message_set_number(message, path, value);
+}
+
+
+
+static int add_additional_data(idmef_alert_t *alert, idmef_heartbeat_t *heartbeat, unsigned int kind)
+{
+        int ret;
+        unsigned int i;
+        char buf[128];
+        prelude_string_t *meaning;
+        idmef_additional_data_t *ad;
+        unsigned char payload[64];
+
+        if ( alert )
+                ret = idmef_alert_new_additional_data(alert, &ad, IDMEF_LIST_APPEND);
+        else
+                ret = idmef_heartbeat_new_additional_data(heartbeat, &ad, IDMEF_LIST_APPEND);
+
+        if ( ret < 0 )
+                return ret;
+
+        ret = idmef_additional_data_new_meaning(ad, &meaning);
+        if ( ret < 0 )
+                return ret;
+
+        switch ( kind % 3 ) {
+        case 0:
+                ret = prelude_string_set_constant(meaning, "Packet Payload");
+                if ( ret < 0 )
+                        return ret;
+
+                for ( i = 0; i < sizeof(payload); i++ )
+                        payload[i] = bench_rand() & 0xff;
+
+                return idmef_additional_data_set_byte_string_dup(ad, payload, sizeof(payload));
+
+        case 1:
+                ret = prelude_string_set_constant(meaning, "Event count");
+                if ( ret < 0 )
+                        return ret;
+
+                idmef_additional_data_set_integer(ad, bench_rand_range(100000));
+                return 0;
+
+        default:
+                ret = prelude_string_set_constant(meaning, "Command line");
+                if ( ret < 0 )
+                        return ret;
+
+                snprintf(buf, sizeof(buf), "/usr/bin/worker --id %u --queue q%u", bench_rand_range(1000), bench_rand_range(16));
+                return idmef_additional_data_set_string_dup(ad, buf);
+        }
+}
+
+
+
+static int set_analyzer(idmef_message_t *message, const char *type, time_t t, unsigned int analyzer)
+{
+        int ret;
+        char buf[64];
+
+        bench_format_time(t, buf, sizeof(buf));
+        ret = set_string(message, buf, "%s.create_time", type);
+        if ( ret < 0 )
+                return ret;
+
+        snprintf(buf, sizeof(buf), "%u", 1000 + analyzer);
+        ret = set_string(message, buf, "%s.analyzer(0).analyzerid", type);
+        if ( ret < 0 )
+                return ret;
+
+        ret = set_string(message, analyzers[analyzer % (sizeof(analyzers) / sizeof(*analyzers))], "%s.analyzer(0).name", type);
+        if ( ret < 0 )
+                return ret;
+
+        ret = set_string(message, "NIDS", "%s.analyzer(0).class", type);
+        if ( ret < 0 )
+                return ret;
+
+        snprintf(buf, sizeof(buf), "sensor%u.example.org", analyzer);
+        return set_string(message, buf, "%s.analyzer(0).node.name", type);
+}
+
+
+
+static int bench_new_alert(idmef_message_t **message, unsigned int num, unsigned int count)
+{
+        int ret;
+        char buf[128];
+        idmef_alert_t *alert;
+        unsigned int i, j, nsource, ntarget, nfile, nad, class;
+
+        ret = idmef_message_new(message);
+        if ( ret < 0 )
+                return ret;
+
+        ret = idmef_message_new_alert(*message, &alert);
+        if ( ret < 0 )
+                goto error;
+
+        snprintf(buf, sizeof(buf), "%08x-%04x-%04x-%04x-%012llx", num, bench_rand_range(0x10000),
+                 bench_rand_range(0x10000), bench_rand_range(0x10000), (unsigned long long) (bench_rand() >> 16));
+        ret = set_string(*message, buf, "alert.messageid");
+        if ( ret < 0 )
+                goto error;
+
+        ret = set_analyzer(*message, "alert", BENCH_START_TIME + (time_t) ((uint64_t) num * BENCH_TIME_SPAN / count),
+                           bench_rand_range(8));
+        if ( ret < 0 )
+                goto error;
+
+        class = bench_rand_range(sizeof(classifications) / sizeof(*classifications));
+        ret = set_string(*message, classifications[class], "alert.classification.text");
+        if ( ret < 0 )
+                goto error;
+
+        ret = set_string(*message, "cve", "alert.classification.reference(0).origin");
+        if ( ret < 0 )
+                goto error;
+
+        snprintf(buf, sizeof(buf), "CVE-20%02u-%04u", 10 + class, bench_rand_range(10000));
+        ret = set_string(*message, buf, "alert.classification.reference(0).name");
+        if ( ret < 0 )
+                goto error;
+
+        ret = set_string(*message, severities[bench_rand_range(4)], "alert.assessment.impact.severity");
+        if ( ret < 0 )
+                goto error;
+
+        ret = set_string(*message, (bench_rand() & 1) ? "failed" : "succeeded", "alert.assessment.impact.completion");
+        if ( ret < 0 )
+                goto error;
+
+        nsource = 1 + bench_rand_range(3);
+        for ( i = 0; i < nsource; i++ ) {
+                snprintf(buf, sizeof(buf), "10.%u.%u.%u", bench_rand_range(4), bench_rand_range(256), bench_rand_range(256));
+                ret = set_string(*message, buf, "alert.source(%u).node.address(0).address", i);
+                if ( ret < 0 )
+                        goto error;
+
+                ret = set_number(*message, 1024 + bench_rand_range(64000), "alert.source(%u).service.port", i);
+                if ( ret < 0 )
+                        goto error;
+
+                ret = set_string(*message, protocols[bench_rand_range(3)], "alert.source(%u).service.protocol", i);
+                if ( ret < 0 )
+                        goto error;
+        }
+
+        ntarget = 1 + bench_rand_range(3);
+        for ( i = 0; i < ntarget; i++ ) {
+                snprintf(buf, sizeof(buf), "192.168.%u.%u", bench_rand_range(16), bench_rand_range(256));
+                ret = set_string(*message, buf, "alert.target(%u).node.address(0).address", i);
+                if ( ret < 0 )
+                        goto error;
+
+                snprintf(buf, sizeof(buf), "host%u.example.org", bench_rand_range(512));
+                ret = set_string(*message, buf, "alert.target(%u).node.name", i);
+                if ( ret < 0 )
+                        goto error;
+
+                ret = set_number(*message, bench_rand_range(1024), "alert.target(%u).service.port", i);
+                if ( ret < 0 )
+                        goto error;
+
+                nfile = bench_rand_range(3);
+                for ( j = 0; j < nfile; j++ ) {
+                        snprintf(buf, sizeof(buf), "file%u.conf", bench_rand_range(100));
+                        ret = set_string(*message, buf, "alert.target(%u).file(%u).name", i, j);
+                        if ( ret < 0 )
+                                goto error;
+
+                        snprintf(buf, sizeof(buf), "/etc/app%u/file%u.conf", bench_rand_range(20), bench_rand_range(100));
+                        ret = set_string(*message, buf, "alert.target(%u).file(%u).path", i, j);
+                        if ( ret < 0 )
+                                goto error;
+
+                        ret = set_string(*message, "current", "alert.target(%u).file(%u).category", i, j);
+                        if ( ret < 0 )
+                                goto error;
+
+                        ret = set_number(*message, bench_rand_range(1 << 20), "alert.target(%u).file(%u).data_size", i, j);
+                        if ( ret < 0 )
+                                goto error;
+                }
+        }
+
+        nad = bench_rand_range(4);
+        for ( i = 0; i < nad; i++ ) {
+                ret = add_additional_data(alert, NULL, i);
+                if ( ret < 0 )
+                        goto error;
+        }
+
+        return 0;
+
+ error:
+        idmef_message_destroy(*message);
+        return ret;
+}
+
+
+
+static int bench_new_heartbeat(idmef_message_t **message, unsigned int num, unsigned int count)
+{
+        int ret;
+        idmef_heartbeat_t *heartbeat;
+
+        ret = idmef_message_new(message);
+        if ( ret < 0 )
+                return ret;
+
+        ret = idmef_message_new_heartbeat(*message, &heartbeat);
+        if ( ret < 0 )
+                goto error;
+
+        ret = set_analyzer(*message, "heartbeat", BENCH_START_TIME + (time_t) ((uint64_t) num * BENCH_TIME_SPAN / count),
+                           num % 8);
+        if ( ret < 0 )
+                goto error;
+
+        ret = set_number(*message, 600, "heartbeat.heartbeat_interval");
+        if ( ret < 0 )
+                goto error;
+
+        ret = add_additional_data(NULL, heartbeat, 1);
+        if ( ret < 0 )
+                goto error;
+
+        return 0;
+
+ error:
+        idmef_message_destroy(*message);
+        return ret;
+}
+
+
+
+static int latency_compare(const void *a, const void *b)
+{
+        uint64_t x = *(const uint64_t *) a, y = *(const uint64_t *) b;
+
+        return (x > y) - (x < y);
+}
+
+
+
+static void latency_init(bench_latency_t *latency, unsigned int max)
+{
+        latency->count = 0;
+        latency->samples = malloc(sizeof(*latency->samples) * (max ? max : 1));
+        if ( ! latency->samples ) {
+                fprintf(stderr, "out of memory.\n");
+                exit(1);
+        }
+}
+
+
+
+static void latency_report(const char *name, bench_latency_t *latency)
+{
+        unsigned int i;
+        uint64_t total = 0;
+
+        if ( latency->count == 0 ) {
+                printf("%-24s no sample\n", name);
+                goto out;
+        }
+
+        qsort(latency->samples, latency->count, sizeof(*latency->samples), latency_compare);
+
+        for ( i = 0; i < latency->count; i++ )
+                total += latency->samples[i];
+
+        printf("%-24s %8u calls  avg %8" PRELUDE_PRIu64 "us  p50 %8" PRELUDE_PRIu64 "us  p99 %8" PRELUDE_PRIu64 "us  max %8" PRELUDE_PRIu64 "us\n",
+               name, latency->count, total / latency->count,
+               latency->samples[latency->count / 2],
+               latency->samples[(uint64_t) latency->count * 99 / 100],
+               latency->samples[latency->count - 1]);
+
+ out:
+        free(latency->samples);
+}
+
+
+
+static void rate_report(const char *name, uint64_t count, uint64_t elapsed)
+{
+        printf("%-24s %8" PRELUDE_PRIu64 " events %8.3fs  %10.1f events/s\n", name, count,
+               elapsed / 1000000.0, elapsed ? count * 1000000.0 / elapsed : 0.0);
+}
+
+
+
+/*
+ * Run the statements of a schema file, split on the semicolons found
+ * outside of quoted strings.
+ */
+static int load_schema(preludedb_sql_t *sql, const char *filename)
+{
+        int ret = 0;
+        FILE *fd;
+        char *query, *ptr, *start;
+        long size;
+        char quote = 0;
+
+        fd = fopen(filename, "r");
+        if ( ! fd ) {
+                fprintf(stderr, "could not open schema '%s': %s.\n", filename, strerror(errno));
+                return -1;
+        }
+
+        fseek(fd, 0, SEEK_END);
+        size = ftell(fd);
+        rewind(fd);
+
+        query = malloc(size + 1);
+        if ( ! query ) {
+                fclose(fd);
+                return preludedb_error_from_errno(errno);
+        }
+
+        size = fread(query, 1, size, fd);
+        query[size] = 0;
+        fclose(fd);
+
+        for ( ptr = start = query; *ptr && ret >= 0; ptr++ ) {
+                if ( quote ) {
+                        if ( *ptr == quote )
+                                quote = 0;
+                        continue;
+                }
+
+                if ( *ptr == '\'' || *ptr == '"' ) {
+                        quote = *ptr;
+                        continue;
+                }
+
+                if ( *ptr != ';' )
+                        continue;
+
+                *ptr = 0;
+                start += strspn(start, " \t\r\n");
+                if ( *start )
+                        ret = preludedb_sql_query(sql, start, NULL);
+
+                start = ptr + 1;
+        }
+
+        free(query);
+
+        return (ret < 0) ? ret : 0;
+}
+
+
+
+static void bench_insert(preludedb_t *db, bench_options_t *opts)
+{
+        ssize_t ret;
+        unsigned int i, j, n, nheartbeat;
+        uint64_t start, elapsed = 0;
+        idmef_message_t **messages;
+
+        messages = malloc(sizeof(*messages) * opts->batch);
+        if ( ! messages ) {
+                fprintf(stderr, "out of memory.\n");
+                exit(1);
+        }
+
+        /*
+         * Only the insertion is timed, message generation is not.
+         */
+        for ( i = 0; i < opts->alerts; i += n ) {
+                n = (opts->batch < opts->alerts - i) ? opts->batch : opts->alerts - i;
+
+                for ( j = 0; j < n; j++ ) {
+                        ret = bench_new_alert(&messages[j], i + j, opts->alerts);
+                        if ( ret < 0 )
+                                bench_die("could not create alert", ret);
+                }
+
+                start = bench_now();
+
+                if ( n == 1 )
+                        ret = preludedb_insert_message(db, messages[0]);
+                else
+                        ret = preludedb_insert_messages(db, messages, n);
+
+                elapsed += bench_now() - start;
+
+                if ( ret < 0 )
+                        bench_die("could not insert alerts", ret);
+
+                for ( j = 0; j < n; j++ )
+                        idmef_message_destroy(messages[j]);
+        }
+
+        rate_report("insert alert", opts->alerts, elapsed);
+
+        nheartbeat = opts->alerts / 10;
+        elapsed = 0;
+
+        for ( i = 0; i < nheartbeat; i++ ) {
+                ret = bench_new_heartbeat(&messages[0], i, nheartbeat);
+                if ( ret < 0 )
+                        bench_die("could not create heartbeat", ret);
+
+                start = bench_now();
+                ret = preludedb_insert_message(db, messages[0]);
+                elapsed += bench_now() - start;
+
+                if ( ret < 0 )
+                        bench_die("could not insert heartbeat", ret);
+
+                idmef_message_destroy(messages[0]);
+        }
+
+        rate_report("insert heartbeat", nheartbeat, elapsed);
+
+        free(messages);
+}
+
+
+
+static void bench_get(preludedb_t *db, bench_options_t *opts)
+{
+        int ret;
+        uint64_t ident, start;
+        unsigned int i, count;
+        idmef_message_t *message;
+        bench_latency_t latency;
+        preludedb_result_idents_t *idents;
+
+        ret = preludedb_get_alert_idents2(db, NULL, -1, -1, NULL, &idents);
+        if ( ret < 0 )
+                bench_die("could not retrieve alert idents", ret);
+
+        latency_init(&latency, opts->gets);
+
+        count = (ret > 0) ? preludedb_result_idents_get_count(idents) : 0;
+
+        for ( i = 0; count > 0 && i < opts->gets; i++ ) {
+                ret = preludedb_result_idents_get(idents, bench_rand_range(count), &ident);
+                if ( ret < 0 )
+                        bench_die("could not retrieve alert ident", ret);
+
+                start = bench_now();
+
+                ret = preludedb_get_alert(db, ident, &message);
+                if ( ret < 0 )
+                        bench_die("could not retrieve alert", ret);
+
+                latency.samples[latency.count++] = bench_now() - start;
+                idmef_message_destroy(message);
+        }
+
+        if ( count > 0 )
+                preludedb_result_idents_destroy(idents);
+
+        latency_report("get alert", &latency);
+}
+
+
+
+static int run_values(preludedb_t *db, const char * const *paths, idmef_criteria_t *criteria)
+{
+        int ret;
+        void *row;
+        unsigned int i;
+        idmef_value_t *value;
+        preludedb_selected_path_t *selected;
+        preludedb_path_selection_t *selection;
+        preludedb_result_values_t *result;
+
+        ret = preludedb_path_selection_new(db, &selection);
+        if ( ret < 0 )
+                return ret;
+
+        for ( i = 0; paths[i]; i++ ) {
+                ret = preludedb_selected_path_new_string(&selected, paths[i]);
+                if ( ret < 0 )
+                        goto out;
+
+                ret = preludedb_path_selection_add(selection, selected);
+                if ( ret < 0 ) {
+                        preludedb_selected_path_destroy(selected);
+                        goto out;
+                }
+        }
+
+        ret = preludedb_get_values(db, selection, criteria, FALSE, -1, -1, &result);
+        if ( ret <= 0 )
+                goto out;
+
+        /*
+         * Rows are converted to values, as a client would.
+         */
+        for ( i = 0; (ret = preludedb_result_values_get_row(result, i, &row)) > 0; i++ ) {
+                selected = NULL;
+                while ( (selected = preludedb_path_selection_get_next(selection, selected)) ) {
+                        ret = preludedb_result_values_get_field(result, row, selected, &value);
+                        if ( ret < 0 )
+                                break;
+
+                        if ( ret > 0 )
+                                idmef_value_destroy(value);
+                }
+
+                if ( ret < 0 )
+                        break;
+        }
+
+        preludedb_result_values_destroy(result);
+
+ out:
+        preludedb_path_selection_destroy(selection);
+        return ret;
+}
+
+
+
+static void bench_values_run(preludedb_t *db, bench_options_t *opts, const char *name,
+                             const char * const *paths, const char *criteria_str)
+{
+        int ret;
+        uint64_t start;
+        unsigned int i;
+        bench_latency_t latency;
+        idmef_criteria_t *criteria = NULL;
+
+        if ( criteria_str ) {
+                ret = idmef_criteria_new_from_string(&criteria, criteria_str);
+                if ( ret < 0 )
+                        bench_die(criteria_str, ret);
+        }
+
+        latency_init(&latency, opts->queries);
+
+        for ( i = 0; i < opts->queries; i++ ) {
+                start = bench_now();
+
+                ret = run_values(db, paths, criteria);
+                if ( ret < 0 )
+                        bench_die(name, ret);
+
+                latency.samples[latency.count++] = bench_now() - start;
+        }
+
+        if ( criteria )
+                idmef_criteria_destroy(criteria);
+
+        latency_report(name, &latency);
+}
+
+
+
+static void bench_values(preludedb_t *db, bench_options_t *opts)
+{
+        static const char * const by_classification[] = {
+                "alert.classification.text/group_by", "count(alert.create_time)/order_desc", NULL
+        };
+        static const char * const by_source[] = {
+                "alert.source(0).node.address(0).address/group_by", "count(alert.create_time)/order_desc", NULL
+        };
+        static const char * const by_hour[] = {
+                "extract(alert.create_time, hour)/group_by", "count(alert.create_time)", NULL
+        };
+        static const char * const by_severity[] = {
+                "alert.assessment.impact.severity/group_by", "alert.analyzer(0).name/group_by", "count(alert.create_time)", NULL
+        };
+
+        bench_values_run(db, opts, "values classification", by_classification, NULL);
+        bench_values_run(db, opts, "values source", by_source, NULL);
+        bench_values_run(db, opts, "values hour", by_hour, NULL);
+        bench_values_run(db, opts, "values severity", by_severity,
+                         "alert.assessment.impact.completion == 'failed'");
+
+        /*
+         * Regular expressions are evaluated by the backend for every row,
+         * through a user defined function with SQLite.
+         */
+        bench_values_run(db, opts, "values regex", by_classification,
+                         "alert.classification.text ~ '^(Remote|Local) .*overflow'");
+}
+
+
+
+/*
+ * Criteria referencing many distinct paths, each one joining its own
+ * table alias, to measure the construction of requests with many joins.
+ */
+static char *join_criteria_new(unsigned int npaths)
+{
+        int len;
+        size_t size;
+        unsigned int i;
+        char *str, *ptr;
+        static const char *templates[] = {
+                "alert.source(%u).node.address(0).address == '10.0.0.%u'",
+                "alert.target(%u).node.name == 'host%u.example.org'",
+                "alert.target(%u).file(0).name == 'file%u.conf'",
+                "alert.target(%u).service.port == %u",
+        };
+
+        size = npaths * 80 + 1;
+        ptr = str = malloc(size);
+        if ( ! str ) {
+                fprintf(stderr, "out of memory.\n");
+                exit(1);
+        }
+
+        *str = 0;
+        for ( i = 0; i < npaths; i++ ) {
+                len = snprintf(ptr, size, "%s", (i == 0) ? "" : " || ");
+                len += snprintf(ptr + len, size - len, templates[i % 4], i / 4, i);
+                ptr += len;
+                size -= len;
+        }
+
+        return str;
+}
+
+
+
+static void bench_join_run(preludedb_t *db, bench_options_t *opts, const char *name, idmef_criteria_t *criteria)
+{
+        int ret;
+        uint64_t start;
+        unsigned int i;
+        bench_latency_t latency;
+        preludedb_result_idents_t *idents;
+
+        latency_init(&latency, opts->queries);
+
+        for ( i = 0; i < opts->queries; i++ ) {
+                start = bench_now();
+
+                ret = preludedb_get_alert_idents2(db, criteria, 1, -1, NULL, &idents);
+                if ( ret < 0 )
+                        bench_die(name, ret);
+
+                latency.samples[latency.count++] = bench_now() - start;
+
+                if ( ret > 0 )
+                        preludedb_result_idents_destroy(idents);
+        }
+
+        latency_report(name, &latency);
+}
+
+
+
+static void bench_join(preludedb_t *db, bench_options_t *opts)
+{
+        int ret;
+        char *str;
+        preludedb_sql_t *sql;
+        preludedb_t *uncached;
+        idmef_criteria_t *criteria;
+        preludedb_sql_settings_t *settings;
+
+        str = join_criteria_new(opts->join_paths);
+
+        ret = idmef_criteria_new_from_string(&criteria, str);
+        if ( ret < 0 )
+                bench_die("could not create join criteria", ret);
+
+        free(str);
+
+        bench_join_run(db, opts, "join cached", criteria);
+
+        /*
+         * Without plan cache, the request is built on every call.
+         */
+        ret = preludedb_sql_settings_new_from_string(&settings, opts->settings);
+        if ( ret < 0 )
+                bench_die("could not parse database settings", ret);
+
+        ret = preludedb_sql_settings_set_plan_cache(settings, "0");
+        if ( ret < 0 )
+                bench_die("could not set plan_cache", ret);
+
+        ret = preludedb_sql_new(&sql, NULL, settings);
+        if ( ret < 0 )
+                bench_die("could not open database", ret);
+
+        ret = preludedb_new(&uncached, sql, NULL, NULL, 0);
+        if ( ret < 0 )
+                bench_die("could not create database", ret);
+
+        bench_join_run(uncached, opts, "join uncached", criteria);
+
+        preludedb_destroy(uncached);
+        preludedb_sql_destroy(sql);
+        idmef_criteria_destroy(criteria);
+}
+
+
+
+static void bench_delete_run(preludedb_t *db, const char *name, const char *type)
+{
+        ssize_t ret;
+        uint64_t start;
+        char buf[64], str[128];
+        idmef_criteria_t *criteria;
+
+        /*
+         * Retention: messages from the first half of the generated day.
+         */
+        bench_format_time(BENCH_START_TIME + BENCH_TIME_SPAN / 2, buf, sizeof(buf));
+        snprintf(str, sizeof(str), "%s.create_time < '%s'", type, buf);
+
+        ret = idmef_criteria_new_from_string(&criteria, str);
+        if ( ret < 0 )
+                bench_die("could not create delete criteria", ret);
+
+        start = bench_now();
+
+        ret = preludedb_delete2(db, criteria, 0, NULL, NULL);
+        if ( ret < 0 )
+                bench_die(name, ret);
+
+        rate_report(name, ret, bench_now() - start);
+        idmef_criteria_destroy(criteria);
+}
+
+
+
+static void bench_delete(preludedb_t *db)
+{
+        bench_delete_run(db, "delete alert", "alert");
+        bench_delete_run(db, "delete heartbeat", "heartbeat");
+}
+
+
+
+static void bench_metrics(preludedb_sql_t *sql)
+{
+        int ret;
+        preludedb_sql_metrics_t *metrics;
+        preludedb_sql_metrics_statement_t *st = NULL;
+
+        ret = preludedb_sql_get_metrics(sql, &metrics);
+        if ( ret < 0 )
+                bench_die("could not retrieve metrics", ret);
+
+        printf("\n%-32s %10s %10s %10s %10s\n", "statement", "calls", "p50 (us)", "p99 (us)", "total (ms)");
+
+        while ( (st = preludedb_sql_metrics_get_next_statement(metrics, st)) )
+                printf("%-32s %10" PRELUDE_PRIu64 " %10" PRELUDE_PRIu64 " %10" PRELUDE_PRIu64 " %10" PRELUDE_PRIu64 "\n",
+                       preludedb_sql_metrics_statement_get_name(st),
+                       preludedb_sql_metrics_statement_get_calls(st),
+                       preludedb_sql_metrics_statement_get_percentile(st, 50),
+                       preludedb_sql_metrics_statement_get_percentile(st, 99),
+                       preludedb_sql_metrics_statement_get_total_time(st) / 1000);
+
+        printf("escaped bytes: %" PRELUDE_PRIu64 "\n", preludedb_sql_metrics_get_escaped_bytes(metrics));
+
+        preludedb_sql_metrics_destroy(metrics);
+}
+
+
+
+static void usage(const char *name)
+{
+        fprintf(stderr,
+                "Usage: %s [options]\n\n"
+                "  -d settings  Database settings (default: \"" BENCH_DEFAULT_SETTINGS "\").\n"
+                "  -s schema    Schema file to load first (default: the classic schema for SQLite).\n"
+                "  -n alerts    Number of alerts to insert (default: 10000).\n"
+                "  -b batch     Number of alerts inserted per call (default: 100).\n"
+                "  -g gets      Number of alerts retrieved one by one (default: 1000).\n"
+                "  -q queries   Number of runs of each aggregate query (default: 50).\n"
+                "  -j paths     Number of paths in the join criteria (default: 32).\n"
+                "  -r seed      Seed of the message generator (default: 1).\n"
+                "  -m           Print per statement metrics.\n", name);
+
+        exit(1);
+}
+
+
+
+int main(int argc, char **argv)
+{
+        int ret, c;
+        char errbuf[1024];
+        const char *file, *type;
+        preludedb_t *db;
+        preludedb_sql_t *sql;
+        preludedb_sql_settings_t *settings;
+        bench_options_t opts = {
+                BENCH_DEFAULT_SETTINGS, NULL, 10000, 100, 1000, 50, 32, 1, FALSE
+        };
+
+        while ( (c = getopt(argc, argv, "d:s:n:b:g:q:j:r:m")) != -1 ) {
+                switch ( c ) {
+                case 'd':
+                        opts.settings = optarg;
+                        break;
+                case 's':
+                        opts.schema = optarg;
+                        break;
+                case 'n':
+                        opts.alerts = strtoul(optarg, NULL, 10);
+                        break;
+                case 'b':
+                        opts.batch = strtoul(optarg, NULL, 10);
+                        break;
+                case 'g':
+                        opts.gets = strtoul(optarg, NULL, 10);
+                        break;
+                case 'q':
+                        opts.queries = strtoul(optarg, NULL, 10);
+                        break;
+                case 'j':
+                        opts.join_paths = strtoul(optarg, NULL, 10);
+                        break;
+                case 'r':
+                        opts.seed = strtoull(optarg, NULL, 10);
+                        break;
+                case 'm':
+                        opts.metrics = TRUE;
+                        break;
+                default:
+                        usage(argv[0]);
+                }
+        }
+
+        if ( opts.batch == 0 || opts.join_paths == 0 )
+                usage(argv[0]);
+
+        /*
+         * xorshift needs a non zero state.
+         */
+        rand_state = opts.seed ? opts.seed : 1;
+
+        ret = preludedb_init();
+        if ( ret < 0 )
+                bench_die("could not initialize libpreludedb", ret);
+
+        ret = preludedb_sql_settings_new_from_string(&settings, opts.settings);
+        if ( ret < 0 )
+                bench_die("could not parse database settings", ret);
+
+        /*
+         * SQLite runs start from a fresh database.
+         */
+        type = preludedb_sql_settings_get_type(settings);
+        if ( type && strcmp(type, "sqlite3") == 0 ) {
+                file = preludedb_sql_settings_get_file(settings);
+                if ( file )
+                        unlink(file);
+
+                if ( ! opts.schema )
+                        opts.schema = BENCH_SCHEMA_DIR "/sqlite.sql";
+        }
+
+        ret = preludedb_sql_new(&sql, NULL, settings);
+        if ( ret < 0 )
+                bench_die("could not open database", ret);
+
+        if ( opts.schema ) {
+                ret = load_schema(sql, opts.schema);
+                if ( ret < 0 )
+                        bench_die("could not load schema", ret);
+        }
+
+        ret = preludedb_new(&db, sql, NULL, errbuf, sizeof(errbuf));
+        if ( ret < 0 ) {
+                fprintf(stderr, "could not create database: %s.\n", errbuf);
+                return 1;
+        }
+
+        preludedb_sql_reset_metrics(sql);
+
+        bench_insert(db, &opts);
+        bench_get(db, &opts);
+        bench_values(db, &opts);
+        bench_join(db, &opts);
+        bench_delete(db);
+
+        if ( opts.metrics )
+                bench_metrics(sql);
+
+        preludedb_destroy(db);
+        preludedb_sql_destroy(sql);
+        preludedb_deinit();
+
+        return 0;
+}
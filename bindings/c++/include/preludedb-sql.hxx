@@ -107,6 +107,10 @@ namespace PreludeDB {
                 bytestring unescapeBinary(const std::string &str);
 
                 uint64_t getLastInsertIdent(void);
+
+                std::map<std::string, std::map<std::string, unsigned long long> > getMetrics(void);
+                uint64_t getEscapedBytes(void);
+                void resetMetrics(void);
                 std::string getType(void) { return preludedb_sql_get_type(_sql); };
 
                 operator preludedb_sql_t *() const;
@@ -25,6 +25,7 @@ namespace PreludeDB {
                         unsigned int getCount(void);
                         unsigned int count() { return getCount(); };
                         uint64_t *get(unsigned int row_index=(unsigned int) -1);
+                        std::string getCursor(void);
 
                         ResultIdents &operator = (const ResultIdents &result);
                 };
@@ -73,6 +74,7 @@ namespace PreludeDB {
                 DB(PreludeDB::SQL &sql);
 
                 ResultIdents getAlertIdents(Prelude::IDMEFCriteria *criteria=NULL, int limit=-1, int offset=-1, const std::vector<std::string> &order=std::vector<std::string>(1, "alert.create_time/order_desc"));
+                ResultIdents getAlertIdentsAfter(Prelude::IDMEFCriteria *criteria=NULL, const std::string &cursor="", int limit=-1, bool desc=true);
                 ResultIdents getHeartbeatIdents(Prelude::IDMEFCriteria *criteria=NULL, int limit=-1, int offset=-1, const std::vector<std::string> &order=std::vector<std::string>(1, "heartbeat.create_time/order_desc"));
                 ResultValues getValues(const std::vector<std::string> &selection, const Prelude::IDMEFCriteria *criteria=NULL, bool distinct=0, int limit=-1, int offset=-1);
 
@@ -80,6 +82,7 @@ namespace PreludeDB {
                 std::string getFormatVersion(void);
 
                 void insert(Prelude::IDMEF &idmef);
+                unsigned int load(const std::vector<Prelude::IDMEF> &idmefs);
 
                 Prelude::IDMEF getAlert(uint64_t ident);
                 Prelude::IDMEF getHeartbeat(uint64_t ident);
@@ -94,6 +97,10 @@ namespace PreludeDB {
  * a vector of unsigned long long, to a vector of unsigned long.
  */
 #define _VECTOR_UINT64_TYPE unsigned long long int
+
+                std::vector<Prelude::IDMEF> getAlerts(const std::vector<_VECTOR_UINT64_TYPE> &idents);
+                std::vector<Prelude::IDMEF> getHeartbeats(const std::vector<_VECTOR_UINT64_TYPE> &idents);
+
                 /*
                  * delete is a reserved keyword
                  */
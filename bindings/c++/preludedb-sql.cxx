@@ -198,10 +198,16 @@ unsigned int SQL::Table::getColumnCount()
 
 unsigned int SQL::Table::getRowCount()
 {
+        int ret;
+
         if ( ! _table )
                 return 0;
 
-        return preludedb_sql_table_get_row_count(_table);
+        ret = preludedb_sql_table_get_row_count(_table);
+        if ( ret < 0 )
+                throw PreludeDBError(ret);
+
+        return ret;
 }
 
 
@@ -499,6 +505,61 @@ uint64_t SQL::getLastInsertIdent()
 }
 
 
+std::map<std::string, std::map<std::string, unsigned long long> > SQL::getMetrics()
+{
+    int ret;
+    preludedb_sql_metrics_t *metrics;
+    preludedb_sql_metrics_statement_t *st = NULL;
+    std::map<std::string, std::map<std::string, unsigned long long> > ret_map;
+
+    ret = preludedb_sql_get_metrics(_sql, &metrics);
+    if ( ret < 0 )
+            throw PreludeDBError(ret);
+
+    while ( (st = preludedb_sql_metrics_get_next_statement(metrics, st)) ) {
+            std::map<std::string, unsigned long long> &m = ret_map[preludedb_sql_metrics_statement_get_name(st)];
+
+            m["calls"] = preludedb_sql_metrics_statement_get_calls(st);
+            m["errors"] = preludedb_sql_metrics_statement_get_errors(st);
+            m["rows"] = preludedb_sql_metrics_statement_get_rows(st);
+            m["fetched_rows"] = preludedb_sql_metrics_statement_get_fetched_rows(st);
+            m["total_time"] = preludedb_sql_metrics_statement_get_total_time(st);
+            m["max_time"] = preludedb_sql_metrics_statement_get_max_time(st);
+            m["p50"] = preludedb_sql_metrics_statement_get_percentile(st, 50);
+            m["p90"] = preludedb_sql_metrics_statement_get_percentile(st, 90);
+            m["p99"] = preludedb_sql_metrics_statement_get_percentile(st, 99);
+            m["p999"] = preludedb_sql_metrics_statement_get_percentile(st, 99.9);
+    }
+
+    preludedb_sql_metrics_destroy(metrics);
+
+    return ret_map;
+}
+
+
+uint64_t SQL::getEscapedBytes()
+{
+    int ret;
+    uint64_t bytes;
+    preludedb_sql_metrics_t *metrics;
+
+    ret = preludedb_sql_get_metrics(_sql, &metrics);
+    if ( ret < 0 )
+            throw PreludeDBError(ret);
+
+    bytes = preludedb_sql_metrics_get_escaped_bytes(metrics);
+    preludedb_sql_metrics_destroy(metrics);
+
+    return bytes;
+}
+
+
+void SQL::resetMetrics()
+{
+    preludedb_sql_reset_metrics(_sql);
+}
+
+
 SQL::operator preludedb_sql_t *() const
 {
         return _sql;
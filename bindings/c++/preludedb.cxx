@@ -106,6 +106,14 @@ uint64_t *DB::ResultIdents::get(unsigned int row_index)
 }
 
 
+std::string DB::ResultIdents::getCursor()
+{
+        const char *cursor = (_result) ? preludedb_result_idents_get_cursor(_result) : NULL;
+
+        return (cursor) ? cursor : "";
+}
+
+
 
 DB::ResultIdents &DB::ResultIdents::operator = (const DB::ResultIdents &result)
 {
@@ -315,7 +323,16 @@ DB::ResultValues::ResultValuesRow *DB::ResultValues::get(unsigned int rownum)
 
 unsigned int DB::ResultValues::getCount()
 {
-        return (_result) ? preludedb_result_values_get_count(_result) : 0;
+        int ret;
+
+        if ( ! _result )
+                return 0;
+
+        ret = preludedb_result_values_get_count(_result);
+        if ( ret < 0 )
+                throw PreludeDBError(ret);
+
+        return ret;
 }
 
 
@@ -419,6 +436,25 @@ DB::ResultIdents DB::getAlertIdents(Prelude::IDMEFCriteria *criteria, int limit,
 }
 
 
+DB::ResultIdents DB::getAlertIdentsAfter(Prelude::IDMEFCriteria *criteria, const std::string &cursor, int limit, bool desc)
+{
+        int ret;
+        idmef_criteria_t *ccriteria = NULL;
+        preludedb_result_idents_t *result;
+
+        if ( criteria )
+                ccriteria = *criteria;
+
+        ret = preludedb_get_alert_idents_after(_db, ccriteria, cursor.empty() ? NULL : cursor.c_str(), limit,
+                                               desc ? PRELUDEDB_RESULT_IDENTS_ORDER_BY_CREATE_TIME_DESC : PRELUDEDB_RESULT_IDENTS_ORDER_BY_CREATE_TIME_ASC,
+                                               &result);
+        if ( ret < 0 )
+                throw PreludeDBError(ret);
+
+        return ResultIdents(this, (ret == 0) ? NULL : result);
+}
+
+
 DB::ResultIdents DB::getHeartbeatIdents(Prelude::IDMEFCriteria *criteria, int limit, int offset, const std::vector<std::string> &order)
 {
         int ret;
@@ -468,6 +504,26 @@ void DB::insert(Prelude::IDMEF &idmef)
 }
 
 
+unsigned int DB::load(const std::vector<Prelude::IDMEF> &idmefs)
+{
+        ssize_t ret;
+        std::vector<idmef_message_t *> messages;
+
+        if ( idmefs.empty() )
+                return 0;
+
+        messages.reserve(idmefs.size());
+        for ( std::vector<Prelude::IDMEF>::const_iterator iter = idmefs.begin(); iter != idmefs.end(); iter++ )
+                messages.push_back((idmef_message_t *) (idmef_object_t *) *iter);
+
+        ret = preludedb_load_messages(_db, &messages[0], messages.size());
+        if ( ret < 0 )
+                throw PreludeDBError(ret);
+
+        return ret;
+}
+
+
 Prelude::IDMEF DB::getAlert(uint64_t ident)
 {
         int ret;
@@ -494,6 +550,45 @@ Prelude::IDMEF DB::getHeartbeat(uint64_t ident)
 }
 
 
+static std::vector<Prelude::IDMEF> _getMessages(preludedb_t *db, const std::vector<_VECTOR_UINT64_TYPE> &idents,
+                                               ssize_t (*get)(preludedb_t *db, uint64_t *idents, size_t size, idmef_message_t **messages))
+{
+        ssize_t ret;
+        std::vector<Prelude::IDMEF> result;
+        std::vector<idmef_message_t *> messages(idents.size());
+
+        if ( idents.empty() )
+                return result;
+
+        ret = get(db, (uint64_t *) &idents[0], idents.size(), &messages[0]);
+        if ( ret < 0 )
+                throw PreludeDBError(ret);
+
+        /*
+         * Idents matching no message are skipped.
+         */
+        result.reserve(ret);
+        for ( size_t i = 0; i < messages.size(); i++ ) {
+                if ( messages[i] )
+                        result.push_back(Prelude::IDMEF((idmef_object_t *) messages[i]));
+        }
+
+        return result;
+}
+
+
+std::vector<Prelude::IDMEF> DB::getAlerts(const std::vector<_VECTOR_UINT64_TYPE> &idents)
+{
+        return _getMessages(_db, idents, preludedb_get_alerts);
+}
+
+
+std::vector<Prelude::IDMEF> DB::getHeartbeats(const std::vector<_VECTOR_UINT64_TYPE> &idents)
+{
+        return _getMessages(_db, idents, preludedb_get_heartbeats);
+}
+
+
 void DB::remove(Prelude::IDMEFCriteria *criteria)
 {
         int ret;
@@ -38,8 +38,11 @@
 %template() std::vector<std::string>;
 %template() std::vector<char*>;
 %template() std::map<std::string,std::string>;
+%template() std::map<std::string,unsigned long long>;
+%template() std::map<std::string,std::map<std::string,unsigned long long> >;
 %template() std::vector<Prelude::IDMEFPath>;
 %template() std::vector<Prelude::IDMEFValue>;
+%template() std::vector<Prelude::IDMEF>;
 
 
 %{
@@ -74,6 +77,7 @@ using namespace PreludeDB;
 %feature("kwargs") PreludeDB::DB::ResultIdents::get;
 %feature("kwargs") PreludeDB::DB::ResultValues::get;
 %feature("kwargs") PreludeDB::DB::getAlertIdents;
+%feature("kwargs") PreludeDB::DB::getAlertIdentsAfter;
 %feature("kwargs") PreludeDB::DB::getHeartbeatIdents;
 %feature("kwargs") PreludeDB::DB::getValues;
 %feature("kwargs") PreludeDB::DB::update;
@@ -81,12 +85,16 @@ using namespace PreludeDB;
 
 %feature("nothread", "0") PreludeDB::SQL::query;
 %feature("nothread", "0") PreludeDB::DB::getAlert;
+%feature("nothread", "0") PreludeDB::DB::getAlerts;
 %feature("nothread", "0") PreludeDB::DB::getAlertIdents;
+%feature("nothread", "0") PreludeDB::DB::getAlertIdentsAfter;
 %feature("nothread", "0") PreludeDB::DB::deleteAlert;
 %feature("nothread", "0") PreludeDB::DB::getHeartbeat;
+%feature("nothread", "0") PreludeDB::DB::getHeartbeats;
 %feature("nothread", "0") PreludeDB::DB::getHeartbeatIdents;
 %feature("nothread", "0") PreludeDB::DB::deleteHeartbeat;
 %feature("nothread", "0") PreludeDB::DB::getValues;
+%feature("nothread", "0") PreludeDB::DB::load;
 %feature("nothread", "0") PreludeDB::DB::update;
 %feature("nothread", "0") PreludeDB::DB::updateFromList;
 
@@ -5832,6 +5832,24 @@ namespace swig {
       }
     
 
+  namespace swig {
+    template <>  struct traits< Prelude::IDMEF > {
+      typedef pointer_category category;
+      static const char* type_name() { return"Prelude::IDMEF"; }
+    };
+  }
+
+
+      namespace swig {
+	template <>  struct traits<std::vector< Prelude::IDMEF, std::allocator< Prelude::IDMEF > > > {
+	  typedef pointer_category category;
+	  static const char* type_name() {
+	    return "std::vector<" "Prelude::IDMEF" "," "std::allocator< Prelude::IDMEF >" " >";
+	  }
+	};
+      }
+    
+
   namespace swig {
     template <>  struct traits< Prelude::IDMEFPath > {
       typedef pointer_category category;
@@ -6218,6 +6236,26 @@ SwigPython_std_pair_setitem (PyObject *a, Py_ssize_t b, PyObject *c)
 	};
       }
     
+
+      namespace swig {
+	template <>  struct traits<std::map< std::string, unsigned long long, std::less< std::string >, std::allocator< std::pair< std::string const,unsigned long long > > > > {
+	  typedef pointer_category category;
+	  static const char* type_name() {
+	    return "std::map<" "std::string" "," "unsigned long long" "," "std::less< std::string >" "," "std::allocator< std::pair< std::string const,unsigned long long > >" " >";
+	  }
+	};
+      }
+    
+
+      namespace swig {
+	template <>  struct traits<std::map< std::string, std::map< std::string,unsigned long long,std::less< std::string >,std::allocator< std::pair< std::string const,unsigned long long > > >, std::less< std::string >, std::allocator< std::pair< std::string const,std::map< std::string,unsigned long long,std::less< std::string >,std::allocator< std::pair< std::string const,unsigned long long > > > > > > > {
+	  typedef pointer_category category;
+	  static const char* type_name() {
+	    return "std::map<" "std::string" "," "std::map< std::string,unsigned long long,std::less< std::string >,std::allocator< std::pair< std::string const,unsigned long long > > >" "," "std::less< std::string >" "," "std::allocator< std::pair< std::string const,std::map< std::string,unsigned long long,std::less< std::string >,std::allocator< std::pair< std::string const,unsigned long long > > > > >" " >";
+	  }
+	};
+      }
+    
 SWIGINTERN GenericIterator< PreludeDB::SQL::Table,PreludeDB::SQL::Table::Row > *PreludeDB_SQL_Table_get__SWIG_1(PreludeDB::SQL::Table *self,PyObject *item){
                 if ( ! PySlice_Check(item) )
                         throw PreludeDB::PreludeDBError("Object is not a slice");
@@ -8774,6 +8812,119 @@ fail:
 }
 
 
+SWIGINTERN PyObject *_wrap_DB_getAlertIdentsAfter(PyObject *self, PyObject *args, PyObject *kwargs) {
+  PyObject *resultobj = 0;
+  PreludeDB::DB *arg1 = (PreludeDB::DB *) 0 ;
+  Prelude::IDMEFCriteria *arg2 = (Prelude::IDMEFCriteria *) NULL ;
+  std::string const &arg3_defvalue = "" ;
+  std::string *arg3 = (std::string *) &arg3_defvalue ;
+  int arg4 = (int) -1 ;
+  bool arg5 = (bool) true ;
+  void *argp1 = 0 ;
+  int res1 = 0 ;
+  int res3 = SWIG_OLDOBJ ;
+  int val4 ;
+  int ecode4 = 0 ;
+  bool val5 ;
+  int ecode5 = 0 ;
+  PyObject * obj1 = 0 ;
+  PyObject * obj2 = 0 ;
+  PyObject * obj3 = 0 ;
+  PyObject * obj4 = 0 ;
+  char * kwnames[] = {
+    (char *)"criteria",  (char *)"cursor",  (char *)"limit",  (char *)"desc",  NULL 
+  };
+  PreludeDB::DB::ResultIdents result;
+  
+  if (!PyArg_ParseTupleAndKeywords(args, kwargs, "|OOOO:DB_getAlertIdentsAfter", kwnames, &obj1, &obj2, &obj3, &obj4)) SWIG_fail;
+  res1 = SWIG_ConvertPtr(self, &argp1,SWIGTYPE_p_PreludeDB__DB, 0 |  0 );
+  if (!SWIG_IsOK(res1)) {
+    SWIG_exception_fail(SWIG_ArgError(res1), "in method '" "DB_getAlertIdentsAfter" "', argument " "1"" of type '" "PreludeDB::DB *""'"); 
+  }
+  arg1 = reinterpret_cast< PreludeDB::DB * >(argp1);
+  if (obj1) {
+    {
+      int ret, alloc = 0;
+      void *crit = NULL;
+      char *strin = NULL;
+      
+      ret = SWIG_AsCharPtrAndSize(obj1, &strin, NULL, &alloc);
+      if ( SWIG_IsOK(ret) ) {
+        if ( strin ) {
+          try {
+            arg2 = new Prelude::IDMEFCriteria(strin);
+          } catch (Prelude::PreludeError &err) {
+            SWIG_exception_fail(SWIG_ArgError(res1), err);
+          }
+        }
+      } else {
+        ret = SWIG_ConvertPtr(obj1, &crit, SWIGTYPE_p_Prelude__IDMEFCriteria, 0);
+        if ( SWIG_IsOK(ret) )
+        arg2 = new Prelude::IDMEFCriteria(*(Prelude::IDMEFCriteria *) crit);
+      }
+      
+      if ( ! SWIG_IsOK(ret) )
+      SWIG_exception_fail(SWIG_ArgError(res1), "Input should be a Prelude::IDMEFCriteria or string");
+    }
+  }
+  if (obj2) {
+    {
+      std::string *ptr = (std::string *)0;
+      res3 = SWIG_AsPtr_std_string(obj2, &ptr);
+      if (!SWIG_IsOK(res3)) {
+        SWIG_exception_fail(SWIG_ArgError(res3), "in method '" "DB_getAlertIdentsAfter" "', argument " "3"" of type '" "std::string const &""'"); 
+      }
+      if (!ptr) {
+        SWIG_exception_fail(SWIG_ValueError, "invalid null reference " "in method '" "DB_getAlertIdentsAfter" "', argument " "3"" of type '" "std::string const &""'"); 
+      }
+      arg3 = ptr;
+    }
+  }
+  if (obj3) {
+    ecode4 = SWIG_AsVal_int(obj3, &val4);
+    if (!SWIG_IsOK(ecode4)) {
+      SWIG_exception_fail(SWIG_ArgError(ecode4), "in method '" "DB_getAlertIdentsAfter" "', argument " "4"" of type '" "int""'");
+    } 
+    arg4 = static_cast< int >(val4);
+  }
+  if (obj4) {
+    ecode5 = SWIG_AsVal_bool(obj4, &val5);
+    if (!SWIG_IsOK(ecode5)) {
+      SWIG_exception_fail(SWIG_ArgError(ecode5), "in method '" "DB_getAlertIdentsAfter" "', argument " "5"" of type '" "bool""'");
+    } 
+    arg5 = static_cast< bool >(val5);
+  }
+  
+  try {
+    {
+      SWIG_PYTHON_THREAD_BEGIN_ALLOW;
+      result = (arg1)->getAlertIdentsAfter(arg2,(std::string const &)*arg3,arg4,arg5);
+      SWIG_PYTHON_THREAD_END_ALLOW;
+    }
+  } catch (PreludeDBError &e) {
+    SWIG_Python_Raise(SWIG_NewPointerObj(new PreludeDBError(e),
+        SWIGTYPE_p_PreludeDB__PreludeDBError, SWIG_POINTER_OWN),
+      "PreludeDBError", SWIGTYPE_p_PreludeDB__PreludeDBError);
+    SWIG_fail;
+  }
+  
+  resultobj = SWIG_NewPointerObj((new PreludeDB::DB::ResultIdents(static_cast< const PreludeDB::DB::ResultIdents& >(result))), SWIGTYPE_p_PreludeDB__DB__ResultIdents, SWIG_POINTER_OWN |  0 );
+  {
+    if ( arg2 )
+    delete(arg2);
+  }
+  if (SWIG_IsNewObj(res3)) delete arg3;
+  return resultobj;
+fail:
+  {
+    if ( arg2 )
+    delete(arg2);
+  }
+  if (SWIG_IsNewObj(res3)) delete arg3;
+  return NULL;
+}
+
+
 SWIGINTERN PyObject *_wrap_DB_getHeartbeatIdents(PyObject *self, PyObject *args, PyObject *kwargs) {
   PyObject *resultobj = 0;
   PreludeDB::DB *arg1 = (PreludeDB::DB *) 0 ;
@@ -9112,6 +9263,57 @@ fail:
 }
 
 
+SWIGINTERN PyObject *_wrap_DB_load(PyObject *self, PyObject *args) {
+  PyObject *resultobj = 0;
+  PreludeDB::DB *arg1 = (PreludeDB::DB *) 0 ;
+  std::vector< Prelude::IDMEF,std::allocator< Prelude::IDMEF > > *arg2 = 0 ;
+  void *argp1 = 0 ;
+  int res1 = 0 ;
+  int res2 = SWIG_OLDOBJ ;
+  PyObject *swig_obj[2] ;
+  unsigned int result;
+  
+  if (!args) SWIG_fail;
+  swig_obj[0] = args;
+  res1 = SWIG_ConvertPtr(self, &argp1,SWIGTYPE_p_PreludeDB__DB, 0 |  0 );
+  if (!SWIG_IsOK(res1)) {
+    SWIG_exception_fail(SWIG_ArgError(res1), "in method '" "DB_load" "', argument " "1"" of type '" "PreludeDB::DB *""'"); 
+  }
+  arg1 = reinterpret_cast< PreludeDB::DB * >(argp1);
+  {
+    std::vector< Prelude::IDMEF,std::allocator< Prelude::IDMEF > > *ptr = (std::vector< Prelude::IDMEF,std::allocator< Prelude::IDMEF > > *)0;
+    res2 = swig::asptr(swig_obj[0], &ptr);
+    if (!SWIG_IsOK(res2)) {
+      SWIG_exception_fail(SWIG_ArgError(res2), "in method '" "DB_load" "', argument " "2"" of type '" "std::vector< Prelude::IDMEF,std::allocator< Prelude::IDMEF > > const &""'"); 
+    }
+    if (!ptr) {
+      SWIG_exception_fail(SWIG_ValueError, "invalid null reference " "in method '" "DB_load" "', argument " "2"" of type '" "std::vector< Prelude::IDMEF,std::allocator< Prelude::IDMEF > > const &""'"); 
+    }
+    arg2 = ptr;
+  }
+  
+  try {
+    {
+      SWIG_PYTHON_THREAD_BEGIN_ALLOW;
+      result = (unsigned int)(arg1)->load((std::vector< Prelude::IDMEF,std::allocator< Prelude::IDMEF > > const &)*arg2);
+      SWIG_PYTHON_THREAD_END_ALLOW;
+    }
+  } catch (PreludeDBError &e) {
+    SWIG_Python_Raise(SWIG_NewPointerObj(new PreludeDBError(e),
+        SWIGTYPE_p_PreludeDB__PreludeDBError, SWIG_POINTER_OWN),
+      "PreludeDBError", SWIGTYPE_p_PreludeDB__PreludeDBError);
+    SWIG_fail;
+  }
+  
+  resultobj = SWIG_From_unsigned_SS_int(static_cast< unsigned int >(result));
+  if (SWIG_IsNewObj(res2)) delete arg2;
+  return resultobj;
+fail:
+  if (SWIG_IsNewObj(res2)) delete arg2;
+  return NULL;
+}
+
+
 SWIGINTERN PyObject *_wrap_DB_getAlert(PyObject *self, PyObject *args) {
   PyObject *resultobj = 0;
   PreludeDB::DB *arg1 = (PreludeDB::DB *) 0 ;
@@ -9200,6 +9402,108 @@ fail:
 }
 
 
+SWIGINTERN PyObject *_wrap_DB_getAlerts(PyObject *self, PyObject *args) {
+  PyObject *resultobj = 0;
+  PreludeDB::DB *arg1 = (PreludeDB::DB *) 0 ;
+  std::vector< unsigned long long,std::allocator< unsigned long long > > *arg2 = 0 ;
+  void *argp1 = 0 ;
+  int res1 = 0 ;
+  int res2 = SWIG_OLDOBJ ;
+  PyObject *swig_obj[2] ;
+  std::vector< Prelude::IDMEF,std::allocator< Prelude::IDMEF > > result;
+  
+  if (!args) SWIG_fail;
+  swig_obj[0] = args;
+  res1 = SWIG_ConvertPtr(self, &argp1,SWIGTYPE_p_PreludeDB__DB, 0 |  0 );
+  if (!SWIG_IsOK(res1)) {
+    SWIG_exception_fail(SWIG_ArgError(res1), "in method '" "DB_getAlerts" "', argument " "1"" of type '" "PreludeDB::DB *""'"); 
+  }
+  arg1 = reinterpret_cast< PreludeDB::DB * >(argp1);
+  {
+    std::vector< unsigned long long,std::allocator< unsigned long long > > *ptr = (std::vector< unsigned long long,std::allocator< unsigned long long > > *)0;
+    res2 = swig::asptr(swig_obj[0], &ptr);
+    if (!SWIG_IsOK(res2)) {
+      SWIG_exception_fail(SWIG_ArgError(res2), "in method '" "DB_getAlerts" "', argument " "2"" of type '" "std::vector< unsigned long long,std::allocator< unsigned long long > > const &""'"); 
+    }
+    if (!ptr) {
+      SWIG_exception_fail(SWIG_ValueError, "invalid null reference " "in method '" "DB_getAlerts" "', argument " "2"" of type '" "std::vector< unsigned long long,std::allocator< unsigned long long > > const &""'"); 
+    }
+    arg2 = ptr;
+  }
+  
+  try {
+    {
+      SWIG_PYTHON_THREAD_BEGIN_ALLOW;
+      result = (arg1)->getAlerts((std::vector< unsigned long long,std::allocator< unsigned long long > > const &)*arg2);
+      SWIG_PYTHON_THREAD_END_ALLOW;
+    }
+  } catch (PreludeDBError &e) {
+    SWIG_Python_Raise(SWIG_NewPointerObj(new PreludeDBError(e),
+        SWIGTYPE_p_PreludeDB__PreludeDBError, SWIG_POINTER_OWN),
+      "PreludeDBError", SWIGTYPE_p_PreludeDB__PreludeDBError);
+    SWIG_fail;
+  }
+  
+  resultobj = swig::from(static_cast< std::vector< Prelude::IDMEF,std::allocator< Prelude::IDMEF > > >(result));
+  if (SWIG_IsNewObj(res2)) delete arg2;
+  return resultobj;
+fail:
+  if (SWIG_IsNewObj(res2)) delete arg2;
+  return NULL;
+}
+
+
+SWIGINTERN PyObject *_wrap_DB_getHeartbeats(PyObject *self, PyObject *args) {
+  PyObject *resultobj = 0;
+  PreludeDB::DB *arg1 = (PreludeDB::DB *) 0 ;
+  std::vector< unsigned long long,std::allocator< unsigned long long > > *arg2 = 0 ;
+  void *argp1 = 0 ;
+  int res1 = 0 ;
+  int res2 = SWIG_OLDOBJ ;
+  PyObject *swig_obj[2] ;
+  std::vector< Prelude::IDMEF,std::allocator< Prelude::IDMEF > > result;
+  
+  if (!args) SWIG_fail;
+  swig_obj[0] = args;
+  res1 = SWIG_ConvertPtr(self, &argp1,SWIGTYPE_p_PreludeDB__DB, 0 |  0 );
+  if (!SWIG_IsOK(res1)) {
+    SWIG_exception_fail(SWIG_ArgError(res1), "in method '" "DB_getHeartbeats" "', argument " "1"" of type '" "PreludeDB::DB *""'"); 
+  }
+  arg1 = reinterpret_cast< PreludeDB::DB * >(argp1);
+  {
+    std::vector< unsigned long long,std::allocator< unsigned long long > > *ptr = (std::vector< unsigned long long,std::allocator< unsigned long long > > *)0;
+    res2 = swig::asptr(swig_obj[0], &ptr);
+    if (!SWIG_IsOK(res2)) {
+      SWIG_exception_fail(SWIG_ArgError(res2), "in method '" "DB_getHeartbeats" "', argument " "2"" of type '" "std::vector< unsigned long long,std::allocator< unsigned long long > > const &""'"); 
+    }
+    if (!ptr) {
+      SWIG_exception_fail(SWIG_ValueError, "invalid null reference " "in method '" "DB_getHeartbeats" "', argument " "2"" of type '" "std::vector< unsigned long long,std::allocator< unsigned long long > > const &""'"); 
+    }
+    arg2 = ptr;
+  }
+  
+  try {
+    {
+      SWIG_PYTHON_THREAD_BEGIN_ALLOW;
+      result = (arg1)->getHeartbeats((std::vector< unsigned long long,std::allocator< unsigned long long > > const &)*arg2);
+      SWIG_PYTHON_THREAD_END_ALLOW;
+    }
+  } catch (PreludeDBError &e) {
+    SWIG_Python_Raise(SWIG_NewPointerObj(new PreludeDBError(e),
+        SWIGTYPE_p_PreludeDB__PreludeDBError, SWIG_POINTER_OWN),
+      "PreludeDBError", SWIGTYPE_p_PreludeDB__PreludeDBError);
+    SWIG_fail;
+  }
+  
+  resultobj = swig::from(static_cast< std::vector< Prelude::IDMEF,std::allocator< Prelude::IDMEF > > >(result));
+  if (SWIG_IsNewObj(res2)) delete arg2;
+  return resultobj;
+fail:
+  if (SWIG_IsNewObj(res2)) delete arg2;
+  return NULL;
+}
+
+
 SWIGINTERN PyObject *_wrap_DB_remove(PyObject *self, PyObject *args) {
   PyObject *resultobj = 0;
   PreludeDB::DB *arg1 = (PreludeDB::DB *) 0 ;
@@ -10561,6 +10865,37 @@ fail:
 }
 
 
+SWIGINTERN PyObject *_wrap_ResultIdents_getCursor(PyObject *self, PyObject *args) {
+  PyObject *resultobj = 0;
+  PreludeDB::DB::ResultIdents *arg1 = (PreludeDB::DB::ResultIdents *) 0 ;
+  void *argp1 = 0 ;
+  int res1 = 0 ;
+  PyObject *swig_obj[1] ;
+  std::string result;
+  
+  if (!SWIG_Python_UnpackTuple(args, "ResultIdents_getCursor", 0, 0, 0)) SWIG_fail;
+  res1 = SWIG_ConvertPtr(self, &argp1,SWIGTYPE_p_PreludeDB__DB__ResultIdents, 0 |  0 );
+  if (!SWIG_IsOK(res1)) {
+    SWIG_exception_fail(SWIG_ArgError(res1), "in method '" "ResultIdents_getCursor" "', argument " "1"" of type '" "PreludeDB::DB::ResultIdents *""'"); 
+  }
+  arg1 = reinterpret_cast< PreludeDB::DB::ResultIdents * >(argp1);
+  
+  try {
+    result = (arg1)->getCursor();
+  } catch (PreludeDBError &e) {
+    SWIG_Python_Raise(SWIG_NewPointerObj(new PreludeDBError(e),
+        SWIGTYPE_p_PreludeDB__PreludeDBError, SWIG_POINTER_OWN),
+      "PreludeDBError", SWIGTYPE_p_PreludeDB__PreludeDBError);
+    SWIG_fail;
+  }
+  
+  resultobj = SWIG_From_std_string(static_cast< std::string >(result));
+  return resultobj;
+fail:
+  return NULL;
+}
+
+
 SWIGINTERN PyObject *_wrap_ResultIdents___iter__(PyObject *self, PyObject *args) {
   PyObject *resultobj = 0;
   PreludeDB::DB::ResultIdents *arg1 = (PreludeDB::DB::ResultIdents *) 0 ;
@@ -12379,6 +12714,98 @@ fail:
 }
 
 
+SWIGINTERN PyObject *_wrap_SQL_getMetrics(PyObject *self, PyObject *args) {
+  PyObject *resultobj = 0;
+  PreludeDB::SQL *arg1 = (PreludeDB::SQL *) 0 ;
+  void *argp1 = 0 ;
+  int res1 = 0 ;
+  PyObject *swig_obj[1] ;
+  std::map< std::string,std::map< std::string,unsigned long long,std::less< std::string >,std::allocator< std::pair< std::string const,unsigned long long > > >,std::less< std::string >,std::allocator< std::pair< std::string const,std::map< std::string,unsigned long long,std::less< std::string >,std::allocator< std::pair< std::string const,unsigned long long > > > > > > result;
+  
+  if (!SWIG_Python_UnpackTuple(args, "SQL_getMetrics", 0, 0, 0)) SWIG_fail;
+  res1 = SWIG_ConvertPtr(self, &argp1,SWIGTYPE_p_PreludeDB__SQL, 0 |  0 );
+  if (!SWIG_IsOK(res1)) {
+    SWIG_exception_fail(SWIG_ArgError(res1), "in method '" "SQL_getMetrics" "', argument " "1"" of type '" "PreludeDB::SQL *""'"); 
+  }
+  arg1 = reinterpret_cast< PreludeDB::SQL * >(argp1);
+  
+  try {
+    result = (arg1)->getMetrics();
+  } catch (PreludeDBError &e) {
+    SWIG_Python_Raise(SWIG_NewPointerObj(new PreludeDBError(e),
+        SWIGTYPE_p_PreludeDB__PreludeDBError, SWIG_POINTER_OWN),
+      "PreludeDBError", SWIGTYPE_p_PreludeDB__PreludeDBError);
+    SWIG_fail;
+  }
+  
+  resultobj = swig::from(static_cast< std::map< std::string,std::map< std::string,unsigned long long,std::less< std::string >,std::allocator< std::pair< std::string const,unsigned long long > > >,std::less< std::string >,std::allocator< std::pair< std::string const,std::map< std::string,unsigned long long,std::less< std::string >,std::allocator< std::pair< std::string const,unsigned long long > > > > > > >(result));
+  return resultobj;
+fail:
+  return NULL;
+}
+
+
+SWIGINTERN PyObject *_wrap_SQL_getEscapedBytes(PyObject *self, PyObject *args) {
+  PyObject *resultobj = 0;
+  PreludeDB::SQL *arg1 = (PreludeDB::SQL *) 0 ;
+  void *argp1 = 0 ;
+  int res1 = 0 ;
+  PyObject *swig_obj[1] ;
+  uint64_t result;
+  
+  if (!SWIG_Python_UnpackTuple(args, "SQL_getEscapedBytes", 0, 0, 0)) SWIG_fail;
+  res1 = SWIG_ConvertPtr(self, &argp1,SWIGTYPE_p_PreludeDB__SQL, 0 |  0 );
+  if (!SWIG_IsOK(res1)) {
+    SWIG_exception_fail(SWIG_ArgError(res1), "in method '" "SQL_getEscapedBytes" "', argument " "1"" of type '" "PreludeDB::SQL *""'"); 
+  }
+  arg1 = reinterpret_cast< PreludeDB::SQL * >(argp1);
+  
+  try {
+    result = (uint64_t)(arg1)->getEscapedBytes();
+  } catch (PreludeDBError &e) {
+    SWIG_Python_Raise(SWIG_NewPointerObj(new PreludeDBError(e),
+        SWIGTYPE_p_PreludeDB__PreludeDBError, SWIG_POINTER_OWN),
+      "PreludeDBError", SWIGTYPE_p_PreludeDB__PreludeDBError);
+    SWIG_fail;
+  }
+  
+  resultobj = SWIG_From_unsigned_SS_long_SS_long(static_cast< unsigned long long >(result));
+  return resultobj;
+fail:
+  return NULL;
+}
+
+
+SWIGINTERN PyObject *_wrap_SQL_resetMetrics(PyObject *self, PyObject *args) {
+  PyObject *resultobj = 0;
+  PreludeDB::SQL *arg1 = (PreludeDB::SQL *) 0 ;
+  void *argp1 = 0 ;
+  int res1 = 0 ;
+  PyObject *swig_obj[1] ;
+  
+  if (!SWIG_Python_UnpackTuple(args, "SQL_resetMetrics", 0, 0, 0)) SWIG_fail;
+  res1 = SWIG_ConvertPtr(self, &argp1,SWIGTYPE_p_PreludeDB__SQL, 0 |  0 );
+  if (!SWIG_IsOK(res1)) {
+    SWIG_exception_fail(SWIG_ArgError(res1), "in method '" "SQL_resetMetrics" "', argument " "1"" of type '" "PreludeDB::SQL *""'"); 
+  }
+  arg1 = reinterpret_cast< PreludeDB::SQL * >(argp1);
+  
+  try {
+    (arg1)->resetMetrics();
+  } catch (PreludeDBError &e) {
+    SWIG_Python_Raise(SWIG_NewPointerObj(new PreludeDBError(e),
+        SWIGTYPE_p_PreludeDB__PreludeDBError, SWIG_POINTER_OWN),
+      "PreludeDBError", SWIGTYPE_p_PreludeDB__PreludeDBError);
+    SWIG_fail;
+  }
+  
+  resultobj = SWIG_Py_Void();
+  return resultobj;
+fail:
+  return NULL;
+}
+
+
 SWIGINTERN PyObject *_wrap_SQL_getType(PyObject *self, PyObject *args) {
   PyObject *resultobj = 0;
   PreludeDB::SQL *arg1 = (PreludeDB::SQL *) 0 ;
@@ -15107,13 +15534,17 @@ SwigPyBuiltin__PreludeDB__DB_richcompare(PyObject *self, PyObject *other, int op
 
 SWIGINTERN PyMethodDef SwigPyBuiltin__PreludeDB__DB_methods[] = {
   { "getAlertIdents", (PyCFunction)(void(*)(void))_wrap_DB_getAlertIdents, METH_VARARGS|METH_KEYWORDS, "" },
+  { "getAlertIdentsAfter", (PyCFunction)(void(*)(void))_wrap_DB_getAlertIdentsAfter, METH_VARARGS|METH_KEYWORDS, "" },
   { "getHeartbeatIdents", (PyCFunction)(void(*)(void))_wrap_DB_getHeartbeatIdents, METH_VARARGS|METH_KEYWORDS, "" },
   { "getValues", (PyCFunction)(void(*)(void))_wrap_DB_getValues, METH_VARARGS|METH_KEYWORDS, "" },
   { "getFormatName", _wrap_DB_getFormatName, METH_NOARGS, "" },
   { "getFormatVersion", _wrap_DB_getFormatVersion, METH_NOARGS, "" },
   { "insert", _wrap_DB_insert, METH_O, "" },
+  { "load", _wrap_DB_load, METH_O, "" },
   { "getAlert", _wrap_DB_getAlert, METH_O, "" },
   { "getHeartbeat", _wrap_DB_getHeartbeat, METH_O, "" },
+  { "getAlerts", _wrap_DB_getAlerts, METH_O, "" },
+  { "getHeartbeats", _wrap_DB_getHeartbeats, METH_O, "" },
   { "remove", _wrap_DB_remove, METH_O, "" },
   { "deleteAlert", _wrap_DB_deleteAlert, METH_VARARGS, "" },
   { "deleteHeartbeat", _wrap_DB_deleteHeartbeat, METH_VARARGS, "" },
@@ -15335,6 +15766,7 @@ SWIGINTERN PyMethodDef SwigPyBuiltin__PreludeDB__DB__ResultIdents_methods[] = {
   { "getCount", _wrap_ResultIdents_getCount, METH_NOARGS, "" },
   { "count", _wrap_ResultIdents_count, METH_NOARGS, "" },
   { "get", (PyCFunction)(void(*)(void))_wrap_ResultIdents_get, METH_VARARGS|METH_KEYWORDS, "" },
+  { "getCursor", _wrap_ResultIdents_getCursor, METH_NOARGS, "" },
   { "__iter__", _wrap_ResultIdents___iter__, METH_NOARGS, "" },
   { NULL, NULL, 0, NULL } /* Sentinel */
 };
@@ -16185,6 +16617,9 @@ SWIGINTERN PyMethodDef SwigPyBuiltin__PreludeDB__SQL_methods[] = {
   { "escapeBinary", _wrap_SQL_escapeBinary, METH_O, "" },
   { "unescapeBinary", _wrap_SQL_unescapeBinary, METH_O, "" },
   { "getLastInsertIdent", _wrap_SQL_getLastInsertIdent, METH_NOARGS, "" },
+  { "getMetrics", _wrap_SQL_getMetrics, METH_NOARGS, "" },
+  { "getEscapedBytes", _wrap_SQL_getEscapedBytes, METH_NOARGS, "" },
+  { "resetMetrics", _wrap_SQL_resetMetrics, METH_NOARGS, "" },
   { "getType", _wrap_SQL_getType, METH_NOARGS, "" },
   { NULL, NULL, 0, NULL } /* Sentinel */
 };
@@ -26,6 +26,7 @@
 #include <stdlib.h>
 #include <stdio.h>
 #include <string.h>
+#include <errno.h>
 #include <sys/types.h>
 
 #include <libprelude/prelude-log.h>
@@ -37,17 +38,29 @@
 #include "preludedb.h"
 
 #include "classic-delete.h"
+#include "classic-rollup.h"
 
 
-static int delete_message(preludedb_sql_t *sql, unsigned int count, const char **queries, const char *idents)
+static int delete_message(preludedb_t *db, unsigned int count, const char **queries, const char *idents,
+                          prelude_bool_t is_alert)
 {
         unsigned int i;
         int ret, tmp;
+        preludedb_sql_t *sql = preludedb_get_sql(db);
 
         ret = preludedb_sql_transaction_start(sql);
         if ( ret < 0 )
                 return ret;
 
+        /*
+         * Rollups are read from the rows about to be deleted.
+         */
+        if ( is_alert ) {
+                ret = classic_rollup_remove_alerts(preludedb_get_data(db), sql, idents);
+                if ( ret < 0 )
+                        goto error;
+        }
+
         for ( i = 0; i < count; i++ ) {
 
                 ret = preludedb_sql_query_sprintf(sql, NULL, queries[i], idents);
@@ -65,7 +78,7 @@ static int delete_message(preludedb_sql_t *sql, unsigned int count, const char *
 }
 
 
-static int do_delete_alert(preludedb_sql_t *sql, const char *idents)
+static int do_delete_alert(preludedb_t *db, const char *idents)
 {
         static const char *queries[] = {
                 "DELETE FROM Prelude_Action WHERE _message_ident %s",
@@ -105,12 +118,12 @@ static int do_delete_alert(preludedb_sql_t *sql, const char *idents)
                 "DELETE FROM Prelude_WebServiceArg WHERE _message_ident %s"
         };
 
-        return delete_message(sql, sizeof(queries) / sizeof(*queries), queries, idents);
+        return delete_message(db, sizeof(queries) / sizeof(*queries), queries, idents, TRUE);
 }
 
 
 
-static int do_delete_heartbeat(preludedb_sql_t *sql, const char *idents)
+static int do_delete_heartbeat(preludedb_t *db, const char *idents)
 {
         static const char *queries[] = {
                 "DELETE FROM Prelude_AdditionalData WHERE _parent_type = 'H' AND _message_ident %s",
@@ -125,11 +138,11 @@ static int do_delete_heartbeat(preludedb_sql_t *sql, const char *idents)
                 "DELETE FROM Prelude_Heartbeat WHERE _ident %s",
         };
 
-        return delete_message(sql, sizeof(queries) / sizeof(*queries), queries, idents);
+        return delete_message(db, sizeof(queries) / sizeof(*queries), queries, idents, FALSE);
 }
 
 
-static ssize_t get_string_from_ident_list(prelude_string_t **out, uint64_t *ident, size_t size)
+ssize_t classic_get_string_from_ident_list(prelude_string_t **out, uint64_t *ident, size_t size)
 {
         int ret;
         size_t i;
@@ -165,7 +178,7 @@ static ssize_t get_string_from_ident_list(prelude_string_t **out, uint64_t *iden
 
 
 
-static ssize_t get_string_from_result_ident(prelude_string_t **out, preludedb_result_idents_t *res)
+ssize_t classic_get_string_from_result_ident(prelude_string_t **out, preludedb_result_idents_t *res)
 {
         int ret;
         uint64_t ident;
@@ -214,7 +227,7 @@ int classic_delete_alert(preludedb_t *db, uint64_t ident)
 
         snprintf(buf, sizeof(buf), "= %" PRELUDE_PRIu64, ident);
 
-        return do_delete_alert(preludedb_get_sql(db), buf);
+        return do_delete_alert(db, buf);
 }
 
 
@@ -225,7 +238,7 @@ int classic_delete_heartbeat(preludedb_t *db, uint64_t ident)
 
         snprintf(buf, sizeof(buf), "= %" PRELUDE_PRIu64, ident);
 
-        return do_delete_heartbeat(preludedb_get_sql(db), buf);
+        return do_delete_heartbeat(db, buf);
 }
 
 
@@ -236,11 +249,11 @@ ssize_t classic_delete_alert_from_result_idents(preludedb_t *db, preludedb_resul
         ssize_t count;
         prelude_string_t *buf;
 
-        count = get_string_from_result_ident(&buf, results);
+        count = classic_get_string_from_result_ident(&buf, results);
         if ( count <= 0 )
                 return count;
 
-        ret = do_delete_alert(preludedb_get_sql(db), prelude_string_get_string(buf));
+        ret = do_delete_alert(db, prelude_string_get_string(buf));
         prelude_string_destroy(buf);
 
         return (ret < 0) ? ret : count;
@@ -253,11 +266,11 @@ ssize_t classic_delete_alert_from_list(preludedb_t *db, uint64_t *ident, size_t
         ssize_t count;
         prelude_string_t *buf;
 
-        count = get_string_from_ident_list(&buf, ident, size);
+        count = classic_get_string_from_ident_list(&buf, ident, size);
         if ( count < 0 )
                 return count;
 
-        ret = do_delete_alert(preludedb_get_sql(db), prelude_string_get_string(buf));
+        ret = do_delete_alert(db, prelude_string_get_string(buf));
         prelude_string_destroy(buf);
 
         return (ret < 0) ? ret : count;
@@ -271,11 +284,11 @@ ssize_t classic_delete_heartbeat_from_result_idents(preludedb_t *db, preludedb_r
         ssize_t count;
         prelude_string_t *buf;
 
-        count = get_string_from_result_ident(&buf, results);
+        count = classic_get_string_from_result_ident(&buf, results);
         if ( count <= 0 )
                 return count;
 
-        ret = do_delete_heartbeat(preludedb_get_sql(db), prelude_string_get_string(buf));
+        ret = do_delete_heartbeat(db, prelude_string_get_string(buf));
         prelude_string_destroy(buf);
 
         return (ret < 0) ? ret : count;
@@ -289,12 +302,84 @@ ssize_t classic_delete_heartbeat_from_list(preludedb_t *db, uint64_t *ident, siz
         ssize_t count;
         prelude_string_t *buf;
 
-        count = get_string_from_ident_list(&buf, ident, size);
+        count = classic_get_string_from_ident_list(&buf, ident, size);
         if ( count < 0 )
                 return count;
 
-        ret = do_delete_heartbeat(preludedb_get_sql(db), prelude_string_get_string(buf));
+        ret = do_delete_heartbeat(db, prelude_string_get_string(buf));
         prelude_string_destroy(buf);
 
         return (ret < 0) ? ret : count;
 }
+
+
+
+/*
+ * Partitions are managed server side by the functions of the partitioned
+ * schema variant (pgsql-partitioned.sql).
+ */
+static int has_partitions(preludedb_sql_t *sql)
+{
+        int ret;
+        preludedb_sql_table_t *table;
+
+        if ( strcmp(preludedb_sql_get_type(sql), "pgsql") != 0 )
+                return 0;
+
+        ret = preludedb_sql_query(sql, "SELECT 1 FROM pg_proc WHERE proname = 'prelude_partition_drop_before'", &table);
+        if ( ret <= 0 )
+                return ret;
+
+        preludedb_sql_table_destroy(table);
+
+        return 1;
+}
+
+
+
+int classic_drop_partitions_before(preludedb_t *db, const idmef_time_t *time)
+{
+        int ret, tmp;
+        int32_t count;
+        preludedb_sql_row_t *row;
+        preludedb_sql_field_t *field;
+        preludedb_sql_table_t *table;
+        preludedb_sql_t *sql = preludedb_get_sql(db);
+        char buf[PRELUDEDB_SQL_TIMESTAMP_STRING_SIZE];
+
+        ret = has_partitions(sql);
+        if ( ret < 0 )
+                return ret;
+
+        if ( ret == 0 )
+                return preludedb_error_verbose(prelude_error_code_from_errno(ENOSYS), "database does not use the partitioned schema");
+
+        ret = preludedb_sql_time_to_timestamp(sql, time, buf, sizeof(buf), NULL, 0, NULL, 0);
+        if ( ret < 0 )
+                return ret;
+
+        ret = preludedb_sql_query_sprintf(sql, &table, "SELECT prelude_partition_drop_before(%s)", buf);
+        if ( ret <= 0 )
+                return ret;
+
+        ret = preludedb_sql_table_fetch_row(table, &row);
+        if ( ret <= 0 )
+                goto out;
+
+        ret = preludedb_sql_row_get_field(row, 0, &field);
+        if ( ret <= 0 )
+                goto out;
+
+        ret = preludedb_sql_field_to_int32(field, &count);
+        if ( ret >= 0 )
+                ret = count;
+
+ out:
+        preludedb_sql_table_destroy(table);
+        if ( ret <= 0 )
+                return ret;
+
+        tmp = classic_rollup_trim(preludedb_get_data(db), sql);
+
+        return (tmp < 0) ? tmp : ret;
+}
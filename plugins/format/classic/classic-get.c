@@ -25,6 +25,7 @@
 
 #include <stdlib.h>
 #include <stdio.h>
+#include <errno.h>
 #include <string.h>
 #include <sys/types.h>
 #include <time.h>
@@ -39,8 +40,397 @@
 #define db_log(sql) prelude_log(PRELUDE_LOG_ERR, "%s\n", prelude_sql_error(sql))
 #define log_memory_exhausted() prelude_log(PRELUDE_LOG_ERR, "memory exhausted !\n")
 
+/*
+ * Every child table of a message is retrieved at most once, with a single
+ * query returning all the rows belonging to the message, the idmef tree is
+ * then assembled by looking up the prefetched rows in memory.
+ *
+ * Besides the requested fields, each prefetched row carries the key columns
+ * (_message_ident followed by the _parent_type / _parentN_index columns the
+ * table has), so that they can be matched against the parent being built.
+ *
+ * When several messages are retrieved at once, each table is queried once
+ * for the whole ident list and ordered by ident: messages are then built in
+ * ascending ident order, each table keeping the offset of the first row not
+ * yet consumed. Large lists are split in chunks of GET_MESSAGES_CHUNK_SIZE
+ * idents, to keep the queries within the backends size limits.
+ */
+#define GET_MESSAGES_CHUNK_SIZE 500
+
+#define GET_KEY_PARENT_TYPE   0x01
+#define GET_KEY_PARENT0_INDEX 0x02
+#define GET_KEY_PARENT1_INDEX 0x04
+#define GET_KEY_PARENT2_INDEX 0x08
+#define GET_KEY_INDEX         0x10
+#define GET_KEY_IDENT         0x20
+
+typedef enum {
+        GET_TABLE_ANALYZER_TIME,
+        GET_TABLE_DETECT_TIME,
+        GET_TABLE_CREATE_TIME,
+        GET_TABLE_USER_ID,
+        GET_TABLE_USER,
+        GET_TABLE_PROCESS_ARG,
+        GET_TABLE_PROCESS_ENV,
+        GET_TABLE_PROCESS,
+        GET_TABLE_WEB_SERVICE_ARG,
+        GET_TABLE_WEB_SERVICE,
+        GET_TABLE_SNMP_SERVICE,
+        GET_TABLE_SERVICE,
+        GET_TABLE_ADDRESS,
+        GET_TABLE_NODE,
+        GET_TABLE_ANALYZER,
+        GET_TABLE_ACTION,
+        GET_TABLE_CONFIDENCE,
+        GET_TABLE_IMPACT,
+        GET_TABLE_ASSESSMENT,
+        GET_TABLE_FILE_ACCESS_PERMISSION,
+        GET_TABLE_FILE_ACCESS,
+        GET_TABLE_LINKAGE,
+        GET_TABLE_INODE,
+        GET_TABLE_CHECKSUM,
+        GET_TABLE_FILE,
+        GET_TABLE_SOURCE,
+        GET_TABLE_TARGET,
+        GET_TABLE_ADDITIONAL_DATA,
+        GET_TABLE_REFERENCE,
+        GET_TABLE_CLASSIFICATION,
+        GET_TABLE_ALERTIDENT,
+        GET_TABLE_TOOL_ALERT,
+        GET_TABLE_CORRELATION_ALERT,
+        GET_TABLE_OVERFLOW_ALERT,
+        GET_TABLE_ALERT,
+        GET_TABLE_HEARTBEAT,
+        GET_TABLE_MAX
+} get_table_t;
+
+
+static const struct {
+        const char *name;
+        const char *fields;
+        int keys;
+} get_tables[GET_TABLE_MAX] = {
+        { "Prelude_AnalyzerTime", "time, gmtoff, usec", GET_KEY_PARENT_TYPE },
+        { "Prelude_DetectTime", "time, gmtoff, usec", 0 },
+        { "Prelude_CreateTime", "time, gmtoff, usec", GET_KEY_PARENT_TYPE },
+        { "Prelude_UserId", "ident, type, name, number, tty",
+          GET_KEY_PARENT_TYPE|GET_KEY_PARENT0_INDEX|GET_KEY_PARENT1_INDEX|GET_KEY_PARENT2_INDEX|GET_KEY_INDEX },
+        { "Prelude_User", "ident, category", GET_KEY_PARENT_TYPE|GET_KEY_PARENT0_INDEX },
+        { "Prelude_ProcessArg", "arg", GET_KEY_PARENT_TYPE|GET_KEY_PARENT0_INDEX|GET_KEY_INDEX },
+        { "Prelude_ProcessEnv", "env", GET_KEY_PARENT_TYPE|GET_KEY_PARENT0_INDEX|GET_KEY_INDEX },
+        { "Prelude_Process", "ident, name, pid, path", GET_KEY_PARENT_TYPE|GET_KEY_PARENT0_INDEX },
+        { "Prelude_WebServiceArg", "arg", GET_KEY_PARENT_TYPE|GET_KEY_PARENT0_INDEX|GET_KEY_INDEX },
+        { "Prelude_WebService", "url, cgi, http_method", GET_KEY_PARENT_TYPE|GET_KEY_PARENT0_INDEX },
+        { "Prelude_SnmpService", "snmp_oid, message_processing_model, security_model, security_name, "
+          "security_level, context_name, context_engine_id, command", GET_KEY_PARENT_TYPE|GET_KEY_PARENT0_INDEX },
+        { "Prelude_Service", "ident, ip_version, name, port, iana_protocol_number, iana_protocol_name, portlist, protocol",
+          GET_KEY_PARENT_TYPE|GET_KEY_PARENT0_INDEX },
+        { "Prelude_Address", "ident, category, vlan_name, vlan_num, address, netmask",
+          GET_KEY_PARENT_TYPE|GET_KEY_PARENT0_INDEX|GET_KEY_INDEX },
+        { "Prelude_Node", "ident, category, location, name", GET_KEY_PARENT_TYPE|GET_KEY_PARENT0_INDEX },
+        { "Prelude_Analyzer", "analyzerid, name, manufacturer, model, version, class, ostype, osversion",
+          GET_KEY_PARENT_TYPE|GET_KEY_INDEX },
+        { "Prelude_Action", "category, description", GET_KEY_INDEX },
+        { "Prelude_Confidence", "rating, confidence", 0 },
+        { "Prelude_Impact", "severity, completion, type, description", 0 },
+        { "Prelude_Assessment", NULL, 0 },
+        { "Prelude_FileAccess_Permission", "permission",
+          GET_KEY_PARENT0_INDEX|GET_KEY_PARENT1_INDEX|GET_KEY_PARENT2_INDEX|GET_KEY_INDEX },
+        { "Prelude_FileAccess", NULL, GET_KEY_PARENT0_INDEX|GET_KEY_PARENT1_INDEX|GET_KEY_INDEX },
+        { "Prelude_Linkage", "category, name, path", GET_KEY_PARENT0_INDEX|GET_KEY_PARENT1_INDEX|GET_KEY_INDEX },
+        { "Prelude_Inode", "change_time, change_time_gmtoff, number, major_device, minor_device, "
+          "c_major_device, c_minor_device", GET_KEY_PARENT0_INDEX|GET_KEY_PARENT1_INDEX },
+        { "Prelude_Checksum", "value, checksum_key, algorithm", GET_KEY_PARENT0_INDEX|GET_KEY_PARENT1_INDEX|GET_KEY_INDEX },
+        { "Prelude_File", "ident, category, name, path, create_time, create_time_gmtoff, "
+          "modify_time, modify_time_gmtoff, access_time, "
+          "access_time_gmtoff, data_size, disk_size, fstype, file_type", GET_KEY_PARENT0_INDEX|GET_KEY_INDEX },
+        { "Prelude_Source", "ident, spoofed, interface", GET_KEY_INDEX },
+        { "Prelude_Target", "ident, decoy, interface", GET_KEY_INDEX },
+        { "Prelude_AdditionalData", "type, meaning, data", GET_KEY_PARENT_TYPE|GET_KEY_INDEX },
+        { "Prelude_Reference", "origin, name, url, meaning", GET_KEY_INDEX },
+        { "Prelude_Classification", "ident, text", 0 },
+        { "Prelude_Alertident", "alertident, analyzerid", GET_KEY_PARENT_TYPE|GET_KEY_INDEX },
+        { "Prelude_ToolAlert", "name, command", 0 },
+        { "Prelude_CorrelationAlert", "name", 0 },
+        { "Prelude_OverflowAlert", "program, size, buffer", 0 },
+        { "Prelude_Alert", "messageid", GET_KEY_IDENT },
+        { "Prelude_Heartbeat", "messageid, heartbeat_interval", GET_KEY_IDENT },
+};
+
+
+static const char *get_key_columns[] = {
+        "_parent_type", "_parent0_index", "_parent1_index", "_parent2_index"
+};
+
+
+typedef struct {
+        preludedb_sql_t *sql;
+        uint64_t ident;
+        uint64_t fetched;
+        const uint64_t *idents;
+        size_t nidents;
+        unsigned int offset[GET_TABLE_MAX];
+        preludedb_sql_table_t *tables[GET_TABLE_MAX];
+} get_context_t;
+
+
+typedef struct {
+        uint64_t ident;
+        size_t index;
+} get_message_order_t;
+
+
+
+static void get_context_init(get_context_t *ctx, preludedb_sql_t *sql, const uint64_t *idents, size_t nidents)
+{
+        memset(ctx, 0, sizeof(*ctx));
+
+        ctx->sql = sql;
+        ctx->idents = idents;
+        ctx->nidents = nidents;
+        ctx->ident = idents[0];
+}
+
+
+
+static void get_context_destroy(get_context_t *ctx)
+{
+        unsigned int i;
+
+        for ( i = 0; i < GET_TABLE_MAX; i++ ) {
+                if ( ctx->tables[i] )
+                        preludedb_sql_table_destroy(ctx->tables[i]);
+        }
+}
+
+
+
+static unsigned int get_key_count(int keys)
+{
+        unsigned int i, count = 1;
+
+        for ( i = 0; i < sizeof(get_key_columns) / sizeof(*get_key_columns); i++ ) {
+                if ( keys & (GET_KEY_PARENT_TYPE << i) )
+                        count++;
+        }
+
+        return count;
+}
+
+
+
+static const char *get_ident_column(get_table_t id)
+{
+        return (get_tables[id].keys & GET_KEY_IDENT) ? "_ident" : "_message_ident";
+}
+
+
+
+static int get_table(get_context_t *ctx, get_table_t id, preludedb_sql_table_t **table)
+{
+        int ret;
+        unsigned int i;
+        char ident[32];
+        prelude_string_t *query;
+        preludedb_sql_param_t param;
+
+        if ( ctx->fetched & ((uint64_t) 1 << id) ) {
+                *table = ctx->tables[id];
+                return (*table) ? 1 : 0;
+        }
+
+        ret = prelude_string_new(&query);
+        if ( ret < 0 )
+                return ret;
+
+        ret = prelude_string_sprintf(query, "SELECT %s%s%s", get_tables[id].fields ? get_tables[id].fields : "",
+                                     get_tables[id].fields ? ", " : "", get_ident_column(id));
+        if ( ret < 0 )
+                goto error;
+
+        for ( i = 0; i < sizeof(get_key_columns) / sizeof(*get_key_columns); i++ ) {
+                if ( ! (get_tables[id].keys & (GET_KEY_PARENT_TYPE << i)) )
+                        continue;
+
+                ret = prelude_string_sprintf(query, ", %s", get_key_columns[i]);
+                if ( ret < 0 )
+                        goto error;
+        }
+
+        ret = prelude_string_sprintf(query, " FROM %s WHERE %s", get_tables[id].name, get_ident_column(id));
+        if ( ret < 0 )
+                goto error;
+
+        /*
+         * Single message retrieval always produces the same queries, have
+         * them go through the statement cache. IN lists vary in size.
+         */
+        if ( ctx->nidents == 1 )
+                ret = prelude_string_cat(query, " = ?");
+        else {
+                ret = prelude_string_cat(query, " IN (");
+
+                for ( i = 0; i < ctx->nidents && ret >= 0; i++ )
+                        ret = prelude_string_sprintf(query, "%s%" PRELUDE_PRIu64, (i == 0) ? "" : ", ", ctx->idents[i]);
+
+                if ( ret >= 0 )
+                        ret = prelude_string_cat(query, ")");
+        }
+
+        if ( ret < 0 )
+                goto error;
+
+        if ( get_tables[id].keys & GET_KEY_INDEX ) {
+                ret = prelude_string_cat(query, " AND _index != -1");
+                if ( ret < 0 )
+                        goto error;
+        }
+
+        if ( ctx->nidents > 1 || get_tables[id].keys & GET_KEY_INDEX ) {
+                ret = prelude_string_sprintf(query, " ORDER BY %s%s%s", (ctx->nidents > 1) ? get_ident_column(id) : "",
+                                             (ctx->nidents > 1 && get_tables[id].keys & GET_KEY_INDEX) ? ", " : "",
+                                             (get_tables[id].keys & GET_KEY_INDEX) ? "_index ASC" : "");
+                if ( ret < 0 )
+                        goto error;
+        }
+
+        if ( ctx->nidents == 1 ) {
+                snprintf(ident, sizeof(ident), "%" PRELUDE_PRIu64, ctx->ident);
+                param.value = ident;
+                param.len = strlen(ident);
+                param.type = PRELUDEDB_SQL_PARAM_TYPE_TEXT;
+
+                ret = preludedb_sql_query_params(ctx->sql, prelude_string_get_string(query), &param, 1, &ctx->tables[id]);
+        } else
+                ret = preludedb_sql_query(ctx->sql, prelude_string_get_string(query), &ctx->tables[id]);
+
+        if ( ret >= 0 ) {
+                if ( ret == 0 )
+                        ctx->tables[id] = NULL;
+
+                ctx->fetched |= (uint64_t) 1 << id;
+
+                *table = ctx->tables[id];
+                ret = (*table) ? 1 : 0;
+        }
+
+ error:
+        prelude_string_destroy(query);
+        return ret;
+}
+
+
+
+static int get_row_ident(get_table_t id, preludedb_sql_row_t *row, uint64_t *ident)
+{
+        int ret;
+        preludedb_sql_field_t *field;
+
+        ret = preludedb_sql_row_get_field(row, - (int) get_key_count(get_tables[id].keys), &field);
+        if ( ret <= 0 )
+                return (ret < 0) ? ret : preludedb_error(PRELUDEDB_ERROR_GENERIC);
+
+        return preludedb_sql_field_to_uint64(field, ident);
+}
+
+
+
+static int get_row_match(get_table_t id, preludedb_sql_row_t *row, const int *wanted)
+{
+        int ret, column;
+        unsigned int i;
+        int32_t value;
+        preludedb_sql_field_t *field;
+
+        column = - (int) get_key_count(get_tables[id].keys) + 1;
+
+        for ( i = 0; i < sizeof(get_key_columns) / sizeof(*get_key_columns); i++ ) {
+                if ( ! (get_tables[id].keys & (GET_KEY_PARENT_TYPE << i)) )
+                        continue;
+
+                ret = preludedb_sql_row_get_field(row, column++, &field);
+                if ( ret <= 0 )
+                        return (ret < 0) ? ret : preludedb_error(PRELUDEDB_ERROR_GENERIC);
+
+                if ( i == 0 )
+                        value = *preludedb_sql_field_get_value(field);
+
+                else {
+                        ret = preludedb_sql_field_to_int32(field, &value);
+                        if ( ret < 0 )
+                                return ret;
+                }
+
+                if ( value != wanted[i] )
+                        return 0;
+        }
+
+        return 1;
+}
+
+
+
+/*
+ * Retrieve, starting at row @pos, the next prefetched row of table @id
+ * belonging to the current message and matching the given parent keys.
+ * Keys the table does not have are ignored.
+ */
+static int get_next_row(get_context_t *ctx, get_table_t id,
+                        char parent_type, int parent0_index, int parent1_index, int parent2_index,
+                        unsigned int *pos, preludedb_sql_row_t **row)
+{
+        int ret;
+        uint64_t ident;
+        preludedb_sql_table_t *table;
+        const int wanted[] = { parent_type, parent0_index, parent1_index, parent2_index };
+
+        ret = get_table(ctx, id, &table);
+        if ( ret <= 0 )
+                return ret;
+
+        if ( *pos < ctx->offset[id] )
+                *pos = ctx->offset[id];
+
+        while ( (ret = preludedb_sql_table_get_row(table, *pos, row)) > 0 ) {
+                ret = get_row_ident(id, *row, &ident);
+                if ( ret < 0 )
+                        return ret;
+
+                /*
+                 * Rows are ordered by ident: rows of previous messages are
+                 * skipped for good, rows of the next ones end the lookup.
+                 */
+                if ( ident > ctx->ident )
+                        return 0;
+
+                (*pos)++;
+
+                if ( ident < ctx->ident ) {
+                        ctx->offset[id] = *pos;
+                        continue;
+                }
+
+                ret = get_row_match(id, *row, wanted);
+                if ( ret != 0 )
+                        return ret;
+        }
+
+        return ret;
+}
+
+
+
+static int get_row(get_context_t *ctx, get_table_t id,
+                   char parent_type, int parent0_index, int parent1_index, int parent2_index,
+                   preludedb_sql_row_t **row)
+{
+        unsigned int pos = 0;
+        return get_next_row(ctx, id, parent_type, parent0_index, parent1_index, parent2_index, &pos, row);
+}
+
+
 #define get_(type, name)                                                                        \
-static int _get_ ## name (preludedb_sql_t *sql, preludedb_sql_row_t *row,                       \
+static int _get_ ## name (get_context_t *ctx, preludedb_sql_row_t *row,                         \
                          int index,                                                             \
                          void *parent, int (*parent_new_child)(void *parent, type **child))     \
 {                                                                                               \
@@ -64,24 +454,24 @@ get_(uint16_t, uint16)
 get_(uint32_t, uint32)
 get_(float, float)
 
-#define get_uint8(sql, row, index, parent, parent_new_child) \
-        _get_uint8(sql, row, index, parent, (int (*)(void *, uint8_t **)) parent_new_child)
+#define get_uint8(ctx, row, index, parent, parent_new_child) \
+        _get_uint8(ctx, row, index, parent, (int (*)(void *, uint8_t **)) parent_new_child)
 
-#define get_uint16(sql, row, index, parent, parent_new_child) \
-        _get_uint16(sql, row, index, parent, (int (*)(void *, uint16_t **)) parent_new_child)
+#define get_uint16(ctx, row, index, parent, parent_new_child) \
+        _get_uint16(ctx, row, index, parent, (int (*)(void *, uint16_t **)) parent_new_child)
 
-#define get_uint32(sql, row, index, parent, parent_new_child) \
-        _get_uint32(sql, row, index, parent, (int (*)(void *, uint32_t **)) parent_new_child)
+#define get_uint32(ctx, row, index, parent, parent_new_child) \
+        _get_uint32(ctx, row, index, parent, (int (*)(void *, uint32_t **)) parent_new_child)
 
-#define get_float(sql, row, index, parent, parent_new_child) \
-        _get_float(sql, row, index, parent, (int (*)(void *, float **)) parent_new_child)
+#define get_float(ctx, row, index, parent, parent_new_child) \
+        _get_float(ctx, row, index, parent, (int (*)(void *, float **)) parent_new_child)
 
 
 int classic_unescape_binary_safe(preludedb_sql_t *sql, preludedb_sql_field_t *field,
                                  idmef_additional_data_type_t type, unsigned char **output, size_t *outsize);
 
 
-static int _get_string(preludedb_sql_t *sql, preludedb_sql_row_t *row,
+static int _get_string(get_context_t *ctx, preludedb_sql_row_t *row,
                        int index,
                        void *parent, int (*parent_new_child)(void *parent, prelude_string_t **child))
 {
@@ -105,7 +495,7 @@ static int _get_string(preludedb_sql_t *sql, preludedb_sql_row_t *row,
 }
 
 
-static int _get_string_listed(preludedb_sql_t *sql, preludedb_sql_row_t *row,
+static int _get_string_listed(get_context_t *ctx, preludedb_sql_row_t *row,
                               int index,
                               void *parent, int (*parent_new_child)(void *parent, prelude_string_t **child, int pos))
 {
@@ -130,7 +520,7 @@ static int _get_string_listed(preludedb_sql_t *sql, preludedb_sql_row_t *row,
 
 
 
-static int _get_enum(preludedb_sql_t *sql, preludedb_sql_row_t *row,
+static int _get_enum(get_context_t *ctx, preludedb_sql_row_t *row,
                      int index,
                      void *parent, int (*parent_new_child)(void *parent, int **child), int (*convert_enum)(const char *))
 {
@@ -153,12 +543,11 @@ static int _get_enum(preludedb_sql_t *sql, preludedb_sql_row_t *row,
 
 
 
-static int _get_timestamp(preludedb_sql_t *sql, preludedb_sql_row_t *row,
+static int _get_timestamp(get_context_t *ctx, preludedb_sql_row_t *row,
                           int time_index, int gmtoff_index, int usec_index,
                           void *parent, int (*parent_new_child)(void *parent, idmef_time_t **child))
 {
         preludedb_sql_field_t *time_field, *gmtoff_field, *usec_field = NULL;
-        const char *tmp;
         int32_t gmtoff;
         uint32_t usec = 0;
         idmef_time_t *time;
@@ -182,8 +571,6 @@ static int _get_timestamp(preludedb_sql_t *sql, preludedb_sql_row_t *row,
                         return ret;
         }
 
-        tmp = preludedb_sql_field_get_value(time_field);
-
         ret = preludedb_sql_field_to_int32(gmtoff_field, &gmtoff);
         if ( ret < 0 )
                 return ret;
@@ -192,114 +579,73 @@ static int _get_timestamp(preludedb_sql_t *sql, preludedb_sql_row_t *row,
         if ( ret < 0 )
                 return ret;
 
-        return preludedb_sql_time_from_timestamp(time, tmp, gmtoff, usec);
+        return preludedb_sql_field_to_time(time_field, time, gmtoff, usec);
 }
 
-#define get_string(sql, row, index, parent, parent_new_child) \
-        _get_string(sql, row, index, parent, (int (*)(void *, prelude_string_t **)) parent_new_child)
+#define get_string(ctx, row, index, parent, parent_new_child) \
+        _get_string(ctx, row, index, parent, (int (*)(void *, prelude_string_t **)) parent_new_child)
 
-#define get_string_listed(sql, row, index, parent, parent_new_child) \
-        _get_string_listed(sql, row, index, parent, (int (*)(void *, prelude_string_t **, int)) parent_new_child)
+#define get_string_listed(ctx, row, index, parent, parent_new_child) \
+        _get_string_listed(ctx, row, index, parent, (int (*)(void *, prelude_string_t **, int)) parent_new_child)
 
-#define get_enum(sql, row, index, parent, parent_new_child, convert_enum) \
-        _get_enum(sql, row, index, parent, (int (*)(void *, int **)) parent_new_child, convert_enum)
+#define get_enum(ctx, row, index, parent, parent_new_child, convert_enum) \
+        _get_enum(ctx, row, index, parent, (int (*)(void *, int **)) parent_new_child, convert_enum)
 
-#define get_timestamp(sql, row, time_index, gmtoff_index, usec_index, parent, parent_new_child) \
-        _get_timestamp(sql, row, time_index, gmtoff_index, usec_index, parent, (int (*)(void *, idmef_time_t **)) parent_new_child)
+#define get_timestamp(ctx, row, time_index, gmtoff_index, usec_index, parent, parent_new_child) \
+        _get_timestamp(ctx, row, time_index, gmtoff_index, usec_index, parent, (int (*)(void *, idmef_time_t **)) parent_new_child)
 
 
 
-static int get_analyzer_time(preludedb_sql_t *sql,
-                             uint64_t message_ident,
+static int get_analyzer_time(get_context_t *ctx,
                              char parent_type,
                              void *parent,
                              int (*parent_new_child)(void *parent, idmef_time_t **child))
 {
-        preludedb_sql_table_t *table;
         preludedb_sql_row_t *row;
         int ret;
 
-        ret = preludedb_sql_query_sprintf(sql, &table,
-                                          "SELECT time, gmtoff, usec "
-                                          "FROM Prelude_AnalyzerTime "
-                                          "WHERE _parent_type = '%c' AND _message_ident = %" PRELUDE_PRIu64 "",
-                                          parent_type, message_ident);
+        ret = get_row(ctx, GET_TABLE_ANALYZER_TIME, parent_type, 0, 0, 0, &row);
         if ( ret <= 0 )
                 return ret;
 
-        ret = preludedb_sql_table_fetch_row(table, &row);
-        if ( ret <= 0 )
-                goto error;
-
-        ret = get_timestamp(sql, row, 0, 1, 2, parent, parent_new_child);
-
- error:
-        preludedb_sql_table_destroy(table);
+        ret = get_timestamp(ctx, row, 0, 1, 2, parent, parent_new_child);
 
         return ret;
 }
 
-static int get_detect_time(preludedb_sql_t *sql,
-                           uint64_t message_ident,
+static int get_detect_time(get_context_t *ctx,
                            idmef_alert_t *alert)
 {
-        preludedb_sql_table_t *table;
         preludedb_sql_row_t *row;
         int ret;
 
-        ret = preludedb_sql_query_sprintf(sql, &table,
-                                          "SELECT time, gmtoff, usec "
-                                          "FROM Prelude_DetectTime "
-                                          "WHERE _message_ident = %" PRELUDE_PRIu64 "",
-                                          message_ident);
-
+        ret = get_row(ctx, GET_TABLE_DETECT_TIME, 0, 0, 0, 0, &row);
         if ( ret <= 0 )
                 return ret;
 
-        ret = preludedb_sql_table_fetch_row(table, &row);
-        if ( ret <= 0 )
-                goto error;
-
-        ret = get_timestamp(sql, row, 0, 1, 2, alert, idmef_alert_new_detect_time);
-
- error:
-        preludedb_sql_table_destroy(table);
+        ret = get_timestamp(ctx, row, 0, 1, 2, alert, idmef_alert_new_detect_time);
 
         return ret;
 }
 
-static int get_create_time(preludedb_sql_t *sql,
-                           uint64_t message_ident,
+static int get_create_time(get_context_t *ctx,
                            char parent_type,
                            void *parent,
                            int (*parent_new_child)(void *parent, idmef_time_t **time))
 {
-        preludedb_sql_table_t *table;
         preludedb_sql_row_t *row;
         int ret;
 
-        ret = preludedb_sql_query_sprintf(sql, &table,
-                                         "SELECT time, gmtoff, usec "
-                                         "FROM Prelude_CreateTime "
-                                         "WHERE _parent_type = '%c' AND _message_ident = %" PRELUDE_PRIu64 "",
-                                         parent_type, message_ident);
+        ret = get_row(ctx, GET_TABLE_CREATE_TIME, parent_type, 0, 0, 0, &row);
         if ( ret <= 0 )
                 return ret;
 
-        ret = preludedb_sql_table_fetch_row(table, &row);
-        if ( ret <= 0 )
-                goto error;
-
-        ret = get_timestamp(sql, row, 0, 1, 2, parent, parent_new_child);
-
- error:
-        preludedb_sql_table_destroy(table);
+        ret = get_timestamp(ctx, row, 0, 1, 2, parent, parent_new_child);
 
         return ret;
 }
 
-static int get_user_id(preludedb_sql_t *sql,
-                       uint64_t message_ident,
+static int get_user_id(get_context_t *ctx,
                        char parent_type,
                        int parent_index,
                        int file_index,
@@ -307,22 +653,12 @@ static int get_user_id(preludedb_sql_t *sql,
                        void *parent, prelude_bool_t listed,
                        int (*_parent_new_child)(void *, idmef_user_id_t **child))
 {
-        preludedb_sql_table_t *table;
+        unsigned int pos = 0;
         preludedb_sql_row_t *row;
         idmef_user_id_t *user_id;
         int ret;
 
-        ret = preludedb_sql_query_sprintf(sql, &table,
-                                          "SELECT ident, type, name, number, tty "
-                                          "FROM Prelude_UserId "
-                                          "WHERE _parent_type = '%c' AND _message_ident = %" PRELUDE_PRIu64 " AND "
-                                          "_parent0_index = %d AND _parent1_index = %d AND _parent2_index = %d AND _index != -1 "
-                                          "ORDER BY _index ASC",
-                                          parent_type, message_ident, parent_index, file_index, file_access_index);
-        if ( ret <= 0 )
-                return ret;
-
-        while ( (ret = preludedb_sql_table_fetch_row(table, &row)) > 0 ) {
+        while ( (ret = get_next_row(ctx, GET_TABLE_USER_ID, parent_type, parent_index, file_index, file_access_index, &pos, &row)) > 0 ) {
 
                 if ( listed ) {
                         int (*parent_new_child)(void *parent, idmef_user_id_t **, int) =
@@ -336,593 +672,460 @@ static int get_user_id(preludedb_sql_t *sql,
                 if ( ret < 0 )
                         goto error;
 
-                ret = get_string(sql, row, 0, user_id, idmef_user_id_new_ident);
+                ret = get_string(ctx, row, 0, user_id, idmef_user_id_new_ident);
                 if ( ret < 0 )
                         goto error;
 
-                ret = get_enum(sql, row, 1, user_id, idmef_user_id_new_type, idmef_user_id_type_to_numeric);
+                ret = get_enum(ctx, row, 1, user_id, idmef_user_id_new_type, idmef_user_id_type_to_numeric);
                 if ( ret < 0 )
                         goto error;
 
-                ret = get_string(sql, row, 2, user_id, idmef_user_id_new_name);
+                ret = get_string(ctx, row, 2, user_id, idmef_user_id_new_name);
                 if ( ret < 0 )
                         goto error;
 
-                ret = get_uint32(sql, row, 3, user_id, idmef_user_id_new_number);
+                ret = get_uint32(ctx, row, 3, user_id, idmef_user_id_new_number);
                 if ( ret < 0 )
                         goto error;
 
-                ret = get_string(sql, row, 4, user_id, idmef_user_id_new_tty);
+                ret = get_string(ctx, row, 4, user_id, idmef_user_id_new_tty);
                 if ( ret < 0 )
                         goto error;
         }
 
  error:
-        preludedb_sql_table_destroy(table);
-
         return ret;
 }
 
-static int get_user(preludedb_sql_t *sql,
-                    uint64_t message_ident,
+static int get_user(get_context_t *ctx,
                     char parent_type,
                     int parent_index,
                     void *parent,
                     int (*parent_new_child)(void *parent, idmef_user_t **child))
 {
-        preludedb_sql_table_t *table;
         preludedb_sql_row_t *row;
         idmef_user_t *user;
         int ret;
 
-        ret = preludedb_sql_query_sprintf(sql, &table,
-                                          "SELECT ident, category "
-                                          "FROM Prelude_User "
-                                          "WHERE _parent_type = '%c' AND _message_ident = %" PRELUDE_PRIu64 " AND _parent0_index = %d",
-                                          parent_type, message_ident, parent_index);
+        ret = get_row(ctx, GET_TABLE_USER, parent_type, parent_index, 0, 0, &row);
         if ( ret <= 0 )
                 return ret;
 
-        ret = preludedb_sql_table_fetch_row(table, &row);
-        if ( ret <= 0 )
-                goto error;
-
         ret = parent_new_child(parent, &user);
         if ( ret < 0 )
                 goto error;
 
-        ret = get_string(sql, row, 0, user, idmef_user_new_ident);
+        ret = get_string(ctx, row, 0, user, idmef_user_new_ident);
         if ( ret < 0 )
                 goto error;
 
-        ret = get_enum(sql, row, 1, user, idmef_user_new_category, idmef_user_category_to_numeric);
+        ret = get_enum(ctx, row, 1, user, idmef_user_new_category, idmef_user_category_to_numeric);
         if ( ret < 0 )
                 goto error;
 
-        ret = get_user_id(sql, message_ident, parent_type, parent_index, 0, 0, user,
+        ret = get_user_id(ctx, parent_type, parent_index, 0, 0, user,
                           TRUE, (int (*)(void *, idmef_user_id_t **)) idmef_user_new_user_id);
 
  error:
-        preludedb_sql_table_destroy(table);
-
         return ret;
 }
 
-static int get_process_arg(preludedb_sql_t *sql,
-                           uint64_t message_ident,
+static int get_process_arg(get_context_t *ctx,
                            char parent_type,
                            char parent_index,
                            void *parent,
                            int (*parent_new_child)(void *parent, prelude_string_t **child, int pos))
 {
-        preludedb_sql_table_t *table;
+        unsigned int pos = 0;
         preludedb_sql_row_t *row;
         int ret;
 
-        ret = preludedb_sql_query_sprintf(sql, &table,
-                                          "SELECT arg "
-                                          "FROM Prelude_ProcessArg "
-                                          "WHERE _parent_type = '%c' AND _message_ident = %" PRELUDE_PRIu64
-                                          " AND _parent0_index = %d AND _index != -1 ORDER BY _index ASC",
-                                          parent_type, message_ident, parent_index);
-        if ( ret <= 0 )
-                return ret;
-
-        while ( (ret = preludedb_sql_table_fetch_row(table, &row)) > 0 ) {
+        while ( (ret = get_next_row(ctx, GET_TABLE_PROCESS_ARG, parent_type, parent_index, 0, 0, &pos, &row)) > 0 ) {
 
-                ret = get_string_listed(sql, row, 0, parent, parent_new_child);
+                ret = get_string_listed(ctx, row, 0, parent, parent_new_child);
                 if ( ret < 0 )
                         goto error;
         }
 
  error:
-        preludedb_sql_table_destroy(table);
-
         return ret;
 }
 
-static int get_process_env(preludedb_sql_t *sql,
-                           uint64_t message_ident,
+static int get_process_env(get_context_t *ctx,
                            char parent_type,
                            int parent_index,
                            void *parent,
                            int (*parent_new_child)(void *parent, prelude_string_t **child, int pos))
 {
-        preludedb_sql_table_t *table;
+        unsigned int pos = 0;
         preludedb_sql_row_t *row;
         int ret;
 
-        ret = preludedb_sql_query_sprintf(sql, &table,
-                                          "SELECT env "
-                                          "FROM Prelude_ProcessEnv "
-                                          "WHERE _parent_type = '%c' AND _message_ident = %" PRELUDE_PRIu64
-                                          " AND _parent0_index = %d AND _index != -1 ORDER BY _index ASC",
-                                          parent_type, message_ident, parent_index);
-        if ( ret <= 0 )
-                return ret;
+        while ( (ret = get_next_row(ctx, GET_TABLE_PROCESS_ENV, parent_type, parent_index, 0, 0, &pos, &row)) > 0 ) {
 
-        while ( (ret = preludedb_sql_table_fetch_row(table, &row)) > 0 ) {
-
-                ret = get_string_listed(sql, row, 0, parent, parent_new_child);
+                ret = get_string_listed(ctx, row, 0, parent, parent_new_child);
                 if ( ret < 0 )
                         goto error;
         }
 
  error:
-        preludedb_sql_table_destroy(table);
-
         return ret;
 }
 
-static int get_process(preludedb_sql_t *sql,
-                       uint64_t message_ident,
+static int get_process(get_context_t *ctx,
                        char parent_type,
                        int parent_index,
                        void *parent,
                        int (*parent_new_child)(void *parent, idmef_process_t **child))
 {
-        preludedb_sql_table_t *table;
         preludedb_sql_row_t *row;
         idmef_process_t *process;
         int ret;
 
-        ret = preludedb_sql_query_sprintf(sql, &table,
-                                          "SELECT ident, name, pid, path "
-                                          "FROM Prelude_Process "
-                                          "WHERE _parent_type = '%c' AND _message_ident = %" PRELUDE_PRIu64 " AND _parent0_index = %d",
-                                          parent_type, message_ident, parent_index);
+        ret = get_row(ctx, GET_TABLE_PROCESS, parent_type, parent_index, 0, 0, &row);
         if ( ret <= 0 )
                 return ret;
 
-        ret = preludedb_sql_table_fetch_row(table, &row);
-        if ( ret <= 0 )
-                goto error;
-
         ret = parent_new_child(parent, &process);
         if ( ret < 0 )
                 goto error;
 
-        ret = get_string(sql, row, 0, process, idmef_process_new_ident);
+        ret = get_string(ctx, row, 0, process, idmef_process_new_ident);
         if ( ret < 0 )
                 goto error;
 
-        ret = get_string(sql, row, 1, process, idmef_process_new_name);
+        ret = get_string(ctx, row, 1, process, idmef_process_new_name);
         if ( ret < 0 )
                 goto error;
 
-        ret = get_uint32(sql, row, 2, process, idmef_process_new_pid);
+        ret = get_uint32(ctx, row, 2, process, idmef_process_new_pid);
         if ( ret < 0 )
                 goto error;
 
-        ret = get_string(sql, row, 3, process, idmef_process_new_path);
+        ret = get_string(ctx, row, 3, process, idmef_process_new_path);
         if ( ret < 0 )
                 goto error;
 
-        ret = get_process_arg(sql, message_ident, parent_type, parent_index, process,
+        ret = get_process_arg(ctx, parent_type, parent_index, process,
                               (int (*)(void *, prelude_string_t **, int)) idmef_process_new_arg);
         if ( ret < 0 )
                 goto error;
 
-        ret = get_process_env(sql, message_ident, parent_type, parent_index, process,
+        ret = get_process_env(ctx, parent_type, parent_index, process,
                               (int (*)(void *, prelude_string_t **, int)) idmef_process_new_env);
 
  error:
-        preludedb_sql_table_destroy(table);
-
         return ret;
 }
 
-static int get_web_service_arg(preludedb_sql_t *sql,
-                               uint64_t message_ident,
+static int get_web_service_arg(get_context_t *ctx,
                                char parent_type,
                                int parent_index,
                                idmef_web_service_t *web_service)
 {
-        preludedb_sql_table_t *table;
+        unsigned int pos = 0;
         preludedb_sql_row_t *row;
         int ret;
 
-        ret = preludedb_sql_query_sprintf(sql, &table,
-                                          "SELECT arg "
-                                          "FROM Prelude_WebServiceArg "
-                                          "WHERE _parent_type = '%c' AND _message_ident = %" PRELUDE_PRIu64
-                                          " AND _parent0_index = %d AND _index != -1 ORDER BY _index ASC",
-                                          parent_type, message_ident, parent_index);
-        if ( ret <= 0 )
-                return ret;
-
-        while ( (ret = preludedb_sql_table_fetch_row(table, &row)) > 0 ) {
+        while ( (ret = get_next_row(ctx, GET_TABLE_WEB_SERVICE_ARG, parent_type, parent_index, 0, 0, &pos, &row)) > 0 ) {
 
-                ret = get_string_listed(sql, row, 0, web_service, idmef_web_service_new_arg);
+                ret = get_string_listed(ctx, row, 0, web_service, idmef_web_service_new_arg);
                 if ( ret < 0 )
                         goto error;
         }
 
  error:
-        preludedb_sql_table_destroy(table);
-
         return ret;
 }
 
-static int get_web_service(preludedb_sql_t *sql,
-                           uint64_t message_ident,
+static int get_web_service(get_context_t *ctx,
                            char parent_type,
                            int parent_index,
                            idmef_service_t *service)
 {
-        preludedb_sql_table_t *table;
         preludedb_sql_row_t *row;
         idmef_web_service_t *web_service;
         int ret;
 
-        ret = preludedb_sql_query_sprintf(sql, &table,
-                                          "SELECT url, cgi, http_method "
-                                          "FROM Prelude_WebService "
-                                          "WHERE _parent_type = '%c' AND _message_ident = %" PRELUDE_PRIu64 " AND _parent0_index = %d",
-                                          parent_type, message_ident, parent_index);
+        ret = get_row(ctx, GET_TABLE_WEB_SERVICE, parent_type, parent_index, 0, 0, &row);
         if ( ret <= 0 )
                 return ret;
 
-        ret = preludedb_sql_table_fetch_row(table, &row);
-        if ( ret <= 0 )
-                goto error;
-
         ret = idmef_service_new_web_service(service, &web_service);
         if ( ret < 0 )
                 goto error;
 
-        ret = get_string(sql, row, 0, web_service, idmef_web_service_new_url);
+        ret = get_string(ctx, row, 0, web_service, idmef_web_service_new_url);
         if ( ret < 0 )
                 goto error;
 
-        ret = get_string(sql, row, 1, web_service, idmef_web_service_new_cgi);
+        ret = get_string(ctx, row, 1, web_service, idmef_web_service_new_cgi);
         if ( ret < 0 )
                 goto error;
 
-        ret = get_string(sql, row, 2, web_service, idmef_web_service_new_http_method);
+        ret = get_string(ctx, row, 2, web_service, idmef_web_service_new_http_method);
         if ( ret < 0 )
                 goto error;
 
-        ret = get_web_service_arg(sql, message_ident, parent_type, parent_index, web_service);
+        ret = get_web_service_arg(ctx, parent_type, parent_index, web_service);
 
  error:
-        preludedb_sql_table_destroy(table);
-
         return ret;
 }
 
-static int get_snmp_service(preludedb_sql_t *sql,
-                            uint64_t message_ident,
+static int get_snmp_service(get_context_t *ctx,
                             char parent_type,
                             int parent_index,
                             idmef_service_t *service)
 {
-        preludedb_sql_table_t *table;
         preludedb_sql_row_t *row;
         idmef_snmp_service_t *snmp_service;
         int ret;
 
-        ret = preludedb_sql_query_sprintf(sql, &table,
-                                          "SELECT snmp_oid, message_processing_model, security_model, security_name, "
-                                          "security_level, context_name, context_engine_id, command "
-                                          "FROM Prelude_SnmpService "
-                                          "WHERE _parent_type = '%c' AND _message_ident = %" PRELUDE_PRIu64 " AND _parent0_index = %d",
-                                          parent_type, message_ident, parent_index);
+        ret = get_row(ctx, GET_TABLE_SNMP_SERVICE, parent_type, parent_index, 0, 0, &row);
         if ( ret <= 0 )
                 return ret;
 
-        ret = preludedb_sql_table_fetch_row(table, &row);
-        if ( ret <= 0 )
-                goto error;
-
         ret = idmef_service_new_snmp_service(service, &snmp_service);
         if ( ret < 0 )
                 goto error;
 
-        ret = get_string(sql, row, 0, snmp_service, idmef_snmp_service_new_oid);
+        ret = get_string(ctx, row, 0, snmp_service, idmef_snmp_service_new_oid);
         if ( ret < 0 )
                 goto error;
 
-        ret = get_uint32(sql, row, 1, snmp_service, idmef_snmp_service_new_message_processing_model);
+        ret = get_uint32(ctx, row, 1, snmp_service, idmef_snmp_service_new_message_processing_model);
         if ( ret < 0 )
                 goto error;
 
-        ret = get_uint32(sql, row, 2, snmp_service, idmef_snmp_service_new_security_model);
+        ret = get_uint32(ctx, row, 2, snmp_service, idmef_snmp_service_new_security_model);
         if ( ret < 0 )
                 goto error;
 
-        ret = get_string(sql, row, 3, snmp_service, idmef_snmp_service_new_security_name);
+        ret = get_string(ctx, row, 3, snmp_service, idmef_snmp_service_new_security_name);
         if ( ret < 0 )
                 goto error;
 
-        ret = get_uint32(sql, row, 4, snmp_service, idmef_snmp_service_new_security_level);
+        ret = get_uint32(ctx, row, 4, snmp_service, idmef_snmp_service_new_security_level);
         if ( ret < 0 )
                 goto error;
 
-        ret = get_string(sql, row, 5, snmp_service, idmef_snmp_service_new_context_name);
+        ret = get_string(ctx, row, 5, snmp_service, idmef_snmp_service_new_context_name);
         if ( ret < 0 )
                 goto error;
 
-        ret = get_string(sql, row, 6, snmp_service, idmef_snmp_service_new_context_engine_id);
+        ret = get_string(ctx, row, 6, snmp_service, idmef_snmp_service_new_context_engine_id);
         if ( ret < 0 )
                 goto error;
 
-        ret = get_string(sql, row, 7, snmp_service, idmef_snmp_service_new_command);
+        ret = get_string(ctx, row, 7, snmp_service, idmef_snmp_service_new_command);
 
  error:
-        preludedb_sql_table_destroy(table);
-
         return ret;
 }
 
-static int get_service(preludedb_sql_t *sql,
-                       uint64_t message_ident,
+static int get_service(get_context_t *ctx,
                        char parent_type,
                        int parent_index,
                        void *parent,
                        int (*parent_new_child)(void *parent, idmef_service_t **child))
 {
-        preludedb_sql_table_t *table;
         preludedb_sql_row_t *row;
         idmef_service_t *service;
         int ret;
 
-        ret = preludedb_sql_query_sprintf(sql, &table,
-                                          "SELECT ident, ip_version, name, port, iana_protocol_number, iana_protocol_name, portlist, protocol "
-                                          "FROM Prelude_Service "
-                                          "WHERE _parent_type = '%c' AND _message_ident = %" PRELUDE_PRIu64 " AND _parent0_index = %d",
-                                          parent_type, message_ident, parent_index);
+        ret = get_row(ctx, GET_TABLE_SERVICE, parent_type, parent_index, 0, 0, &row);
         if ( ret <= 0 )
-                return 0;
-
-        ret = preludedb_sql_table_fetch_row(table, &row);
-        if ( ret <= 0 )
-                goto error;
+                return ret;
 
         ret = parent_new_child(parent, &service);
         if ( ret < 0 )
                 goto error;
 
-        ret = get_string(sql, row, 0, service, idmef_service_new_ident);
+        ret = get_string(ctx, row, 0, service, idmef_service_new_ident);
         if ( ret < 0 )
                 goto error;
 
-        ret = get_uint8(sql, row, 1, service, idmef_service_new_ip_version);
+        ret = get_uint8(ctx, row, 1, service, idmef_service_new_ip_version);
         if ( ret < 0 )
                 goto error;
 
-        ret = get_string(sql, row, 2, service, idmef_service_new_name);
+        ret = get_string(ctx, row, 2, service, idmef_service_new_name);
         if ( ret < 0 )
                 goto error;
 
-        ret = get_uint16(sql, row, 3, service, idmef_service_new_port);
+        ret = get_uint16(ctx, row, 3, service, idmef_service_new_port);
         if ( ret < 0 )
                 goto error;
 
-        ret = get_uint8(sql, row, 4, service, idmef_service_new_iana_protocol_number);
+        ret = get_uint8(ctx, row, 4, service, idmef_service_new_iana_protocol_number);
         if ( ret < 0 )
                 goto error;
 
-        ret = get_string(sql, row, 5, service, idmef_service_new_iana_protocol_name);
+        ret = get_string(ctx, row, 5, service, idmef_service_new_iana_protocol_name);
         if ( ret < 0 )
                 goto error;
 
-        ret = get_string(sql, row, 6, service, idmef_service_new_portlist);
+        ret = get_string(ctx, row, 6, service, idmef_service_new_portlist);
         if ( ret < 0 )
                 goto error;
 
-        ret = get_string(sql, row, 7, service, idmef_service_new_protocol);
+        ret = get_string(ctx, row, 7, service, idmef_service_new_protocol);
         if ( ret < 0 )
                 goto error;
 
-        ret = get_web_service(sql, message_ident, parent_type, parent_index, service);
+        ret = get_web_service(ctx, parent_type, parent_index, service);
         if ( ret < 0 )
                 goto error;
 
-        ret = get_snmp_service(sql, message_ident, parent_type, parent_index, service);
+        ret = get_snmp_service(ctx, parent_type, parent_index, service);
 
  error:
-        preludedb_sql_table_destroy(table);
-
         return ret;
 }
 
-static int get_address(preludedb_sql_t *sql,
-                       uint64_t message_ident,
+static int get_address(get_context_t *ctx,
                        char parent_type,
                        int parent_index,
                        void *parent,
                        int (*parent_new_child)(void *parent, idmef_address_t **child, int pos))
 {
-        preludedb_sql_table_t *table;
+        unsigned int pos = 0;
         preludedb_sql_row_t *row;
         idmef_address_t *idmef_address;
         int ret;
 
-        ret = preludedb_sql_query_sprintf(sql, &table,
-                                          "SELECT ident, category, vlan_name, vlan_num, address, netmask "
-                                          "FROM Prelude_Address "
-                                          "WHERE _parent_type = '%c' AND _message_ident = %" PRELUDE_PRIu64
-                                          " AND _parent0_index = %d AND _index != -1 ORDER BY _index ASC",
-                                          parent_type, message_ident, parent_index);
-        if ( ret <= 0 )
-                return ret;
-
-        while ( (ret = preludedb_sql_table_fetch_row(table, &row)) > 0 ) {
+        while ( (ret = get_next_row(ctx, GET_TABLE_ADDRESS, parent_type, parent_index, 0, 0, &pos, &row)) > 0 ) {
 
                 ret = parent_new_child(parent, &idmef_address, IDMEF_LIST_APPEND);
                 if ( ret < 0 )
                         goto error;
 
-                ret = get_string(sql, row, 0, idmef_address, idmef_address_new_ident);
+                ret = get_string(ctx, row, 0, idmef_address, idmef_address_new_ident);
                 if ( ret < 0 )
                         goto error;
 
-                ret = get_enum(sql, row, 1, idmef_address, idmef_address_new_category, idmef_address_category_to_numeric);
+                ret = get_enum(ctx, row, 1, idmef_address, idmef_address_new_category, idmef_address_category_to_numeric);
                 if ( ret < 0 )
                         goto error;
 
-                ret = get_string(sql, row, 2, idmef_address, idmef_address_new_vlan_name);
+                ret = get_string(ctx, row, 2, idmef_address, idmef_address_new_vlan_name);
                 if ( ret < 0 )
                         goto error;
 
-                ret = get_uint32(sql, row, 3, idmef_address, idmef_address_new_vlan_num);
+                ret = get_uint32(ctx, row, 3, idmef_address, idmef_address_new_vlan_num);
                 if ( ret < 0 )
                         goto error;
 
-                ret = get_string(sql, row, 4, idmef_address, idmef_address_new_address);
+                ret = get_string(ctx, row, 4, idmef_address, idmef_address_new_address);
                 if ( ret < 0 )
                         goto error;
 
-                ret = get_string(sql, row, 5, idmef_address, idmef_address_new_netmask);
+                ret = get_string(ctx, row, 5, idmef_address, idmef_address_new_netmask);
                 if ( ret < 0 )
                         goto error;
         }
 
  error:
-        preludedb_sql_table_destroy(table);
-
         return ret;
 }
 
-static int get_node(preludedb_sql_t *sql,
-                    uint64_t message_ident,
+static int get_node(get_context_t *ctx,
                     char parent_type,
                     int parent_index,
                     void *parent,
                     int (*parent_new_child)(void *parent, idmef_node_t **node))
 {
-        preludedb_sql_table_t *table;
         preludedb_sql_row_t *row;
         idmef_node_t *node;
         int ret;
 
-        ret = preludedb_sql_query_sprintf(sql, &table,
-                                          "SELECT ident, category, location, name "
-                                          "FROM Prelude_Node "
-                                          "WHERE _parent_type = '%c' AND _message_ident = %" PRELUDE_PRIu64 " AND _parent0_index = %d",
-                                          parent_type, message_ident, parent_index);
+        ret = get_row(ctx, GET_TABLE_NODE, parent_type, parent_index, 0, 0, &row);
         if ( ret <= 0 )
                 return ret;
 
-        ret = preludedb_sql_table_fetch_row(table, &row);
-        if ( ret <= 0 )
-                goto error;
-
         ret = parent_new_child(parent, &node);
         if ( ret < 0 )
                 goto error;
 
-        ret = get_string(sql, row, 0, node, idmef_node_new_ident);
+        ret = get_string(ctx, row, 0, node, idmef_node_new_ident);
         if ( ret < 0 )
                 goto error;
 
-        ret = get_enum(sql, row, 1, node, idmef_node_new_category, idmef_node_category_to_numeric);
+        ret = get_enum(ctx, row, 1, node, idmef_node_new_category, idmef_node_category_to_numeric);
         if ( ret < 0 )
                 goto error;
 
-        ret = get_string(sql, row, 2, node, idmef_node_new_location);
+        ret = get_string(ctx, row, 2, node, idmef_node_new_location);
         if ( ret < 0 )
                 goto error;
 
-        ret = get_string(sql, row, 3, node, idmef_node_new_name);
+        ret = get_string(ctx, row, 3, node, idmef_node_new_name);
         if ( ret < 0 )
                 goto error;
 
-        ret = get_address(sql, message_ident, parent_type, parent_index, node,
+        ret = get_address(ctx, parent_type, parent_index, node,
                           (int (*)(void *, idmef_address_t **, int)) idmef_node_new_address);
 
  error:
-        preludedb_sql_table_destroy(table);
-
         return ret;
 }
 
-static int get_analyzer(preludedb_sql_t *sql,
-                        uint64_t message_ident,
+static int get_analyzer(get_context_t *ctx,
                         char parent_type,
                         void *parent,
                         int (*parent_new_child)(void *parent, idmef_analyzer_t **child, int pos))
 {
-        preludedb_sql_table_t *table;
+        unsigned int pos = 0;
         preludedb_sql_row_t *row;
         idmef_analyzer_t *analyzer;
         int ret;
         int index;
 
-        ret = preludedb_sql_query_sprintf(sql, &table,
-                                          "SELECT analyzerid, name, manufacturer, model, version, class, ostype, osversion "
-                                          "FROM Prelude_Analyzer "
-                                          "WHERE _parent_type = '%c' AND _message_ident = %" PRELUDE_PRIu64 " AND _index != -1 "
-                                          "ORDER BY _index ASC",
-                                          parent_type, message_ident);
-        if ( ret <= 0 )
-                return ret;
-
         index = 0;
-        while ( (ret = preludedb_sql_table_fetch_row(table, &row)) > 0 ) {
+        while ( (ret = get_next_row(ctx, GET_TABLE_ANALYZER, parent_type, 0, 0, 0, &pos, &row)) > 0 ) {
                 ret = parent_new_child(parent, &analyzer, IDMEF_LIST_APPEND);
                 if ( ret < 0 )
                         goto error;
 
-                ret = get_string(sql, row, 0, analyzer, idmef_analyzer_new_analyzerid);
+                ret = get_string(ctx, row, 0, analyzer, idmef_analyzer_new_analyzerid);
                 if ( ret < 0 )
                         goto error;
 
-                ret = get_string(sql, row, 1, analyzer, idmef_analyzer_new_name);
+                ret = get_string(ctx, row, 1, analyzer, idmef_analyzer_new_name);
                 if ( ret < 0 )
                         goto error;
 
-                ret = get_string(sql, row, 2, analyzer, idmef_analyzer_new_manufacturer);
+                ret = get_string(ctx, row, 2, analyzer, idmef_analyzer_new_manufacturer);
                 if ( ret < 0 )
                         goto error;
 
-                ret = get_string(sql, row, 3, analyzer, idmef_analyzer_new_model);
+                ret = get_string(ctx, row, 3, analyzer, idmef_analyzer_new_model);
                 if ( ret < 0 )
                         goto error;
 
-                ret = get_string(sql, row, 4, analyzer, idmef_analyzer_new_version);
+                ret = get_string(ctx, row, 4, analyzer, idmef_analyzer_new_version);
                 if ( ret < 0 )
                         goto error;
 
-                ret = get_string(sql, row, 5, analyzer, idmef_analyzer_new_class);
+                ret = get_string(ctx, row, 5, analyzer, idmef_analyzer_new_class);
                 if ( ret < 0 )
                         goto error;
 
-                ret = get_string(sql, row, 6, analyzer, idmef_analyzer_new_ostype);
+                ret = get_string(ctx, row, 6, analyzer, idmef_analyzer_new_ostype);
                 if ( ret < 0 )
                         goto error;
 
-                ret = get_string(sql, row, 7, analyzer, idmef_analyzer_new_osversion);
+                ret = get_string(ctx, row, 7, analyzer, idmef_analyzer_new_osversion);
                 if ( ret < 0 )
                         goto error;
 
-                ret = get_node(sql, message_ident, parent_type, index, analyzer,
+                ret = get_node(ctx, parent_type, index, analyzer,
                                (int (*)(void *, idmef_node_t **)) idmef_analyzer_new_node);
                 if ( ret < 0 )
                         goto error;
 
-                ret = get_process(sql, message_ident, parent_type, index, analyzer,
+                ret = get_process(ctx, parent_type, index, analyzer,
                                   (int (*)(void *, idmef_process_t **)) idmef_analyzer_new_process);
                 if ( ret < 0 )
                         goto error;
@@ -931,163 +1134,118 @@ static int get_analyzer(preludedb_sql_t *sql,
         }
 
  error:
-        preludedb_sql_table_destroy(table);
-
         return ret;
 }
 
-static int get_action(preludedb_sql_t *sql,
-                      uint64_t message_ident,
+static int get_action(get_context_t *ctx,
                       idmef_assessment_t *assessment)
 {
-        preludedb_sql_table_t *table;
+        unsigned int pos = 0;
         preludedb_sql_row_t *row;
         idmef_action_t *action;
         int ret;
 
-        ret = preludedb_sql_query_sprintf(sql, &table,
-                                          "SELECT category, description "
-                                          "FROM Prelude_Action "
-                                          "WHERE _message_ident = %" PRELUDE_PRIu64 " AND _index != -1 "
-                                          "ORDER BY _index ASC",
-                                          message_ident);
-        if ( ret <= 0 )
-                return ret;
-
-        while ( (ret = preludedb_sql_table_fetch_row(table, &row)) > 0 ) {
+        while ( (ret = get_next_row(ctx, GET_TABLE_ACTION, 0, 0, 0, 0, &pos, &row)) > 0 ) {
 
                 ret = idmef_assessment_new_action(assessment, &action, IDMEF_LIST_APPEND);
                 if ( ret < 0 )
                         return ret;
 
-                ret = get_enum(sql, row, 0, action, idmef_action_new_category, idmef_action_category_to_numeric);
+                ret = get_enum(ctx, row, 0, action, idmef_action_new_category, idmef_action_category_to_numeric);
                 if ( ret < 0 )
                         goto error;
 
-                ret = get_string(sql, row, 1, action, idmef_action_new_description);
+                ret = get_string(ctx, row, 1, action, idmef_action_new_description);
                 if ( ret < 0 )
                         goto error;
         }
 
  error:
-        preludedb_sql_table_destroy(table);
-
         return ret;
 }
 
-static int get_confidence(preludedb_sql_t *sql,
-                          uint64_t message_ident,
+static int get_confidence(get_context_t *ctx,
                           idmef_assessment_t *assessment)
 {
-        preludedb_sql_table_t *table;
         preludedb_sql_row_t *row;
         idmef_confidence_t *confidence;
         int ret;
 
-        ret = preludedb_sql_query_sprintf(sql, &table,
-                                          "SELECT rating, confidence "
-                                          "FROM Prelude_Confidence "
-                                          "WHERE _message_ident = %" PRELUDE_PRIu64 "",
-                                          message_ident);
+        ret = get_row(ctx, GET_TABLE_CONFIDENCE, 0, 0, 0, 0, &row);
         if ( ret <= 0 )
                 return ret;
 
-        ret = preludedb_sql_table_fetch_row(table, &row);
-        if ( ret <= 0 )
-                goto error;
-
         ret = idmef_assessment_new_confidence(assessment, &confidence);
         if ( ret < 0 )
                 goto error;
 
-        ret = get_enum(sql, row, 0, confidence, idmef_confidence_new_rating, idmef_confidence_rating_to_numeric);
+        ret = get_enum(ctx, row, 0, confidence, idmef_confidence_new_rating, idmef_confidence_rating_to_numeric);
         if ( ret < 0 )
                 goto error;
 
-        ret = get_float(sql, row, 1, confidence, idmef_confidence_new_confidence);
+        ret = get_float(ctx, row, 1, confidence, idmef_confidence_new_confidence);
 
  error:
-        preludedb_sql_table_destroy(table);
-
         return ret;
 }
 
-static int get_impact(preludedb_sql_t *sql,
-                      uint64_t message_ident,
+static int get_impact(get_context_t *ctx,
                       idmef_assessment_t *assessment)
 {
-        preludedb_sql_table_t *table;
         preludedb_sql_row_t *row;
         idmef_impact_t *impact;
         int ret;
 
-        ret = preludedb_sql_query_sprintf(sql, &table,
-                                          "SELECT severity, completion, type, description "
-                                          "FROM Prelude_Impact "
-                                          "WHERE _message_ident = %" PRELUDE_PRIu64 "",
-                                          message_ident);
+        ret = get_row(ctx, GET_TABLE_IMPACT, 0, 0, 0, 0, &row);
         if ( ret <= 0 )
                 return ret;
 
-        ret = preludedb_sql_table_fetch_row(table, &row);
-        if ( ret <= 0 )
-                goto error;
-
         ret = idmef_assessment_new_impact(assessment, &impact);
         if ( ret < 0 )
                 goto error;
 
-        ret = get_enum(sql, row, 0, impact, idmef_impact_new_severity, idmef_impact_severity_to_numeric);
+        ret = get_enum(ctx, row, 0, impact, idmef_impact_new_severity, idmef_impact_severity_to_numeric);
         if ( ret < 0 )
                 goto error;
 
-        ret = get_enum(sql, row, 1, impact, idmef_impact_new_completion, idmef_impact_completion_to_numeric);
+        ret = get_enum(ctx, row, 1, impact, idmef_impact_new_completion, idmef_impact_completion_to_numeric);
         if ( ret < 0 )
                 goto error;
 
-        ret = get_enum(sql, row, 2, impact, idmef_impact_new_type, idmef_impact_type_to_numeric);
+        ret = get_enum(ctx, row, 2, impact, idmef_impact_new_type, idmef_impact_type_to_numeric);
         if ( ret < 0 )
                 goto error;
 
-        ret = get_string(sql, row, 3, impact, idmef_impact_new_description);
+        ret = get_string(ctx, row, 3, impact, idmef_impact_new_description);
 
  error:
-        preludedb_sql_table_destroy(table);
-
         return ret;
 }
 
-static int get_assessment(preludedb_sql_t *sql,
-                          uint64_t message_ident,
+static int get_assessment(get_context_t *ctx,
                           idmef_alert_t *alert)
 {
-        preludedb_sql_table_t *table;
+        preludedb_sql_row_t *row;
         idmef_assessment_t *assessment;
         int ret;
 
-        ret = preludedb_sql_query_sprintf(sql, &table,
-                                          "SELECT _message_ident "
-                                          "FROM Prelude_Assessment "
-                                          "WHERE _message_ident = %" PRELUDE_PRIu64 "",
-                                          message_ident);
+        ret = get_row(ctx, GET_TABLE_ASSESSMENT, 0, 0, 0, 0, &row);
         if ( ret <= 0 )
                 return ret;
 
-        preludedb_sql_table_destroy(table);
-
         ret = idmef_alert_new_assessment(alert, &assessment);
         if ( ret < 0 )
                 goto error;
 
-        ret = get_impact(sql, message_ident, assessment);
+        ret = get_impact(ctx, assessment);
         if ( ret < 0 )
                 goto error;
 
-        ret = get_confidence(sql, message_ident, assessment);
+        ret = get_confidence(ctx, assessment);
         if ( ret < 0 )
                 goto error;
 
-        ret = get_action(sql, message_ident, assessment);
+        ret = get_action(ctx, assessment);
         if ( ret < 0 )
                 goto error;
 
@@ -1095,133 +1253,85 @@ static int get_assessment(preludedb_sql_t *sql,
         return ret;
 }
 
-static int get_file_access_permission(preludedb_sql_t *sql,
-                                      uint64_t message_ident,
+static int get_file_access_permission(get_context_t *ctx,
                                       int target_index,
                                       int file_index,
                                       int file_access_index,
                                       idmef_file_access_t *parent)
 {
-        preludedb_sql_table_t *table;
+        unsigned int pos = 0;
         preludedb_sql_row_t *row;
         int ret;
 
-        ret = preludedb_sql_query_sprintf(sql, &table,
-                                          "SELECT permission "
-                                          "FROM Prelude_FileAccess_Permission "
-                                          "WHERE _message_ident = %" PRELUDE_PRIu64 " AND _parent0_index = %d AND "
-                                          "_parent1_index = %d AND _parent2_index = %d AND _index != -1 "
-                                          "ORDER BY _index ASC",
-                                          message_ident, target_index, file_index, file_access_index);
-        if ( ret <= 0 )
-                return ret;
-
-        while ( (ret = preludedb_sql_table_fetch_row(table, &row)) > 0 ) {
+        while ( (ret = get_next_row(ctx, GET_TABLE_FILE_ACCESS_PERMISSION, 0, target_index, file_index, file_access_index, &pos, &row)) > 0 ) {
 
-                ret = get_string_listed(sql, row, 0, parent, idmef_file_access_new_permission);
+                ret = get_string_listed(ctx, row, 0, parent, idmef_file_access_new_permission);
                 if ( ret < 0 )
                         goto error;
         }
 
  error:
-        preludedb_sql_table_destroy(table);
-
         return ret;
 }
 
-static int get_file_access(preludedb_sql_t *sql,
-                           uint64_t message_ident,
+static int get_file_access(get_context_t *ctx,
                            int target_index,
                            int file_index,
                            idmef_file_t *file)
 {
-        preludedb_sql_table_t *table;
+        unsigned int pos = 0;
         preludedb_sql_row_t *row;
-        preludedb_sql_field_t *field;
         idmef_file_access_t *file_access;
-        uint32_t file_access_count;
-        unsigned int cnt;
+        unsigned int cnt = 0;
         int ret;
 
-        ret = preludedb_sql_query_sprintf(sql, &table,
-                                          "SELECT COUNT(*) "
-                                          "FROM Prelude_FileAccess "
-                                          "WHERE _message_ident = %" PRELUDE_PRIu64
-                                          " AND _parent0_index = %d AND _parent1_index = %d AND _index != -1",
-                                          message_ident, target_index, file_index);
-        if ( ret <= 0 )
-                return ret;
-
-        ret = preludedb_sql_table_fetch_row(table, &row);
-        if ( ret <= 0 )
-                goto error;
-
-        ret = preludedb_sql_row_get_field(row, 0, &field);
-        if ( ret <= 0 )
-                goto error;
-
-        ret = preludedb_sql_field_to_uint32(field, &file_access_count);
-        if ( ret < 0 )
-                goto error;
-
-        for ( cnt = 0; cnt < file_access_count; cnt++ ) {
+        while ( (ret = get_next_row(ctx, GET_TABLE_FILE_ACCESS, 0, target_index, file_index, 0, &pos, &row)) > 0 ) {
 
                 ret = idmef_file_new_file_access(file, &file_access, IDMEF_LIST_APPEND);
                 if ( ret < 0 )
                         goto error;
 
-                ret = get_user_id(sql, message_ident, 'F', target_index, file_index, cnt,
+                ret = get_user_id(ctx, 'F', target_index, file_index, cnt,
                                   file_access, FALSE, (int (*)(void *, idmef_user_id_t **)) idmef_file_access_new_user_id);
                 if ( ret < 0 )
                         goto error;
 
-                ret = get_file_access_permission(sql, message_ident, target_index, file_index, cnt, file_access);
+                ret = get_file_access_permission(ctx, target_index, file_index, cnt, file_access);
                 if ( ret < 0 )
                         goto error;
+
+                cnt++;
         }
 
  error:
-        preludedb_sql_table_destroy(table);
-
         return ret;
 }
 
-static int get_linkage(preludedb_sql_t *sql,
-                       uint64_t message_ident,
+static int get_linkage(get_context_t *ctx,
                        int target_index,
                        int file_index,
                        idmef_file_t *file)
 {
-        preludedb_sql_table_t *table;
+        unsigned int pos = 0;
         preludedb_sql_row_t *row;
         idmef_linkage_t *linkage;
         int ret;
 
-        ret = preludedb_sql_query_sprintf(sql, &table,
-                                          "SELECT category, name, path "
-                                          "FROM Prelude_Linkage "
-                                          "WHERE _message_ident = %" PRELUDE_PRIu64
-                                          " AND _parent0_index = %d AND _parent1_index = %d AND _index != -1 "
-                                          "ORDER BY _index ASC",
-                                          message_ident, target_index, file_index);
-        if ( ret <= 0 )
-                return ret;
-
-        while ( (ret = preludedb_sql_table_fetch_row(table, &row)) > 0 ) {
+        while ( (ret = get_next_row(ctx, GET_TABLE_LINKAGE, 0, target_index, file_index, 0, &pos, &row)) > 0 ) {
 
                 ret = idmef_file_new_linkage(file, &linkage, IDMEF_LIST_APPEND);
                 if ( ret < 0 )
                         goto error;
 
-                ret = get_enum(sql, row, 0, linkage, idmef_linkage_new_category, idmef_linkage_category_to_numeric);
+                ret = get_enum(ctx, row, 0, linkage, idmef_linkage_new_category, idmef_linkage_category_to_numeric);
                 if ( ret < 0 )
                         goto error;
 
-                ret = get_string(sql, row, 1, linkage, idmef_linkage_new_name);
+                ret = get_string(ctx, row, 1, linkage, idmef_linkage_new_name);
                 if ( ret < 0 )
                         goto error;
 
-                ret = get_string(sql, row, 2, linkage, idmef_linkage_new_path);
+                ret = get_string(ctx, row, 2, linkage, idmef_linkage_new_path);
                 if ( ret < 0 )
                         goto error;
         }
@@ -1229,186 +1339,146 @@ static int get_linkage(preludedb_sql_t *sql,
         /* FIXME: file in linkage is not currently supported  */
 
  error:
-        preludedb_sql_table_destroy(table);
-
         return ret;
 }
 
-static int get_inode(preludedb_sql_t *sql,
-                     uint64_t message_ident,
+static int get_inode(get_context_t *ctx,
                      int target_index,
                      int file_index,
                      idmef_file_t *file)
 {
-        preludedb_sql_table_t *table;
         preludedb_sql_row_t *row;
         idmef_inode_t *inode;
         int ret;
 
-        ret = preludedb_sql_query_sprintf(sql, &table,
-                                          "SELECT change_time, change_time_gmtoff, number, major_device, minor_device, "
-                                          "c_major_device, c_minor_device "
-                                          "FROM Prelude_Inode "
-                                          "WHERE _message_ident = %" PRELUDE_PRIu64 " AND _parent0_index = %d AND _parent1_index = %d",
-                                          message_ident, target_index, file_index);
+        ret = get_row(ctx, GET_TABLE_INODE, 0, target_index, file_index, 0, &row);
         if ( ret <= 0 )
                 return ret;
 
-        ret = preludedb_sql_table_fetch_row(table, &row);
-        if ( ret <= 0 )
-                goto error;
-
         ret = idmef_file_new_inode(file, &inode);
         if ( ret < 0 )
                 goto error;
 
-        ret = get_timestamp(sql, row, 0, 1, -1, inode, idmef_inode_new_change_time);
+        ret = get_timestamp(ctx, row, 0, 1, -1, inode, idmef_inode_new_change_time);
         if ( ret < 0 )
                 goto error;
 
-        ret = get_uint32(sql, row, 2, inode, idmef_inode_new_number);
+        ret = get_uint32(ctx, row, 2, inode, idmef_inode_new_number);
         if ( ret < 0 )
                 goto error;
 
-        ret = get_uint32(sql, row, 3, inode, idmef_inode_new_major_device);
+        ret = get_uint32(ctx, row, 3, inode, idmef_inode_new_major_device);
         if ( ret < 0 )
                 goto error;
 
-        ret = get_uint32(sql, row, 4, inode, idmef_inode_new_minor_device);
+        ret = get_uint32(ctx, row, 4, inode, idmef_inode_new_minor_device);
         if ( ret < 0 )
                 goto error;
 
-        ret = get_uint32(sql, row, 5, inode, idmef_inode_new_c_major_device);
+        ret = get_uint32(ctx, row, 5, inode, idmef_inode_new_c_major_device);
         if ( ret < 0 )
                 goto error;
 
-        ret = get_uint32(sql, row, 6, inode, idmef_inode_new_c_minor_device);
+        ret = get_uint32(ctx, row, 6, inode, idmef_inode_new_c_minor_device);
         if ( ret < 0 )
                 goto error;
 
  error:
-        preludedb_sql_table_destroy(table);
-
         return ret;
 }
 
 
-static int get_checksum(preludedb_sql_t *sql,
-                        uint64_t message_ident,
+static int get_checksum(get_context_t *ctx,
                         int target_index,
                         int file_index,
                         idmef_file_t *file)
 {
-        preludedb_sql_table_t *table;
+        unsigned int pos = 0;
         preludedb_sql_row_t *row;
         idmef_checksum_t *checksum;
         int ret;
 
-        ret = preludedb_sql_query_sprintf(sql, &table,
-                                          "SELECT value, checksum_key, algorithm "
-                                          "FROM Prelude_Checksum "
-                                          "WHERE _message_ident = %" PRELUDE_PRIu64
-                                          " AND _parent0_index = %d AND _parent1_index = %d AND _index != -1 "
-                                          "ORDER BY _index ASC",
-                                          message_ident, target_index, file_index);
-        if ( ret <= 0 )
-                return ret;
-
-        while ( (ret = preludedb_sql_table_fetch_row(table, &row)) > 0 ) {
+        while ( (ret = get_next_row(ctx, GET_TABLE_CHECKSUM, 0, target_index, file_index, 0, &pos, &row)) > 0 ) {
 
                 ret = idmef_file_new_checksum(file, &checksum, IDMEF_LIST_APPEND);
                 if ( ret < 0 )
                         goto error;
 
-                ret = get_string(sql, row, 0, checksum, idmef_checksum_new_value);
+                ret = get_string(ctx, row, 0, checksum, idmef_checksum_new_value);
                 if ( ret < 0 )
                         goto error;
 
-                ret = get_string(sql, row, 1, checksum, idmef_checksum_new_key);
+                ret = get_string(ctx, row, 1, checksum, idmef_checksum_new_key);
                 if ( ret < 0 )
                         goto error;
 
-                ret = get_enum(sql, row, 2, checksum, idmef_checksum_new_algorithm, idmef_checksum_algorithm_to_numeric);
+                ret = get_enum(ctx, row, 2, checksum, idmef_checksum_new_algorithm, idmef_checksum_algorithm_to_numeric);
                 if ( ret < 0 )
                         goto error;
         }
 
  error:
-        preludedb_sql_table_destroy(table);
-
         return ret;
 }
 
 
-static int get_file(preludedb_sql_t *sql,
-                    uint64_t message_ident,
+static int get_file(get_context_t *ctx,
                     int target_index,
                     idmef_target_t *target)
 {
-        preludedb_sql_table_t *table;
+        unsigned int pos = 0;
         preludedb_sql_row_t *row;
         idmef_file_t *file = NULL;
         int cnt;
         int ret;
 
-        ret = preludedb_sql_query_sprintf(sql, &table,
-                                          "SELECT ident, category, name, path, create_time, create_time_gmtoff, "
-                                          "modify_time, modify_time_gmtoff, access_time, "
-                                          "access_time_gmtoff, data_size, disk_size, fstype, file_type "
-                                          "FROM Prelude_File "
-                                          "WHERE _message_ident = %" PRELUDE_PRIu64 " AND _parent0_index = %d AND _index != -1 "
-                                          "ORDER BY _index ASC",
-                                          message_ident, target_index);
-        if ( ret <= 0 )
-                return ret;
-
-        while ( (ret = preludedb_sql_table_fetch_row(table, &row)) > 0 ) {
+        while ( (ret = get_next_row(ctx, GET_TABLE_FILE, 0, target_index, 0, 0, &pos, &row)) > 0 ) {
 
                 ret = idmef_target_new_file(target, &file, IDMEF_LIST_APPEND);
                 if ( ret < 0 )
                         goto error;
 
-                ret = get_string(sql, row, 0, file, idmef_file_new_ident);
+                ret = get_string(ctx, row, 0, file, idmef_file_new_ident);
                 if ( ret < 0 )
                         goto error;
 
-                ret = get_enum(sql, row, 1, file, idmef_file_new_category, idmef_file_category_to_numeric);
+                ret = get_enum(ctx, row, 1, file, idmef_file_new_category, idmef_file_category_to_numeric);
                 if ( ret < 0 )
                         goto error;
 
-                ret = get_string(sql, row, 2, file, idmef_file_new_name);
+                ret = get_string(ctx, row, 2, file, idmef_file_new_name);
                 if ( ret < 0 )
                         goto error;
 
-                ret = get_string(sql, row, 3, file, idmef_file_new_path);
+                ret = get_string(ctx, row, 3, file, idmef_file_new_path);
                 if ( ret < 0 )
                         goto error;
 
-                ret = get_timestamp(sql, row, 4, 5, -1, file, idmef_file_new_create_time);
+                ret = get_timestamp(ctx, row, 4, 5, -1, file, idmef_file_new_create_time);
                 if ( ret < 0 )
                         goto error;
 
-                ret = get_timestamp(sql, row, 6, 7, -1, file, idmef_file_new_modify_time);
+                ret = get_timestamp(ctx, row, 6, 7, -1, file, idmef_file_new_modify_time);
                 if ( ret < 0 )
                         goto error;
 
-                ret = get_timestamp(sql, row, 8, 9, -1, file, idmef_file_new_access_time);
+                ret = get_timestamp(ctx, row, 8, 9, -1, file, idmef_file_new_access_time);
                 if ( ret < 0 )
                         goto error;
 
-                ret = get_uint32(sql, row, 10, file, idmef_file_new_data_size);
+                ret = get_uint32(ctx, row, 10, file, idmef_file_new_data_size);
                 if ( ret < 0 )
                         goto error;
 
-                ret = get_uint32(sql, row, 11, file, idmef_file_new_disk_size);
+                ret = get_uint32(ctx, row, 11, file, idmef_file_new_disk_size);
                 if ( ret < 0 )
                         goto error;
 
-                ret = get_enum(sql, row, 12, file, idmef_file_new_fstype, idmef_file_fstype_to_numeric);
+                ret = get_enum(ctx, row, 12, file, idmef_file_new_fstype, idmef_file_fstype_to_numeric);
                 if ( ret < 0 )
                         goto error;
 
-                ret = get_string(sql, row, 13, file, idmef_file_new_file_type);
+                ret = get_string(ctx, row, 13, file, idmef_file_new_file_type);
                 if ( ret < 0 )
                         goto error;
         }
@@ -1417,19 +1487,19 @@ static int get_file(preludedb_sql_t *sql,
         cnt = 0;
         while ( (file = idmef_target_get_next_file(target, file)) ) {
 
-                ret = get_file_access(sql, message_ident, target_index, cnt, file);
+                ret = get_file_access(ctx, target_index, cnt, file);
                 if ( ret < 0 )
                         goto error;
 
-                ret = get_linkage(sql, message_ident, target_index, cnt, file);
+                ret = get_linkage(ctx, target_index, cnt, file);
                 if ( ret < 0 )
                         goto error;
 
-                ret = get_inode(sql, message_ident, target_index, cnt, file);
+                ret = get_inode(ctx, target_index, cnt, file);
                 if ( ret < 0 )
                         goto error;
 
-                ret = get_checksum(sql, message_ident, target_index, cnt, file);
+                ret = get_checksum(ctx, target_index, cnt, file);
                 if ( ret < 0 )
                         goto error;
 
@@ -1437,45 +1507,33 @@ static int get_file(preludedb_sql_t *sql,
         }
 
  error:
-        preludedb_sql_table_destroy(table);
-
         return ret;
 }
 
-static int get_source(preludedb_sql_t *sql,
-                      uint64_t message_ident,
+static int get_source(get_context_t *ctx,
                       idmef_alert_t *alert)
 {
-        preludedb_sql_table_t *table;
+        unsigned int pos = 0;
         preludedb_sql_row_t *row;
         idmef_source_t *source;
         int cnt;
         int ret;
 
-        ret = preludedb_sql_query_sprintf(sql, &table,
-                                          "SELECT ident, spoofed, interface "
-                                          "FROM Prelude_Source "
-                                          "WHERE _message_ident = %" PRELUDE_PRIu64 " AND _index != -1 "
-                                          "ORDER BY _index ASC",
-                                          message_ident);
-        if ( ret <= 0 )
-                return ret;
-
-        while ( (ret = preludedb_sql_table_fetch_row(table, &row)) > 0 ) {
+        while ( (ret = get_next_row(ctx, GET_TABLE_SOURCE, 0, 0, 0, 0, &pos, &row)) > 0 ) {
 
                 ret = idmef_alert_new_source(alert, &source, IDMEF_LIST_APPEND);
                 if ( ret < 0 )
                         goto error;
 
-                ret = get_string(sql, row, 0, source, idmef_source_new_ident);
+                ret = get_string(ctx, row, 0, source, idmef_source_new_ident);
                 if ( ret < 0 )
                         goto error;
 
-                ret = get_enum(sql, row, 1, source, idmef_source_new_spoofed, idmef_source_spoofed_to_numeric);
+                ret = get_enum(ctx, row, 1, source, idmef_source_new_spoofed, idmef_source_spoofed_to_numeric);
                 if ( ret < 0 )
                         goto error;
 
-                ret = get_string(sql, row, 2, source, idmef_source_new_interface);
+                ret = get_string(ctx, row, 2, source, idmef_source_new_interface);
                 if ( ret < 0 )
                         goto error;
         }
@@ -1484,19 +1542,19 @@ static int get_source(preludedb_sql_t *sql,
         cnt = 0;
         while ( (source = idmef_alert_get_next_source(alert, source)) ) {
 
-                ret = get_node(sql, message_ident, 'S', cnt, source, (int (*)(void *, idmef_node_t **)) idmef_source_new_node);
+                ret = get_node(ctx, 'S', cnt, source, (int (*)(void *, idmef_node_t **)) idmef_source_new_node);
                 if ( ret < 0 )
                         goto error;
 
-                ret = get_user(sql, message_ident, 'S', cnt, source, (int (*)(void *, idmef_user_t **)) idmef_source_new_user);
+                ret = get_user(ctx, 'S', cnt, source, (int (*)(void *, idmef_user_t **)) idmef_source_new_user);
                 if ( ret < 0 )
                         goto error;
 
-                ret = get_process(sql, message_ident, 'S', cnt, source, (int (*)(void *, idmef_process_t **)) idmef_source_new_process);
+                ret = get_process(ctx, 'S', cnt, source, (int (*)(void *, idmef_process_t **)) idmef_source_new_process);
                 if ( ret < 0 )
                         goto error;
 
-                ret = get_service(sql, message_ident, 'S', cnt, source, (int (*)(void *, idmef_service_t **)) idmef_source_new_service);
+                ret = get_service(ctx, 'S', cnt, source, (int (*)(void *, idmef_service_t **)) idmef_source_new_service);
                 if ( ret < 0 )
                         goto error;
 
@@ -1504,45 +1562,33 @@ static int get_source(preludedb_sql_t *sql,
         }
 
  error:
-        preludedb_sql_table_destroy(table);
-
         return ret;
 }
 
-static int get_target(preludedb_sql_t *sql,
-                      uint64_t message_ident,
+static int get_target(get_context_t *ctx,
                       idmef_alert_t *alert)
 {
-        preludedb_sql_table_t *table;
+        unsigned int pos = 0;
         preludedb_sql_row_t *row;
         idmef_target_t *target;
         int cnt;
         int ret;
 
-        ret = preludedb_sql_query_sprintf(sql, &table,
-                                          "SELECT ident, decoy, interface "
-                                          "FROM Prelude_Target "
-                                          "WHERE _message_ident = %" PRELUDE_PRIu64 " AND _index != -1 "
-                                          "ORDER BY _index ASC",
-                                          message_ident);
-        if ( ret <= 0 )
-                return ret;
-
-        while ( (ret = preludedb_sql_table_fetch_row(table, &row)) > 0 ) {
+        while ( (ret = get_next_row(ctx, GET_TABLE_TARGET, 0, 0, 0, 0, &pos, &row)) > 0 ) {
 
                 ret = idmef_alert_new_target(alert, &target, IDMEF_LIST_APPEND);
                 if ( ret < 0 )
                         goto error;
 
-                ret = get_string(sql, row, 0, target, idmef_target_new_ident);
+                ret = get_string(ctx, row, 0, target, idmef_target_new_ident);
                 if ( ret < 0 )
                         goto error;
 
-                ret = get_enum(sql, row, 1, target, idmef_target_new_decoy, idmef_target_decoy_to_numeric);
+                ret = get_enum(ctx, row, 1, target, idmef_target_new_decoy, idmef_target_decoy_to_numeric);
                 if ( ret < 0 )
                         goto error;
 
-                ret = get_string(sql, row, 2, target, idmef_target_new_interface);
+                ret = get_string(ctx, row, 2, target, idmef_target_new_interface);
                 if ( ret < 0 )
                         goto error;
         }
@@ -1551,23 +1597,23 @@ static int get_target(preludedb_sql_t *sql,
         cnt = 0;
         while ( (target = idmef_alert_get_next_target(alert, target)) ) {
 
-                ret = get_node(sql, message_ident, 'T', cnt, target, (int (*)(void *, idmef_node_t **)) idmef_target_new_node);
+                ret = get_node(ctx, 'T', cnt, target, (int (*)(void *, idmef_node_t **)) idmef_target_new_node);
                 if ( ret < 0 )
                         goto error;
 
-                ret = get_user(sql, message_ident, 'T', cnt, target, (int (*)(void *, idmef_user_t **)) idmef_target_new_user);
+                ret = get_user(ctx, 'T', cnt, target, (int (*)(void *, idmef_user_t **)) idmef_target_new_user);
                 if ( ret < 0 )
                         goto error;
 
-                ret = get_process(sql, message_ident, 'T', cnt, target, (int (*)(void *, idmef_process_t **)) idmef_target_new_process);
+                ret = get_process(ctx, 'T', cnt, target, (int (*)(void *, idmef_process_t **)) idmef_target_new_process);
                 if ( ret < 0 )
                         goto error;
 
-                ret = get_service(sql, message_ident, 'T', cnt, target, (int (*)(void *, idmef_service_t **)) idmef_target_new_service);
+                ret = get_service(ctx, 'T', cnt, target, (int (*)(void *, idmef_service_t **)) idmef_target_new_service);
                 if ( ret < 0 )
                         goto error;
 
-                ret = get_file(sql, message_ident, cnt, target);
+                ret = get_file(ctx, cnt, target);
                 if ( ret < 0 )
                         goto error;
 
@@ -1575,14 +1621,11 @@ static int get_target(preludedb_sql_t *sql,
         }
 
  error:
-        preludedb_sql_table_destroy(table);
-
         return ret;
 }
 
 
-static int get_additional_data(preludedb_sql_t *sql,
-                               uint64_t message_ident,
+static int get_additional_data(get_context_t *ctx,
                                char parent_type,
                                void *parent,
                                int (*parent_new_child)(void *, idmef_additional_data_t **, int pos))
@@ -1591,34 +1634,25 @@ static int get_additional_data(preludedb_sql_t *sql,
         char *svalue = NULL;
         size_t svalue_size;
         prelude_bool_t svalue_need_free;
-        preludedb_sql_table_t *table;
+        unsigned int pos = 0;
         preludedb_sql_row_t *row;
         idmef_additional_data_type_t type;
         idmef_additional_data_t *additional_data;
         idmef_data_t *data;
         preludedb_sql_field_t *field;
 
-        ret = preludedb_sql_query_sprintf(sql, &table,
-                                          "SELECT type, meaning, data "
-                                          "FROM Prelude_AdditionalData "
-                                          "WHERE _parent_type = '%c' AND _message_ident = %" PRELUDE_PRIu64 " AND _index != -1 "
-                                          "ORDER BY _index ASC",
-                                          parent_type, message_ident);
-        if ( ret <= 0 )
-                return ret;
-
-        while ( (ret = preludedb_sql_table_fetch_row(table, &row)) > 0 ) {
+        while ( (ret = get_next_row(ctx, GET_TABLE_ADDITIONAL_DATA, parent_type, 0, 0, 0, &pos, &row)) > 0 ) {
 
                 ret = parent_new_child(parent, &additional_data, IDMEF_LIST_APPEND);
                 if ( ret < 0 )
                         goto error;
 
-                ret = get_enum(sql, row, 0, additional_data, idmef_additional_data_new_type,
+                ret = get_enum(ctx, row, 0, additional_data, idmef_additional_data_new_type,
                                idmef_additional_data_type_to_numeric);
                 if ( ret < 0 )
                         goto error;
 
-                ret = get_string(sql, row, 1, additional_data, idmef_additional_data_new_meaning);
+                ret = get_string(ctx, row, 1, additional_data, idmef_additional_data_new_meaning);
                 if ( ret < 0 )
                         goto error;
 
@@ -1632,7 +1666,7 @@ static int get_additional_data(preludedb_sql_t *sql,
 
                 type = idmef_additional_data_get_type(additional_data);
 
-                ret = classic_unescape_binary_safe(sql, field, type, (unsigned char **) &svalue, &svalue_size);
+                ret = classic_unescape_binary_safe(ctx->sql, field, type, (unsigned char **) &svalue, &svalue_size);
                 if ( ret < 0 )
                         break;
 
@@ -1728,228 +1762,165 @@ static int get_additional_data(preludedb_sql_t *sql,
         }
 
  error:
-        preludedb_sql_table_destroy(table);
         return ret;
 }
 
-static int get_reference(preludedb_sql_t *sql,
-                         uint64_t message_ident,
+static int get_reference(get_context_t *ctx,
                          idmef_classification_t *classification)
 {
-        preludedb_sql_table_t *table;
+        unsigned int pos = 0;
         preludedb_sql_row_t *row;
         idmef_reference_t *reference;
         int ret;
 
-        ret = preludedb_sql_query_sprintf(sql, &table,
-                                          "SELECT origin, name, url, meaning "
-                                          "FROM Prelude_Reference "
-                                          "WHERE _message_ident = %" PRELUDE_PRIu64 " AND _index != -1 "
-                                          "ORDER BY _index ASC",
-                                          message_ident);
-        if ( ret <= 0 )
-                return ret;
-
-        while ( (ret = preludedb_sql_table_fetch_row(table, &row)) > 0 ) {
+        while ( (ret = get_next_row(ctx, GET_TABLE_REFERENCE, 0, 0, 0, 0, &pos, &row)) > 0 ) {
 
                 ret = idmef_classification_new_reference(classification, &reference, IDMEF_LIST_APPEND);
                 if ( ret < 0 )
                         goto error;
 
-                ret = get_enum(sql, row, 0, reference, idmef_reference_new_origin,
+                ret = get_enum(ctx, row, 0, reference, idmef_reference_new_origin,
                                idmef_reference_origin_to_numeric);
                 if ( ret < 0 )
                         goto error;
 
-                ret = get_string(sql, row, 1, reference, idmef_reference_new_name);
+                ret = get_string(ctx, row, 1, reference, idmef_reference_new_name);
                 if ( ret < 0 )
                         goto error;
 
-                ret = get_string(sql, row, 2, reference, idmef_reference_new_url);
+                ret = get_string(ctx, row, 2, reference, idmef_reference_new_url);
                 if ( ret < 0 )
                         goto error;
 
-                ret = get_string(sql, row, 3, reference, idmef_reference_new_meaning);
+                ret = get_string(ctx, row, 3, reference, idmef_reference_new_meaning);
                 if ( ret < 0 )
                         goto error;
         }
 
  error:
-        preludedb_sql_table_destroy(table);
-
         return ret;
 }
 
-static int get_classification(preludedb_sql_t *sql,
-                              uint64_t message_ident,
+static int get_classification(get_context_t *ctx,
                               idmef_alert_t *alert)
 {
-        preludedb_sql_table_t *table;
         preludedb_sql_row_t *row;
         idmef_classification_t *classification;
         int ret;
 
-        ret = preludedb_sql_query_sprintf(sql, &table,
-                                          "SELECT ident, text "
-                                          "FROM Prelude_Classification "
-                                          "WHERE _message_ident = %" PRELUDE_PRIu64 "",
-                                          message_ident);
+        ret = get_row(ctx, GET_TABLE_CLASSIFICATION, 0, 0, 0, 0, &row);
         if ( ret <= 0 )
                 return ret;
 
-        ret = preludedb_sql_table_fetch_row(table, &row);
-        if ( ret <= 0 )
-                goto error;
-
         ret = idmef_alert_new_classification(alert, &classification);
         if ( ret < 0 )
                 goto error;
 
-        ret = get_string(sql, row, 0, classification, idmef_classification_new_ident);
+        ret = get_string(ctx, row, 0, classification, idmef_classification_new_ident);
         if ( ret < 0 )
                 goto error;
 
-        ret = get_string(sql, row, 1, classification, idmef_classification_new_text);
+        ret = get_string(ctx, row, 1, classification, idmef_classification_new_text);
         if ( ret < 0 )
                 goto error;
 
-        ret = get_reference(sql, message_ident, classification);
+        ret = get_reference(ctx, classification);
         if ( ret < 0 )
                 goto error;
 
  error:
-        preludedb_sql_table_destroy(table);
-
         return ret;
 }
 
-static int get_alertident(preludedb_sql_t *sql,
-                          uint64_t message_ident,
+static int get_alertident(get_context_t *ctx,
                           char parent_type,
                           void *parent,
                           int (*parent_new_child)(void *parent, idmef_alertident_t **child, int pos))
 {
-        preludedb_sql_table_t *table;
+        unsigned int pos = 0;
         preludedb_sql_row_t *row;
         idmef_alertident_t *alertident = NULL;
         int ret;
 
-        ret = preludedb_sql_query_sprintf(sql, &table,
-                                          "SELECT alertident, analyzerid "
-                                          "FROM Prelude_Alertident "
-                                          "WHERE _parent_type = '%c' AND _message_ident = %" PRELUDE_PRIu64" AND _index != -1 "
-                                          "ORDER BY _index ASC",
-                                          parent_type, message_ident);
-        if ( ret <= 0 )
-                return ret;
-
-        while ( (ret = preludedb_sql_table_fetch_row(table, &row)) > 0 ) {
+        while ( (ret = get_next_row(ctx, GET_TABLE_ALERTIDENT, parent_type, 0, 0, 0, &pos, &row)) > 0 ) {
 
                 ret = parent_new_child(parent, &alertident, IDMEF_LIST_APPEND);
                 if ( ret < 0 )
                         goto error;
 
-                ret = get_string(sql, row, 0, alertident, idmef_alertident_new_alertident);
+                ret = get_string(ctx, row, 0, alertident, idmef_alertident_new_alertident);
                 if ( ret < 0 )
                         goto error;
 
-                ret = get_string(sql, row, 1, alertident, idmef_alertident_new_analyzerid);
+                ret = get_string(ctx, row, 1, alertident, idmef_alertident_new_analyzerid);
                 if ( ret < 0 )
                         goto error;
         }
 
  error:
-        preludedb_sql_table_destroy(table);
-
         return ret;
 }
 
-static int get_tool_alert(preludedb_sql_t *sql,
-                          uint64_t message_ident,
+static int get_tool_alert(get_context_t *ctx,
                           idmef_alert_t *alert)
 {
-        preludedb_sql_table_t *table;
         preludedb_sql_row_t *row;
         idmef_tool_alert_t *tool_alert;
         int ret;
 
-        ret = preludedb_sql_query_sprintf(sql, &table,
-                                          "SELECT name, command "
-                                          "FROM Prelude_ToolAlert "
-                                          "WHERE _message_ident = %" PRELUDE_PRIu64 "",
-                                          message_ident);
+        ret = get_row(ctx, GET_TABLE_TOOL_ALERT, 0, 0, 0, 0, &row);
         if ( ret <= 0 )
                 return ret;
 
-        ret = preludedb_sql_table_fetch_row(table, &row);
-        if ( ret <= 0 )
-                goto error;
-
         ret = idmef_alert_new_tool_alert(alert, &tool_alert);
         if ( ret < 0 )
                 goto error;
 
-        ret = get_string(sql, row, 0, tool_alert, idmef_tool_alert_new_name);
+        ret = get_string(ctx, row, 0, tool_alert, idmef_tool_alert_new_name);
         if ( ret < 0 )
                 goto error;
 
-        ret = get_string(sql, row, 1, tool_alert, idmef_tool_alert_new_command);
+        ret = get_string(ctx, row, 1, tool_alert, idmef_tool_alert_new_command);
         if ( ret < 0 )
                 goto error;
 
-        ret = get_alertident(sql, message_ident, 'T', tool_alert,
+        ret = get_alertident(ctx, 'T', tool_alert,
                              (int (*)(void *, idmef_alertident_t **, int)) idmef_tool_alert_new_alertident);
 
  error:
-        preludedb_sql_table_destroy(table);
-
         return ret;
 }
 
-static int get_correlation_alert(preludedb_sql_t *sql,
-                                 uint64_t message_ident,
+static int get_correlation_alert(get_context_t *ctx,
                                  idmef_alert_t *alert)
 {
-        preludedb_sql_table_t *table;
         preludedb_sql_row_t *row;
         idmef_correlation_alert_t *correlation_alert;
         int ret;
 
-        ret = preludedb_sql_query_sprintf(sql, &table,
-                                          "SELECT name "
-                                          "FROM Prelude_CorrelationAlert "
-                                          "WHERE _message_ident = %" PRELUDE_PRIu64 "",
-                                          message_ident);
+        ret = get_row(ctx, GET_TABLE_CORRELATION_ALERT, 0, 0, 0, 0, &row);
         if ( ret <= 0 )
                 return ret;
 
-        ret = preludedb_sql_table_fetch_row(table, &row);
-        if ( ret <= 0 )
-                goto error;
-
         ret = idmef_alert_new_correlation_alert(alert, &correlation_alert);
         if ( ret < 0 )
                 goto error;
 
-        ret = get_string(sql, row, 0, correlation_alert, idmef_correlation_alert_new_name);
+        ret = get_string(ctx, row, 0, correlation_alert, idmef_correlation_alert_new_name);
         if ( ret < 0 )
                 goto error;
 
-        ret = get_alertident(sql, message_ident, 'C', correlation_alert,
+        ret = get_alertident(ctx, 'C', correlation_alert,
                              (int (*)(void *, idmef_alertident_t **, int)) idmef_correlation_alert_new_alertident);
 
  error:
-        preludedb_sql_table_destroy(table);
-
         return ret;
 }
 
 
-static int get_overflow_alert(preludedb_sql_t *sql,
-                              uint64_t message_ident,
+static int get_overflow_alert(get_context_t *ctx,
                               idmef_alert_t *alert)
 {
-        preludedb_sql_table_t *table;
         preludedb_sql_row_t *row;
         idmef_overflow_alert_t *overflow_alert;
         preludedb_sql_field_t *field;
@@ -1958,27 +1929,19 @@ static int get_overflow_alert(preludedb_sql_t *sql,
         size_t data_size;
         int ret;
 
-        ret = preludedb_sql_query_sprintf(sql, &table,
-                                          "SELECT program, size, buffer "
-                                          "FROM Prelude_OverflowAlert "
-                                          "WHERE _message_ident = %" PRELUDE_PRIu64 "",
-                                          message_ident);
+        ret = get_row(ctx, GET_TABLE_OVERFLOW_ALERT, 0, 0, 0, 0, &row);
         if ( ret <= 0 )
                 return ret;
 
-        ret = preludedb_sql_table_fetch_row(table, &row);
-        if ( ret <= 0 )
-                goto error;
-
         ret = idmef_alert_new_overflow_alert(alert, &overflow_alert);
         if ( ret < 0 )
                 goto error;
 
-        ret = get_string(sql, row, 0, overflow_alert, idmef_overflow_alert_new_program);
+        ret = get_string(ctx, row, 0, overflow_alert, idmef_overflow_alert_new_program);
         if ( ret < 0 )
                 goto error;
 
-        ret = get_uint32(sql, row, 1, overflow_alert, idmef_overflow_alert_new_size);
+        ret = get_uint32(ctx, row, 1, overflow_alert, idmef_overflow_alert_new_size);
         if ( ret < 0 )
                 goto error;
 
@@ -1990,10 +1953,7 @@ static int get_overflow_alert(preludedb_sql_t *sql,
         if ( ret < 0 )
                 goto error;
 
-        ret = preludedb_sql_unescape_binary(sql,
-                                            preludedb_sql_field_get_value(field),
-                                            preludedb_sql_field_get_len(field),
-                                            &data, &data_size);
+        ret = preludedb_sql_field_to_binary(ctx->sql, field, &data, &data_size);
 
         if ( ret < 0 )
                 goto error;
@@ -2001,41 +1961,30 @@ static int get_overflow_alert(preludedb_sql_t *sql,
         ret = idmef_data_set_byte_string_nodup(buffer, data, data_size);
 
  error:
-        preludedb_sql_table_destroy(table);
-
         return ret;
 }
 
 
-static int get_alert_messageid(preludedb_sql_t *sql, uint64_t ident, idmef_alert_t *alert)
+static int get_alert_messageid(get_context_t *ctx, idmef_alert_t *alert)
 {
-        preludedb_sql_table_t *table;
         preludedb_sql_row_t *row;
         int ret;
 
-        ret = preludedb_sql_query_sprintf(sql, &table, "SELECT messageid FROM Prelude_Alert WHERE _ident = %" PRELUDE_PRIu64 "", ident);
+        ret = get_row(ctx, GET_TABLE_ALERT, 0, 0, 0, 0, &row);
         if ( ret < 0 )
                 return ret;
 
         if ( ret == 0 )
                 return preludedb_error(PRELUDEDB_ERROR_INVALID_MESSAGE_IDENT);
 
-        ret = preludedb_sql_table_fetch_row(table, &row);
-        if ( ret < 0 )
-                goto error;
-
-        ret = get_string(sql, row, 0, alert, idmef_alert_new_messageid);
-
- error:
-        preludedb_sql_table_destroy(table);
+        ret = get_string(ctx, row, 0, alert, idmef_alert_new_messageid);
 
         return (ret < 0) ? ret : 1;
 }
 
 
-int classic_get_alert(preludedb_t *db, uint64_t ident, idmef_message_t **message)
+static int get_alert(get_context_t *ctx, idmef_message_t **message)
 {
-        preludedb_sql_t *sql = preludedb_get_sql(db);
         idmef_alert_t *alert;
         int ret;
 
@@ -2047,56 +1996,56 @@ int classic_get_alert(preludedb_t *db, uint64_t ident, idmef_message_t **message
         if ( ret < 0 )
                 goto error;
 
-        ret = get_alert_messageid(sql, ident, alert);
+        ret = get_alert_messageid(ctx, alert);
         if ( ret < 0 )
                 goto error;
 
-        ret = get_assessment(sql, ident, alert);
+        ret = get_assessment(ctx, alert);
         if ( ret < 0 )
                 goto error;
 
-        ret = get_analyzer(sql, ident, 'A', alert, (int (*)(void *, idmef_analyzer_t **, int)) idmef_alert_new_analyzer);
+        ret = get_analyzer(ctx, 'A', alert, (int (*)(void *, idmef_analyzer_t **, int)) idmef_alert_new_analyzer);
         if ( ret < 0 )
                 goto error;
 
-        ret = get_create_time(sql, ident, 'A', alert, (int (*)(void *, idmef_time_t **)) idmef_alert_new_create_time);
+        ret = get_create_time(ctx, 'A', alert, (int (*)(void *, idmef_time_t **)) idmef_alert_new_create_time);
         if ( ret < 0 )
                 goto error;
 
-        ret = get_detect_time(sql, ident, alert);
+        ret = get_detect_time(ctx, alert);
         if ( ret < 0 )
                 goto error;
 
-        ret = get_analyzer_time(sql, ident, 'A', alert, (int (*)(void *, idmef_time_t **)) idmef_alert_new_analyzer_time);
+        ret = get_analyzer_time(ctx, 'A', alert, (int (*)(void *, idmef_time_t **)) idmef_alert_new_analyzer_time);
         if ( ret < 0 )
                 goto error;
 
-        ret = get_source(sql, ident, alert);
+        ret = get_source(ctx, alert);
         if ( ret < 0 )
                 goto error;
 
-        ret = get_target(sql, ident, alert);
+        ret = get_target(ctx, alert);
         if ( ret < 0 )
                 goto error;
 
-        ret = get_classification(sql, ident, alert);
+        ret = get_classification(ctx, alert);
         if ( ret < 0 )
                 goto error;
 
-        ret = get_additional_data(sql, ident, 'A', alert,
+        ret = get_additional_data(ctx, 'A', alert,
                                   (int (*)(void *, idmef_additional_data_t **, int)) idmef_alert_new_additional_data);
         if ( ret < 0 )
                 goto error;
 
-        ret = get_tool_alert(sql, ident, alert);
+        ret = get_tool_alert(ctx, alert);
         if ( ret < 0 )
                 goto error;
 
-        ret = get_correlation_alert(sql, ident, alert);
+        ret = get_correlation_alert(ctx, alert);
         if ( ret < 0 )
                 goto error;
 
-        ret = get_overflow_alert(sql, ident, alert);
+        ret = get_overflow_alert(ctx, alert);
         if ( ret < 0 )
                 goto error;
 
@@ -2110,40 +2059,31 @@ int classic_get_alert(preludedb_t *db, uint64_t ident, idmef_message_t **message
 
 
 
-static int _get_heartbeat(preludedb_sql_t *sql, uint64_t ident, idmef_heartbeat_t *heartbeat)
+static int _get_heartbeat(get_context_t *ctx, idmef_heartbeat_t *heartbeat)
 {
-        preludedb_sql_table_t *table;
         preludedb_sql_row_t *row;
         int ret;
 
-        ret = preludedb_sql_query_sprintf(sql, &table, "SELECT messageid, heartbeat_interval FROM Prelude_Heartbeat WHERE _ident = %" PRELUDE_PRIu64 "", ident);
+        ret = get_row(ctx, GET_TABLE_HEARTBEAT, 0, 0, 0, 0, &row);
         if ( ret < 0 )
                 return ret;
 
         if ( ret == 0 )
                 return preludedb_error(PRELUDEDB_ERROR_INVALID_MESSAGE_IDENT);
 
-        ret = preludedb_sql_table_fetch_row(table, &row);
+        ret = get_string(ctx, row, 0, heartbeat, idmef_heartbeat_new_messageid);
         if ( ret < 0 )
-                goto error;
-
-        ret = get_string(sql, row, 0, heartbeat, idmef_heartbeat_new_messageid);
-        if ( ret < 0 )
-                goto error;
-
-        ret = get_uint32(sql, row, 1, heartbeat, idmef_heartbeat_new_heartbeat_interval);
+                return ret;
 
- error:
-        preludedb_sql_table_destroy(table);
+        ret = get_uint32(ctx, row, 1, heartbeat, idmef_heartbeat_new_heartbeat_interval);
 
         return (ret < 0) ? ret : 1;
 }
 
 
 
-int classic_get_heartbeat(preludedb_t *db, uint64_t ident, idmef_message_t **message)
+static int get_heartbeat(get_context_t *ctx, idmef_message_t **message)
 {
-        preludedb_sql_t *sql = preludedb_get_sql(db);
         idmef_heartbeat_t *heartbeat;
         int ret;
 
@@ -2155,23 +2095,23 @@ int classic_get_heartbeat(preludedb_t *db, uint64_t ident, idmef_message_t **mes
         if ( ret < 0 )
                 goto error;
 
-        ret = _get_heartbeat(sql, ident, heartbeat);
+        ret = _get_heartbeat(ctx, heartbeat);
         if ( ret <= 0 )
                 goto error;
 
-        ret = get_analyzer(sql, ident, 'H', heartbeat, (int (*)(void *, idmef_analyzer_t **, int)) idmef_heartbeat_new_analyzer);
+        ret = get_analyzer(ctx, 'H', heartbeat, (int (*)(void *, idmef_analyzer_t **, int)) idmef_heartbeat_new_analyzer);
         if ( ret < 0 )
                 goto error;
 
-        ret = get_create_time(sql, ident, 'H', heartbeat, (int (*)(void *, idmef_time_t **)) idmef_heartbeat_new_create_time);
+        ret = get_create_time(ctx, 'H', heartbeat, (int (*)(void *, idmef_time_t **)) idmef_heartbeat_new_create_time);
         if ( ret < 0 )
                 goto error;
 
-        ret = get_analyzer_time(sql, ident, 'H', heartbeat, (int (*)(void *, idmef_time_t **)) idmef_heartbeat_new_analyzer_time);
+        ret = get_analyzer_time(ctx, 'H', heartbeat, (int (*)(void *, idmef_time_t **)) idmef_heartbeat_new_analyzer_time);
         if ( ret < 0 )
                 goto error;
 
-        ret = get_additional_data(sql, ident, 'H', heartbeat,
+        ret = get_additional_data(ctx, 'H', heartbeat,
                                   (int (*)(void *, idmef_additional_data_t **, int)) idmef_heartbeat_new_additional_data);
         if ( ret < 0 )
                 goto error;
@@ -2183,3 +2123,139 @@ int classic_get_heartbeat(preludedb_t *db, uint64_t ident, idmef_message_t **mes
 
         return ret;
 }
+
+
+
+static int get_message(preludedb_t *db, uint64_t ident, idmef_message_t **message,
+                       int (*get_func)(get_context_t *ctx, idmef_message_t **message))
+{
+        int ret;
+        get_context_t ctx;
+
+        get_context_init(&ctx, preludedb_get_sql(db), &ident, 1);
+        ret = get_func(&ctx, message);
+        get_context_destroy(&ctx);
+
+        return ret;
+}
+
+
+
+static int get_message_order_cmp(const void *a, const void *b)
+{
+        const get_message_order_t *o1 = a, *o2 = b;
+
+        if ( o1->ident != o2->ident )
+                return (o1->ident < o2->ident) ? -1 : 1;
+
+        return (o1->index < o2->index) ? -1 : (o1->index > o2->index);
+}
+
+
+
+static ssize_t get_messages(preludedb_t *db, uint64_t *idents, size_t size, idmef_message_t **messages,
+                            int (*get_func)(get_context_t *ctx, idmef_message_t **message))
+{
+        int ret = 0;
+        size_t i, j, n, count = 0;
+        get_context_t ctx;
+        get_message_order_t *order;
+        uint64_t *sorted;
+
+        if ( size == 0 )
+                return 0;
+
+        order = malloc(size * sizeof(*order));
+        if ( ! order )
+                return preludedb_error_from_errno(errno);
+
+        sorted = malloc(size * sizeof(*sorted));
+        if ( ! sorted ) {
+                free(order);
+                return preludedb_error_from_errno(errno);
+        }
+
+        for ( i = 0; i < size; i++ ) {
+                messages[i] = NULL;
+                order[i].ident = idents[i];
+                order[i].index = i;
+        }
+
+        /*
+         * Messages are built in ascending ident order so that each
+         * prefetched table is walked only once.
+         */
+        qsort(order, size, sizeof(*order), get_message_order_cmp);
+
+        for ( i = 0; i < size; i++ )
+                sorted[i] = order[i].ident;
+
+        for ( i = 0; i < size && ret >= 0; i += n ) {
+                n = (size - i < GET_MESSAGES_CHUNK_SIZE) ? size - i : GET_MESSAGES_CHUNK_SIZE;
+
+                get_context_init(&ctx, preludedb_get_sql(db), sorted + i, n);
+
+                for ( j = i; j < i + n; j++ ) {
+                        ctx.ident = order[j].ident;
+
+                        ret = get_func(&ctx, &messages[order[j].index]);
+                        if ( ret < 0 ) {
+                                messages[order[j].index] = NULL;
+
+                                if ( ! preludedb_error_check(ret, PRELUDEDB_ERROR_INVALID_MESSAGE_IDENT) )
+                                        break;
+
+                                ret = 0;
+                                continue;
+                        }
+
+                        count++;
+                }
+
+                get_context_destroy(&ctx);
+        }
+
+        free(sorted);
+        free(order);
+
+        if ( ret < 0 ) {
+                for ( i = 0; i < size; i++ ) {
+                        if ( messages[i] ) {
+                                idmef_message_destroy(messages[i]);
+                                messages[i] = NULL;
+                        }
+                }
+
+                return ret;
+        }
+
+        return count;
+}
+
+
+
+int classic_get_alert(preludedb_t *db, uint64_t ident, idmef_message_t **message)
+{
+        return get_message(db, ident, message, get_alert);
+}
+
+
+
+ssize_t classic_get_alerts(preludedb_t *db, uint64_t *idents, size_t size, idmef_message_t **messages)
+{
+        return get_messages(db, idents, size, messages, get_alert);
+}
+
+
+
+int classic_get_heartbeat(preludedb_t *db, uint64_t ident, idmef_message_t **message)
+{
+        return get_message(db, ident, message, get_heartbeat);
+}
+
+
+
+ssize_t classic_get_heartbeats(preludedb_t *db, uint64_t *idents, size_t size, idmef_message_t **messages)
+{
+        return get_messages(db, idents, size, messages, get_heartbeat);
+}
@@ -25,6 +25,7 @@
 
 #include <stdio.h>
 #include <stdlib.h>
+#include <stdarg.h>
 #include <string.h>
 
 #include <libprelude/prelude-log.h>
@@ -35,6 +36,7 @@
 #include "preludedb.h"
 
 #include "classic-insert.h"
+#include "classic-rollup.h"
 
 
 static inline const char *get_string(prelude_string_t *string)
@@ -51,41 +53,149 @@ static inline const char *get_string(prelude_string_t *string)
 
 
 
-static int get_data(preludedb_sql_t *sql, idmef_data_t *data, char **output)
+/*
+ * Values of a row queued with preludedb_sql_insert_params(). Strings and
+ * data are referenced as is, numbers are formatted in the row storage.
+ */
+#define INSERT_PARAMS_MAX 20
+
+typedef struct {
+        unsigned int count;
+        prelude_string_t *data;
+        preludedb_sql_param_t params[INSERT_PARAMS_MAX];
+        char values[INSERT_PARAMS_MAX][PRELUDEDB_SQL_TIMESTAMP_STRING_SIZE];
+} insert_params_t;
+
+
+
+static inline void insert_params_init(insert_params_t *params)
+{
+        params->count = 0;
+        params->data = NULL;
+}
+
+
+
+static inline void add_value(insert_params_t *params, const char *value, size_t len, preludedb_sql_param_type_t type)
+{
+        preludedb_sql_param_t *param = &params->params[params->count++];
+
+        param->value = value;
+        param->len = len;
+        param->type = type;
+}
+
+
+
+static inline void add_string(insert_params_t *params, const char *value)
+{
+        add_value(params, value, value ? strlen(value) : 0, PRELUDEDB_SQL_PARAM_TYPE_TEXT);
+}
+
+
+
+static void add_number(insert_params_t *params, const char *format, ...)
+                       __attribute__ ((__format__ (__printf__, 2, 3)));
+
+static void add_number(insert_params_t *params, const char *format, ...)
+{
+        va_list ap;
+        char *value = params->values[params->count];
+
+        va_start(ap, format);
+        vsnprintf(value, sizeof(params->values[0]), format, ap);
+        va_end(ap);
+
+        add_string(params, value);
+}
+
+
+
+static int add_data(insert_params_t *params, idmef_data_t *data)
 {
         int ret;
-        prelude_string_t *string;
+
+        if ( ! data ) {
+                add_string(params, NULL);
+                return 0;
+        }
 
         switch ( idmef_data_get_type(data) ) {
         case IDMEF_DATA_TYPE_BYTE_STRING:
-                return preludedb_sql_escape_binary(sql, idmef_data_get_data(data), idmef_data_get_len(data), output);
+                add_value(params, idmef_data_get_data(data), idmef_data_get_len(data), PRELUDEDB_SQL_PARAM_TYPE_BINARY);
+                return 0;
 
         case IDMEF_DATA_TYPE_CHAR_STRING:
-                return preludedb_sql_escape_binary(sql, idmef_data_get_data(data), idmef_data_get_len(data) - 1, output);
+                add_value(params, idmef_data_get_data(data), idmef_data_get_len(data) - 1, PRELUDEDB_SQL_PARAM_TYPE_BINARY);
+                return 0;
 
         case IDMEF_DATA_TYPE_CHAR:
-                return preludedb_sql_escape_binary(sql, idmef_data_get_data(data), 1, output);
+                add_value(params, idmef_data_get_data(data), 1, PRELUDEDB_SQL_PARAM_TYPE_BINARY);
+                return 0;
 
         default:
-                ret = prelude_string_new(&string);
+                ret = prelude_string_new(&params->data);
                 if ( ret < 0 )
                         return ret;
 
-                ret = idmef_data_to_string(data, string);
+                ret = idmef_data_to_string(data, params->data);
                 if (  ret < 0 ) {
-                        prelude_string_destroy(string);
+                        prelude_string_destroy(params->data);
+                        params->data = NULL;
                         return ret;
                 }
 
-                ret = preludedb_sql_escape_binary(sql, (const unsigned char *) prelude_string_get_string(string),
-                                                  prelude_string_get_len(string), output);
-                prelude_string_destroy(string);
-                return ret;
+                add_value(params, prelude_string_get_string(params->data), prelude_string_get_len(params->data),
+                          PRELUDEDB_SQL_PARAM_TYPE_BINARY);
+                return 0;
         }
 }
 
 
 
+/*
+ * Add the time, GMT offset and optionally microseconds columns. The
+ * timestamp is built as a SQL literal, its quotes are stripped.
+ */
+static int add_time(preludedb_sql_t *sql, insert_params_t *params, const idmef_time_t *time, prelude_bool_t usec)
+{
+        int ret;
+        size_t len;
+        char *value;
+
+        if ( ! time ) {
+                add_string(params, NULL);
+                add_string(params, NULL);
+
+                if ( usec )
+                        add_string(params, NULL);
+
+                return 0;
+        }
+
+        value = params->values[params->count];
+
+        ret = preludedb_sql_time_to_timestamp(sql, time, value, sizeof(params->values[0]), NULL, 0, NULL, 0);
+        if ( ret < 0 )
+                return ret;
+
+        len = strlen(value);
+        if ( len >= 2 && value[0] == '\'' && value[len - 1] == '\'' ) {
+                value[len - 1] = 0;
+                add_value(params, value + 1, len - 2, PRELUDEDB_SQL_PARAM_TYPE_TEXT);
+        } else
+                add_string(params, value);
+
+        add_number(params, "%d", idmef_time_get_gmt_offset(time));
+
+        if ( usec )
+                add_number(params, "%d", idmef_time_get_usec(time));
+
+        return 0;
+}
+
+
+
 static inline char *get_optional_enum(int *value, char *(*convert_func)(int))
 {
         if ( ! value )
@@ -96,96 +206,71 @@ static inline char *get_optional_enum(int *value, char *(*convert_func)(int))
 
 
 
-#define get_optional_integer(name, type, format)                                \
-static inline void get_optional_ ## name(char *dst, size_t size, type *value)   \
-{                                                                               \
-        if ( ! value )                                                          \
-                strncpy(dst, "NULL", size);                                     \
-        else                                                                    \
-                snprintf(dst, size, format, *value);                            \
+#define add_optional_integer(name, type, format)                                        \
+static inline void add_optional_ ## name(insert_params_t *params, type *value)          \
+{                                                                                       \
+        if ( ! value )                                                                  \
+                add_string(params, NULL);                                               \
+        else                                                                            \
+                add_number(params, format, *value);                                     \
 }
 
 
 /*
  * %hh convertion specifier is not portable.
  */
-static inline void get_optional_uint8(char *dst, size_t size, uint8_t *value)
+static inline void add_optional_uint8(insert_params_t *params, uint8_t *value)
 {
         if ( ! value )
-                strncpy(dst, "NULL", size);
-        else {
-                unsigned int tmp = (unsigned int) *value;
-                snprintf(dst, size, "%u", tmp);
-        }
+                add_string(params, NULL);
+        else
+                add_number(params, "%u", (unsigned int) *value);
 }
 
-get_optional_integer(uint16, uint16_t, "%hu")
-get_optional_integer(int32, int32_t, "%d")
-get_optional_integer(uint32, uint32_t, "%u")
-get_optional_integer(uint64, uint64_t, "%" PRELUDE_PRIu64)
-get_optional_integer(float, float, "%f")
+add_optional_integer(uint16, uint16_t, "%hu")
+add_optional_integer(int32, int32_t, "%d")
+add_optional_integer(uint32, uint32_t, "%u")
+add_optional_integer(uint64, uint64_t, "%" PRELUDE_PRIu64)
 
 
-static int insert_address(preludedb_sql_t *sql,
-                          char parent_type, uint64_t message_ident, int parent_index, int address_index,
-                          idmef_address_t *address)
+
+static int insert_params(preludedb_sql_t *sql, const char *table, const char *fields, insert_params_t *params)
 {
         int ret;
-        char *vlan_name, vlan_num[16], *addr, *netmask, *category, *ident;
-
-        if ( ! address )
-                return 0;
 
-        ret = preludedb_sql_escape(sql, idmef_address_category_to_string(idmef_address_get_category(address)), &category);
-        if ( ret < 0 )
-                return ret;
+        ret = preludedb_sql_insert_params(sql, table, fields, params->params, params->count);
 
-        ret = preludedb_sql_escape(sql, get_string(idmef_address_get_ident(address)), &ident);
-        if ( ret < 0 ) {
-                free(category);
-                return ret;
-        }
+        if ( params->data )
+                prelude_string_destroy(params->data);
 
-        ret = preludedb_sql_escape(sql, get_string(idmef_address_get_address(address)), &addr);
-        if ( ret < 0 ) {
-                free(ident);
-                free(category);
-                return ret;
-        }
-
-        ret = preludedb_sql_escape(sql, get_string(idmef_address_get_netmask(address)), &netmask);
-        if ( ret < 0 ) {
-                free(ident);
-                free(addr);
-                free(category);
-                return ret;
-        }
-
-        ret = preludedb_sql_escape(sql, get_string(idmef_address_get_vlan_name(address)), &vlan_name);
-        if ( ret < 0 ) {
-                free(ident);
-                free(addr);
-                free(netmask);
-                free(category);
-                return ret;
-        }
+        return ret;
+}
 
-        get_optional_int32(vlan_num, sizeof(vlan_num), idmef_address_get_vlan_num(address));
 
-        ret = preludedb_sql_insert(sql, "Prelude_Address",
-                                   "_parent_type, _message_ident, _parent0_index, _index,"
-                                   "ident, category, vlan_name, vlan_num, address, netmask",
-                                   "'%c', %" PRELUDE_PRIu64 ", %d, %d, %s, %s, %s, %s, %s, %s",
-                                   parent_type, message_ident, parent_index, address_index,
-                                   ident, category, vlan_name, vlan_num, addr, netmask);
+static int insert_address(preludedb_sql_t *sql,
+                          char parent_type, uint64_t message_ident, int parent_index, int address_index,
+                          idmef_address_t *address)
+{
+        insert_params_t params;
 
-        free(ident);
-        free(addr);
-        free(netmask);
-        free(category);
-        free(vlan_name);
+        if ( ! address )
+                return 0;
 
-        return ret;
+        insert_params_init(&params);
+        add_number(&params, "%c", parent_type);
+        add_number(&params, "%" PRELUDE_PRIu64, message_ident);
+        add_number(&params, "%d", parent_index);
+        add_number(&params, "%d", address_index);
+        add_string(&params, get_string(idmef_address_get_ident(address)));
+        add_string(&params, idmef_address_category_to_string(idmef_address_get_category(address)));
+        add_string(&params, get_string(idmef_address_get_vlan_name(address)));
+        add_optional_int32(&params, idmef_address_get_vlan_num(address));
+        add_string(&params, get_string(idmef_address_get_address(address)));
+        add_string(&params, get_string(idmef_address_get_netmask(address)));
+
+        return insert_params(sql, "Prelude_Address",
+                             "_parent_type, _message_ident, _parent0_index, _index,"
+                             "ident, category, vlan_name, vlan_num, address, netmask", &params);
 }
 
 
@@ -196,49 +281,24 @@ static int insert_node(preludedb_sql_t *sql,
 {
         int ret;
         idmef_address_t *address, *last_address;
-        char *location, *name, *category, *ident;
+        insert_params_t params;
         int index;
 
         if ( ! node )
                 return 0;
 
-        ret = preludedb_sql_escape(sql, idmef_node_category_to_string(idmef_node_get_category(node)), &category);
-        if ( ret < 0 )
-                return ret;
-
-        ret = preludedb_sql_escape(sql, get_string(idmef_node_get_ident(node)), &ident);
-        if ( ret < 0 ) {
-                free(category);
-                return ret;
-        }
-
-        ret = preludedb_sql_escape(sql, get_string(idmef_node_get_name(node)), &name);
-        if ( ret < 0 ) {
-                free(ident);
-                free(category);
-                return ret;
-        }
-
-        ret = preludedb_sql_escape(sql, get_string(idmef_node_get_location(node)), &location);
-        if ( ret < 0 ) {
-                free(name);
-                free(ident);
-                free(category);
-                return -1;
-        }
-
-        ret = preludedb_sql_insert(sql, "Prelude_Node",
-                                   "_parent_type, _message_ident, _parent0_index, "
-                                   "ident, category, location, name",
-                                   "'%c', %" PRELUDE_PRIu64 ", %d, %s, %s, %s, %s",
-                                   parent_type, message_ident, parent_index,
-                                   ident, category, location, name);
-
-        free(name);
-        free(ident);
-        free(location);
-        free(category);
+        insert_params_init(&params);
+        add_number(&params, "%c", parent_type);
+        add_number(&params, "%" PRELUDE_PRIu64, message_ident);
+        add_number(&params, "%d", parent_index);
+        add_string(&params, get_string(idmef_node_get_ident(node)));
+        add_string(&params, idmef_node_category_to_string(idmef_node_get_category(node)));
+        add_string(&params, get_string(idmef_node_get_location(node)));
+        add_string(&params, get_string(idmef_node_get_name(node)));
 
+        ret = insert_params(sql, "Prelude_Node",
+                            "_parent_type, _message_ident, _parent0_index, "
+                            "ident, category, location, name", &params);
         if ( ret < 0 )
                 return ret;
 
@@ -269,49 +329,24 @@ static int insert_user_id(preludedb_sql_t *sql,
                           int parent_index, int file_index, int file_access_index, int index,
                           idmef_user_id_t *user_id)
 {
-        int ret;
-        char *name, *type, *ident, *tty, number[16];
-
-        ret = preludedb_sql_escape(sql, get_string(idmef_user_id_get_ident(user_id)), &ident);
-        if ( ret < 0 )
-                return ret;
-
-        ret = preludedb_sql_escape(sql, get_string(idmef_user_id_get_tty(user_id)), &tty);
-        if ( ret < 0 ) {
-                free(ident);
-                return ret;
-        }
-
-        ret = preludedb_sql_escape(sql, idmef_user_id_type_to_string(idmef_user_id_get_type(user_id)), &type);
-        if ( ret < 0 ) {
-                free(tty);
-                free(ident);
-                return ret;
-        }
-
-        ret = preludedb_sql_escape(sql, get_string(idmef_user_id_get_name(user_id)), &name);
-        if ( ret < 0 ) {
-                free(tty);
-                free(type);
-                free(ident);
-                return ret;
-        }
-
-        get_optional_uint32(number, sizeof(number), idmef_user_id_get_number(user_id));
-
-        ret = preludedb_sql_insert(sql, "Prelude_UserId",
-                                   "_parent_type, _message_ident, _parent0_index, _parent1_index, _parent2_index, _index, "
-                                   "ident, type, name, number, tty",
-                                   "'%c', %" PRELUDE_PRIu64 ", %d, %d, %d, %d, %s, %s, %s, %s, %s",
-                                   parent_type, message_ident, parent_index, file_index, file_access_index, index,
-                                   ident, type, name, number, tty);
-
-        free(tty);
-        free(type);
-        free(name);
-        free(ident);
-
-        return ret;
+        insert_params_t params;
+
+        insert_params_init(&params);
+        add_number(&params, "%c", parent_type);
+        add_number(&params, "%" PRELUDE_PRIu64, message_ident);
+        add_number(&params, "%d", parent_index);
+        add_number(&params, "%d", file_index);
+        add_number(&params, "%d", file_access_index);
+        add_number(&params, "%d", index);
+        add_string(&params, get_string(idmef_user_id_get_ident(user_id)));
+        add_string(&params, idmef_user_id_type_to_string(idmef_user_id_get_type(user_id)));
+        add_string(&params, get_string(idmef_user_id_get_name(user_id)));
+        add_optional_uint32(&params, idmef_user_id_get_number(user_id));
+        add_string(&params, get_string(idmef_user_id_get_tty(user_id)));
+
+        return insert_params(sql, "Prelude_UserId",
+                             "_parent_type, _message_ident, _parent0_index, _parent1_index, _parent2_index, _index, "
+                             "ident, type, name, number, tty", &params);
 }
 
 
@@ -319,34 +354,24 @@ static int insert_user_id(preludedb_sql_t *sql,
 static int insert_user(preludedb_sql_t *sql, char parent_type, uint64_t message_ident, int parent_index,
                        idmef_user_t *user)
 {
-        char *category, *ident;
         idmef_user_id_t *user_id, *last_user_id;
+        insert_params_t params;
         int index;
         int ret;
 
         if ( ! user )
                 return 0;
 
-        ret = preludedb_sql_escape(sql, get_string(idmef_user_get_ident(user)), &ident);
-        if ( ret < 0 )
-                return ret;
-
-        ret = preludedb_sql_escape(sql, idmef_user_category_to_string(idmef_user_get_category(user)), &category);
-        if ( ret < 0 ) {
-                free(ident);
-                return ret;
-        }
-
-        ret = preludedb_sql_insert(sql, "Prelude_User",
-                                   "_parent_type, _message_ident, _parent0_index, "
-                                   "ident, category",
-                                   "'%c', %" PRELUDE_PRIu64 ", %d, %s, %s",
-                                   parent_type, message_ident, parent_index,
-                                   ident, category);
-
-        free(ident);
-        free(category);
+        insert_params_init(&params);
+        add_number(&params, "%c", parent_type);
+        add_number(&params, "%" PRELUDE_PRIu64, message_ident);
+        add_number(&params, "%d", parent_index);
+        add_string(&params, get_string(idmef_user_get_ident(user)));
+        add_string(&params, idmef_user_category_to_string(idmef_user_get_category(user)));
 
+        ret = insert_params(sql, "Prelude_User",
+                            "_parent_type, _message_ident, _parent0_index, "
+                            "ident, category", &params);
         if ( ret < 0 )
                 return ret;
 
@@ -376,22 +401,17 @@ static int insert_process_arg(preludedb_sql_t *sql,
                               char parent_type, uint64_t message_ident, int parent_index, int arg_index,
                               prelude_string_t *arg)
 {
-        char *tmp;
-        int ret;
+        insert_params_t params;
 
-        ret = preludedb_sql_escape(sql, get_string(arg), &tmp);
-        if ( ret < 0 )
-                return ret;
+        insert_params_init(&params);
+        add_number(&params, "%c", parent_type);
+        add_number(&params, "%" PRELUDE_PRIu64, message_ident);
+        add_number(&params, "%d", parent_index);
+        add_number(&params, "%d", arg_index);
+        add_string(&params, get_string(arg));
 
-        ret = preludedb_sql_insert(sql, "Prelude_ProcessArg",
-                                   "_parent_type, _message_ident, _parent0_index, _index, arg",
-                                   "'%c', %" PRELUDE_PRIu64 ", %d, %d, %s",
-                                   parent_type, message_ident, parent_index, arg_index,
-                                   tmp);
-
-        free(tmp);
-
-        return ret;
+        return insert_params(sql, "Prelude_ProcessArg",
+                             "_parent_type, _message_ident, _parent0_index, _index, arg", &params);
 }
 
 
@@ -400,22 +420,17 @@ static int insert_process_env(preludedb_sql_t *sql,
                               char parent_type, uint64_t message_ident, int parent_index, int env_index,
                               prelude_string_t *env)
 {
-        char *tmp;
-        int ret;
-
-        ret = preludedb_sql_escape(sql, get_string(env), &tmp);
-        if ( ret < 0 )
-                return ret;
-
-        ret = preludedb_sql_insert(sql, "Prelude_ProcessEnv",
-                                   "_parent_type, _message_ident, _parent0_index, _index, env",
-                                   "'%c', %" PRELUDE_PRIu64 ", %d, %d, %s",
-                                   parent_type, message_ident, parent_index, env_index,
-                                   tmp);
+        insert_params_t params;
 
-        free(tmp);
+        insert_params_init(&params);
+        add_number(&params, "%c", parent_type);
+        add_number(&params, "%" PRELUDE_PRIu64, message_ident);
+        add_number(&params, "%d", parent_index);
+        add_number(&params, "%d", env_index);
+        add_string(&params, get_string(env));
 
-        return ret;
+        return insert_params(sql, "Prelude_ProcessEnv",
+                             "_parent_type, _message_ident, _parent0_index, _index, env", &params);
 }
 
 
@@ -425,42 +440,24 @@ static int insert_process(preludedb_sql_t *sql, char parent_type, uint64_t messa
 {
         prelude_string_t *process_arg;
         prelude_string_t *process_env;
-        char *name, *path, pid[16], *ident;
+        insert_params_t params;
         int index;
         int ret;
 
         if ( ! process )
                 return 0;
 
-        ret = preludedb_sql_escape(sql, get_string(idmef_process_get_ident(process)), &ident);
-        if ( ret < 0 )
-                return ret;
-
-        ret = preludedb_sql_escape(sql, get_string(idmef_process_get_name(process)), &name);
-        if ( ret < 0 ) {
-                free(ident);
-                return ret;
-        }
-
-        ret = preludedb_sql_escape(sql, get_string(idmef_process_get_path(process)), &path);
-        if ( ret < 0 ) {
-                free(ident);
-                free(name);
-                return ret;
-        }
-
-        get_optional_uint32(pid, sizeof(pid), idmef_process_get_pid(process));
-
-        ret = preludedb_sql_insert(sql, "Prelude_Process",
-                                   "_parent_type, _message_ident, _parent0_index, ident, name, pid, path",
-                                   "'%c', %" PRELUDE_PRIu64 ", %d, %s, %s, %s, %s",
-                                   parent_type, message_ident, parent_index,
-                                   ident, name, pid, path);
-
-        free(name);
-        free(path);
-        free(ident);
+        insert_params_init(&params);
+        add_number(&params, "%c", parent_type);
+        add_number(&params, "%" PRELUDE_PRIu64, message_ident);
+        add_number(&params, "%d", parent_index);
+        add_string(&params, get_string(idmef_process_get_ident(process)));
+        add_string(&params, get_string(idmef_process_get_name(process)));
+        add_optional_uint32(&params, idmef_process_get_pid(process));
+        add_string(&params, get_string(idmef_process_get_path(process)));
 
+        ret = insert_params(sql, "Prelude_Process",
+                            "_parent_type, _message_ident, _parent0_index, ident, name, pid, path", &params);
         if ( ret < 0 )
                 return ret;
 
@@ -488,66 +485,28 @@ static int insert_process(preludedb_sql_t *sql, char parent_type, uint64_t messa
 static int insert_snmp_service(preludedb_sql_t *sql, char parent_type, uint64_t message_ident, int parent_index,
                                idmef_snmp_service_t *snmp_service)
 {
-        char *oid = NULL, *community = NULL, *security_name = NULL, *context_name = NULL,
-                *context_engine_id = NULL, *command = NULL, mpm[12], sem[12], sel[12];
-        int ret = -1;
+        insert_params_t params;
 
         if ( ! snmp_service )
                 return 0;
 
-        ret = preludedb_sql_escape(sql, get_string(idmef_snmp_service_get_oid(snmp_service)), &oid);
-        if ( ret < 0 )
-                goto error;
-
-        get_optional_uint32(mpm, sizeof(mpm), idmef_snmp_service_get_message_processing_model(snmp_service));
-        get_optional_uint32(sem, sizeof(sem), idmef_snmp_service_get_security_model(snmp_service));
-
-        ret = preludedb_sql_escape(sql, get_string(idmef_snmp_service_get_security_name(snmp_service)), &security_name);
-        if ( ret < 0 )
-                goto error;
-
-        get_optional_uint32(sel, sizeof(sel), idmef_snmp_service_get_security_level(snmp_service));
-
-        ret = preludedb_sql_escape(sql, get_string(idmef_snmp_service_get_context_name(snmp_service)), &context_name);
-        if ( ret < 0 )
-                goto error;
-
-        ret = preludedb_sql_escape(sql, get_string(idmef_snmp_service_get_context_engine_id(snmp_service)), &context_engine_id);
-        if ( ret < 0 )
-                goto error;
-
-        ret = preludedb_sql_escape(sql, get_string(idmef_snmp_service_get_command(snmp_service)), &command);
-        if ( ret < 0 )
-                goto error;
-
-        ret = preludedb_sql_insert(sql, "Prelude_SnmpService",
-                                   "_parent_type, _message_ident, _parent0_index, snmp_oid, message_processing_model, "
-                                   "security_model, security_name, security_level, context_name, "
-                                   "context_engine_id, command",
-                                   "'%c', %" PRELUDE_PRIu64 ", %d, %s, %s, %s, %s, %s, %s, %s, %s",
-                                   parent_type, message_ident, parent_index, oid, mpm, sem, security_name, sel, context_name,
-                                   context_engine_id, command);
-
- error:
-        if ( oid )
-                free(oid);
-
-        if ( community )
-                free(community);
-
-        if ( security_name )
-                free(security_name);
-
-        if ( context_name )
-                free(context_name);
-
-        if ( context_engine_id )
-                free(context_engine_id);
-
-        if ( command )
-                free(command);
-
-        return ret;
+        insert_params_init(&params);
+        add_number(&params, "%c", parent_type);
+        add_number(&params, "%" PRELUDE_PRIu64, message_ident);
+        add_number(&params, "%d", parent_index);
+        add_string(&params, get_string(idmef_snmp_service_get_oid(snmp_service)));
+        add_optional_uint32(&params, idmef_snmp_service_get_message_processing_model(snmp_service));
+        add_optional_uint32(&params, idmef_snmp_service_get_security_model(snmp_service));
+        add_string(&params, get_string(idmef_snmp_service_get_security_name(snmp_service)));
+        add_optional_uint32(&params, idmef_snmp_service_get_security_level(snmp_service));
+        add_string(&params, get_string(idmef_snmp_service_get_context_name(snmp_service)));
+        add_string(&params, get_string(idmef_snmp_service_get_context_engine_id(snmp_service)));
+        add_string(&params, get_string(idmef_snmp_service_get_command(snmp_service)));
+
+        return insert_params(sql, "Prelude_SnmpService",
+                             "_parent_type, _message_ident, _parent0_index, snmp_oid, message_processing_model, "
+                             "security_model, security_name, security_level, context_name, "
+                             "context_engine_id, command", &params);
 }
 
 
@@ -556,22 +515,17 @@ static int insert_web_service_arg(preludedb_sql_t *sql,
                                   char parent_type, uint64_t message_ident, int parent_index, int arg_index,
                                   prelude_string_t *arg)
 {
-        char *tmp;
-        int ret;
-
-        ret = preludedb_sql_escape(sql, get_string(arg), &tmp);
-        if ( ret < 0 )
-                return ret;
+        insert_params_t params;
 
-        ret = preludedb_sql_insert(sql, "Prelude_WebServiceArg",
-                                   "_parent_type, _message_ident, _parent0_index, _index, arg",
-                                   "'%c', %" PRELUDE_PRIu64 ", %d, %d, %s",
-                                   parent_type, message_ident, parent_index, arg_index,
-                                   tmp);
+        insert_params_init(&params);
+        add_number(&params, "%c", parent_type);
+        add_number(&params, "%" PRELUDE_PRIu64, message_ident);
+        add_number(&params, "%d", parent_index);
+        add_number(&params, "%d", arg_index);
+        add_string(&params, get_string(arg));
 
-        free(tmp);
-
-        return ret;
+        return insert_params(sql, "Prelude_WebServiceArg",
+                             "_parent_type, _message_ident, _parent0_index, _index, arg", &params);
 }
 
 
@@ -581,41 +535,26 @@ static int insert_web_service(preludedb_sql_t *sql,
                               idmef_web_service_t *web_service)
 {
         prelude_string_t *web_service_arg, *last_web_service_arg;
-        char *url, *cgi, *method;
+        insert_params_t params;
         int index = 0;
         int ret;
 
         if ( ! web_service )
                 return 0;
 
-        ret = preludedb_sql_escape(sql, get_string(idmef_web_service_get_url(web_service)), &url);
-        if ( ret < 0 )
-                return ret;
-
-        ret = preludedb_sql_escape(sql, get_string(idmef_web_service_get_cgi(web_service)), &cgi);
-        if ( ret < 0 ) {
-                free(url);
-                return -1;
-        }
+        insert_params_init(&params);
+        add_number(&params, "%c", parent_type);
+        add_number(&params, "%" PRELUDE_PRIu64, message_ident);
+        add_number(&params, "%d", parent_index);
+        add_string(&params, get_string(idmef_web_service_get_url(web_service)));
+        add_string(&params, get_string(idmef_web_service_get_cgi(web_service)));
+        add_string(&params, get_string(idmef_web_service_get_http_method(web_service)));
 
-        ret = preludedb_sql_escape(sql, get_string(idmef_web_service_get_http_method(web_service)), &method);
-        if ( ret < 0 ) {
-                free(url);
-                free(cgi);
+        ret = insert_params(sql, "Prelude_WebService",
+                            "_parent_type, _message_ident, _parent0_index, "
+                            "url, cgi, http_method", &params);
+        if ( ret < 0 )
                 return ret;
-        }
-
-        ret = preludedb_sql_insert(sql,
-                                   "Prelude_WebService",
-                                   "_parent_type, _message_ident, _parent0_index, "
-                                   "url, cgi, http_method",
-                                   "'%c', %" PRELUDE_PRIu64 ", %d, %s, %s, %s",
-                                   parent_type, message_ident, parent_index,
-                                   url, cgi, method);
-
-        free(url);
-        free(cgi);
-        free(method);
 
         index = 0;
         last_web_service_arg = web_service_arg = NULL;
@@ -641,48 +580,31 @@ static int insert_web_service(preludedb_sql_t *sql,
 static int insert_service(preludedb_sql_t *sql, char parent_type, uint64_t message_ident, int parent_index,
                           idmef_service_t *service)
 {
-        int ret = -1;
-        char ip_version[8], *name = NULL, port[8], iana_protocol_number[8], *iana_protocol_name = NULL,
-                *portlist = NULL, *protocol = NULL, *ident;
+        int ret;
+        insert_params_t params;
 
         if ( ! service )
                 return 0;
 
-        get_optional_uint8(ip_version, sizeof(ip_version), idmef_service_get_ip_version(service));
-
-        ret = preludedb_sql_escape(sql, get_string(idmef_service_get_ident(service)), &ident);
-        if ( ret < 0 )
-                goto error;
-
-        ret = preludedb_sql_escape(sql, get_string(idmef_service_get_name(service)), &name);
-        if ( ret < 0 )
-                goto error;
-
-        get_optional_uint16(port, sizeof(port), idmef_service_get_port(service));
-        get_optional_uint8(iana_protocol_number, sizeof(iana_protocol_number), idmef_service_get_iana_protocol_number(service));
+        insert_params_init(&params);
+        add_number(&params, "%c", parent_type);
+        add_number(&params, "%" PRELUDE_PRIu64, message_ident);
+        add_number(&params, "%d", parent_index);
+        add_string(&params, get_string(idmef_service_get_ident(service)));
+        add_optional_uint8(&params, idmef_service_get_ip_version(service));
+        add_string(&params, get_string(idmef_service_get_name(service)));
+        add_optional_uint16(&params, idmef_service_get_port(service));
+        add_optional_uint8(&params, idmef_service_get_iana_protocol_number(service));
+        add_string(&params, get_string(idmef_service_get_iana_protocol_name(service)));
+        add_string(&params, get_string(idmef_service_get_portlist(service)));
+        add_string(&params, get_string(idmef_service_get_protocol(service)));
 
-        ret = preludedb_sql_escape(sql, get_string(idmef_service_get_iana_protocol_name(service)), &iana_protocol_name);
+        ret = insert_params(sql, "Prelude_Service",
+                            "_parent_type, _message_ident, _parent0_index, "
+                            "ident, ip_version, name, port, iana_protocol_number, iana_protocol_name, portlist, protocol",
+                            &params);
         if ( ret < 0 )
-                goto error;
-
-        ret = preludedb_sql_escape(sql, get_string(idmef_service_get_portlist(service)), &portlist);
-        if ( ret < 0 )
-                goto error;
-
-        ret = preludedb_sql_escape(sql, get_string(idmef_service_get_protocol(service)), &protocol);
-        if ( ret < 0 )
-                goto error;
-
-        ret = preludedb_sql_insert(sql, "Prelude_Service",
-                                   "_parent_type, _message_ident, _parent0_index, "
-                                   "ident, ip_version, name, port, iana_protocol_number, iana_protocol_name, portlist, protocol",
-                                   "'%c', %" PRELUDE_PRIu64 ", %d, %s, %s, %s, %s, %s, %s, %s, %s",
-                                   parent_type, message_ident, parent_index,
-                                   ident, ip_version, name, port, iana_protocol_number,
-                                   iana_protocol_name, portlist, protocol);
-
-        if ( ret < 0 )
-                goto error;
+                return ret;
 
         switch ( idmef_service_get_type(service)) {
 
@@ -701,22 +623,6 @@ static int insert_service(preludedb_sql_t *sql, char parent_type, uint64_t messa
                 ret = -1;
         }
 
- error:
-        if ( name )
-                free(name);
-
-        if ( iana_protocol_name )
-                free(iana_protocol_name);
-
-        if ( portlist )
-                free(portlist);
-
-        if ( protocol )
-                free(protocol);
-
-        if ( ident )
-                free(ident);
-
         return ret;
 }
 
@@ -726,32 +632,31 @@ static int insert_inode(preludedb_sql_t *sql,
                         uint64_t message_ident, int target_index, int file_index,
                         idmef_inode_t *inode)
 {
-        char ctime[PRELUDEDB_SQL_TIMESTAMP_STRING_SIZE], ctime_gmtoff[16];
-        char number[16], major_device[16], minor_device[16], c_major_device[16], c_minor_device[16];
         int ret;
+        insert_params_t params;
 
         if ( ! inode )
                 return 0;
 
-        if ( preludedb_sql_time_to_timestamp(sql, idmef_inode_get_change_time(inode),
-                                             ctime, sizeof (ctime), ctime_gmtoff, sizeof (ctime_gmtoff), NULL, 0) < 0 )
-                return -1;
+        insert_params_init(&params);
+        add_number(&params, "%" PRELUDE_PRIu64, message_ident);
+        add_number(&params, "%d", target_index);
+        add_number(&params, "%d", file_index);
 
-        get_optional_uint32(number, sizeof(number), idmef_inode_get_number(inode));
-        get_optional_uint32(major_device, sizeof(major_device), idmef_inode_get_major_device(inode));
-        get_optional_uint32(minor_device, sizeof(minor_device), idmef_inode_get_minor_device(inode));
-        get_optional_uint32(c_major_device, sizeof(c_major_device), idmef_inode_get_c_major_device(inode));
-        get_optional_uint32(c_minor_device, sizeof(c_minor_device), idmef_inode_get_c_minor_device(inode));
+        ret = add_time(sql, &params, idmef_inode_get_change_time(inode), FALSE);
+        if ( ret < 0 )
+                return ret;
 
-        ret = preludedb_sql_insert(sql, "Prelude_Inode",
-                                   "_message_ident, _parent0_index, _parent1_index, "
-                                   "change_time, change_time_gmtoff, number, major_device, minor_device, c_major_device, "
-                                   "c_minor_device",
-                                   "%" PRELUDE_PRIu64 ", %d, %d, %s, %s, %s, %s, %s, %s, %s",
-                                   message_ident, target_index, file_index, ctime, ctime_gmtoff, number, major_device,
-                                   minor_device, c_major_device, c_minor_device);
+        add_optional_uint32(&params, idmef_inode_get_number(inode));
+        add_optional_uint32(&params, idmef_inode_get_major_device(inode));
+        add_optional_uint32(&params, idmef_inode_get_minor_device(inode));
+        add_optional_uint32(&params, idmef_inode_get_c_major_device(inode));
+        add_optional_uint32(&params, idmef_inode_get_c_minor_device(inode));
 
-        return ret;
+        return insert_params(sql, "Prelude_Inode",
+                             "_message_ident, _parent0_index, _parent1_index, "
+                             "change_time, change_time_gmtoff, number, major_device, minor_device, c_major_device, "
+                             "c_minor_device", &params);
 }
 
 
@@ -759,42 +664,24 @@ static int insert_inode(preludedb_sql_t *sql,
 static int insert_linkage(preludedb_sql_t *sql, uint64_t message_ident, int target_index, int file_index, int index,
                           idmef_linkage_t *linkage)
 {
-        int ret;
-        char *name, *path, *category;
+        insert_params_t params;
 
         if ( ! linkage )
                 return 0;
 
-        ret = preludedb_sql_escape(sql, idmef_linkage_category_to_string(idmef_linkage_get_category(linkage)), &category);
-        if ( ret < 0 )
-                return ret;
-
-        ret = preludedb_sql_escape(sql, get_string(idmef_linkage_get_name(linkage)), &name);
-        if ( ret < 0 ) {
-                free(category);
-                return ret;
-        }
-
-        ret = preludedb_sql_escape(sql, get_string(idmef_linkage_get_path(linkage)), &path);
-        if ( ret < 0 ) {
-                free(name);
-                free(category);
-                return ret;
-        }
-
-        ret = preludedb_sql_insert(sql, "Prelude_Linkage",
-                                   "_message_ident, _parent0_index, _parent1_index, _index, category, name, path",
-                                   "%" PRELUDE_PRIu64 ", %d, %d, %d, %s, %s, %s",
-                                   message_ident, target_index, file_index, index,
-                                   category, name, path);
-
-        free(name);
-        free(path);
-        free(category);
+        insert_params_init(&params);
+        add_number(&params, "%" PRELUDE_PRIu64, message_ident);
+        add_number(&params, "%d", target_index);
+        add_number(&params, "%d", file_index);
+        add_number(&params, "%d", index);
+        add_string(&params, idmef_linkage_category_to_string(idmef_linkage_get_category(linkage)));
+        add_string(&params, get_string(idmef_linkage_get_name(linkage)));
+        add_string(&params, get_string(idmef_linkage_get_path(linkage)));
 
         /* FIXME: idmef_file in idmef_linkage is not currently supported by the db */
 
-        return ret;
+        return insert_params(sql, "Prelude_Linkage",
+                             "_message_ident, _parent0_index, _parent1_index, _index, category, name, path", &params);
 }
 
 
@@ -803,21 +690,18 @@ static int insert_file_access_permission(preludedb_sql_t *sql,
                                          uint64_t message_ident, int target_index, int file_index, int file_access_index, int perm_index,
                                          prelude_string_t *perm)
 {
-        char *tmp;
-        int ret;
-
-        ret = preludedb_sql_escape(sql, get_string(perm), &tmp);
-        if ( ret < 0 )
-                return ret;
-
-        ret = preludedb_sql_insert(sql, "Prelude_FileAccess_Permission",
-                                   "_message_ident, _parent0_index, _parent1_index, _parent2_index, _index, permission",
-                                   "%" PRELUDE_PRIu64 ", %d, %d, %d, %d, %s",
-                                   message_ident, target_index, file_index, file_access_index, perm_index, tmp);
-
-        free(tmp);
-
-        return ret;
+        insert_params_t params;
+
+        insert_params_init(&params);
+        add_number(&params, "%" PRELUDE_PRIu64, message_ident);
+        add_number(&params, "%d", target_index);
+        add_number(&params, "%d", file_index);
+        add_number(&params, "%d", file_access_index);
+        add_number(&params, "%d", perm_index);
+        add_string(&params, get_string(perm));
+
+        return insert_params(sql, "Prelude_FileAccess_Permission",
+                             "_message_ident, _parent0_index, _parent1_index, _parent2_index, _index, permission", &params);
 }
 
 
@@ -827,14 +711,20 @@ static int insert_file_access(preludedb_sql_t *sql,
                               idmef_file_access_t *file_access)
 {
         prelude_string_t *file_access_permission, *last_file_access_permission;
+        insert_params_t params;
         int index;
         int ret;
 
         if ( ! file_access )
                 return 0;
 
-        ret = preludedb_sql_insert(sql, "Prelude_FileAccess", "_message_ident, _parent0_index, _parent1_index, _index",
-                                   "%" PRELUDE_PRIu64 ", %d, %d, %d", message_ident, target_index, file_index, file_access_index);
+        insert_params_init(&params);
+        add_number(&params, "%" PRELUDE_PRIu64, message_ident);
+        add_number(&params, "%d", target_index);
+        add_number(&params, "%d", file_index);
+        add_number(&params, "%d", file_access_index);
+
+        ret = insert_params(sql, "Prelude_FileAccess", "_message_ident, _parent0_index, _parent1_index, _index", &params);
         if ( ret < 0 )
                 return ret;
 
@@ -870,38 +760,19 @@ static int insert_checksum(preludedb_sql_t *sql,
                            uint64_t message_ident, int target_index, int file_index, int checksum_index,
                            idmef_checksum_t *checksum)
 {
-        char *value = NULL, *key = NULL, *algorithm = NULL;
-        int ret = -1;
-
-        ret = preludedb_sql_escape(sql, get_string(idmef_checksum_get_value(checksum)), &value);
-        if ( ret < 0 )
-                return ret;
-
-        ret = preludedb_sql_escape(sql, get_string(idmef_checksum_get_key(checksum)), &key);
-        if ( ret < 0 )
-                goto error;
-
-        ret = preludedb_sql_escape(sql, idmef_checksum_algorithm_to_string(idmef_checksum_get_algorithm(checksum)), &algorithm);
-        if ( ret < 0 )
-                goto error;
-
-        ret = preludedb_sql_insert(sql, "Prelude_Checksum",
-                                   "_message_ident, _parent0_index, _parent1_index, _index, value, checksum_key, algorithm",
-                                   "%" PRELUDE_PRIu64 ", %d, %d, %d, %s, %s, %s",
-                                   message_ident, target_index, file_index, checksum_index,
-                                   value, key, algorithm);
-
-error:
-        if ( value )
-                free(value);
-
-        if ( key )
-                free(key);
-
-        if ( algorithm )
-                free(algorithm);
-
-        return ret;
+        insert_params_t params;
+
+        insert_params_init(&params);
+        add_number(&params, "%" PRELUDE_PRIu64, message_ident);
+        add_number(&params, "%d", target_index);
+        add_number(&params, "%d", file_index);
+        add_number(&params, "%d", checksum_index);
+        add_string(&params, get_string(idmef_checksum_get_value(checksum)));
+        add_string(&params, get_string(idmef_checksum_get_key(checksum)));
+        add_string(&params, idmef_checksum_algorithm_to_string(idmef_checksum_get_algorithm(checksum)));
+
+        return insert_params(sql, "Prelude_Checksum",
+                             "_message_ident, _parent0_index, _parent1_index, _index, value, checksum_key, algorithm", &params);
 }
 
 
@@ -909,71 +780,45 @@ error:
 static int insert_file(preludedb_sql_t *sql, uint64_t message_ident, int target_index, int file_index,
                        idmef_file_t *file)
 {
-        int ret = -1;
+        int ret;
         idmef_linkage_t *linkage, *last_linkage;
         idmef_checksum_t *checksum, *last_checksum;
         idmef_file_access_t *file_access, *last_file_access;
+        insert_params_t params;
         int index;
-        char *name = NULL, *path = NULL, *category = NULL, *fstype = NULL,
-                *ident = NULL, *file_type = NULL, data_size[32], disk_size[32];
-        char ctime[PRELUDEDB_SQL_TIMESTAMP_STRING_SIZE], ctime_gmtoff[16];
-        char mtime[PRELUDEDB_SQL_TIMESTAMP_STRING_SIZE], mtime_gmtoff[16];
-        char atime[PRELUDEDB_SQL_TIMESTAMP_STRING_SIZE], atime_gmtoff[16];
-
-        ret = preludedb_sql_time_to_timestamp(sql, idmef_file_get_create_time(file),
-                                              ctime, sizeof (ctime), ctime_gmtoff, sizeof (ctime_gmtoff), NULL, 0);
-        if ( ret < 0 )
-                return ret;
 
-        ret = preludedb_sql_time_to_timestamp(sql, idmef_file_get_modify_time(file),
-                                              mtime, sizeof (mtime), mtime_gmtoff, sizeof (mtime_gmtoff), NULL, 0);
-        if ( ret < 0 )
-                return ret;
+        insert_params_init(&params);
+        add_number(&params, "%" PRELUDE_PRIu64, message_ident);
+        add_number(&params, "%d", target_index);
+        add_number(&params, "%d", file_index);
+        add_string(&params, get_string(idmef_file_get_ident(file)));
+        add_string(&params, idmef_file_category_to_string(idmef_file_get_category(file)));
+        add_string(&params, get_string(idmef_file_get_name(file)));
+        add_string(&params, get_string(idmef_file_get_path(file)));
 
-        ret = preludedb_sql_time_to_timestamp(sql, idmef_file_get_access_time(file),
-                                              atime, sizeof(atime), atime_gmtoff, sizeof (atime_gmtoff), NULL, 0);
+        ret = add_time(sql, &params, idmef_file_get_create_time(file), FALSE);
         if ( ret < 0 )
                 return ret;
 
-        ret = preludedb_sql_escape(sql, idmef_file_category_to_string(idmef_file_get_category(file)), &category);
+        ret = add_time(sql, &params, idmef_file_get_modify_time(file), FALSE);
         if ( ret < 0 )
                 return ret;
 
-        ret = preludedb_sql_escape(sql, get_string(idmef_file_get_ident(file)), &ident);
-        if ( ret < 0 )
-                goto error;
-
-        ret = preludedb_sql_escape(sql, get_string(idmef_file_get_name(file)), &name);
-        if ( ret < 0 )
-                goto error;
-
-        ret = preludedb_sql_escape(sql, get_string(idmef_file_get_path(file)), &path);
-        if ( ret < 0 )
-                goto error;
-
-        ret = preludedb_sql_escape(sql, get_string(idmef_file_get_file_type(file)), &file_type);
+        ret = add_time(sql, &params, idmef_file_get_access_time(file), FALSE);
         if ( ret < 0 )
-                goto error;
-
-        get_optional_uint64(data_size, sizeof(data_size), idmef_file_get_data_size(file));
-        get_optional_uint64(disk_size, sizeof(disk_size), idmef_file_get_disk_size(file));
-
-        ret = preludedb_sql_escape(sql, get_optional_enum((int *) idmef_file_get_fstype(file),
-                                                          (char *(*)(int)) idmef_file_fstype_to_string), &fstype);
-        if ( ret < 0 )
-                goto error;
+                return ret;
 
-        ret = preludedb_sql_insert(sql, "Prelude_File", "_message_ident, _parent0_index, _index, ident, category, name, path, "
-                                   "create_time, create_time_gmtoff, modify_time, modify_time_gmtoff, access_time, access_time_gmtoff, "
-                                   "data_size, disk_size, fstype, file_type",
-                                   "%" PRELUDE_PRIu64 ", %d, %d, %s, %s, %s, %s, %s, %s, %s, %s, %s, %s, %s, %s, %s, %s",
-                                   message_ident, target_index, file_index,
-                                   ident, category, name, path,
-                                   ctime, ctime_gmtoff, mtime, mtime_gmtoff, atime, atime_gmtoff,
-                                   data_size, disk_size, fstype, file_type);
+        add_optional_uint64(&params, idmef_file_get_data_size(file));
+        add_optional_uint64(&params, idmef_file_get_disk_size(file));
+        add_string(&params, get_optional_enum((int *) idmef_file_get_fstype(file),
+                                              (char *(*)(int)) idmef_file_fstype_to_string));
+        add_string(&params, get_string(idmef_file_get_file_type(file)));
 
+        ret = insert_params(sql, "Prelude_File", "_message_ident, _parent0_index, _index, ident, category, name, path, "
+                            "create_time, create_time_gmtoff, modify_time, modify_time_gmtoff, access_time, access_time_gmtoff, "
+                            "data_size, disk_size, fstype, file_type", &params);
         if ( ret < 0 )
-                goto error;
+                return ret;
 
         index = 0;
         last_file_access = file_access = NULL;
@@ -981,7 +826,7 @@ static int insert_file(preludedb_sql_t *sql, uint64_t message_ident, int target_
 
                 ret = insert_file_access(sql, message_ident, target_index, file_index, index++, file_access);
                 if ( ret < 0 )
-                        goto error;
+                        return ret;
 
                 last_file_access = file_access;
         }
@@ -989,7 +834,7 @@ static int insert_file(preludedb_sql_t *sql, uint64_t message_ident, int target_
         if ( last_file_access ) {
                 ret = insert_file_access(sql, message_ident, target_index, file_index, -1, last_file_access);
                 if ( ret < 0 )
-                        goto error;
+                        return ret;
         }
 
         index = 0;
@@ -998,7 +843,7 @@ static int insert_file(preludedb_sql_t *sql, uint64_t message_ident, int target_
 
                 ret = insert_linkage(sql, message_ident, target_index, file_index, index++, linkage);
                 if ( ret < 0 )
-                        goto error;
+                        return ret;
 
                 last_linkage = linkage;
         }
@@ -1011,7 +856,7 @@ static int insert_file(preludedb_sql_t *sql, uint64_t message_ident, int target_
 
         ret = insert_inode(sql, message_ident, target_index, file_index, idmef_file_get_inode(file));
         if ( ret < 0 )
-                goto error;
+                return ret;
 
         index = 0;
         last_checksum = checksum = NULL;
@@ -1019,7 +864,7 @@ static int insert_file(preludedb_sql_t *sql, uint64_t message_ident, int target_
 
                 ret = insert_checksum(sql, message_ident, target_index, file_index, index++, checksum);
                 if ( ret < 0 )
-                        goto error;
+                        return ret;
 
                 last_checksum = checksum;
         }
@@ -1027,28 +872,9 @@ static int insert_file(preludedb_sql_t *sql, uint64_t message_ident, int target_
         if ( last_checksum ) {
                 ret = insert_checksum(sql, message_ident, target_index, file_index, -1, last_checksum);
                 if ( ret < 0 )
-                        goto error;
+                        return ret;
         }
 
- error:
-        if ( ident )
-                free(ident);
-
-        if ( name )
-                free(name);
-
-        if ( path )
-                free(path);
-
-        if ( category )
-                free(category);
-
-        if ( fstype )
-                free(fstype);
-
-        if ( file_type )
-                free(file_type);
-
         return ret;
 }
 
@@ -1057,35 +883,16 @@ static int insert_file(preludedb_sql_t *sql, uint64_t message_ident, int target_
 static int insert_source(preludedb_sql_t *sql, uint64_t message_ident, int index, idmef_source_t *source)
 {
         int ret;
-        char *interface, *spoofed, *ident;
-
-        ret = preludedb_sql_escape(sql, get_string(idmef_source_get_ident(source)), &ident);
-        if ( ret < 0 )
-                return ret;
-
-        ret = preludedb_sql_escape(sql, idmef_source_spoofed_to_string(idmef_source_get_spoofed(source)), &spoofed);
-        if ( ret < 0 ) {
-                free(ident);
-                return ret;
-        }
-
-        ret = preludedb_sql_escape(sql, get_string(idmef_source_get_interface(source)), &interface);
-        if ( ret < 0 ) {
-                free(ident);
-                free(spoofed);
-                return ret;
-        }
+        insert_params_t params;
 
-        ret = preludedb_sql_insert(sql, "Prelude_Source",
-                                   "_message_ident, _index, ident, spoofed, interface",
-                                   "%" PRELUDE_PRIu64 ", %d, %s, %s, %s",
-                                   message_ident, index,
-                                   ident, spoofed, interface);
-
-        free(ident);
-        free(spoofed);
-        free(interface);
+        insert_params_init(&params);
+        add_number(&params, "%" PRELUDE_PRIu64, message_ident);
+        add_number(&params, "%d", index);
+        add_string(&params, get_string(idmef_source_get_ident(source)));
+        add_string(&params, idmef_source_spoofed_to_string(idmef_source_get_spoofed(source)));
+        add_string(&params, get_string(idmef_source_get_interface(source)));
 
+        ret = insert_params(sql, "Prelude_Source", "_message_ident, _index, ident, spoofed, interface", &params);
         if ( ret < 0 )
                 return ret;
 
@@ -1114,38 +921,19 @@ static int insert_target(preludedb_sql_t *sql, uint64_t message_ident, int targe
 {
         int ret;
         idmef_file_t *file, *last_file;
+        insert_params_t params;
         int index;
-        char *interface, *decoy, *ident;
-
-        ret = preludedb_sql_escape(sql, idmef_target_decoy_to_string(idmef_target_get_decoy(target)), &decoy);
-        if ( ret < 0 )
-                return ret;
-
-        ret = preludedb_sql_escape(sql, get_string(idmef_target_get_ident(target)), &ident);
-        if ( ret < 0 ) {
-                free(decoy);
-                return -2;
-        }
-
-        ret = preludedb_sql_escape(sql, get_string(idmef_target_get_interface(target)), &interface);
-        if ( ret < 0 ) {
-                free(ident);
-                free(decoy);
-                return -2;
-        }
 
-        ret = preludedb_sql_insert(sql, "Prelude_Target",
-                                   "_message_ident, _index, ident, decoy, interface",
-                                   "%" PRELUDE_PRIu64 ", %d, %s, %s, %s",
-                                   message_ident, target_index,
-                                   ident, decoy, interface);
-
-        free(ident);
-        free(decoy);
-        free(interface);
+        insert_params_init(&params);
+        add_number(&params, "%" PRELUDE_PRIu64, message_ident);
+        add_number(&params, "%d", target_index);
+        add_string(&params, get_string(idmef_target_get_ident(target)));
+        add_string(&params, idmef_target_decoy_to_string(idmef_target_get_decoy(target)));
+        add_string(&params, get_string(idmef_target_get_interface(target)));
 
+        ret = insert_params(sql, "Prelude_Target", "_message_ident, _index, ident, decoy, interface", &params);
         if ( ret < 0 )
-                return -1;
+                return ret;
 
         ret = insert_node(sql, 'T', message_ident, target_index, idmef_target_get_node(target));
         if ( ret < 0 )
@@ -1189,88 +977,37 @@ static int insert_analyzer(preludedb_sql_t *sql,
                            char parent_type, uint64_t message_ident, int analyzer_index,
                            idmef_analyzer_t *analyzer)
 {
-        int ret = -1;
-        char *name = NULL, *manufacturer = NULL, *model = NULL, *version = NULL, *class = NULL,
-                *ostype = NULL, *osversion = NULL, *analyzerid = NULL;
+        int ret;
+        insert_params_t params;
 
         if ( ! analyzer )
                 return 0;
 
-        ret = preludedb_sql_escape(sql, get_string(idmef_analyzer_get_analyzerid(analyzer)), &analyzerid);
-        if ( ret < 0 )
-                return ret;
-
-        ret = preludedb_sql_escape(sql, get_string(idmef_analyzer_get_class(analyzer)), &class);
-        if ( ret < 0 )
-                goto error;
-
-        ret = preludedb_sql_escape(sql, get_string(idmef_analyzer_get_name(analyzer)), &name);
-        if ( ret < 0 )
-                goto error;
-
-        ret = preludedb_sql_escape(sql, get_string(idmef_analyzer_get_model(analyzer)), &model);
-        if ( ret < 0 )
-                goto error;
-
-        ret = preludedb_sql_escape(sql, get_string(idmef_analyzer_get_version(analyzer)), &version);
-        if ( ret < 0 )
-                goto error;
-
-        ret = preludedb_sql_escape(sql, get_string(idmef_analyzer_get_manufacturer(analyzer)), &manufacturer);
-        if ( ret < 0 )
-                goto error;
-
-        ret = preludedb_sql_escape(sql, get_string(idmef_analyzer_get_ostype(analyzer)), &ostype);
-        if ( ret < 0 )
-                goto error;
-
-        ret = preludedb_sql_escape(sql, get_string(idmef_analyzer_get_osversion(analyzer)), &osversion);
-        if ( ret < 0 )
-                goto error;
-
-        ret = preludedb_sql_insert(sql, "Prelude_Analyzer",
-                                   "_parent_type, _message_ident, _index, analyzerid, name, manufacturer, "
-                                   "model, version, class, "
-                                   "ostype, osversion",
-                                   "'%c', %" PRELUDE_PRIu64 ", %d, %s, %s, %s, %s, %s, %s, %s, %s",
-                                   parent_type, message_ident, analyzer_index,
-                                   analyzerid, name, manufacturer, model, version, class, ostype, osversion);
+        insert_params_init(&params);
+        add_number(&params, "%c", parent_type);
+        add_number(&params, "%" PRELUDE_PRIu64, message_ident);
+        add_number(&params, "%d", analyzer_index);
+        add_string(&params, get_string(idmef_analyzer_get_analyzerid(analyzer)));
+        add_string(&params, get_string(idmef_analyzer_get_name(analyzer)));
+        add_string(&params, get_string(idmef_analyzer_get_manufacturer(analyzer)));
+        add_string(&params, get_string(idmef_analyzer_get_model(analyzer)));
+        add_string(&params, get_string(idmef_analyzer_get_version(analyzer)));
+        add_string(&params, get_string(idmef_analyzer_get_class(analyzer)));
+        add_string(&params, get_string(idmef_analyzer_get_ostype(analyzer)));
+        add_string(&params, get_string(idmef_analyzer_get_osversion(analyzer)));
 
+        ret = insert_params(sql, "Prelude_Analyzer",
+                            "_parent_type, _message_ident, _index, analyzerid, name, manufacturer, "
+                            "model, version, class, "
+                            "ostype, osversion", &params);
         if ( ret < 0 )
-                goto error;
+                return ret;
 
         ret = insert_node(sql, parent_type, message_ident, analyzer_index, idmef_analyzer_get_node(analyzer));
         if ( ret < 0 )
-                goto error;
-
-        ret = insert_process(sql, parent_type, message_ident, analyzer_index, idmef_analyzer_get_process(analyzer));
-
- error:
-        if ( class )
-                free(class);
-
-        if ( name )
-                free(name);
-
-        if ( model )
-                free(model);
-
-        if ( version )
-                free(version);
-
-        if ( manufacturer )
-                free(manufacturer);
-
-        if ( ostype )
-                free(ostype);
-
-        if ( osversion )
-                free(osversion);
-
-        if ( analyzerid )
-                free(analyzerid);
+                return ret;
 
-        return ret;
+        return insert_process(sql, parent_type, message_ident, analyzer_index, idmef_analyzer_get_process(analyzer));
 }
 
 
@@ -1279,73 +1016,38 @@ static int insert_reference(preludedb_sql_t *sql,
                             uint64_t message_ident, int reference_index,
                             idmef_reference_t *reference)
 {
-        char *origin = NULL, *name = NULL, *url = NULL, *meaning = NULL;
-        int ret = -1;
-
-        ret = preludedb_sql_escape(sql, idmef_reference_origin_to_string(idmef_reference_get_origin(reference)), &origin);
-        if ( ret < 0 )
-                return ret;
-
-        ret = preludedb_sql_escape(sql, get_string(idmef_reference_get_url(reference)), &url);
-        if ( ret < 0 )
-                goto error;
-
-        ret = preludedb_sql_escape(sql, get_string(idmef_reference_get_name(reference)), &name);
-        if ( ret < 0 )
-                goto error;
-
-        ret = preludedb_sql_escape(sql, get_string(idmef_reference_get_meaning(reference)), &meaning);
-        if ( ret < 0 )
-                goto error;
-
-        ret = preludedb_sql_insert(sql, "Prelude_Reference", "_message_ident, _index, origin, name, url, meaning",
-                                   "%" PRELUDE_PRIu64 ", %d, %s, %s, %s, %s",
-                                   message_ident, reference_index, origin, name, url, meaning);
+        insert_params_t params;
 
- error:
-        if ( origin )
-                free(origin);
-
-        if ( url )
-                free(url);
-
-        if ( name )
-                free(name);
-
-        if ( meaning )
-                free(meaning);
+        insert_params_init(&params);
+        add_number(&params, "%" PRELUDE_PRIu64, message_ident);
+        add_number(&params, "%d", reference_index);
+        add_string(&params, idmef_reference_origin_to_string(idmef_reference_get_origin(reference)));
+        add_string(&params, get_string(idmef_reference_get_name(reference)));
+        add_string(&params, get_string(idmef_reference_get_url(reference)));
+        add_string(&params, get_string(idmef_reference_get_meaning(reference)));
 
-        return ret;
+        return insert_params(sql, "Prelude_Reference", "_message_ident, _index, origin, name, url, meaning", &params);
 }
 
 
 static int insert_classification(preludedb_sql_t *sql, uint64_t message_ident, idmef_classification_t *classification)
 {
-        char *text, *ident;
         idmef_reference_t *reference, *last_reference;
+        insert_params_t params;
         int index;
         int ret;
 
         if ( ! classification )
                 return 0;
 
-        ret = preludedb_sql_escape(sql, get_string(idmef_classification_get_ident(classification)), &ident);
-        if ( ret < 0 )
-                return ret;
+        insert_params_init(&params);
+        add_number(&params, "%" PRELUDE_PRIu64, message_ident);
+        add_string(&params, get_string(idmef_classification_get_ident(classification)));
+        add_string(&params, get_string(idmef_classification_get_text(classification)));
 
-        ret = preludedb_sql_escape(sql, get_string(idmef_classification_get_text(classification)), &text);
-        if ( ret < 0 ) {
-                free(ident);
+        ret = insert_params(sql, "Prelude_Classification", "_message_ident, ident, text", &params);
+        if ( ret < 0 )
                 return ret;
-        }
-
-        ret = preludedb_sql_insert(sql, "Prelude_Classification",
-                                   "_message_ident, ident, text",
-                                   "%" PRELUDE_PRIu64 ", %s, %s",
-                                   message_ident, ident, text);
-
-        free(text);
-        free(ident);
 
         index = 0;
         last_reference = reference = NULL;
@@ -1374,201 +1076,136 @@ static int insert_additional_data(preludedb_sql_t *sql,
                                   idmef_additional_data_t *additional_data)
 {
         int ret;
-        char *meaning, *type, *data;
+        insert_params_t params;
 
         if ( ! additional_data )
                 return 0;
 
-        ret = preludedb_sql_escape(sql, idmef_additional_data_type_to_string(idmef_additional_data_get_type(additional_data)), &type);
-        if ( ret < 0 )
-                return ret;
-
-        ret = preludedb_sql_escape(sql, get_string(idmef_additional_data_get_meaning(additional_data)), &meaning);
-        if ( ret < 0 ) {
-                free(type);
-                return ret;
-        }
+        insert_params_init(&params);
+        add_number(&params, "%c", parent_type);
+        add_number(&params, "%" PRELUDE_PRIu64, message_ident);
+        add_number(&params, "%d", ad_index);
+        add_string(&params, idmef_additional_data_type_to_string(idmef_additional_data_get_type(additional_data)));
+        add_string(&params, get_string(idmef_additional_data_get_meaning(additional_data)));
 
-        ret = get_data(sql, idmef_additional_data_get_data(additional_data), &data);
-        if ( ret < 0 ) {
-                free(type);
-                free(meaning);
+        ret = add_data(&params, idmef_additional_data_get_data(additional_data));
+        if ( ret < 0 )
                 return ret;
-        }
-
-        ret = preludedb_sql_insert(sql, "Prelude_AdditionalData",
-                                   "_parent_type, _message_ident, _index, type, meaning, data",
-                                   "'%c', %" PRELUDE_PRIu64 ", %d, %s, %s, %s",
-                                   parent_type, message_ident, ad_index, type, meaning, data);
 
-        free(type);
-        free(meaning);
-        free(data);
-
-        return ret;
+        return insert_params(sql, "Prelude_AdditionalData",
+                             "_parent_type, _message_ident, _index, type, meaning, data", &params);
 }
 
 
 
 static int insert_createtime(preludedb_sql_t *sql, char parent_type, uint64_t message_ident, idmef_time_t *time)
 {
-        char utc_time[PRELUDEDB_SQL_TIMESTAMP_STRING_SIZE];
-        char utc_time_usec[16];
-        char utc_time_gmtoff[16];
         int ret;
+        insert_params_t params;
 
-        ret = preludedb_sql_time_to_timestamp(sql, time, utc_time, sizeof (utc_time),
-                                              utc_time_gmtoff, sizeof (utc_time_gmtoff),
-                                              utc_time_usec, sizeof (utc_time_usec));
+        insert_params_init(&params);
+        add_number(&params, "%c", parent_type);
+        add_number(&params, "%" PRELUDE_PRIu64, message_ident);
+
+        ret = add_time(sql, &params, time, TRUE);
         if ( ret < 0 )
                 return ret;
 
-        return preludedb_sql_insert(sql, "Prelude_CreateTime", "_parent_type, _message_ident, time, gmtoff, usec",
-                                    "'%c', %" PRELUDE_PRIu64 ", %s, %s, %s",
-                                    parent_type, message_ident, utc_time, utc_time_gmtoff, utc_time_usec);
+        return insert_params(sql, "Prelude_CreateTime", "_parent_type, _message_ident, time, gmtoff, usec", &params);
 }
 
 
 
 static int insert_detecttime(preludedb_sql_t *sql, uint64_t message_ident, idmef_time_t *time)
 {
-        char utc_time[PRELUDEDB_SQL_TIMESTAMP_STRING_SIZE];
-        char utc_time_usec[16];
-        char utc_time_gmtoff[16];
         int ret;
+        insert_params_t params;
 
         if ( ! time )
                 return 0;
 
-        ret = preludedb_sql_time_to_timestamp(sql, time, utc_time, sizeof (utc_time),
-                                              utc_time_gmtoff, sizeof (utc_time_gmtoff),
-                                              utc_time_usec, sizeof (utc_time_usec));
+        insert_params_init(&params);
+        add_number(&params, "%" PRELUDE_PRIu64, message_ident);
+
+        ret = add_time(sql, &params, time, TRUE);
         if ( ret < 0 )
                 return ret;
 
-        return preludedb_sql_insert(sql, "Prelude_DetectTime", "_message_ident, time, gmtoff, usec",
-                                    "%" PRELUDE_PRIu64 ", %s, %s, %s", message_ident, utc_time, utc_time_gmtoff, utc_time_usec);
+        return insert_params(sql, "Prelude_DetectTime", "_message_ident, time, gmtoff, usec", &params);
 }
 
 
 
 static int insert_analyzertime(preludedb_sql_t *sql, char parent_type, uint64_t message_ident, idmef_time_t *time)
 {
-        char utc_time[PRELUDEDB_SQL_TIMESTAMP_STRING_SIZE];
-        char utc_time_usec[16];
-        char utc_time_gmtoff[16];
         int ret;
+        insert_params_t params;
 
         if ( ! time )
                 return 0;
 
-        ret = preludedb_sql_time_to_timestamp(sql, time, utc_time, sizeof(utc_time),
-                                              utc_time_gmtoff, sizeof(utc_time_gmtoff),
-                                              utc_time_usec, sizeof (utc_time_usec));
+        insert_params_init(&params);
+        add_number(&params, "%c", parent_type);
+        add_number(&params, "%" PRELUDE_PRIu64, message_ident);
+
+        ret = add_time(sql, &params, time, TRUE);
         if ( ret < 0 )
                 return ret;
 
-        return preludedb_sql_insert(sql, "Prelude_AnalyzerTime", "_parent_type, _message_ident, time, gmtoff, usec",
-                                    "'%c', %" PRELUDE_PRIu64 ", %s, %s, %s",
-                                    parent_type, message_ident, utc_time, utc_time_gmtoff, utc_time_usec);
+        return insert_params(sql, "Prelude_AnalyzerTime", "_parent_type, _message_ident, time, gmtoff, usec", &params);
 }
 
 
 
 static int insert_impact(preludedb_sql_t *sql, uint64_t message_ident, idmef_impact_t *impact)
 {
-        int ret = -1;
-        char *completion = NULL, *type = NULL, *severity = NULL, *description = NULL;
+        insert_params_t params;
 
         if ( ! impact )
                 return 0;
 
-        ret = preludedb_sql_escape(sql, get_optional_enum((int *) idmef_impact_get_completion(impact),
-                                                          (char *(*)(int)) idmef_impact_completion_to_string), &completion);
-        if ( ret < 0 )
-                return ret;
-
-        ret = preludedb_sql_escape(sql, idmef_impact_type_to_string(idmef_impact_get_type(impact)), &type);
-        if ( ret < 0 )
-                goto error;
-
-        ret = preludedb_sql_escape(sql, get_optional_enum((int *) idmef_impact_get_severity(impact),
-                                                          (char *(*)(int))idmef_impact_severity_to_string), &severity);
-        if ( ret < 0 )
-                goto error;
-
-        ret = preludedb_sql_escape(sql, get_string(idmef_impact_get_description(impact)), &description);
-        if ( ret < 0 )
-                goto error;
-
-        ret = preludedb_sql_insert(sql, "Prelude_Impact", "_message_ident, severity, completion, type, description",
-                                   "%" PRELUDE_PRIu64 ", %s, %s, %s, %s",
-                                   message_ident, severity, completion, type, description);
-
- error:
-        if ( completion )
-                free(completion);
-
-        if ( type )
-                free(type);
-
-        if ( severity )
-                free(severity);
+        insert_params_init(&params);
+        add_number(&params, "%" PRELUDE_PRIu64, message_ident);
+        add_string(&params, get_optional_enum((int *) idmef_impact_get_severity(impact),
+                                              (char *(*)(int)) idmef_impact_severity_to_string));
+        add_string(&params, get_optional_enum((int *) idmef_impact_get_completion(impact),
+                                              (char *(*)(int)) idmef_impact_completion_to_string));
+        add_string(&params, idmef_impact_type_to_string(idmef_impact_get_type(impact)));
+        add_string(&params, get_string(idmef_impact_get_description(impact)));
 
-        if ( description )
-                free(description);
-
-        return ret;
+        return insert_params(sql, "Prelude_Impact", "_message_ident, severity, completion, type, description", &params);
 }
 
 
 
 static int insert_action(preludedb_sql_t *sql, uint64_t message_ident, int action_index, idmef_action_t *action)
 {
-        int ret;
-        char *category, *description;
-
-        ret = preludedb_sql_escape(sql, idmef_action_category_to_string(idmef_action_get_category(action)), &category);
-        if ( ret < 0 )
-                return ret;
-
-        ret = preludedb_sql_escape(sql, get_string(idmef_action_get_description(action)), &description);
-        if ( ret < 0 ) {
-                free(category);
-                return ret;
-        }
+        insert_params_t params;
 
-        ret = preludedb_sql_insert(sql, "Prelude_Action",
-                                   "_message_ident, _index, category, description",
-                                   "%" PRELUDE_PRIu64 ", %d, %s, %s",
-                                   message_ident, action_index, category, description);
+        insert_params_init(&params);
+        add_number(&params, "%" PRELUDE_PRIu64, message_ident);
+        add_number(&params, "%d", action_index);
+        add_string(&params, idmef_action_category_to_string(idmef_action_get_category(action)));
+        add_string(&params, get_string(idmef_action_get_description(action)));
 
-        free(category);
-        free(description);
-
-        return ret;
+        return insert_params(sql, "Prelude_Action", "_message_ident, _index, category, description", &params);
 }
 
 
 
 static int insert_confidence(preludedb_sql_t *sql, uint64_t message_ident, idmef_confidence_t *confidence)
 {
-        int ret;
-        char *rating;
+        insert_params_t params;
 
         if ( ! confidence )
                 return 0;
 
-        ret = preludedb_sql_escape(sql, idmef_confidence_rating_to_string(idmef_confidence_get_rating(confidence)), &rating);
-        if ( ret < 0 )
-                return ret;
-
-        ret = preludedb_sql_insert(sql, "Prelude_Confidence", "_message_ident, rating, confidence",
-                                   "%" PRELUDE_PRIu64 ", %s, %f", message_ident, rating, idmef_confidence_get_confidence(confidence));
+        insert_params_init(&params);
+        add_number(&params, "%" PRELUDE_PRIu64, message_ident);
+        add_string(&params, idmef_confidence_rating_to_string(idmef_confidence_get_rating(confidence)));
+        add_number(&params, "%f", idmef_confidence_get_confidence(confidence));
 
-        free(rating);
-
-        return ret;
+        return insert_params(sql, "Prelude_Confidence", "_message_ident, rating, confidence", &params);
 }
 
 
@@ -1576,13 +1213,17 @@ static int insert_confidence(preludedb_sql_t *sql, uint64_t message_ident, idmef
 static int insert_assessment(preludedb_sql_t *sql, uint64_t message_ident, idmef_assessment_t *assessment)
 {
         idmef_action_t *action, *last_action;
+        insert_params_t params;
         int index;
         int ret;
 
         if ( ! assessment )
                 return 0;
 
-        ret = preludedb_sql_insert(sql, "Prelude_Assessment", "_message_ident", "%" PRELUDE_PRIu64, message_ident);
+        insert_params_init(&params);
+        add_number(&params, "%" PRELUDE_PRIu64, message_ident);
+
+        ret = insert_params(sql, "Prelude_Assessment", "_message_ident", &params);
         if ( ret < 0 )
                 return ret;
 
@@ -1618,29 +1259,19 @@ static int insert_assessment(preludedb_sql_t *sql, uint64_t message_ident, idmef
 
 static int insert_overflow_alert(preludedb_sql_t *sql, uint64_t message_ident, idmef_overflow_alert_t *overflow_alert)
 {
-        char *program, *buffer, size[16];
         int ret;
+        insert_params_t params;
 
-        ret = preludedb_sql_escape(sql, get_string(idmef_overflow_alert_get_program(overflow_alert)), &program);
-        if ( ret < 0 )
-                return ret;
+        insert_params_init(&params);
+        add_number(&params, "%" PRELUDE_PRIu64, message_ident);
+        add_string(&params, get_string(idmef_overflow_alert_get_program(overflow_alert)));
+        add_optional_uint32(&params, idmef_overflow_alert_get_size(overflow_alert));
 
-        ret = get_data(sql, idmef_overflow_alert_get_buffer(overflow_alert), &buffer);
-        if ( ret < 0 ) {
-                free(program);
+        ret = add_data(&params, idmef_overflow_alert_get_buffer(overflow_alert));
+        if ( ret < 0 )
                 return ret;
-        }
 
-        get_optional_uint32(size, sizeof(size), idmef_overflow_alert_get_size(overflow_alert));
-
-        ret = preludedb_sql_insert(sql, "Prelude_OverflowAlert", "_message_ident, program, size, buffer",
-                                   "%" PRELUDE_PRIu64 ", %s, %s, %s",
-                                   message_ident, program, size, buffer);
-
-        free(program);
-        free(buffer);
-
-        return ret;
+        return insert_params(sql, "Prelude_OverflowAlert", "_message_ident, program, size, buffer", &params);
 }
 
 
@@ -1648,58 +1279,38 @@ static int insert_alertident(preludedb_sql_t *sql,
                              char parent_type, uint64_t message_ident, int alertident_index,
                              idmef_alertident_t *alertident)
 {
-        int ret;
-        char *analyzerid, *messageid;
-
-        ret = preludedb_sql_escape(sql, get_string(idmef_alertident_get_analyzerid(alertident)), &analyzerid);
-        if ( ret < 0 )
-                return ret;
+        insert_params_t params;
 
-        ret = preludedb_sql_escape(sql, get_string(idmef_alertident_get_alertident(alertident)), &messageid);
-        if ( ret < 0 ) {
-                free(analyzerid);
-                return ret;
-        }
-
-        ret = preludedb_sql_insert(sql, "Prelude_Alertident",
-                                   "_parent_type, _message_ident, _index, alertident, analyzerid",
-                                   "'%c', %" PRELUDE_PRIu64 ", %d, %s, %s",
-                                   parent_type, message_ident, alertident_index,
-                                   messageid, analyzerid);
+        insert_params_init(&params);
+        add_number(&params, "%c", parent_type);
+        add_number(&params, "%" PRELUDE_PRIu64, message_ident);
+        add_number(&params, "%d", alertident_index);
+        add_string(&params, get_string(idmef_alertident_get_alertident(alertident)));
+        add_string(&params, get_string(idmef_alertident_get_analyzerid(alertident)));
 
-        free(analyzerid);
-        free(messageid);
-
-        return ret;
+        return insert_params(sql, "Prelude_Alertident",
+                             "_parent_type, _message_ident, _index, alertident, analyzerid", &params);
 }
 
 
 static int insert_tool_alert(preludedb_sql_t *sql, uint64_t message_ident, idmef_tool_alert_t *tool_alert)
 {
-        char *name, *command;
         idmef_alertident_t *alertident;
+        insert_params_t params;
         int index;
         int ret;
 
         if ( ! tool_alert )
                 return 0;
 
-        ret = preludedb_sql_escape(sql, get_string(idmef_tool_alert_get_name(tool_alert)), &name);
-        if ( ret < 0 )
-                return ret;
+        insert_params_init(&params);
+        add_number(&params, "%" PRELUDE_PRIu64, message_ident);
+        add_string(&params, get_string(idmef_tool_alert_get_name(tool_alert)));
+        add_string(&params, get_string(idmef_tool_alert_get_command(tool_alert)));
 
-        ret = preludedb_sql_escape(sql, get_string(idmef_tool_alert_get_command(tool_alert)), &command);
-        if ( ret < 0 ) {
-                free(name);
+        ret = insert_params(sql, "Prelude_ToolAlert", "_message_ident, name, command", &params);
+        if ( ret < 0 )
                 return ret;
-        }
-
-        ret = preludedb_sql_insert(sql, "Prelude_ToolAlert", "_message_ident, name, command",
-                                   "%" PRELUDE_PRIu64 ", %s, %s",
-                                   message_ident, name, command);
-
-        free(name);
-        free(command);
 
         index = 0;
         alertident = NULL;
@@ -1723,22 +1334,19 @@ static int insert_tool_alert(preludedb_sql_t *sql, uint64_t message_ident, idmef
 static int insert_correlation_alert(preludedb_sql_t *sql, uint64_t message_ident,
                                     idmef_correlation_alert_t *correlation_alert)
 {
-        char *name;
         idmef_alertident_t *alertident, *last_alertident;
+        insert_params_t params;
         int index;
         int ret;
 
         if ( ! correlation_alert )
                 return 0;
 
-        ret = preludedb_sql_escape(sql, get_string(idmef_correlation_alert_get_name(correlation_alert)), &name);
-        if ( ret < 0 )
-                return ret;
-
-        ret = preludedb_sql_insert(sql, "Prelude_CorrelationAlert", "_message_ident, name",
-                                   "%" PRELUDE_PRIu64 ", %s", message_ident, name);
+        insert_params_init(&params);
+        add_number(&params, "%" PRELUDE_PRIu64, message_ident);
+        add_string(&params, get_string(idmef_correlation_alert_get_name(correlation_alert)));
 
-        free(name);
+        ret = insert_params(sql, "Prelude_CorrelationAlert", "_message_ident, name", &params);
 
         if ( ret < 0 )
                 return ret;
@@ -1769,14 +1377,30 @@ static int insert_message_messageid(preludedb_sql_t *sql, const char *table_name
                                     prelude_string_t *messageid, uint64_t *result)
 {
         int ret;
-        char *tmp;
+        char query[128];
+        insert_params_t params;
 
-        ret = preludedb_sql_escape(sql, get_string(messageid), &tmp);
+        ret = preludedb_sql_reserve_ident(sql, table_name, "_ident", result);
         if ( ret < 0 )
                 return ret;
 
-        ret = preludedb_sql_insert(sql, table_name, "messageid", "%s", tmp);
-        free(tmp);
+        insert_params_init(&params);
+
+        if ( ret > 0 ) {
+                add_number(&params, "%" PRELUDE_PRIu64, *result);
+                add_string(&params, get_string(messageid));
+
+                return insert_params(sql, table_name, "_ident, messageid", &params);
+        }
+
+        /*
+         * The ident is read back from the session: the row is sent right
+         * away, without the rows queued for the previous messages.
+         */
+        add_string(&params, get_string(messageid));
+        snprintf(query, sizeof(query), "INSERT INTO %s (messageid) VALUES(?)", table_name);
+
+        ret = preludedb_sql_write_params(sql, query, params.params, params.count);
         if ( ret < 0 )
                 return ret;
 
@@ -1926,29 +1550,35 @@ static int insert_heartbeat(preludedb_sql_t *sql, idmef_heartbeat_t *heartbeat)
 {
         uint64_t ident;
         idmef_analyzer_t *analyzer, *last_analyzer;
-        char heartbeat_interval[16], *messageid;
         idmef_additional_data_t *additional_data, *last_additional_data;
+        insert_params_t params;
         unsigned int index;
         int ret;
 
         if ( ! heartbeat )
                 return 0;
 
-        ret = preludedb_sql_escape(sql, get_string(idmef_heartbeat_get_messageid(heartbeat)), &messageid);
-        if ( ret < 0 )
-                return ret;
+        ret = preludedb_sql_reserve_ident(sql, "Prelude_Heartbeat", "_ident", &ident);
+        if ( ret > 0 ) {
+                insert_params_init(&params);
+                add_number(&params, "%" PRELUDE_PRIu64, ident);
+                add_string(&params, get_string(idmef_heartbeat_get_messageid(heartbeat)));
+                add_optional_uint32(&params, idmef_heartbeat_get_heartbeat_interval(heartbeat));
 
-        get_optional_uint32(heartbeat_interval, sizeof(heartbeat_interval),
-                            idmef_heartbeat_get_heartbeat_interval(heartbeat));
+                ret = insert_params(sql, "Prelude_Heartbeat", "_ident, messageid, heartbeat_interval", &params);
+        }
 
-        ret = preludedb_sql_insert(sql, "Prelude_Heartbeat", "messageid, heartbeat_interval",
-                                   "%s, %s", messageid, heartbeat_interval);
+        else if ( ret == 0 ) {
+                insert_params_init(&params);
+                add_string(&params, get_string(idmef_heartbeat_get_messageid(heartbeat)));
+                add_optional_uint32(&params, idmef_heartbeat_get_heartbeat_interval(heartbeat));
 
-        free(messageid);
-        if ( ret < 0 )
-                return ret;
+                ret = preludedb_sql_write_params(sql, "INSERT INTO Prelude_Heartbeat (messageid, heartbeat_interval) VALUES(?, ?)",
+                                                 params.params, params.count);
+                if ( ret >= 0 )
+                        ret = preludedb_sql_get_last_insert_ident(sql, &ident);
+        }
 
-        ret = preludedb_sql_get_last_insert_ident(sql, &ident);
         if ( ret < 0 )
                 return ret;
 
@@ -1999,10 +1629,32 @@ static int insert_heartbeat(preludedb_sql_t *sql, idmef_heartbeat_t *heartbeat)
 
 
 
+static int insert_message(preludedb_sql_t *sql, idmef_message_t *message)
+{
+        switch ( idmef_message_get_type(message) ) {
+
+        case IDMEF_MESSAGE_TYPE_ALERT:
+                return insert_alert(sql, idmef_message_get_alert(message));
+
+        case IDMEF_MESSAGE_TYPE_HEARTBEAT:
+                return insert_heartbeat(sql, idmef_message_get_heartbeat(message));
+
+        default:
+                return -1;
+        }
+}
+
+
+
+/*
+ * The rollups of the database are only updated within the transaction,
+ * which serializes their use.
+ */
 int classic_insert(preludedb_t *db, idmef_message_t *message)
 {
-        int ret;
+        int ret, tmp;
         preludedb_sql_t *sql = preludedb_get_sql(db);
+        classic_rollup_t *rollup = preludedb_get_data(db);
 
         if ( ! message )
                 return 0;
@@ -2011,27 +1663,82 @@ int classic_insert(preludedb_t *db, idmef_message_t *message)
         if ( ret < 0 )
                 return ret;
 
-        switch ( idmef_message_get_type(message) ) {
-
-        case IDMEF_MESSAGE_TYPE_ALERT:
-                ret = insert_alert(sql, idmef_message_get_alert(message));
-                break;
-
-        case IDMEF_MESSAGE_TYPE_HEARTBEAT:
-                ret = insert_heartbeat(sql, idmef_message_get_heartbeat(message));
-                break;
-
-        default:
-                ret = -1;
+        ret = insert_message(sql, message);
+        if ( ret >= 0 && rollup ) {
+                ret = classic_rollup_add_message(rollup, message);
+                if ( ret >= 0 )
+                        ret = classic_rollup_flush(rollup, sql);
+                else
+                        classic_rollup_clear(rollup);
         }
 
         if ( ret < 0 ) {
-                int tmp;
-
                 tmp = preludedb_sql_transaction_abort(sql);
-
                 return (tmp < 0) ? tmp : ret;
         }
 
         return preludedb_sql_transaction_end(sql);
 }
+
+
+
+/*
+ * All the messages are inserted within a single transaction: child rows are
+ * queued per table and sent as multi-row INSERT statements on commit.
+ */
+ssize_t classic_insert_messages(preludedb_t *db, idmef_message_t **messages, size_t size)
+{
+        int ret, tmp;
+        size_t i;
+        ssize_t count = 0;
+        preludedb_sql_t *sql = preludedb_get_sql(db);
+        classic_rollup_t *rollup = preludedb_get_data(db);
+
+        ret = preludedb_sql_transaction_start(sql);
+        if ( ret < 0 )
+                return ret;
+
+        for ( i = 0; i < size; i++ ) {
+                if ( ! messages[i] )
+                        continue;
+
+                ret = insert_message(sql, messages[i]);
+                if ( ret >= 0 && rollup )
+                        ret = classic_rollup_add_message(rollup, messages[i]);
+
+                if ( ret < 0 )
+                        goto error;
+
+                count++;
+        }
+
+        /*
+         * The rollups of the whole batch are updated once, each counter
+         * with a single statement.
+         */
+        if ( rollup ) {
+                ret = classic_rollup_flush(rollup, sql);
+                if ( ret < 0 )
+                        goto error;
+        }
+
+        /*
+         * When the caller handles the transaction, rows are only flushed
+         * when it is committed or when the next query is issued.
+         */
+        ret = preludedb_sql_transaction_end(sql);
+        if ( ret < 0 )
+                return ret;
+
+        return count;
+
+ error:
+        if ( rollup )
+                classic_rollup_clear(rollup);
+
+        tmp = preludedb_sql_transaction_abort(sql);
+        if ( tmp < 0 )
+                ret = tmp;
+
+        return ret;
+}
@@ -328,9 +328,11 @@ static int _classic_path_resolve(const idmef_path_t *path, int field_context, vo
 
         class = search_path(path);
 
-        table = classic_sql_join_lookup_table(join, path);
+        ret = classic_sql_join_lookup_table(join, path, &table);
+        if ( ret < 0 )
+                return ret;
 
-        if ( ! table ) {
+        if ( ret == 0 ) {
                 ret = class->resolve_table_name(path, &table_name);
                 if ( ret < 0 )
                         return ret;
@@ -353,9 +355,21 @@ int classic_path_resolve(preludedb_selected_path_t *selpath, preludedb_selected_
 
 
 
+/*
+ * Resolve @path to the single column holding its value, as used within a
+ * function or a GROUP BY clause, adding the tables it requires to @join.
+ */
+int classic_path_resolve_column(const idmef_path_t *path, classic_sql_join_t *join, prelude_string_t *output)
+{
+        return _classic_path_resolve(path, FIELD_CONTEXT_FUNCTION, join, output);
+}
+
+
+
 static int classic_path_resolve_criterion(preludedb_sql_t *sql,
                                           idmef_criteria_t *criterion,
-                                          classic_sql_join_t *join, prelude_string_t *output)
+                                          classic_sql_join_t *join, prelude_string_t *output,
+                                          prelude_bool_t template)
 {
         prelude_string_t *field_name;
         int ret;
@@ -368,10 +382,16 @@ static int classic_path_resolve_criterion(preludedb_sql_t *sql,
         if ( ret < 0 )
                 goto error;
 
-        ret = preludedb_sql_build_criterion_string(sql, output,
-                                                   prelude_string_get_string(field_name),
-                                                   idmef_criteria_get_operator(criterion),
-                                                   idmef_criteria_get_value(criterion));
+        if ( template )
+                ret = preludedb_sql_build_criterion_template(sql, output,
+                                                             prelude_string_get_string(field_name),
+                                                             idmef_criteria_get_operator(criterion),
+                                                             idmef_criteria_get_value(criterion));
+        else
+                ret = preludedb_sql_build_criterion_string(sql, output,
+                                                           prelude_string_get_string(field_name),
+                                                           idmef_criteria_get_operator(criterion),
+                                                           idmef_criteria_get_value(criterion));
 
  error:
         prelude_string_destroy(field_name);
@@ -381,16 +401,16 @@ static int classic_path_resolve_criterion(preludedb_sql_t *sql,
 
 
 
-int classic_path_resolve_criteria(preludedb_sql_t *sql,
-                                  idmef_criteria_t *criteria,
-                                  classic_sql_join_t *join, prelude_string_t *output)
+static int resolve_criteria(preludedb_sql_t *sql,
+                            idmef_criteria_t *criteria,
+                            classic_sql_join_t *join, prelude_string_t *output, prelude_bool_t template)
 {
         int ret;
         const char *operator;
         idmef_criteria_t *left, *right;
 
         if ( idmef_criteria_is_criterion(criteria) )
-                return classic_path_resolve_criterion(sql, criteria, join, output);
+                return classic_path_resolve_criterion(sql, criteria, join, output, template);
 
         left = idmef_criteria_get_left(criteria);
         right = idmef_criteria_get_right(criteria);
@@ -400,7 +420,7 @@ int classic_path_resolve_criteria(preludedb_sql_t *sql,
                 return ret;
 
         if ( left ) {
-                ret = classic_path_resolve_criteria(sql, left, join, output);
+                ret = resolve_criteria(sql, left, join, output, template);
                 if ( ret < 0 )
                         return ret;
 
@@ -413,7 +433,7 @@ int classic_path_resolve_criteria(preludedb_sql_t *sql,
                         return ret;
         }
 
-        ret = classic_path_resolve_criteria(sql, right, join, output);
+        ret = resolve_criteria(sql, right, join, output, template);
         if ( ret < 0 )
                 return ret;
 
@@ -424,3 +444,193 @@ int classic_path_resolve_criteria(preludedb_sql_t *sql,
         return 0;
 
 }
+
+
+
+int classic_path_resolve_criteria(preludedb_sql_t *sql,
+                                  idmef_criteria_t *criteria,
+                                  classic_sql_join_t *join, prelude_string_t *output)
+{
+        return resolve_criteria(sql, criteria, join, output, FALSE);
+}
+
+
+
+/*
+ * Same as classic_path_resolve_criteria(), fixed values being replaced with
+ * placeholders. Their parameters are collected in the same order, walking
+ * the criteria through preludedb_sql_params_add_criterion().
+ */
+int classic_path_resolve_criteria_template(preludedb_sql_t *sql,
+                                           idmef_criteria_t *criteria,
+                                           classic_sql_join_t *join, prelude_string_t *output)
+{
+        return resolve_criteria(sql, criteria, join, output, TRUE);
+}
+
+
+
+/*
+ * Turn the comma separated list of qualified @fields into "column = ?"
+ * assignments, and return their count.
+ */
+static int build_update_assignments(const char *fields, prelude_string_t *output)
+{
+        int ret, count = 0;
+        const char *end, *column;
+
+        do {
+                end = strchr(fields, ',');
+                if ( ! end )
+                        end = fields + strlen(fields);
+
+                for ( column = end; column > fields && column[-1] != '.' && column[-1] != ' '; column-- );
+
+                ret = prelude_string_sprintf(output, "%s%.*s = ?", count ? ", " : "", (int) (end - column), column);
+                if ( ret < 0 )
+                        return ret;
+
+                count++;
+                fields = end + (*end ? 1 : 0);
+
+        } while ( *fields );
+
+        return count;
+}
+
+
+
+/*
+ * Build the statement updating @path in the messages selected by @idents,
+ * an "IN (...)" condition on their ident. Only the rows that already exist
+ * are updated. New values are left as placeholders, one per updated column:
+ * the number of columns is returned.
+ */
+int classic_path_resolve_update(const idmef_path_t *path, const char *idents, prelude_string_t *output)
+{
+        int ret, count;
+        char *table_name;
+        classic_sql_join_t *join;
+        prelude_string_t *fields;
+        classic_sql_joined_table_t *table;
+        const classic_idmef_class_t *class;
+        unsigned int depth = idmef_path_get_depth(path);
+        idmef_value_type_id_t type = idmef_path_get_value_type(path, -1);
+
+        if ( depth < 2 || type == IDMEF_VALUE_TYPE_CLASS || type == IDMEF_VALUE_TYPE_LIST )
+                return preludedb_error_verbose(PRELUDEDB_ERROR_QUERY, "path '%s' does not address a value", idmef_path_get_name(path, -1));
+
+        if ( depth == 2 && type != IDMEF_VALUE_TYPE_TIME ) {
+                ret = prelude_string_sprintf(output, "UPDATE %s SET %s = ? WHERE _ident %s",
+                                             (idmef_path_get_class(path, 0) == IDMEF_CLASS_ID_ALERT) ? "Prelude_Alert" : "Prelude_Heartbeat",
+                                             idmef_path_get_name(path, 1), idents);
+                return (ret < 0) ? ret : 1;
+        }
+
+        class = search_path(path);
+
+        ret = class->resolve_table_name(path, &table_name);
+        if ( ret < 0 )
+                return ret;
+
+        ret = classic_sql_join_new(&join);
+        if ( ret < 0 ) {
+                free(table_name);
+                return ret;
+        }
+
+        ret = prelude_string_new(&fields);
+        if ( ret < 0 ) {
+                free(table_name);
+                classic_sql_join_destroy(join);
+                return ret;
+        }
+
+        classic_sql_join_set_top_class(join, idmef_path_get_class(path, 0));
+
+        ret = classic_sql_join_new_table(join, &table, path, table_name);
+        if ( ret < 0 )
+                goto error;
+
+        /*
+         * Time values span several columns, all of them are updated.
+         */
+        ret = class->resolve_field_name(path, (type == IDMEF_VALUE_TYPE_TIME) ? FIELD_CONTEXT_SELECT : FIELD_CONTEXT_WHERE,
+                                        table_name, fields);
+        if ( ret < 0 )
+                goto error;
+
+        ret = prelude_string_sprintf(output, "UPDATE %s SET ", table_name);
+        if ( ret < 0 )
+                goto error;
+
+        ret = count = build_update_assignments(prelude_string_get_string(fields), output);
+        if ( ret < 0 )
+                goto error;
+
+        ret = prelude_string_sprintf(output, " WHERE _message_ident %s", idents);
+        if ( ret < 0 )
+                goto error;
+
+        ret = classic_sql_joined_table_constraints_to_string(table, NULL, output);
+
+ error:
+        prelude_string_destroy(fields);
+        classic_sql_join_destroy(join);
+
+        return (ret < 0) ? ret : count;
+}
+
+
+
+/*
+ * Build the condition telling whether a message, aliased as top_table,
+ * has the row holding @path, which classic_path_resolve_update() only
+ * updates if it exists. Returns 0 if the path is held by the message table
+ * itself, so that there is no condition, or 1.
+ */
+int classic_path_resolve_update_condition(const idmef_path_t *path, prelude_string_t *output)
+{
+        int ret;
+        char *table_name;
+        classic_sql_join_t *join;
+        classic_sql_joined_table_t *table;
+        const classic_idmef_class_t *class;
+
+        if ( idmef_path_get_depth(path) == 2 && idmef_path_get_value_type(path, -1) != IDMEF_VALUE_TYPE_TIME )
+                return 0;
+
+        class = search_path(path);
+
+        ret = class->resolve_table_name(path, &table_name);
+        if ( ret < 0 )
+                return ret;
+
+        ret = classic_sql_join_new(&join);
+        if ( ret < 0 ) {
+                free(table_name);
+                return ret;
+        }
+
+        classic_sql_join_set_top_class(join, idmef_path_get_class(path, 0));
+
+        ret = classic_sql_join_new_table(join, &table, path, table_name);
+        if ( ret < 0 )
+                goto error;
+
+        ret = prelude_string_sprintf(output, "EXISTS (SELECT 1 FROM %s WHERE %s._message_ident = top_table._ident",
+                                     table_name, table_name);
+        if ( ret < 0 )
+                goto error;
+
+        ret = classic_sql_joined_table_constraints_to_string(table, table_name, output);
+        if ( ret < 0 )
+                goto error;
+
+        ret = prelude_string_cat(output, ")");
+
+ error:
+        classic_sql_join_destroy(join);
+
+        return (ret < 0) ? ret : 1;
+}
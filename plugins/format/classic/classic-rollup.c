@@ -0,0 +1,1650 @@
+/*****
+*
+* Copyright (C) 2020 CS GROUP - France. All Rights Reserved.
+*
+* This file is part of the PreludeDB library.
+*
+* This program is free software; you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation; either version 2, or (at your option)
+* any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License along
+* with this program; if not, write to the Free Software Foundation, Inc.,
+* 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+*
+*****/
+
+/*
+ * Rollups count the alerts per hour of their create time, for each value
+ * of the alert paths listed in the "rollups" setting (comma separated), in
+ * the Prelude_Rollup table created by the *-rollup.sql schema files. The
+ * total number of alerts is kept under the alert.create_time dimension.
+ *
+ * They are updated along with the inserted, updated and deleted alerts,
+ * and answer the preludedb_get_values() selections counting alerts grouped
+ * by extract(alert.create_time, ...) and at most one of these paths,
+ * within hour aligned create time ranges.
+ *
+ * The first time a database is opened with a path in the setting, the
+ * hour from which its rollups are complete is recorded in the
+ * Prelude_RollupDimension table: the next hour, or the beginning of time
+ * when there is no alert yet. The rollups of a path only answer requests
+ * starting from that hour, so that alerts inserted before the path was
+ * added are never missed. All the processes writing to the database are
+ * expected to share the same setting.
+ */
+
+#include "config.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+
+#include <libprelude/prelude.h>
+#include <libprelude/idmef.h>
+
+#include "preludedb-error.h"
+#include "preludedb-sql-settings.h"
+#include "preludedb-sql.h"
+#include "preludedb-path-selection.h"
+#include "preludedb.h"
+
+#include "classic-sql-join.h"
+#include "classic-path-resolve.h"
+#include "classic-rollup.h"
+
+
+#define ROLLUP_BUCKET_SIZE 3600
+#define ROLLUP_TOTAL_DIMENSION "alert.create_time"
+
+/*
+ * Increments are sent by multi-row upserts of at most this many rows.
+ */
+#define ROLLUP_UPSERT_MAX_ROWS 64
+#define ROLLUP_UPSERT_COLUMNS 5
+
+
+typedef struct {
+        prelude_list_t list;
+        char *key;
+        const char *dimension;
+        time_t bucket;
+        int64_t hash;
+        char *value;
+        int64_t count;
+} rollup_entry_t;
+
+
+typedef struct {
+        char bucket[PRELUDEDB_SQL_TIMESTAMP_STRING_SIZE];
+        char hash[32];
+        char count[32];
+} rollup_upsert_t;
+
+
+/*
+ * Watermarks are the first complete bucket of each dimension, -1 while
+ * it is not recorded.
+ */
+struct classic_rollup {
+        unsigned int dimension_count;
+        idmef_path_t **dimensions;
+        time_t *since;
+
+        idmef_path_t *create_time;
+        time_t total_since;
+
+        prelude_hash_t *hash;
+        prelude_list_t entries;
+};
+
+
+
+static inline time_t get_bucket(time_t sec)
+{
+        return sec - (sec % ROLLUP_BUCKET_SIZE);
+}
+
+
+
+/*
+ * 64 bits FNV-1a hash of @value, kept positive so that it fits a signed
+ * BIGINT column. Zero stands for the NULL value.
+ */
+static int64_t get_value_hash(const char *value)
+{
+        uint64_t hash = 14695981039346656037ULL;
+
+        if ( ! value )
+                return 0;
+
+        while ( *value ) {
+                hash ^= (unsigned char) *value++;
+                hash *= 1099511628211ULL;
+        }
+
+        hash &= INT64_MAX;
+
+        return hash ? (int64_t) hash : 1;
+}
+
+
+
+/*
+ * Iterate over the paths of the comma separated @setting.
+ */
+static const char *get_next_dimension(const char *setting, size_t *len)
+{
+        setting += strspn(setting, ", \t");
+        if ( ! *setting )
+                return NULL;
+
+        *len = strcspn(setting, ", \t");
+
+        return setting;
+}
+
+
+
+/*
+ * Returns the watermark of the @name path, NULL when it is not rolled up.
+ */
+static time_t *get_watermark(classic_rollup_t *rollup, const char *name)
+{
+        unsigned int i;
+
+        for ( i = 0; i < rollup->dimension_count; i++ ) {
+                if ( strcmp(idmef_path_get_name(rollup->dimensions[i], -1), name) == 0 )
+                        return &rollup->since[i];
+        }
+
+        return NULL;
+}
+
+
+
+static int check_dimension(const idmef_path_t *path)
+{
+        if ( idmef_path_get_class(path, 0) != IDMEF_CLASS_ID_ALERT )
+                return preludedb_error_verbose(PRELUDEDB_ERROR_INVALID_SETTINGS_STRING,
+                                               "rollup path '%s' is not an alert path", idmef_path_get_name(path, -1));
+
+        switch ( idmef_path_get_value_type(path, -1) ) {
+        case IDMEF_VALUE_TYPE_STRING:
+        case IDMEF_VALUE_TYPE_ENUM:
+        case IDMEF_VALUE_TYPE_INT8:
+        case IDMEF_VALUE_TYPE_UINT8:
+        case IDMEF_VALUE_TYPE_INT16:
+        case IDMEF_VALUE_TYPE_UINT16:
+        case IDMEF_VALUE_TYPE_INT32:
+        case IDMEF_VALUE_TYPE_UINT32:
+        case IDMEF_VALUE_TYPE_INT64:
+        case IDMEF_VALUE_TYPE_UINT64:
+                return 0;
+
+        default:
+                return preludedb_error_verbose(PRELUDEDB_ERROR_INVALID_SETTINGS_STRING,
+                                               "rollup path '%s' does not hold a string, enumeration or integer value",
+                                               idmef_path_get_name(path, -1));
+        }
+}
+
+
+
+static int add_dimension(classic_rollup_t *rollup, const char *name, size_t len)
+{
+        int ret;
+        char *str;
+        time_t *since;
+        idmef_path_t *path, **dimensions;
+
+        str = strndup(name, len);
+        if ( ! str )
+                return preludedb_error_from_errno(errno);
+
+        ret = idmef_path_new_fast(&path, str);
+        free(str);
+
+        if ( ret < 0 )
+                return ret;
+
+        ret = check_dimension(path);
+        if ( ret < 0 || get_watermark(rollup, idmef_path_get_name(path, -1)) ) {
+                idmef_path_destroy(path);
+                return (ret < 0) ? ret : 0;
+        }
+
+        since = realloc(rollup->since, (rollup->dimension_count + 1) * sizeof(*since));
+        if ( ! since ) {
+                idmef_path_destroy(path);
+                return preludedb_error_from_errno(errno);
+        }
+
+        rollup->since = since;
+
+        dimensions = realloc(rollup->dimensions, (rollup->dimension_count + 1) * sizeof(*dimensions));
+        if ( ! dimensions ) {
+                idmef_path_destroy(path);
+                return preludedb_error_from_errno(errno);
+        }
+
+        since[rollup->dimension_count] = -1;
+        dimensions[rollup->dimension_count++] = path;
+        rollup->dimensions = dimensions;
+
+        return 0;
+}
+
+
+
+/*
+ * Drop the counters accumulated in @rollup.
+ */
+void classic_rollup_clear(classic_rollup_t *rollup)
+{
+        rollup_entry_t *entry;
+        prelude_list_t *tmp, *bkp;
+
+        prelude_list_for_each_safe(&rollup->entries, tmp, bkp) {
+                entry = prelude_list_entry(tmp, rollup_entry_t, list);
+
+                prelude_list_del(&entry->list);
+                prelude_hash_elem_destroy(rollup->hash, entry->key);
+
+                if ( entry->value )
+                        free(entry->value);
+
+                free(entry);
+        }
+}
+
+
+
+void classic_rollup_destroy(classic_rollup_t *rollup)
+{
+        unsigned int i;
+
+        classic_rollup_clear(rollup);
+
+        for ( i = 0; i < rollup->dimension_count; i++ )
+                idmef_path_destroy(rollup->dimensions[i]);
+
+        if ( rollup->dimensions )
+                free(rollup->dimensions);
+
+        if ( rollup->since )
+                free(rollup->since);
+
+        if ( rollup->create_time )
+                idmef_path_destroy(rollup->create_time);
+
+        if ( rollup->hash )
+                prelude_hash_destroy(rollup->hash);
+
+        free(rollup);
+}
+
+
+
+/*
+ * Add @count to the @dimension / @bucket / @value counter. Empty values
+ * are distinct from NULL.
+ */
+static int rollup_add(classic_rollup_t *rollup, const char *dimension, time_t bucket, const char *value, int64_t count)
+{
+        int ret;
+        char *key;
+        int64_t hash;
+        prelude_string_t *str;
+        rollup_entry_t *entry;
+
+        hash = get_value_hash(value);
+
+        ret = prelude_string_new(&str);
+        if ( ret < 0 )
+                return ret;
+
+        ret = prelude_string_sprintf(str, "%s|%" PRELUDE_PRId64 "|%" PRELUDE_PRId64, dimension, (int64_t) bucket, hash);
+        if ( ret >= 0 )
+                ret = prelude_string_get_string_released(str, &key);
+
+        prelude_string_destroy(str);
+
+        if ( ret < 0 )
+                return ret;
+
+        entry = prelude_hash_get(rollup->hash, key);
+        if ( entry ) {
+                entry->count += count;
+                free(key);
+                return 0;
+        }
+
+        entry = calloc(1, sizeof(*entry));
+        if ( ! entry ) {
+                free(key);
+                return preludedb_error_from_errno(errno);
+        }
+
+        if ( value ) {
+                entry->value = strdup(value);
+                if ( ! entry->value ) {
+                        free(entry);
+                        free(key);
+                        return preludedb_error_from_errno(errno);
+                }
+        }
+
+        entry->key = key;
+        entry->dimension = dimension;
+        entry->bucket = bucket;
+        entry->hash = hash;
+        entry->count = count;
+
+        ret = prelude_hash_set(rollup->hash, key, entry);
+        if ( ret < 0 ) {
+                if ( entry->value )
+                        free(entry->value);
+
+                free(entry);
+                free(key);
+                return ret;
+        }
+
+        prelude_list_add_tail(&rollup->entries, &entry->list);
+
+        return 0;
+}
+
+
+
+/*
+ * Count each value of @value, lists being flattened. Returns the number of
+ * values counted.
+ */
+static int rollup_add_value(classic_rollup_t *rollup, const char *dimension, time_t bucket,
+                            const idmef_value_t *value, int64_t count)
+{
+        int ret, i;
+        int added = 0;
+        const char *str;
+        idmef_value_t *item;
+        prelude_string_t *out;
+
+        if ( idmef_value_is_list(value) ) {
+                for ( i = 0; i < idmef_value_get_count(value); i++ ) {
+                        item = idmef_value_get_nth(value, i);
+                        if ( ! item )
+                                continue;
+
+                        ret = rollup_add_value(rollup, dimension, bucket, item, count);
+                        if ( ret < 0 )
+                                return ret;
+
+                        added += ret;
+                }
+
+                return added;
+        }
+
+        ret = prelude_string_new(&out);
+        if ( ret < 0 )
+                return ret;
+
+        ret = idmef_value_to_string(value, out);
+        if ( ret >= 0 ) {
+                str = prelude_string_get_string(out);
+                ret = rollup_add(rollup, dimension, bucket, str ? str : "", count);
+        }
+
+        prelude_string_destroy(out);
+
+        return (ret < 0) ? ret : 1;
+}
+
+
+
+/*
+ * Account for @message, if it is an alert, in the counters of @rollup.
+ */
+int classic_rollup_add_message(classic_rollup_t *rollup, idmef_message_t *message)
+{
+        int ret;
+        time_t bucket;
+        unsigned int i;
+        idmef_time_t *time;
+        idmef_value_t *value;
+        const char *dimension;
+
+        if ( idmef_message_get_type(message) != IDMEF_MESSAGE_TYPE_ALERT )
+                return 0;
+
+        time = idmef_alert_get_create_time(idmef_message_get_alert(message));
+        if ( ! time )
+                return 0;
+
+        bucket = get_bucket(idmef_time_get_sec(time));
+
+        ret = rollup_add(rollup, ROLLUP_TOTAL_DIMENSION, bucket, NULL, 1);
+        if ( ret < 0 )
+                return ret;
+
+        for ( i = 0; i < rollup->dimension_count; i++ ) {
+                dimension = idmef_path_get_name(rollup->dimensions[i], -1);
+
+                ret = idmef_path_get(rollup->dimensions[i], message, &value);
+                if ( ret < 0 )
+                        return ret;
+
+                if ( ret > 0 ) {
+                        ret = rollup_add_value(rollup, dimension, bucket, value, 1);
+                        idmef_value_destroy(value);
+                        if ( ret < 0 )
+                                return ret;
+                }
+
+                /*
+                 * An alert without any value is counted under NULL, as
+                 * the outer joins of the regular query do.
+                 */
+                if ( ret == 0 ) {
+                        ret = rollup_add(rollup, dimension, bucket, NULL, 1);
+                        if ( ret < 0 )
+                                return ret;
+                }
+        }
+
+        return 0;
+}
+
+
+
+/*
+ * Count the alerts selected either by @idents, or by their create time
+ * within the [@from, @to[ range (@to being optional), under @path (the
+ * total when NULL).
+ */
+static int rollup_add_rows(classic_rollup_t *rollup, preludedb_sql_t *sql, const idmef_path_t *path,
+                           const char *idents, const char *from, const char *to, int64_t count)
+{
+        int ret;
+        time_t bucket;
+        const char *value;
+        const char *dimension;
+        idmef_time_t *time;
+        classic_sql_join_t *join;
+        preludedb_sql_row_t *row;
+        preludedb_sql_field_t *field;
+        preludedb_sql_table_t *table;
+        prelude_string_t *query, *time_field, *value_field = NULL, *str = NULL;
+
+        dimension = path ? idmef_path_get_name(path, -1) : ROLLUP_TOTAL_DIMENSION;
+
+        ret = classic_sql_join_new(&join);
+        if ( ret < 0 )
+                return ret;
+
+        classic_sql_join_set_top_class(join, IDMEF_CLASS_ID_ALERT);
+
+        ret = prelude_string_new(&query);
+        if ( ret < 0 ) {
+                classic_sql_join_destroy(join);
+                return ret;
+        }
+
+        ret = prelude_string_new(&time_field);
+        if ( ret < 0 ) {
+                prelude_string_destroy(query);
+                classic_sql_join_destroy(join);
+                return ret;
+        }
+
+        ret = classic_path_resolve_column(rollup->create_time, join, time_field);
+        if ( ret < 0 )
+                goto error;
+
+        if ( path ) {
+                ret = prelude_string_new(&value_field);
+                if ( ret < 0 )
+                        goto error;
+
+                ret = classic_path_resolve_column(path, join, value_field);
+                if ( ret < 0 )
+                        goto error;
+        }
+
+        ret = prelude_string_sprintf(query, "SELECT %s%s%s FROM ", prelude_string_get_string(time_field),
+                                     value_field ? ", " : "", value_field ? prelude_string_get_string(value_field) : "");
+        if ( ret < 0 )
+                goto error;
+
+        ret = classic_sql_join_to_string(join, query);
+        if ( ret < 0 )
+                goto error;
+
+        if ( idents )
+                ret = prelude_string_sprintf(query, " WHERE top_table._ident %s", idents);
+
+        else if ( to )
+                ret = prelude_string_sprintf(query, " WHERE %s >= %s AND %s < %s", prelude_string_get_string(time_field), from,
+                                             prelude_string_get_string(time_field), to);
+        else
+                ret = prelude_string_sprintf(query, " WHERE %s >= %s", prelude_string_get_string(time_field), from);
+        if ( ret < 0 )
+                goto error;
+
+        ret = preludedb_sql_query(sql, prelude_string_get_string(query), &table);
+        if ( ret <= 0 )
+                goto error;
+
+        ret = idmef_time_new(&time);
+        if ( ret < 0 )
+                goto out;
+
+        ret = prelude_string_new(&str);
+        if ( ret < 0 ) {
+                idmef_time_destroy(time);
+                goto out;
+        }
+
+        while ( (ret = preludedb_sql_table_fetch_row(table, &row)) > 0 ) {
+                ret = preludedb_sql_row_get_field(row, 0, &field);
+                if ( ret < 0 )
+                        break;
+
+                if ( ret == 0 )
+                        continue;
+
+                ret = preludedb_sql_field_to_time(field, time, 0, 0);
+                if ( ret < 0 )
+                        break;
+
+                bucket = get_bucket(idmef_time_get_sec(time));
+                value = NULL;
+
+                if ( path ) {
+                        ret = preludedb_sql_row_get_field(row, 1, &field);
+                        if ( ret < 0 )
+                                break;
+
+                        if ( ret > 0 ) {
+                                prelude_string_clear(str);
+
+                                ret = preludedb_sql_field_to_string(field, str);
+                                if ( ret < 0 )
+                                        break;
+
+                                value = prelude_string_get_string(str);
+                                if ( ! value )
+                                        value = "";
+                        }
+                }
+
+                ret = rollup_add(rollup, dimension, bucket, value, count);
+                if ( ret < 0 )
+                        break;
+        }
+
+        idmef_time_destroy(time);
+
+ out:
+        preludedb_sql_table_destroy(table);
+
+ error:
+        if ( str )
+                prelude_string_destroy(str);
+
+        if ( value_field )
+                prelude_string_destroy(value_field);
+
+        prelude_string_destroy(time_field);
+        prelude_string_destroy(query);
+        classic_sql_join_destroy(join);
+
+        return (ret < 0) ? ret : 0;
+}
+
+
+
+/*
+ * Build the timestamp literal of @bucket.
+ */
+static int get_bucket_timestamp(preludedb_sql_t *sql, idmef_time_t *time, time_t bucket, char *buf, size_t size)
+{
+        idmef_time_set_sec(time, bucket);
+        idmef_time_set_usec(time, 0);
+        idmef_time_set_gmt_offset(time, 0);
+
+        return preludedb_sql_time_to_timestamp(sql, time, buf, size, NULL, 0, NULL, 0);
+}
+
+
+
+static const char *strip_quotes(char *buf)
+{
+        size_t len = strlen(buf);
+
+        if ( len < 2 || buf[0] != '\'' || buf[len - 1] != '\'' )
+                return buf;
+
+        buf[len - 1] = 0;
+
+        return buf + 1;
+}
+
+
+
+static inline void set_param(preludedb_sql_param_t *param, const char *value)
+{
+        param->value = value;
+        param->len = value ? strlen(value) : 0;
+        param->type = PRELUDEDB_SQL_PARAM_TYPE_TEXT;
+}
+
+
+
+static const char *get_upsert_clause(preludedb_sql_t *sql)
+{
+        const char *type = preludedb_sql_get_type(sql);
+
+        if ( strcmp(type, "mysql") == 0 )
+                return " ON DUPLICATE KEY UPDATE _count = _count + VALUES(_count)";
+
+        if ( strcmp(type, "pgsql") == 0 )
+                return " ON CONFLICT (_dimension, _bucket, _hash) DO UPDATE SET _count = Prelude_Rollup._count + EXCLUDED._count";
+
+        return " ON CONFLICT (_dimension, _bucket, _hash) DO UPDATE SET _count = _count + excluded._count";
+}
+
+
+
+/*
+ * Add the counters of the @rows rows of @params at once, with a multi-row
+ * upsert. Entries are unique per key, so that no row is affected twice.
+ */
+static int upsert_rows(preludedb_sql_t *sql, const preludedb_sql_param_t *params, unsigned int rows)
+{
+        int ret;
+        unsigned int i;
+        prelude_string_t *query;
+
+        ret = prelude_string_new(&query);
+        if ( ret < 0 )
+                return ret;
+
+        ret = prelude_string_cat(query, "INSERT INTO Prelude_Rollup (_dimension, _bucket, _hash, _value, _count) VALUES ");
+
+        for ( i = 0; i < rows && ret >= 0; i++ )
+                ret = prelude_string_cat(query, (i == 0) ? "(?, ?, ?, ?, ?)" : ", (?, ?, ?, ?, ?)");
+
+        if ( ret >= 0 )
+                ret = prelude_string_cat(query, get_upsert_clause(sql));
+
+        /*
+         * Only Prelude_Rollup is involved: rows queued for the messages
+         * being inserted do not need to be flushed first.
+         */
+        if ( ret >= 0 )
+                ret = preludedb_sql_write_params(sql, prelude_string_get_string(query), params, rows * ROLLUP_UPSERT_COLUMNS);
+
+        prelude_string_destroy(query);
+
+        return ret;
+}
+
+
+
+/*
+ * Send the @count pending upserts, in batches of a power of two size so
+ * that only a handful of distinct statements end up in the statement
+ * cache.
+ */
+static int upsert_pending(preludedb_sql_t *sql, const preludedb_sql_param_t *params, unsigned int count)
+{
+        int ret;
+        unsigned int rows, row = 0;
+
+        while ( row < count ) {
+                for ( rows = 1; rows * 2 <= count - row; rows *= 2 );
+
+                ret = upsert_rows(sql, params + row * ROLLUP_UPSERT_COLUMNS, rows);
+                if ( ret < 0 )
+                        return ret;
+
+                row += rows;
+        }
+
+        return 0;
+}
+
+
+
+static int decrement_entry(preludedb_sql_t *sql, rollup_entry_t *entry, const char *bucket)
+{
+        int ret;
+        char hash[32], count[32];
+        preludedb_sql_param_t params[4];
+
+        snprintf(hash, sizeof(hash), "%" PRELUDE_PRId64, entry->hash);
+        snprintf(count, sizeof(count), "%" PRELUDE_PRId64, -entry->count);
+
+        set_param(&params[0], count);
+        set_param(&params[1], entry->dimension);
+        set_param(&params[2], bucket);
+        set_param(&params[3], hash);
+
+        ret = preludedb_sql_write_params(sql, "UPDATE Prelude_Rollup SET _count = _count - ? "
+                                         "WHERE _dimension = ? AND _bucket = ? AND _hash = ?", params, 4);
+        if ( ret < 0 )
+                return ret;
+
+        return preludedb_sql_write_params(sql, "DELETE FROM Prelude_Rollup "
+                                          "WHERE _dimension = ? AND _bucket = ? AND _hash = ? AND _count <= 0", params + 1, 3);
+}
+
+
+
+/*
+ * Apply the counters accumulated in @rollup to the Prelude_Rollup table,
+ * within the current transaction. Increments are sent with a few
+ * multi-row upserts, counters dropping to zero are removed. The
+ * accumulated counters are dropped in any case.
+ */
+int classic_rollup_flush(classic_rollup_t *rollup, preludedb_sql_t *sql)
+{
+        int ret = 0;
+        idmef_time_t *time;
+        prelude_list_t *tmp;
+        rollup_entry_t *entry;
+        unsigned int pending = 0;
+        char bucket[PRELUDEDB_SQL_TIMESTAMP_STRING_SIZE];
+        rollup_upsert_t upserts[ROLLUP_UPSERT_MAX_ROWS];
+        preludedb_sql_param_t params[ROLLUP_UPSERT_MAX_ROWS * ROLLUP_UPSERT_COLUMNS], *param;
+
+        ret = idmef_time_new(&time);
+        if ( ret < 0 )
+                return ret;
+
+        prelude_list_for_each(&rollup->entries, tmp) {
+                entry = prelude_list_entry(tmp, rollup_entry_t, list);
+
+                if ( entry->count == 0 )
+                        continue;
+
+                if ( entry->count < 0 ) {
+                        ret = get_bucket_timestamp(sql, time, entry->bucket, bucket, sizeof(bucket));
+                        if ( ret < 0 )
+                                break;
+
+                        ret = decrement_entry(sql, entry, strip_quotes(bucket));
+                        if ( ret < 0 )
+                                break;
+
+                        continue;
+                }
+
+                ret = get_bucket_timestamp(sql, time, entry->bucket, upserts[pending].bucket, sizeof(upserts[pending].bucket));
+                if ( ret < 0 )
+                        break;
+
+                snprintf(upserts[pending].hash, sizeof(upserts[pending].hash), "%" PRELUDE_PRId64, entry->hash);
+                snprintf(upserts[pending].count, sizeof(upserts[pending].count), "%" PRELUDE_PRId64, entry->count);
+
+                param = &params[pending * ROLLUP_UPSERT_COLUMNS];
+                set_param(&param[0], entry->dimension);
+                set_param(&param[1], strip_quotes(upserts[pending].bucket));
+                set_param(&param[2], upserts[pending].hash);
+                set_param(&param[3], entry->value);
+                set_param(&param[4], upserts[pending].count);
+
+                if ( ++pending == ROLLUP_UPSERT_MAX_ROWS ) {
+                        ret = upsert_rows(sql, params, pending);
+                        if ( ret < 0 )
+                                break;
+
+                        pending = 0;
+                }
+        }
+
+        if ( ret >= 0 )
+                ret = upsert_pending(sql, params, pending);
+
+        idmef_time_destroy(time);
+        classic_rollup_clear(rollup);
+
+        return (ret < 0) ? ret : 0;
+}
+
+
+
+/*
+ * Account for the alerts selected by the @idents condition, @count times.
+ */
+static int rollup_add_alerts(classic_rollup_t *rollup, preludedb_sql_t *sql, const char *idents, int64_t count)
+{
+        int ret;
+        unsigned int i;
+
+        if ( ! rollup )
+                return 0;
+
+        ret = rollup_add_rows(rollup, sql, NULL, idents, NULL, NULL, count);
+
+        for ( i = 0; ret >= 0 && i < rollup->dimension_count; i++ )
+                ret = rollup_add_rows(rollup, sql, rollup->dimensions[i], idents, NULL, NULL, count);
+
+        if ( ret < 0 ) {
+                classic_rollup_clear(rollup);
+                return ret;
+        }
+
+        return classic_rollup_flush(rollup, sql);
+}
+
+
+
+/*
+ * Remove the alerts selected by the @idents condition from the rollups,
+ * before they are deleted or updated, and within the same transaction.
+ */
+int classic_rollup_remove_alerts(classic_rollup_t *rollup, preludedb_sql_t *sql, const char *idents)
+{
+        return rollup_add_alerts(rollup, sql, idents, -1);
+}
+
+
+
+/*
+ * Add the alerts selected by the @idents condition back to the rollups,
+ * once they are updated.
+ */
+int classic_rollup_add_alerts(classic_rollup_t *rollup, preludedb_sql_t *sql, const char *idents)
+{
+        return rollup_add_alerts(rollup, sql, idents, 1);
+}
+
+
+
+/*
+ * Whether updating @path might change the rollups: the create time moves
+ * alerts between buckets, other paths matter when they hold a rolled up
+ * path, whatever their list indexes.
+ */
+static prelude_bool_t is_rolled_up(classic_rollup_t *rollup, const idmef_path_t *path)
+{
+        unsigned int i, j, depth = idmef_path_get_depth(path);
+
+        if ( idmef_path_get_class(path, 0) != IDMEF_CLASS_ID_ALERT )
+                return FALSE;
+
+        if ( strcmp(idmef_path_get_name(path, -1), ROLLUP_TOTAL_DIMENSION) == 0 )
+                return TRUE;
+
+        for ( i = 0; i < rollup->dimension_count; i++ ) {
+                if ( depth > idmef_path_get_depth(rollup->dimensions[i]) )
+                        continue;
+
+                for ( j = 0; j < depth; j++ ) {
+                        if ( strcmp(idmef_path_get_name(path, j), idmef_path_get_name(rollup->dimensions[i], j)) != 0 )
+                                break;
+                }
+
+                if ( j == depth )
+                        return TRUE;
+        }
+
+        return FALSE;
+}
+
+
+
+/*
+ * Whether updating @paths might change the rollups.
+ */
+prelude_bool_t classic_rollup_has_paths(classic_rollup_t *rollup, const idmef_path_t * const *paths, size_t size)
+{
+        size_t i;
+
+        if ( ! rollup )
+                return FALSE;
+
+        for ( i = 0; i < size; i++ ) {
+                if ( is_rolled_up(rollup, paths[i]) )
+                        return TRUE;
+        }
+
+        return FALSE;
+}
+
+
+
+/*
+ * Rebuild the rollups of the oldest remaining hour, and drop the older
+ * ones.
+ */
+static int trim_rollups(classic_rollup_t *rollup, preludedb_sql_t *sql)
+{
+        int ret;
+        time_t bucket;
+        unsigned int i;
+        idmef_time_t *time;
+        preludedb_sql_row_t *row;
+        preludedb_sql_field_t *field;
+        preludedb_sql_table_t *table;
+        char from[PRELUDEDB_SQL_TIMESTAMP_STRING_SIZE], to[PRELUDEDB_SQL_TIMESTAMP_STRING_SIZE];
+
+        ret = preludedb_sql_query(sql, "SELECT MIN(time) FROM Prelude_CreateTime WHERE _parent_type = 'A'", &table);
+        if ( ret < 0 )
+                return ret;
+
+        if ( ret == 0 )
+                return preludedb_sql_query(sql, "DELETE FROM Prelude_Rollup", NULL);
+
+        ret = idmef_time_new(&time);
+        if ( ret < 0 ) {
+                preludedb_sql_table_destroy(table);
+                return ret;
+        }
+
+        ret = preludedb_sql_table_fetch_row(table, &row);
+        if ( ret > 0 )
+                ret = preludedb_sql_row_get_field(row, 0, &field);
+
+        if ( ret > 0 )
+                ret = preludedb_sql_field_to_time(field, time, 0, 0);
+
+        preludedb_sql_table_destroy(table);
+
+        if ( ret < 0 )
+                goto out;
+
+        if ( ret == 0 ) {
+                ret = preludedb_sql_query(sql, "DELETE FROM Prelude_Rollup", NULL);
+                goto out;
+        }
+
+        bucket = get_bucket(idmef_time_get_sec(time));
+
+        ret = get_bucket_timestamp(sql, time, bucket, from, sizeof(from));
+        if ( ret < 0 )
+                goto out;
+
+        ret = get_bucket_timestamp(sql, time, bucket + ROLLUP_BUCKET_SIZE, to, sizeof(to));
+        if ( ret < 0 )
+                goto out;
+
+        ret = preludedb_sql_query_sprintf(sql, NULL, "DELETE FROM Prelude_Rollup WHERE _bucket <= %s", from);
+        if ( ret < 0 )
+                goto out;
+
+        ret = rollup_add_rows(rollup, sql, NULL, NULL, from, to, 1);
+
+        for ( i = 0; ret >= 0 && i < rollup->dimension_count; i++ )
+                ret = rollup_add_rows(rollup, sql, rollup->dimensions[i], NULL, from, to, 1);
+
+        if ( ret >= 0 )
+                ret = classic_rollup_flush(rollup, sql);
+
+ out:
+        classic_rollup_clear(rollup);
+        idmef_time_destroy(time);
+        return ret;
+}
+
+
+
+/*
+ * Bring the rollups in line with the remaining alerts once whole partitions
+ * were dropped: the hour holding the oldest alert is rebuilt, older hours
+ * are removed.
+ */
+int classic_rollup_trim(classic_rollup_t *rollup, preludedb_sql_t *sql)
+{
+        int ret, tmp;
+
+        if ( ! rollup )
+                return 0;
+
+        ret = preludedb_sql_transaction_start(sql);
+        if ( ret < 0 )
+                return ret;
+
+        ret = trim_rollups(rollup, sql);
+        if ( ret < 0 ) {
+                tmp = preludedb_sql_transaction_abort(sql);
+                if ( tmp < 0 )
+                        ret = tmp;
+        } else
+                ret = preludedb_sql_transaction_end(sql);
+
+        return ret;
+}
+
+
+
+/*
+ * Read the watermarks recorded for the dimensions of @rollup.
+ */
+static int load_watermarks(classic_rollup_t *rollup, preludedb_sql_t *sql)
+{
+        int ret;
+        time_t *since;
+        const char *name;
+        idmef_time_t *time;
+        preludedb_sql_row_t *row;
+        preludedb_sql_field_t *field;
+        preludedb_sql_table_t *table;
+
+        ret = preludedb_sql_query(sql, "SELECT _dimension, _since FROM Prelude_RollupDimension", &table);
+        if ( ret <= 0 )
+                return ret;
+
+        ret = idmef_time_new(&time);
+        if ( ret < 0 ) {
+                preludedb_sql_table_destroy(table);
+                return ret;
+        }
+
+        while ( (ret = preludedb_sql_table_fetch_row(table, &row)) > 0 ) {
+                ret = preludedb_sql_row_get_field(row, 0, &field);
+                if ( ret < 0 )
+                        break;
+
+                if ( ret == 0 )
+                        continue;
+
+                name = preludedb_sql_field_get_value(field);
+                if ( strcmp(name, ROLLUP_TOTAL_DIMENSION) == 0 )
+                        since = &rollup->total_since;
+                else
+                        since = get_watermark(rollup, name);
+
+                if ( ! since )
+                        continue;
+
+                ret = preludedb_sql_row_get_field(row, 1, &field);
+                if ( ret < 0 )
+                        break;
+
+                if ( ret == 0 )
+                        continue;
+
+                ret = preludedb_sql_field_to_time(field, time, 0, 0);
+                if ( ret < 0 )
+                        break;
+
+                *since = idmef_time_get_sec(time);
+        }
+
+        idmef_time_destroy(time);
+        preludedb_sql_table_destroy(table);
+
+        return ret;
+}
+
+
+
+static prelude_bool_t has_watermarks(classic_rollup_t *rollup)
+{
+        unsigned int i;
+
+        if ( rollup->total_since < 0 )
+                return FALSE;
+
+        for ( i = 0; i < rollup->dimension_count; i++ ) {
+                if ( rollup->since[i] < 0 )
+                        return FALSE;
+        }
+
+        return TRUE;
+}
+
+
+
+/*
+ * Count the alerts created from @from on under @path, and record @bucket
+ * as its watermark.
+ */
+static int add_watermark(classic_rollup_t *rollup, preludedb_sql_t *sql, const idmef_path_t *path,
+                         const char *from, const char *bucket)
+{
+        int ret;
+        preludedb_sql_param_t params[2];
+
+        if ( from ) {
+                ret = rollup_add_rows(rollup, sql, path, NULL, from, NULL, 1);
+                if ( ret < 0 )
+                        return ret;
+        }
+
+        set_param(&params[0], path ? idmef_path_get_name(path, -1) : ROLLUP_TOTAL_DIMENSION);
+        set_param(&params[1], bucket);
+
+        return preludedb_sql_query_params(sql, "INSERT INTO Prelude_RollupDimension (_dimension, _since) VALUES (?, ?)",
+                                          params, 2, NULL);
+}
+
+
+
+/*
+ * Record the watermarks of the dimensions newly listed in the setting.
+ * Their rollups are complete from the next hour on, once the alerts
+ * already created within it are counted, or from the beginning when
+ * there is no alert at all.
+ */
+static int register_watermarks(classic_rollup_t *rollup, preludedb_sql_t *sql, time_t since)
+{
+        int ret;
+        unsigned int i;
+        idmef_time_t *time;
+        const char *value;
+        char from[PRELUDEDB_SQL_TIMESTAMP_STRING_SIZE], bucket[PRELUDEDB_SQL_TIMESTAMP_STRING_SIZE];
+
+        ret = idmef_time_new(&time);
+        if ( ret < 0 )
+                return ret;
+
+        ret = get_bucket_timestamp(sql, time, since, from, sizeof(from));
+        idmef_time_destroy(time);
+
+        if ( ret < 0 )
+                return ret;
+
+        strcpy(bucket, from);
+        value = strip_quotes(bucket);
+
+        if ( rollup->total_since < 0 ) {
+                ret = add_watermark(rollup, sql, NULL, since ? from : NULL, value);
+                if ( ret < 0 )
+                        goto out;
+        }
+
+        for ( i = 0; i < rollup->dimension_count; i++ ) {
+                if ( rollup->since[i] >= 0 )
+                        continue;
+
+                ret = add_watermark(rollup, sql, rollup->dimensions[i], since ? from : NULL, value);
+                if ( ret < 0 )
+                        goto out;
+        }
+
+        ret = classic_rollup_flush(rollup, sql);
+
+ out:
+        classic_rollup_clear(rollup);
+        return ret;
+}
+
+
+
+static int init_watermarks(classic_rollup_t *rollup, preludedb_sql_t *sql)
+{
+        int ret, tmp;
+        unsigned int i;
+        time_t since = 0;
+        preludedb_sql_table_t *table;
+
+        ret = load_watermarks(rollup, sql);
+        if ( ret < 0 || has_watermarks(rollup) )
+                return ret;
+
+        ret = preludedb_sql_transaction_start(sql);
+        if ( ret < 0 )
+                return ret;
+
+        ret = preludedb_sql_query(sql, "SELECT _ident FROM Prelude_Alert LIMIT 1", &table);
+        if ( ret > 0 ) {
+                preludedb_sql_table_destroy(table);
+                since = get_bucket(time(NULL)) + ROLLUP_BUCKET_SIZE;
+        }
+
+        if ( ret >= 0 )
+                ret = register_watermarks(rollup, sql, since);
+
+        if ( ret >= 0 ) {
+                ret = preludedb_sql_transaction_end(sql);
+                if ( ret < 0 )
+                        return ret;
+
+                if ( rollup->total_since < 0 )
+                        rollup->total_since = since;
+
+                for ( i = 0; i < rollup->dimension_count; i++ ) {
+                        if ( rollup->since[i] < 0 )
+                                rollup->since[i] = since;
+                }
+
+                return 0;
+        }
+
+        tmp = preludedb_sql_transaction_abort(sql);
+        if ( tmp < 0 )
+                return tmp;
+
+        /*
+         * Another process might have recorded them concurrently.
+         */
+        tmp = load_watermarks(rollup, sql);
+        if ( tmp < 0 )
+                return tmp;
+
+        return has_watermarks(rollup) ? 0 : ret;
+}
+
+
+
+/*
+ * Create the rollups of the paths listed in the "rollups" setting of @sql,
+ * recording the watermarks of the newly listed ones. They are meant to be
+ * created once per database. @rollup is set to NULL when the setting is
+ * not set.
+ */
+int classic_rollup_new(preludedb_sql_t *sql, classic_rollup_t **rollup)
+{
+        int ret;
+        size_t len;
+        const char *setting;
+
+        *rollup = NULL;
+
+        setting = preludedb_sql_settings_get_rollups(preludedb_sql_get_settings(sql));
+        if ( ! setting || ! get_next_dimension(setting, &len) )
+                return 0;
+
+        *rollup = calloc(1, sizeof(**rollup));
+        if ( ! *rollup )
+                return preludedb_error_from_errno(errno);
+
+        (*rollup)->total_since = -1;
+        prelude_list_init(&(*rollup)->entries);
+
+        ret = prelude_hash_new(&(*rollup)->hash, NULL, NULL, free, NULL);
+        if ( ret < 0 )
+                goto error;
+
+        ret = idmef_path_new_fast(&(*rollup)->create_time, ROLLUP_TOTAL_DIMENSION);
+        if ( ret < 0 )
+                goto error;
+
+        while ( (setting = get_next_dimension(setting, &len)) ) {
+                ret = add_dimension(*rollup, setting, len);
+                if ( ret < 0 )
+                        goto error;
+
+                setting += len;
+        }
+
+        ret = init_watermarks(*rollup, sql);
+        if ( ret < 0 )
+                goto error;
+
+        return 0;
+
+ error:
+        classic_rollup_destroy(*rollup);
+        *rollup = NULL;
+
+        return ret;
+}
+
+
+
+static prelude_bool_t is_create_time(preludedb_selected_object_t *object)
+{
+        if ( ! object || preludedb_selected_object_get_type(object) != PRELUDEDB_SELECTED_OBJECT_TYPE_IDMEFPATH )
+                return FALSE;
+
+        return strcmp(idmef_path_get_name(preludedb_selected_object_get_data(object), -1), ROLLUP_TOTAL_DIMENSION) == 0;
+}
+
+
+
+static prelude_bool_t is_bucket_extract(preludedb_selected_object_t *object)
+{
+        preludedb_selected_object_t *unit;
+
+        if ( ! is_create_time(preludedb_selected_object_get_arg(object, 0)) )
+                return FALSE;
+
+        unit = preludedb_selected_object_get_arg(object, 1);
+        if ( ! unit || preludedb_selected_object_get_type(unit) != PRELUDEDB_SELECTED_OBJECT_TYPE_INT )
+                return FALSE;
+
+        /*
+         * Anything coarser than the hour, in UTC.
+         */
+        switch ( *(const int *) preludedb_selected_object_get_data(unit) ) {
+        case PRELUDEDB_SQL_TIME_CONSTRAINT_YEAR:
+        case PRELUDEDB_SQL_TIME_CONSTRAINT_QUARTER:
+        case PRELUDEDB_SQL_TIME_CONSTRAINT_MONTH:
+        case PRELUDEDB_SQL_TIME_CONSTRAINT_YDAY:
+        case PRELUDEDB_SQL_TIME_CONSTRAINT_MDAY:
+        case PRELUDEDB_SQL_TIME_CONSTRAINT_WDAY:
+        case PRELUDEDB_SQL_TIME_CONSTRAINT_HOUR:
+                return TRUE;
+
+        default:
+                return FALSE;
+        }
+}
+
+
+
+/*
+ * Check that @selection only counts alerts, grouped by create time
+ * extractions and at most one rolled up path, returned in @dimension
+ * along with its watermark.
+ */
+static int get_selection_dimension(classic_rollup_t *rollup, preludedb_path_selection_t *selection,
+                                   const char **dimension, time_t *since)
+{
+        const char *name = NULL;
+        unsigned int count = 0;
+        time_t *watermark = NULL;
+        preludedb_selected_object_t *object;
+        preludedb_selected_path_flags_t flags;
+        preludedb_selected_path_t *selected = NULL;
+
+        while ( (selected = preludedb_path_selection_get_next(selection, selected)) ) {
+                object = preludedb_selected_path_get_object(selected);
+                flags = preludedb_selected_path_get_flags(selected);
+
+                if ( preludedb_selected_path_get_time_constraint(selected) )
+                        return 0;
+
+                switch ( preludedb_selected_object_get_type(object) ) {
+                case PRELUDEDB_SELECTED_OBJECT_TYPE_EXTRACT:
+                        if ( ! (flags & PRELUDEDB_SELECTED_PATH_FLAGS_GROUP_BY) || ! is_bucket_extract(object) )
+                                return 0;
+                        break;
+
+                case PRELUDEDB_SELECTED_OBJECT_TYPE_COUNT:
+                        if ( (flags & PRELUDEDB_SELECTED_PATH_FLAGS_GROUP_BY) || ! is_create_time(preludedb_selected_object_get_arg(object, 0)) )
+                                return 0;
+
+                        count++;
+                        break;
+
+                case PRELUDEDB_SELECTED_OBJECT_TYPE_IDMEFPATH:
+                        if ( ! (flags & PRELUDEDB_SELECTED_PATH_FLAGS_GROUP_BY) || name )
+                                return 0;
+
+                        name = idmef_path_get_name(preludedb_selected_object_get_data(object), -1);
+
+                        watermark = get_watermark(rollup, name);
+                        if ( ! watermark )
+                                return 0;
+                        break;
+
+                default:
+                        return 0;
+                }
+        }
+
+        if ( count == 0 )
+                return 0;
+
+        *dimension = name ? name : ROLLUP_TOTAL_DIMENSION;
+        *since = watermark ? *watermark : rollup->total_since;
+
+        return 1;
+}
+
+
+
+/*
+ * Only ANDed create time lower (inclusive) and upper (exclusive) bounds,
+ * on hour boundaries, match whole buckets. The greatest lower bound is
+ * returned in @from.
+ */
+static prelude_bool_t match_criteria(idmef_criteria_t *criteria, time_t *from)
+{
+        idmef_value_t *value;
+        const idmef_time_t *time;
+        idmef_criterion_value_t *cvalue;
+        idmef_criterion_operator_t operator;
+
+        if ( ! idmef_criteria_is_criterion(criteria) ) {
+                if ( idmef_criteria_get_operator(criteria) != IDMEF_CRITERIA_OPERATOR_AND || ! idmef_criteria_get_left(criteria) )
+                        return FALSE;
+
+                return match_criteria(idmef_criteria_get_left(criteria), from) && match_criteria(idmef_criteria_get_right(criteria), from);
+        }
+
+        if ( strcmp(idmef_path_get_name(idmef_criteria_get_path(criteria), -1), ROLLUP_TOTAL_DIMENSION) != 0 )
+                return FALSE;
+
+        operator = idmef_criteria_get_operator(criteria);
+        if ( operator != IDMEF_CRITERION_OPERATOR_GREATER_OR_EQUAL && operator != IDMEF_CRITERION_OPERATOR_LESSER )
+                return FALSE;
+
+        cvalue = idmef_criteria_get_value(criteria);
+        if ( ! cvalue || idmef_criterion_value_get_type(cvalue) != IDMEF_CRITERION_VALUE_TYPE_VALUE )
+                return FALSE;
+
+        value = (idmef_value_t *) idmef_criterion_value_get_value(cvalue);
+        if ( idmef_value_get_type(value) != IDMEF_VALUE_TYPE_TIME )
+                return FALSE;
+
+        time = idmef_value_get_time(value);
+        if ( idmef_time_get_sec(time) % ROLLUP_BUCKET_SIZE != 0 || idmef_time_get_usec(time) != 0 )
+                return FALSE;
+
+        if ( operator == IDMEF_CRITERION_OPERATOR_GREATER_OR_EQUAL && (time_t) idmef_time_get_sec(time) > *from )
+                *from = idmef_time_get_sec(time);
+
+        return TRUE;
+}
+
+
+
+/*
+ * Returns 1 if the preludedb_get_values() request can be answered from the
+ * rollups, 0 otherwise. Requests without a lower bound start from the
+ * beginning.
+ */
+int classic_rollup_match_values(classic_rollup_t *rollup, preludedb_path_selection_t *selection,
+                                idmef_criteria_t *criteria, int distinct)
+{
+        time_t from = 0, since;
+        const char *dimension;
+
+        if ( ! rollup || distinct )
+                return 0;
+
+        if ( ! get_selection_dimension(rollup, selection, &dimension, &since) )
+                return 0;
+
+        if ( criteria && ! match_criteria(criteria, &from) )
+                return 0;
+
+        /*
+         * Counts are only complete from the watermark on.
+         */
+        return since >= 0 && from >= since;
+}
+
+
+
+/*
+ * Same walk as classic_path_resolve_criteria_template(), so that the
+ * parameters collected along the request key match the placeholders.
+ */
+static int build_criteria_template(preludedb_sql_t *sql, idmef_criteria_t *criteria, prelude_string_t *output)
+{
+        int ret;
+
+        if ( idmef_criteria_is_criterion(criteria) )
+                return preludedb_sql_build_criterion_template(sql, output, "_bucket", idmef_criteria_get_operator(criteria),
+                                                              idmef_criteria_get_value(criteria));
+
+        ret = prelude_string_cat(output, "(");
+        if ( ret < 0 )
+                return ret;
+
+        ret = build_criteria_template(sql, idmef_criteria_get_left(criteria), output);
+        if ( ret < 0 )
+                return ret;
+
+        ret = prelude_string_cat(output, " AND ");
+        if ( ret < 0 )
+                return ret;
+
+        ret = build_criteria_template(sql, idmef_criteria_get_right(criteria), output);
+        if ( ret < 0 )
+                return ret;
+
+        return prelude_string_cat(output, ")");
+}
+
+
+
+static int add_modifiers(prelude_string_t *group_by, prelude_string_t *order_by,
+                         preludedb_selected_path_flags_t flags, unsigned int index)
+{
+        int ret;
+
+        if ( flags & PRELUDEDB_SELECTED_PATH_FLAGS_GROUP_BY ) {
+                ret = prelude_string_sprintf(group_by, "%s%u", prelude_string_is_empty(group_by) ? "" : ", ", index);
+                if ( ret < 0 )
+                        return ret;
+        }
+
+        if ( flags & (PRELUDEDB_SELECTED_PATH_FLAGS_ORDER_ASC|PRELUDEDB_SELECTED_PATH_FLAGS_ORDER_DESC) ) {
+                ret = prelude_string_sprintf(order_by, "%s%u %s", prelude_string_is_empty(order_by) ? "" : ", ", index,
+                                             (flags & PRELUDEDB_SELECTED_PATH_FLAGS_ORDER_ASC) ? "ASC" : "DESC");
+                if ( ret < 0 )
+                        return ret;
+        }
+
+        return 0;
+}
+
+
+
+/*
+ * Build the query answering a request accepted by
+ * classic_rollup_match_values() from the rollups, with the columns the
+ * regular query would return: one per selected path.
+ */
+int classic_rollup_build_values_plan(classic_rollup_t *rollup, preludedb_sql_t *sql, preludedb_path_selection_t *selection,
+                                     idmef_criteria_t *criteria, char **plan)
+{
+        int ret;
+        time_t since;
+        char *escaped;
+        unsigned int index = 0;
+        const char *dimension;
+        preludedb_selected_object_t *object;
+        preludedb_selected_path_t *selected = NULL;
+        prelude_string_t *query, *group_by, *order_by;
+
+        if ( ! rollup || ! get_selection_dimension(rollup, selection, &dimension, &since) )
+                return preludedb_error(PRELUDEDB_ERROR_QUERY);
+
+        ret = preludedb_sql_escape(sql, dimension, &escaped);
+        if ( ret < 0 )
+                return ret;
+
+        ret = prelude_string_new(&query);
+        if ( ret < 0 ) {
+                free(escaped);
+                return ret;
+        }
+
+        ret = prelude_string_new(&group_by);
+        if ( ret < 0 ) {
+                free(escaped);
+                prelude_string_destroy(query);
+                return ret;
+        }
+
+        ret = prelude_string_new(&order_by);
+        if ( ret < 0 ) {
+                free(escaped);
+                prelude_string_destroy(query);
+                prelude_string_destroy(group_by);
+                return ret;
+        }
+
+        ret = prelude_string_cat(query, "SELECT ");
+        if ( ret < 0 )
+                goto error;
+
+        while ( (selected = preludedb_path_selection_get_next(selection, selected)) ) {
+                object = preludedb_selected_path_get_object(selected);
+
+                if ( index++ > 0 ) {
+                        ret = prelude_string_cat(query, ", ");
+                        if ( ret < 0 )
+                                goto error;
+                }
+
+                switch ( preludedb_selected_object_get_type(object) ) {
+                case PRELUDEDB_SELECTED_OBJECT_TYPE_EXTRACT:
+                        ret = preludedb_sql_build_time_extract_string(sql, query, "_bucket",
+                                                                      *(const int *) preludedb_selected_object_get_data(preludedb_selected_object_get_arg(object, 1)), 0);
+                        break;
+
+                case PRELUDEDB_SELECTED_OBJECT_TYPE_COUNT:
+                        ret = prelude_string_cat(query, "SUM(_count)");
+                        break;
+
+                default:
+                        ret = prelude_string_cat(query, "_value");
+                        break;
+                }
+
+                if ( ret < 0 )
+                        goto error;
+
+                ret = add_modifiers(group_by, order_by, preludedb_selected_path_get_flags(selected), index);
+                if ( ret < 0 )
+                        goto error;
+        }
+
+        ret = prelude_string_sprintf(query, " FROM Prelude_Rollup WHERE _dimension = %s", escaped);
+        if ( ret < 0 )
+                goto error;
+
+        if ( criteria ) {
+                ret = prelude_string_cat(query, " AND ");
+                if ( ret < 0 )
+                        goto error;
+
+                ret = build_criteria_template(sql, criteria, query);
+                if ( ret < 0 )
+                        goto error;
+        }
+
+        if ( ! prelude_string_is_empty(group_by) ) {
+                ret = prelude_string_sprintf(query, " GROUP BY %s", prelude_string_get_string(group_by));
+                if ( ret < 0 )
+                        goto error;
+        }
+
+        if ( ! prelude_string_is_empty(order_by) ) {
+                ret = prelude_string_sprintf(query, " ORDER BY %s", prelude_string_get_string(order_by));
+                if ( ret < 0 )
+                        goto error;
+        }
+
+        ret = prelude_string_get_string_released(query, plan);
+
+ error:
+        free(escaped);
+        prelude_string_destroy(query);
+        prelude_string_destroy(group_by);
+        prelude_string_destroy(order_by);
+
+        return ret;
+}
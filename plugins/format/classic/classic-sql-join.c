@@ -38,19 +38,32 @@
 #include "classic-sql-join.h"
 
 
+typedef struct {
+        int parent_level;
+        int index;
+} classic_sql_index_constraint_t;
+
+
 struct classic_sql_joined_table {
         prelude_list_t list;
         const idmef_path_t *path;
         char *table_name;
         char aliased_table_name[16];
         char parent_type;
-        prelude_string_t *index_constraints;
+        unsigned int index_count;
+        classic_sql_index_constraint_t *indexes;
 };
 
 
+/*
+ * Joined tables are kept in order in the tables list, and indexed in the
+ * registry hash, so that looking a path up does not depend on the number
+ * of tables already joined. See join_key() for the keys.
+ */
 struct classic_sql_join {
         idmef_class_id_t top_class;
         prelude_list_t tables;
+        prelude_hash_t *registry;
         unsigned int next_id;
 };
 
@@ -58,10 +71,18 @@ struct classic_sql_join {
 
 int classic_sql_join_new(classic_sql_join_t **join)
 {
+        int ret;
+
         *join = calloc(1, sizeof (**join));
         if ( ! *join )
                 return prelude_error_from_errno(errno);
 
+        ret = prelude_hash_new(&(*join)->registry, NULL, NULL, free, NULL);
+        if ( ret < 0 ) {
+                free(*join);
+                return ret;
+        }
+
         prelude_list_init(&(*join)->tables);
 
         return 0;
@@ -77,11 +98,12 @@ void classic_sql_join_destroy(classic_sql_join_t *join)
         prelude_list_for_each_safe(&join->tables, tmp, next) {
                 table = prelude_list_entry(tmp, classic_sql_joined_table_t, list);
                 free(table->table_name);
-                prelude_string_destroy(table->index_constraints);
+                free(table->indexes);
                 prelude_list_del(&table->list);
                 free(table);
         }
 
+        prelude_hash_destroy(join->registry);
         free(join);
 }
 
@@ -93,33 +115,96 @@ void classic_sql_join_set_top_class(classic_sql_join_t *join, idmef_class_id_t t
 }
 
 
-classic_sql_joined_table_t *classic_sql_join_lookup_table(const classic_sql_join_t *join, const idmef_path_t *path)
+/*
+ * A table path is registered under two keys: one made of the whole path,
+ * and one made of its parent path only. Both start with the path depth,
+ * since only tables of the same depth match.
+ */
+static int join_key(const idmef_path_t *path, prelude_bool_t full, char **key)
 {
-        prelude_list_t *tmp;
-        classic_sql_joined_table_t *table;
-        unsigned int depth;
-        int last_element_is_listed;
         int ret;
+        unsigned int i, depth;
+        prelude_string_t *str;
+
+        ret = prelude_string_new(&str);
+        if ( ret < 0 )
+                return ret;
 
         depth = idmef_path_get_depth(path);
-        last_element_is_listed = ((ret = idmef_path_get_index(path, depth - 1)) > -1 ||
-                                  prelude_error_get_code(ret) != PRELUDE_ERROR_IDMEF_PATH_INDEX_FORBIDDEN);
 
-        prelude_list_for_each(&join->tables, tmp) {
-                table = prelude_list_entry(tmp, classic_sql_joined_table_t, list);
-                if ( depth == idmef_path_get_depth(table->path) ) {
-                        if ( last_element_is_listed || (idmef_path_get_value_type(path, -1) == IDMEF_VALUE_TYPE_TIME && idmef_path_get_class(path, depth - 2) != IDMEF_CLASS_ID_FILE) )
-                                ret = idmef_path_compare(path, table->path);
-                        else
-                                ret = idmef_path_ncompare(path, table->path, depth - 1);
+        ret = prelude_string_sprintf(str, "%c%u", full ? 'F' : 'P', depth);
+        if ( ret < 0 )
+                goto error;
+
+        for ( i = 0; i < (full ? depth : depth - 1); i++ ) {
+                ret = prelude_string_sprintf(str, ".%s(%d)", idmef_path_get_name(path, i), idmef_path_get_index(path, i));
+                if ( ret < 0 )
+                        goto error;
+        }
 
+        ret = prelude_string_get_string_released(str, key);
 
-                        if ( ret == 0 )
-                                return table;
-                }
+ error:
+        prelude_string_destroy(str);
+        return ret;
+}
+
+
+
+/*
+ * Register @table under @key, unless another table already uses it: the
+ * first table joined for a path is the one lookups have to return.
+ */
+static int join_register(classic_sql_join_t *join, classic_sql_joined_table_t *table, prelude_bool_t full)
+{
+        int ret;
+        char *key;
+
+        ret = join_key(table->path, full, &key);
+        if ( ret < 0 )
+                return ret;
+
+        if ( prelude_hash_get(join->registry, key) ) {
+                free(key);
+                return 0;
         }
 
-        return NULL;
+        ret = prelude_hash_set(join->registry, key, table);
+        if ( ret < 0 )
+                free(key);
+
+        return ret;
+}
+
+
+
+/*
+ * Look up the table already joined for @path. Returns 1 if it was found,
+ * 0 if it was not, or a negative value if the lookup key could not be built.
+ */
+int classic_sql_join_lookup_table(const classic_sql_join_t *join, const idmef_path_t *path,
+                                  classic_sql_joined_table_t **table)
+{
+        int ret;
+        char *key;
+        unsigned int depth;
+        prelude_bool_t full;
+
+        depth = idmef_path_get_depth(path);
+        full = ((ret = idmef_path_get_index(path, depth - 1)) > -1 ||
+                prelude_error_get_code(ret) != PRELUDE_ERROR_IDMEF_PATH_INDEX_FORBIDDEN);
+
+        if ( ! full && idmef_path_get_value_type(path, -1) == IDMEF_VALUE_TYPE_TIME && idmef_path_get_class(path, depth - 2) != IDMEF_CLASS_ID_FILE )
+                full = TRUE;
+
+        ret = join_key(path, full, &key);
+        if ( ret < 0 )
+                return ret;
+
+        *table = prelude_hash_get(join->registry, key);
+        free(key);
+
+        return (*table) ? 1 : 0;
 }
 
 
@@ -217,33 +302,11 @@ static char resolve_parent_type(const idmef_path_t *path)
 
 
 
-static int add_index_constraint(classic_sql_joined_table_t *table, int parent_level, int index)
+static void add_index_constraint(classic_sql_joined_table_t *table, int parent_level, int index)
 {
-        int ret;
-        const char *operator;
-
-        if ( ! prelude_string_is_empty(table->index_constraints) ) {
-                ret = prelude_string_cat(table->index_constraints, " AND ");
-                if ( ret < 0 )
-                        return ret;
-        }
-
-        if ( index >= -1 )
-                operator = "=";
-        else {
-                /* index is PRELUDE_ERROR_IDMEF_PATH_INDEX_UNDEFINED */
-                index = -1;
-                operator = "!=";
-        }
-
-        if ( parent_level == -1 )
-                ret = prelude_string_sprintf(table->index_constraints, "%s._index %s %d",
-                                             table->aliased_table_name, operator, index);
-        else
-                ret = prelude_string_sprintf(table->index_constraints, "%s._parent%d_index %s %d",
-                                             table->aliased_table_name, parent_level, operator, index);
-
-        return ret;
+        table->indexes[table->index_count].parent_level = parent_level;
+        table->indexes[table->index_count].index = index;
+        table->index_count++;
 }
 
 
@@ -254,7 +317,6 @@ static int resolve_indexes(classic_sql_joined_table_t *table)
         unsigned int max_depth;
         unsigned int parent_level;
         int index, index1, index2;
-        int ret = 0;
 
         max_depth = idmef_path_get_depth(table->path);
         if ( max_depth < 2 )
@@ -267,10 +329,7 @@ static int resolve_indexes(classic_sql_joined_table_t *table)
                 if ( prelude_error_get_code(index) == PRELUDE_ERROR_IDMEF_PATH_INDEX_FORBIDDEN )
                         continue;
 
-                ret = add_index_constraint(table, parent_level, index);
-                if ( ret < 0 )
-                        return ret;
-
+                add_index_constraint(table, parent_level, index);
                 parent_level++;
         }
 
@@ -279,9 +338,9 @@ static int resolve_indexes(classic_sql_joined_table_t *table)
 
         if ( prelude_error_get_code(index = index1) != PRELUDE_ERROR_IDMEF_PATH_INDEX_FORBIDDEN ||
              prelude_error_get_code(index = index2) != PRELUDE_ERROR_IDMEF_PATH_INDEX_FORBIDDEN )
-                ret = add_index_constraint(table, -1, index);
+                add_index_constraint(table, -1, index);
 
-        return ret;
+        return 0;
 }
 
 
@@ -306,10 +365,13 @@ int classic_sql_join_new_table(classic_sql_join_t *join, classic_sql_joined_tabl
         if ( ! *table )
                 return prelude_error_from_errno(errno);
 
-        ret = prelude_string_new(&(*table)->index_constraints);
-        if ( ret < 0 ) {
+        /*
+         * At most one index constraint per path element.
+         */
+        (*table)->indexes = calloc(idmef_path_get_depth(path), sizeof(*(*table)->indexes));
+        if ( ! (*table)->indexes ) {
                 free(*table);
-                return ret;
+                return prelude_error_from_errno(errno);
         }
 
         (*table)->path = path;
@@ -320,15 +382,23 @@ int classic_sql_join_new_table(classic_sql_join_t *join, classic_sql_joined_tabl
 
         ret = resolve_indexes(*table);
         if ( ret < 0 ) {
-                prelude_string_destroy((*table)->index_constraints);
+                free((*table)->indexes);
                 free((*table)->table_name);
                 free(*table);
                 return ret;
         }
 
+        ret = join_register(join, *table, TRUE);
+        if ( ret >= 0 )
+                ret = join_register(join, *table, FALSE);
+
+        /*
+         * The table is listed even on failure, so that it is released
+         * along with the join.
+         */
         prelude_list_add_tail(&join->tables, &(*table)->list);
 
-        return 0;
+        return ret;
 }
 
 
@@ -340,31 +410,65 @@ const char *classic_sql_joined_table_get_name(classic_sql_joined_table_t *table)
 
 
 
-static int classic_joined_table_to_string(classic_sql_joined_table_t *table, prelude_string_t *output)
+/*
+ * Append the parent type and index constraints selecting the rows of @table,
+ * each one preceded with " AND ". Columns are qualified with @qualifier,
+ * unless it is NULL.
+ */
+int classic_sql_joined_table_constraints_to_string(classic_sql_joined_table_t *table, const char *qualifier,
+                                                   prelude_string_t *output)
 {
-        int ret;
+        int ret, index;
+        unsigned int i;
+        const char *operator, *dot = qualifier ? "." : "";
 
-        ret = prelude_string_sprintf(output, " LEFT JOIN %s AS %s ON (", table->table_name, table->aliased_table_name);
-        if ( ret < 0 )
-                return ret;
+        if ( ! qualifier )
+                qualifier = "";
 
         if ( table->parent_type ) {
-                ret = prelude_string_sprintf(output, "%s._parent_type='%c' AND ",
-                                             table->aliased_table_name, table->parent_type);
+                ret = prelude_string_sprintf(output, " AND %s%s_parent_type='%c'", qualifier, dot, table->parent_type);
                 if ( ret < 0 )
                         return ret;
         }
 
-        ret = prelude_string_sprintf(output, "%s._message_ident=top_table._ident", table->aliased_table_name);
-        if ( ret < 0 )
-                return ret;
+        for ( i = 0; i < table->index_count; i++ ) {
+                index = table->indexes[i].index;
 
-        if ( ! prelude_string_is_empty(table->index_constraints) ) {
-                ret = prelude_string_sprintf(output, " AND %s", prelude_string_get_string(table->index_constraints));
+                if ( index >= -1 )
+                        operator = "=";
+                else {
+                        /* index is PRELUDE_ERROR_IDMEF_PATH_INDEX_UNDEFINED */
+                        index = -1;
+                        operator = "!=";
+                }
+
+                if ( table->indexes[i].parent_level == -1 )
+                        ret = prelude_string_sprintf(output, " AND %s%s_index %s %d", qualifier, dot, operator, index);
+                else
+                        ret = prelude_string_sprintf(output, " AND %s%s_parent%d_index %s %d", qualifier, dot,
+                                                     table->indexes[i].parent_level, operator, index);
                 if ( ret < 0 )
                         return ret;
         }
 
+        return 0;
+}
+
+
+
+static int classic_joined_table_to_string(classic_sql_joined_table_t *table, prelude_string_t *output)
+{
+        int ret;
+
+        ret = prelude_string_sprintf(output, " LEFT JOIN %s AS %s ON (%s._message_ident=top_table._ident",
+                                     table->table_name, table->aliased_table_name, table->aliased_table_name);
+        if ( ret < 0 )
+                return ret;
+
+        ret = classic_sql_joined_table_constraints_to_string(table, table->aliased_table_name, output);
+        if ( ret < 0 )
+                return ret;
+
         return prelude_string_cat(output, ")");
 }
 
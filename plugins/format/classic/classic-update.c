@@ -0,0 +1,529 @@
+/*****
+*
+* Copyright (C) 2020 CS GROUP - France. All Rights Reserved.
+*
+* This file is part of the PreludeDB library.
+*
+* This program is free software; you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation; either version 2, or (at your option)
+* any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License along
+* with this program; if not, write to the Free Software Foundation, Inc.,
+* 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+*
+*****/
+
+#include "config.h"
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <sys/types.h>
+
+#include <libprelude/prelude.h>
+#include <libprelude/idmef.h>
+
+#include "preludedb-error.h"
+#include "preludedb-path-selection.h"
+#include "preludedb-sql-settings.h"
+#include "preludedb-sql.h"
+#include "preludedb.h"
+
+#include "classic-sql-join.h"
+#include "classic-path-resolve.h"
+#include "classic-delete.h"
+#include "classic-rollup.h"
+#include "classic-update.h"
+
+
+/*
+ * A path never spans more than the time, GMT offset and microseconds
+ * columns.
+ */
+#define UPDATE_COLUMN_MAX 3
+
+
+typedef struct {
+        prelude_string_t *data;
+        char values[UPDATE_COLUMN_MAX][PRELUDEDB_SQL_TIMESTAMP_STRING_SIZE];
+} update_value_t;
+
+
+
+static void set_param(preludedb_sql_param_t *param, const char *value, size_t len, preludedb_sql_param_type_t type)
+{
+        param->value = value;
+        param->len = len;
+        param->type = type;
+}
+
+
+
+static int set_time_params(preludedb_sql_t *sql, update_value_t *uv, preludedb_sql_param_t *params,
+                           unsigned int count, const idmef_time_t *time)
+{
+        int ret;
+        size_t len;
+        unsigned int i;
+        char *value = uv->values[0];
+
+        ret = preludedb_sql_time_to_timestamp(sql, time, uv->values[0], sizeof(uv->values[0]),
+                                              uv->values[1], sizeof(uv->values[1]),
+                                              (count > 2) ? uv->values[2] : NULL, sizeof(uv->values[2]));
+        if ( ret < 0 )
+                return ret;
+
+        /*
+         * The timestamp is built as a SQL literal, its quotes are stripped.
+         */
+        len = strlen(value);
+        if ( len >= 2 && value[0] == '\'' && value[len - 1] == '\'' ) {
+                value[len - 1] = 0;
+                set_param(&params[0], value + 1, len - 2, PRELUDEDB_SQL_PARAM_TYPE_TEXT);
+        } else
+                set_param(&params[0], value, len, PRELUDEDB_SQL_PARAM_TYPE_TEXT);
+
+        for ( i = 1; i < count; i++ )
+                set_param(&params[i], uv->values[i], strlen(uv->values[i]), PRELUDEDB_SQL_PARAM_TYPE_TEXT);
+
+        return 0;
+}
+
+
+
+static int set_data_param(update_value_t *uv, preludedb_sql_param_t *param, idmef_data_t *data)
+{
+        int ret;
+
+        switch ( idmef_data_get_type(data) ) {
+        case IDMEF_DATA_TYPE_BYTE_STRING:
+                set_param(param, idmef_data_get_data(data), idmef_data_get_len(data), PRELUDEDB_SQL_PARAM_TYPE_BINARY);
+                return 0;
+
+        case IDMEF_DATA_TYPE_CHAR_STRING:
+                set_param(param, idmef_data_get_data(data), idmef_data_get_len(data) - 1, PRELUDEDB_SQL_PARAM_TYPE_BINARY);
+                return 0;
+
+        case IDMEF_DATA_TYPE_CHAR:
+                set_param(param, idmef_data_get_data(data), 1, PRELUDEDB_SQL_PARAM_TYPE_BINARY);
+                return 0;
+
+        default:
+                ret = idmef_data_to_string(data, uv->data);
+                if ( ret < 0 )
+                        return ret;
+
+                set_param(param, prelude_string_get_string(uv->data), prelude_string_get_len(uv->data),
+                          PRELUDEDB_SQL_PARAM_TYPE_BINARY);
+                return 0;
+        }
+}
+
+
+
+/*
+ * Fill the @count parameters of the columns @value is stored in. Values
+ * are converted the same way they are when inserted.
+ */
+static int set_value_params(preludedb_sql_t *sql, update_value_t *uv, preludedb_sql_param_t *params,
+                            unsigned int count, const idmef_value_t *value)
+{
+        int ret;
+        unsigned int i;
+
+        prelude_string_clear(uv->data);
+
+        if ( ! value ) {
+                for ( i = 0; i < count; i++ )
+                        set_param(&params[i], NULL, 0, PRELUDEDB_SQL_PARAM_TYPE_TEXT);
+
+                return 0;
+        }
+
+        if ( idmef_value_get_type(value) == IDMEF_VALUE_TYPE_TIME )
+                return set_time_params(sql, uv, params, count, idmef_value_get_time(value));
+
+        if ( count != 1 )
+                return preludedb_error_verbose(PRELUDEDB_ERROR_QUERY, "value does not match the updated path type");
+
+        if ( idmef_value_get_type(value) == IDMEF_VALUE_TYPE_DATA )
+                return set_data_param(uv, &params[0], idmef_value_get_data(value));
+
+        ret = idmef_value_to_string(value, uv->data);
+        if ( ret < 0 )
+                return ret;
+
+        set_param(&params[0], prelude_string_get_string(uv->data), prelude_string_get_len(uv->data), PRELUDEDB_SQL_PARAM_TYPE_TEXT);
+
+        return 0;
+}
+
+
+
+static int update_path(preludedb_sql_t *sql, update_value_t *uv, const idmef_path_t *path,
+                       const idmef_value_t *value, const char *idents)
+{
+        int ret, count;
+        prelude_string_t *query;
+        preludedb_sql_param_t params[UPDATE_COLUMN_MAX];
+
+        ret = prelude_string_new(&query);
+        if ( ret < 0 )
+                return ret;
+
+        ret = count = classic_path_resolve_update(path, idents, query);
+        if ( ret < 0 )
+                goto error;
+
+        ret = set_value_params(sql, uv, params, count, value);
+        if ( ret < 0 )
+                goto error;
+
+        ret = preludedb_sql_query_params(sql, prelude_string_get_string(query), params, count, NULL);
+
+ error:
+        prelude_string_destroy(query);
+        return ret;
+}
+
+
+
+/*
+ * Count the messages selected by @idents, and those of them having the
+ * rows of every updated path. Child rows are only updated where they
+ * exist, the other messages are skipped.
+ */
+static int count_updated_messages(preludedb_sql_t *sql, const idmef_path_t * const *paths, size_t pvsize,
+                                  const char *idents, uint64_t *selected, uint64_t *updated)
+{
+        size_t i;
+        int ret, count = 0;
+        prelude_string_t *query, *conditions;
+        preludedb_sql_table_t *table;
+        preludedb_sql_row_t *row;
+        preludedb_sql_field_t *field;
+
+        ret = prelude_string_new(&query);
+        if ( ret < 0 )
+                return ret;
+
+        ret = prelude_string_new(&conditions);
+        if ( ret < 0 ) {
+                prelude_string_destroy(query);
+                return ret;
+        }
+
+        for ( i = 0; i < pvsize; i++ ) {
+                prelude_string_clear(query);
+
+                ret = classic_path_resolve_update_condition(paths[i], query);
+                if ( ret <= 0 ) {
+                        if ( ret < 0 )
+                                goto error;
+
+                        continue;
+                }
+
+                ret = prelude_string_sprintf(conditions, "%s%s", count++ ? " AND " : "", prelude_string_get_string(query));
+                if ( ret < 0 )
+                        goto error;
+        }
+
+        prelude_string_clear(query);
+
+        ret = prelude_string_sprintf(query, "SELECT COUNT(*), %s%s%s FROM %s AS top_table WHERE top_table._ident %s",
+                                     count ? "COUNT(CASE WHEN " : "COUNT(*)",
+                                     count ? prelude_string_get_string(conditions) : "",
+                                     count ? " THEN 1 END)" : "",
+                                     (idmef_path_get_class(paths[0], 0) == IDMEF_CLASS_ID_ALERT) ? "Prelude_Alert" : "Prelude_Heartbeat",
+                                     idents);
+        if ( ret < 0 )
+                goto error;
+
+        ret = preludedb_sql_query(sql, prelude_string_get_string(query), &table);
+        if ( ret <= 0 ) {
+                if ( ret == 0 )
+                        ret = preludedb_error(PRELUDEDB_ERROR_GENERIC);
+                goto error;
+        }
+
+        ret = preludedb_sql_table_get_row(table, 0, &row);
+        if ( ret > 0 )
+                ret = preludedb_sql_row_get_field(row, 0, &field);
+
+        if ( ret > 0 )
+                ret = preludedb_sql_field_to_uint64(field, selected);
+
+        if ( ret >= 0 )
+                ret = preludedb_sql_row_get_field(row, 1, &field);
+
+        if ( ret > 0 )
+                ret = preludedb_sql_field_to_uint64(field, updated);
+        else if ( ret == 0 )
+                ret = preludedb_error(PRELUDEDB_ERROR_GENERIC);
+
+        preludedb_sql_table_destroy(table);
+
+ error:
+        prelude_string_destroy(query);
+        prelude_string_destroy(conditions);
+
+        return ret;
+}
+
+
+
+/*
+ * Run the @query selecting the idents of the messages to update, and build
+ * the list of the idents it returns. Returns the number of idents.
+ */
+static ssize_t select_idents(preludedb_sql_t *sql, const char *query, const preludedb_sql_param_t *params,
+                             unsigned int nparams, prelude_string_t **out)
+{
+        int ret;
+        uint64_t ident;
+        ssize_t count = 0;
+        preludedb_sql_table_t *table;
+        preludedb_sql_row_t *row;
+        preludedb_sql_field_t *field;
+
+        *out = NULL;
+
+        ret = preludedb_sql_query_params(sql, query, params, nparams, &table);
+        if ( ret <= 0 )
+                return ret;
+
+        ret = prelude_string_new(out);
+        if ( ret < 0 )
+                goto error;
+
+        ret = prelude_string_cat(*out, "IN (");
+        if ( ret < 0 )
+                goto error;
+
+        while ( (ret = preludedb_sql_table_fetch_row(table, &row)) > 0 ) {
+                ret = preludedb_sql_row_get_field(row, 0, &field);
+                if ( ret <= 0 )
+                        break;
+
+                ret = preludedb_sql_field_to_uint64(field, &ident);
+                if ( ret < 0 )
+                        break;
+
+                ret = prelude_string_sprintf(*out, "%s%" PRELUDE_PRIu64, count++ ? ", " : "", ident);
+                if ( ret < 0 )
+                        break;
+        }
+
+        if ( ret >= 0 && count > 0 )
+                ret = prelude_string_cat(*out, ")");
+
+ error:
+        preludedb_sql_table_destroy(table);
+
+        if ( ret < 0 || count == 0 ) {
+                if ( *out )
+                        prelude_string_destroy(*out);
+
+                *out = NULL;
+                return (ret < 0) ? ret : 0;
+        }
+
+        return count;
+}
+
+
+
+/*
+ * Alerts whose rollups might change are removed from them before the
+ * update, and added back afterward.
+ */
+static int update_messages(preludedb_t *db, const idmef_path_t * const *paths, const idmef_value_t * const *values,
+                           size_t pvsize, const char *idents, uint64_t *selected, uint64_t *updated)
+{
+        size_t i;
+        int ret;
+        update_value_t uv;
+        prelude_bool_t rolled_up;
+        preludedb_sql_t *sql = preludedb_get_sql(db);
+        classic_rollup_t *rollup = preludedb_get_data(db);
+
+        ret = prelude_string_new(&uv.data);
+        if ( ret < 0 )
+                return ret;
+
+        ret = count_updated_messages(sql, paths, pvsize, idents, selected, updated);
+
+        rolled_up = classic_rollup_has_paths(rollup, paths, pvsize);
+        if ( ret >= 0 && rolled_up )
+                ret = classic_rollup_remove_alerts(rollup, sql, idents);
+
+        for ( i = 0; ret >= 0 && i < pvsize; i++ )
+                ret = update_path(sql, &uv, paths[i], values[i], idents);
+
+        if ( ret >= 0 && rolled_up )
+                ret = classic_rollup_add_alerts(rollup, sql, idents);
+
+        prelude_string_destroy(uv.data);
+
+        return ret;
+}
+
+
+
+static int check_paths(const idmef_path_t * const *paths, size_t pvsize)
+{
+        size_t i;
+
+        for ( i = 1; i < pvsize; i++ ) {
+                if ( idmef_path_get_class(paths[i], 0) != idmef_path_get_class(paths[0], 0) )
+                        return preludedb_error_verbose(PRELUDEDB_ERROR_QUERY, "updated paths must belong to the same message type");
+        }
+
+        return 0;
+}
+
+
+
+/*
+ * End the transaction of an update, depending on @ret. Returns the number
+ * of updated messages.
+ */
+static int end_update(preludedb_sql_t *sql, int ret, uint64_t selected, uint64_t updated)
+{
+        int tmp;
+
+        if ( ret < 0 ) {
+                tmp = preludedb_sql_transaction_abort(sql);
+                return (tmp < 0) ? tmp : ret;
+        }
+
+        ret = preludedb_sql_transaction_end(sql);
+        if ( ret < 0 )
+                return ret;
+
+        if ( selected > updated )
+                prelude_log(PRELUDE_LOG_WARN, "%" PRELUDE_PRIu64 " of %" PRELUDE_PRIu64 " messages lack a row of the updated paths and were not updated.\n",
+                            selected - updated, selected);
+
+        return (int) updated;
+}
+
+
+
+/*
+ * Update @paths in the messages whose ident match @idents, a list of
+ * idents, within a single transaction: one statement is run per path,
+ * whatever the number of messages.
+ *
+ * Returns the number of updated messages. Messages lacking the row of an
+ * updated path, such as an alert without impact, are skipped.
+ */
+int classic_update_messages(preludedb_t *db, const idmef_path_t * const *paths, const idmef_value_t * const *values,
+                            size_t pvsize, const char *idents)
+{
+        int ret;
+        uint64_t selected = 0, updated = 0;
+        preludedb_sql_t *sql = preludedb_get_sql(db);
+
+        ret = check_paths(paths, pvsize);
+        if ( ret < 0 )
+                return ret;
+
+        ret = preludedb_sql_transaction_start(sql);
+        if ( ret < 0 )
+                return ret;
+
+        ret = update_messages(db, paths, values, pvsize, idents, &selected, &updated);
+
+        return end_update(sql, ret, selected, updated);
+}
+
+
+
+/*
+ * Same as classic_update_messages(), for the messages whose idents are
+ * returned by @query. The idents are selected once, within the transaction,
+ * so that the count and every statement work on the same messages, even
+ * when the criteria involve an updated path or the selection is limited.
+ */
+int classic_update_selected_messages(preludedb_t *db, const idmef_path_t * const *paths, const idmef_value_t * const *values,
+                                     size_t pvsize, const char *query, const preludedb_sql_param_t *params, unsigned int nparams)
+{
+        int ret;
+        ssize_t count;
+        prelude_string_t *idents = NULL;
+        uint64_t selected = 0, updated = 0;
+        preludedb_sql_t *sql = preludedb_get_sql(db);
+
+        ret = check_paths(paths, pvsize);
+        if ( ret < 0 )
+                return ret;
+
+        ret = preludedb_sql_transaction_start(sql);
+        if ( ret < 0 )
+                return ret;
+
+        count = select_idents(sql, query, params, nparams, &idents);
+        if ( count > 0 )
+                ret = update_messages(db, paths, values, pvsize, prelude_string_get_string(idents), &selected, &updated);
+        else
+                ret = count;
+
+        if ( idents )
+                prelude_string_destroy(idents);
+
+        return end_update(sql, ret, selected, updated);
+}
+
+
+
+int classic_update_from_list(preludedb_t *db, const idmef_path_t * const *paths, const idmef_value_t * const *values,
+                             size_t pvsize, uint64_t *idents, size_t size)
+{
+        int ret;
+        ssize_t count;
+        prelude_string_t *buf;
+
+        if ( size == 0 || pvsize == 0 )
+                return 0;
+
+        count = classic_get_string_from_ident_list(&buf, idents, size);
+        if ( count < 0 )
+                return count;
+
+        ret = classic_update_messages(db, paths, values, pvsize, prelude_string_get_string(buf));
+        prelude_string_destroy(buf);
+
+        return ret;
+}
+
+
+
+int classic_update_from_result_idents(preludedb_t *db, const idmef_path_t * const *paths, const idmef_value_t * const *values,
+                                      size_t pvsize, preludedb_result_idents_t *results)
+{
+        int ret;
+        ssize_t count;
+        prelude_string_t *buf;
+
+        if ( pvsize == 0 )
+                return 0;
+
+        count = classic_get_string_from_result_ident(&buf, results);
+        if ( count <= 0 )
+                return count;
+
+        ret = classic_update_messages(db, paths, values, pvsize, prelude_string_get_string(buf));
+        prelude_string_destroy(buf);
+
+        return ret;
+}
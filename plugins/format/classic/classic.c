@@ -25,6 +25,9 @@
 
 #include <stdio.h>
 #include <stdlib.h>
+#include <errno.h>
+#include <ctype.h>
+#include <limits.h>
 #include <sys/types.h>
 #include <string.h>
 #include <unistd.h>
@@ -41,8 +44,10 @@
 #include "classic-insert.h"
 #include "classic-get.h"
 #include "classic-delete.h"
+#include "classic-update.h"
 #include "classic-sql-join.h"
 #include "classic-path-resolve.h"
+#include "classic-rollup.h"
 
 
 #define CLASSIC_SCHEMA_VERSION "14.8"
@@ -75,10 +80,7 @@ int classic_unescape_binary_safe(preludedb_sql_t *sql, preludedb_sql_field_t *fi
         size_t size;
         unsigned char *value;
 
-        ret = preludedb_sql_unescape_binary(sql,
-                                            preludedb_sql_field_get_value(field),
-                                            preludedb_sql_field_get_len(field),
-                                            (unsigned char **) &value, &size);
+        ret = preludedb_sql_field_to_binary(sql, field, &value, &size);
         if ( ret < 0 )
                 return ret;
 
@@ -109,6 +111,174 @@ int classic_unescape_binary_safe(preludedb_sql_t *sql, preludedb_sql_field_t *fi
 }
 
 
+/*
+ * Query plans are cached by the SQL layer, under a key describing the shape
+ * of the request: the selected paths, the paths and operators of the
+ * criteria, and the values written within the query. Fixed criteria values
+ * are collected as parameters along the way, bound to the placeholders of
+ * the plan. Values written within the query are length prefixed so that
+ * distinct requests can not share a key.
+ */
+static int plan_key_add_criteria(preludedb_sql_t *sql, idmef_criteria_t *criteria,
+                                 prelude_string_t *key, preludedb_sql_params_t *params)
+{
+        int ret;
+        prelude_string_t *str;
+        idmef_criteria_t *left;
+        idmef_criterion_value_t *value;
+
+        if ( idmef_criteria_is_criterion(criteria) ) {
+                value = idmef_criteria_get_value(criteria);
+
+                ret = prelude_string_sprintf(key, "[%s %d", idmef_path_get_name(idmef_criteria_get_path(criteria), -1),
+                                             idmef_criteria_get_operator(criteria));
+                if ( ret < 0 )
+                        return ret;
+
+                ret = preludedb_sql_params_add_criterion(params, sql, idmef_criteria_get_operator(criteria), value);
+                if ( ret < 0 )
+                        return ret;
+
+                if ( ret == 0 && value ) {
+                        ret = prelude_string_new(&str);
+                        if ( ret < 0 )
+                                return ret;
+
+                        ret = idmef_criterion_value_to_string(value, str);
+                        if ( ret >= 0 )
+                                ret = prelude_string_sprintf(key, " %" PRELUDE_PRIu64 ":%s",
+                                                             (uint64_t) prelude_string_get_len(str), prelude_string_get_string(str));
+
+                        prelude_string_destroy(str);
+                        if ( ret < 0 )
+                                return ret;
+                }
+
+                return prelude_string_cat(key, "]");
+        }
+
+        ret = prelude_string_sprintf(key, "(%d", idmef_criteria_get_operator(criteria));
+        if ( ret < 0 )
+                return ret;
+
+        left = idmef_criteria_get_left(criteria);
+        if ( left ) {
+                ret = plan_key_add_criteria(sql, left, key, params);
+                if ( ret < 0 )
+                        return ret;
+        }
+
+        ret = plan_key_add_criteria(sql, idmef_criteria_get_right(criteria), key, params);
+        if ( ret < 0 )
+                return ret;
+
+        return prelude_string_cat(key, ")");
+}
+
+
+
+static int plan_key_add_object(prelude_string_t *key, preludedb_selected_object_t *object)
+{
+        int ret;
+        size_t i;
+        const void *data = preludedb_selected_object_get_data(object);
+        preludedb_selected_object_t *arg;
+
+        ret = prelude_string_sprintf(key, "(%d", preludedb_selected_object_get_type(object));
+        if ( ret < 0 )
+                return ret;
+
+        switch ( preludedb_selected_object_get_type(object) ) {
+        case PRELUDEDB_SELECTED_OBJECT_TYPE_IDMEFPATH:
+                ret = prelude_string_sprintf(key, " %s", idmef_path_get_name(data, -1));
+                break;
+
+        case PRELUDEDB_SELECTED_OBJECT_TYPE_STRING:
+                ret = prelude_string_sprintf(key, " %" PRELUDE_PRIu64 ":%s", (uint64_t) strlen(data), (const char *) data);
+                break;
+
+        case PRELUDEDB_SELECTED_OBJECT_TYPE_INT:
+                ret = prelude_string_sprintf(key, " %d", *(const int *) data);
+                break;
+
+        default:
+                for ( i = 0; (arg = preludedb_selected_object_get_arg(object, i)); i++ ) {
+                        ret = plan_key_add_object(key, arg);
+                        if ( ret < 0 )
+                                return ret;
+                }
+        }
+
+        if ( ret < 0 )
+                return ret;
+
+        return prelude_string_cat(key, ")");
+}
+
+
+
+static int plan_key_add_selection(prelude_string_t *key, const preludedb_path_selection_t *selection)
+{
+        int ret;
+        preludedb_selected_path_t *selected = NULL;
+
+        while ( (selected = preludedb_path_selection_get_next(selection, selected)) ) {
+                ret = prelude_string_sprintf(key, "{%d %d", preludedb_selected_path_get_flags(selected),
+                                             preludedb_selected_path_get_time_constraint(selected));
+                if ( ret < 0 )
+                        return ret;
+
+                ret = plan_key_add_object(key, preludedb_selected_path_get_object(selected));
+                if ( ret < 0 )
+                        return ret;
+
+                ret = prelude_string_cat(key, "}");
+                if ( ret < 0 )
+                        return ret;
+        }
+
+        return 0;
+}
+
+
+
+/*
+ * Run @plan, completed with the @limit and @offset clause, with the
+ * parameters collected while building its key.
+ */
+static int run_plan(preludedb_t *db, const char *plan, preludedb_sql_params_t *params,
+                    int limit, int offset, preludedb_sql_table_t **table)
+{
+        int ret;
+        prelude_string_t *query;
+        preludedb_sql_t *sql = preludedb_get_sql(db);
+
+        ret = prelude_string_new(&query);
+        if ( ret < 0 )
+                return ret;
+
+        ret = prelude_string_cat(query, plan);
+        if ( ret < 0 )
+                goto error;
+
+        ret = preludedb_sql_build_limit_offset_string(sql, limit, offset, query);
+        if ( ret < 0 )
+                goto error;
+
+        if ( preludedb_get_result_streaming(db) )
+                ret = preludedb_sql_query_stream_params(sql, prelude_string_get_string(query),
+                                                        preludedb_sql_params_get(params), preludedb_sql_params_get_count(params), table);
+        else
+                ret = preludedb_sql_query_params(sql, prelude_string_get_string(query),
+                                                 preludedb_sql_params_get(params), preludedb_sql_params_get_count(params), table);
+
+ error:
+        prelude_string_destroy(query);
+        return ret;
+}
+
+
+
 static int get_message_idents_set_order(idmef_class_id_t message_type, const preludedb_path_selection_t *order,
                                         classic_sql_join_t *join, preludedb_sql_select_t *select)
 {
@@ -126,17 +296,806 @@ static int get_message_idents_set_order(idmef_class_id_t message_type, const pre
 
 
 
-static int get_message_idents(preludedb_t *db, idmef_class_id_t message_type,
-                              idmef_criteria_t *criteria, int limit, int offset,
-                              const preludedb_path_selection_t *order,
-                              preludedb_sql_table_t **table)
+static int build_message_idents_plan(preludedb_t *db, idmef_class_id_t message_type,
+                                     idmef_criteria_t *criteria, const preludedb_path_selection_t *order,
+                                     char **plan)
+{
+        prelude_string_t *query;
+        prelude_string_t *where = NULL;
+        classic_sql_join_t *join;
+        preludedb_sql_t *sql = preludedb_get_sql(db);
+        preludedb_sql_select_t *select;
+        int ret;
+
+        ret = prelude_string_new(&query);
+        if ( ret < 0 )
+                return ret;
+
+        ret = classic_sql_join_new(&join);
+        if ( ret < 0 ) {
+                prelude_string_destroy(query);
+                return ret;
+        }
+
+        ret = preludedb_sql_select_new(db, &select);
+        if ( ret < 0 ) {
+                prelude_string_destroy(query);
+                classic_sql_join_destroy(join);
+                return ret;
+        }
+
+        classic_sql_join_set_top_class(join, message_type);
+
+        ret = preludedb_sql_select_add_field(select, "DISTINCT(top_table._ident) AS _ident");
+        if ( ret < 0 )
+                goto error;
+
+        if ( order ) {
+                ret = get_message_idents_set_order(message_type, order, join, select);
+                if ( ret < 0 )
+                        goto error;
+        }
+
+        if ( criteria ) {
+                ret = prelude_string_new(&where);
+                if ( ret < 0 )
+                        goto error;
+
+                ret = classic_path_resolve_criteria_template(sql, criteria, join, where);
+                if ( ret < 0 )
+                        goto error;
+        }
+
+        ret = prelude_string_sprintf(query, "SELECT ");
+        if ( ret < 0 )
+                goto error;
+
+        ret = preludedb_sql_select_fields_to_string(select, query);
+        if ( ret < 0 )
+                goto error;
+
+
+        ret = prelude_string_cat(query, " FROM ");
+        if ( ret < 0 )
+                goto error;
+
+        ret = classic_sql_join_to_string(join, query);
+        if ( ret < 0 )
+                goto error;
+
+        if ( where ) {
+                ret = prelude_string_cat(query, " WHERE ");
+                if ( ret < 0 )
+                        goto error;
+
+                ret = prelude_string_cat(query, prelude_string_get_string(where));
+                if ( ret < 0 )
+                        goto error;
+        }
+
+        ret = preludedb_sql_select_modifiers_to_string(select, query);
+        if ( ret < 0 )
+                goto error;
+
+        ret = prelude_string_get_string_released(query, plan);
+
+ error:
+        prelude_string_destroy(query);
+        if ( where )
+                prelude_string_destroy(where);
+        classic_sql_join_destroy(join);
+        preludedb_sql_select_destroy(select);
+
+        return ret;
+}
+
+
+
+/*
+ * Retrieve the plan selecting the idents of the @message_type messages
+ * matching @criteria, building it on a cache miss. Its parameters are
+ * collected into @params.
+ */
+static int get_message_idents_plan(preludedb_t *db, idmef_class_id_t message_type,
+                                   idmef_criteria_t *criteria, const preludedb_path_selection_t *order,
+                                   preludedb_sql_params_t *params, char **plan)
+{
+        int ret;
+        prelude_string_t *key;
+        preludedb_sql_t *sql = preludedb_get_sql(db);
+
+        *plan = NULL;
+
+        ret = prelude_string_new(&key);
+        if ( ret < 0 )
+                return ret;
+
+        ret = prelude_string_sprintf(key, "idents %d ", message_type);
+        if ( ret < 0 )
+                goto error;
+
+        if ( order ) {
+                ret = plan_key_add_selection(key, order);
+                if ( ret < 0 )
+                        goto error;
+        }
+
+        if ( criteria ) {
+                ret = plan_key_add_criteria(sql, criteria, key, params);
+                if ( ret < 0 )
+                        goto error;
+        }
+
+        ret = preludedb_sql_plan_cache_get(sql, prelude_string_get_string(key), plan);
+        if ( ret == 0 ) {
+                ret = build_message_idents_plan(db, message_type, criteria, order, plan);
+                if ( ret >= 0 )
+                        ret = preludedb_sql_plan_cache_set(sql, prelude_string_get_string(key), *plan);
+        }
+
+ error:
+        prelude_string_destroy(key);
+        return ret;
+}
+
+
+
+static int get_message_idents(preludedb_t *db, idmef_class_id_t message_type,
+                              idmef_criteria_t *criteria, int limit, int offset,
+                              const preludedb_path_selection_t *order,
+                              preludedb_sql_table_t **table)
+{
+        int ret;
+        char *plan;
+        preludedb_sql_params_t *params;
+
+        ret = preludedb_sql_params_new(&params);
+        if ( ret < 0 )
+                return ret;
+
+        ret = get_message_idents_plan(db, message_type, criteria, order, params, &plan);
+        if ( ret >= 0 )
+                ret = run_plan(db, plan, params, limit, offset, table);
+
+        if ( plan )
+                free(plan);
+
+        preludedb_sql_params_destroy(params);
+
+        return ret;
+}
+
+
+
+static int classic_get_alert_idents(preludedb_t *db, idmef_criteria_t *criteria,
+                                    int limit, int offset, const preludedb_path_selection_t *order,
+                                    void **res)
+{
+        return get_message_idents(db, IDMEF_CLASS_ID_ALERT, criteria, limit, offset, order,
+                                  (preludedb_sql_table_t **) res);
+}
+
+
+
+static int classic_get_heartbeat_idents(preludedb_t *db, idmef_criteria_t *criteria,
+                                        int limit, int offset, const preludedb_path_selection_t *order,
+                                        void **res)
+{
+        return get_message_idents(db, IDMEF_CLASS_ID_HEARTBEAT, criteria, limit, offset, order,
+                                  (preludedb_sql_table_t **) res);
+}
+
+
+
+/*
+ * Alert idents are paged through a continuation token made of the order,
+ * followed by the creation time and the ident of the last alert of the
+ * previous page, as in "d1577836800.1234".
+ */
+static int parse_idents_cursor(const char *cursor, preludedb_result_idents_order_t order,
+                               time_t *sec, uint64_t *ident)
+{
+        char *end;
+        char expected = (order == PRELUDEDB_RESULT_IDENTS_ORDER_BY_CREATE_TIME_DESC) ? 'd' : 'a';
+
+        if ( cursor[0] != expected || ! isdigit((unsigned char) cursor[1]) )
+                goto error;
+
+        errno = 0;
+
+        *sec = strtoll(cursor + 1, &end, 10);
+        if ( errno || *end != '.' || ! isdigit((unsigned char) end[1]) )
+                goto error;
+
+        *ident = strtoull(end + 1, &end, 10);
+        if ( errno || *end )
+                goto error;
+
+        return 0;
+
+ error:
+        return preludedb_error_verbose(PRELUDEDB_ERROR_INVALID_VALUE, "invalid alert idents cursor '%s'", cursor);
+}
+
+
+
+static int build_idents_cursor(preludedb_sql_row_t *row, preludedb_result_idents_order_t order, char **cursor)
+{
+        int ret;
+        uint64_t ident;
+        idmef_time_t *time;
+        preludedb_sql_field_t *field;
+        char buf[64];
+
+        ret = preludedb_sql_row_get_field(row, 0, &field);
+        if ( ret <= 0 )
+                return (ret < 0) ? ret : preludedb_error(PRELUDEDB_ERROR_GENERIC);
+
+        ret = preludedb_sql_field_to_uint64(field, &ident);
+        if ( ret < 0 )
+                return ret;
+
+        ret = preludedb_sql_row_get_field(row, 1, &field);
+        if ( ret <= 0 )
+                return (ret < 0) ? ret : preludedb_error(PRELUDEDB_ERROR_GENERIC);
+
+        ret = idmef_time_new(&time);
+        if ( ret < 0 )
+                return ret;
+
+        ret = preludedb_sql_field_to_time(field, time, 0, 0);
+        if ( ret < 0 ) {
+                idmef_time_destroy(time);
+                return ret;
+        }
+
+        snprintf(buf, sizeof(buf), "%c%" PRELUDE_PRId64 ".%" PRELUDE_PRIu64,
+                 (order == PRELUDEDB_RESULT_IDENTS_ORDER_BY_CREATE_TIME_DESC) ? 'd' : 'a',
+                 (int64_t) idmef_time_get_sec(time), ident);
+
+        idmef_time_destroy(time);
+
+        *cursor = strdup(buf);
+        if ( ! *cursor )
+                return preludedb_error_from_errno(errno);
+
+        return 0;
+}
+
+
+
+static int build_alert_idents_after_plan(preludedb_t *db, idmef_criteria_t *criteria,
+                                         preludedb_result_idents_order_t order, prelude_bool_t seek, char **plan)
+{
+        int ret;
+        idmef_path_t *path;
+        classic_sql_join_t *join;
+        prelude_string_t *query, *time_field, *where = NULL;
+        preludedb_sql_t *sql = preludedb_get_sql(db);
+        prelude_bool_t desc = (order == PRELUDEDB_RESULT_IDENTS_ORDER_BY_CREATE_TIME_DESC);
+
+        ret = idmef_path_new_fast(&path, "alert.create_time");
+        if ( ret < 0 )
+                return ret;
+
+        ret = prelude_string_new(&query);
+        if ( ret < 0 ) {
+                idmef_path_destroy(path);
+                return ret;
+        }
+
+        ret = prelude_string_new(&time_field);
+        if ( ret < 0 ) {
+                idmef_path_destroy(path);
+                prelude_string_destroy(query);
+                return ret;
+        }
+
+        ret = classic_sql_join_new(&join);
+        if ( ret < 0 ) {
+                idmef_path_destroy(path);
+                prelude_string_destroy(query);
+                prelude_string_destroy(time_field);
+                return ret;
+        }
+
+        classic_sql_join_set_top_class(join, IDMEF_CLASS_ID_ALERT);
+
+        ret = classic_path_resolve_column(path, join, time_field);
+        if ( ret < 0 )
+                goto error;
+
+        if ( criteria ) {
+                ret = prelude_string_new(&where);
+                if ( ret < 0 )
+                        goto error;
+
+                ret = classic_path_resolve_criteria_template(sql, criteria, join, where);
+                if ( ret < 0 )
+                        goto error;
+        }
+
+        ret = prelude_string_sprintf(query, "SELECT DISTINCT top_table._ident, %s FROM ", prelude_string_get_string(time_field));
+        if ( ret < 0 )
+                goto error;
+
+        ret = classic_sql_join_to_string(join, query);
+        if ( ret < 0 )
+                goto error;
+
+        if ( where || seek ) {
+                ret = prelude_string_cat(query, " WHERE ");
+                if ( ret < 0 )
+                        goto error;
+        }
+
+        if ( where ) {
+                ret = prelude_string_sprintf(query, "(%s)%s", prelude_string_get_string(where), seek ? " AND " : "");
+                if ( ret < 0 )
+                        goto error;
+        }
+
+        /*
+         * The parameters of this condition follow the ones of the criteria.
+         */
+        if ( seek ) {
+                ret = prelude_string_sprintf(query, "(%s %c ? OR (%s = ? AND top_table._ident %c ?))",
+                                             prelude_string_get_string(time_field), desc ? '<' : '>',
+                                             prelude_string_get_string(time_field), desc ? '<' : '>');
+                if ( ret < 0 )
+                        goto error;
+        }
+
+        ret = prelude_string_sprintf(query, " ORDER BY 2 %s, 1 %s", desc ? "DESC" : "ASC", desc ? "DESC" : "ASC");
+        if ( ret < 0 )
+                goto error;
+
+        ret = prelude_string_get_string_released(query, plan);
+
+ error:
+        idmef_path_destroy(path);
+        prelude_string_destroy(query);
+        prelude_string_destroy(time_field);
+        if ( where )
+                prelude_string_destroy(where);
+        classic_sql_join_destroy(join);
+
+        return ret;
+}
+
+
+
+static int add_idents_cursor_params(preludedb_sql_t *sql, preludedb_sql_params_t *params, time_t sec, uint64_t ident)
+{
+        int ret;
+        size_t len;
+        idmef_time_t *time;
+        char buf[PRELUDEDB_SQL_TIMESTAMP_STRING_SIZE], identbuf[32];
+
+        ret = idmef_time_new_from_time(&time, &sec);
+        if ( ret < 0 )
+                return ret;
+
+        ret = preludedb_sql_time_to_timestamp(sql, time, buf, sizeof(buf), NULL, 0, NULL, 0);
+        idmef_time_destroy(time);
+        if ( ret < 0 )
+                return ret;
+
+        /*
+         * Strip the quotes from the timestamp literal.
+         */
+        len = strlen(buf);
+        if ( len >= 2 && buf[0] == '\'' && buf[len - 1] == '\'' ) {
+                memmove(buf, buf + 1, len - 2);
+                buf[len - 2] = 0;
+        }
+
+        snprintf(identbuf, sizeof(identbuf), "%" PRELUDE_PRIu64, ident);
+
+        ret = preludedb_sql_params_add_string(params, buf);
+        if ( ret < 0 )
+                return ret;
+
+        ret = preludedb_sql_params_add_string(params, buf);
+        if ( ret < 0 )
+                return ret;
+
+        return preludedb_sql_params_add_string(params, identbuf);
+}
+
+
+
+/*
+ * Unlike LIMIT/OFFSET paging, which has the database produce and discard
+ * all the rows preceding the page, this seeks directly after the last row
+ * of the previous page, so that every page costs the same.
+ */
+static int classic_get_alert_idents_after(preludedb_t *db, idmef_criteria_t *criteria,
+                                          const char *cursor, int limit,
+                                          preludedb_result_idents_order_t order,
+                                          void **res, char **next_cursor)
+{
+        int ret;
+        time_t sec = 0;
+        uint64_t ident = 0;
+        char *plan = NULL;
+        unsigned int count = 0;
+        prelude_string_t *key, *query = NULL;
+        preludedb_sql_params_t *params;
+        preludedb_sql_table_t *table;
+        preludedb_sql_row_t *row, *last = NULL;
+        preludedb_sql_t *sql = preludedb_get_sql(db);
+
+        if ( cursor ) {
+                ret = parse_idents_cursor(cursor, order, &sec, &ident);
+                if ( ret < 0 )
+                        return ret;
+        }
+
+        ret = preludedb_sql_params_new(&params);
+        if ( ret < 0 )
+                return ret;
+
+        ret = prelude_string_new(&key);
+        if ( ret < 0 ) {
+                preludedb_sql_params_destroy(params);
+                return ret;
+        }
+
+        ret = prelude_string_sprintf(key, "idents_after %d %d ", order, cursor ? 1 : 0);
+        if ( ret < 0 )
+                goto error;
+
+        if ( criteria ) {
+                ret = plan_key_add_criteria(sql, criteria, key, params);
+                if ( ret < 0 )
+                        goto error;
+        }
+
+        ret = preludedb_sql_plan_cache_get(sql, prelude_string_get_string(key), &plan);
+        if ( ret == 0 ) {
+                ret = build_alert_idents_after_plan(db, criteria, order, cursor != NULL, &plan);
+                if ( ret >= 0 )
+                        ret = preludedb_sql_plan_cache_set(sql, prelude_string_get_string(key), plan);
+        }
+
+        if ( ret < 0 )
+                goto error;
+
+        if ( cursor ) {
+                ret = add_idents_cursor_params(sql, params, sec, ident);
+                if ( ret < 0 )
+                        goto error;
+        }
+
+        ret = prelude_string_new(&query);
+        if ( ret < 0 )
+                goto error;
+
+        ret = prelude_string_cat(query, plan);
+        if ( ret < 0 )
+                goto error;
+
+        ret = preludedb_sql_build_limit_offset_string(sql, limit, -1, query);
+        if ( ret < 0 )
+                goto error;
+
+        ret = preludedb_sql_query_params(sql, prelude_string_get_string(query),
+                                         preludedb_sql_params_get(params), preludedb_sql_params_get_count(params), &table);
+        if ( ret <= 0 )
+                goto error;
+
+        /*
+         * Fetching the rows in order keeps them available for later
+         * retrieval by index.
+         */
+        while ( (ret = preludedb_sql_table_get_row(table, count, &row)) > 0 ) {
+                last = row;
+                count++;
+        }
+
+        if ( ret == 0 && limit > 0 && count == (unsigned int) limit )
+                ret = build_idents_cursor(last, order, next_cursor);
+
+        if ( ret < 0 ) {
+                preludedb_sql_table_destroy(table);
+                goto error;
+        }
+
+        *res = table;
+        ret = count;
+
+ error:
+        if ( plan )
+                free(plan);
+
+        if ( query )
+                prelude_string_destroy(query);
+
+        prelude_string_destroy(key);
+        preludedb_sql_params_destroy(params);
+
+        return ret;
+}
+
+
+
+/*
+ * The count of a streamed result is unknown until all of it is fetched:
+ * the error is reported, and no ident counted.
+ */
+static size_t classic_get_message_ident_count(void *res)
+{
+        int ret;
+
+        ret = preludedb_sql_table_get_row_count(res);
+        if ( ret < 0 ) {
+                prelude_log(PRELUDE_LOG_ERR, "could not count idents: %s.\n", preludedb_strerror(ret));
+                return 0;
+        }
+
+        return ret;
+}
+
+
+
+static int classic_get_message_ident(void *res, unsigned int row_index, uint64_t *ident)
+{
+        preludedb_sql_row_t *row;
+        preludedb_sql_field_t *field;
+        int ret;
+
+        ret = preludedb_sql_table_get_row(res, row_index, &row);
+        if ( ret <= 0 )
+                return ret;
+
+        ret = preludedb_sql_row_get_field(row, 0, &field);
+        if ( ret <= 0 )
+                return ret;
+
+        ret = preludedb_sql_field_to_uint64(field, ident);
+
+        return (ret < 0) ? ret : 1;
+}
+
+
+static void classic_destroy_message_idents_resource(void *res)
+{
+        preludedb_sql_table_destroy(res);
+}
+
+
+
+/*
+ * The messages to update are selected through the idents plan, whose
+ * results are fixed before anything is updated.
+ */
+static int classic_update(preludedb_t *db, const idmef_path_t * const *paths, const idmef_value_t * const *values, size_t pvsize,
+                          idmef_criteria_t *criteria, preludedb_path_selection_t *order, int limit, int offset)
+{
+        int ret;
+        char *plan;
+        prelude_string_t *query;
+        preludedb_sql_params_t *params;
+
+        if ( pvsize == 0 )
+                return 0;
+
+        ret = prelude_string_new(&query);
+        if ( ret < 0 )
+                return ret;
+
+        ret = preludedb_sql_params_new(&params);
+        if ( ret < 0 ) {
+                prelude_string_destroy(query);
+                return ret;
+        }
+
+        ret = get_message_idents_plan(db, idmef_path_get_class(paths[0], 0), criteria, order, params, &plan);
+        if ( ret < 0 )
+                goto error;
+
+        ret = prelude_string_cat(query, plan);
+        if ( ret < 0 )
+                goto error;
+
+        ret = preludedb_sql_build_limit_offset_string(preludedb_get_sql(db), limit, offset, query);
+        if ( ret < 0 )
+                goto error;
+
+        ret = classic_update_selected_messages(db, paths, values, pvsize, prelude_string_get_string(query),
+                                               preludedb_sql_params_get(params), preludedb_sql_params_get_count(params));
+
+ error:
+        if ( plan )
+                free(plan);
+
+        prelude_string_destroy(query);
+        preludedb_sql_params_destroy(params);
+
+        return ret;
+}
+
+
+
+static int build_values_plan(preludedb_t *db, preludedb_path_selection_t *selection,
+                             idmef_criteria_t *criteria, int distinct, char **plan)
+{
+        prelude_string_t *where = NULL;
+        prelude_string_t *query;
+        classic_sql_join_t *join;
+        preludedb_sql_select_t *select;
+        int ret;
+
+        ret = classic_sql_join_new(&join);
+        if ( ret < 0 )
+                return ret;
+
+        ret = preludedb_sql_select_new(db, &select);
+        if ( ret < 0 ) {
+                classic_sql_join_destroy(join);
+                return ret;
+        }
+
+        ret = prelude_string_new(&query);
+        if ( ret < 0 ) {
+                classic_sql_join_destroy(join);
+                preludedb_sql_select_destroy(select);
+                return ret;
+        }
+
+        ret = preludedb_sql_select_add_selection(select, selection, join);
+        if ( ret < 0 )
+                goto error;
+
+        if ( criteria ) {
+                ret = prelude_string_new(&where);
+                if ( ret < 0 )
+                        goto error;
+
+                ret = classic_path_resolve_criteria_template(preludedb_get_sql(db), criteria, join, where);
+                if ( ret < 0 )
+                        goto error;
+        }
+
+        ret = prelude_string_cat(query, "SELECT ");
+        if ( ret < 0 )
+                goto error;
+
+        if ( distinct ) {
+                ret = prelude_string_cat(query, "DISTINCT ");
+                if ( ret < 0 )
+                        goto error;
+        }
+
+        ret = preludedb_sql_select_fields_to_string(select, query);
+        if ( ret < 0 )
+                goto error;
+
+        ret = prelude_string_cat(query, " FROM ");
+        if ( ret < 0 )
+                goto error;
+
+        ret = classic_sql_join_to_string(join, query);
+        if ( ret < 0 )
+                goto error;
+
+        if ( where ) {
+                ret = prelude_string_sprintf(query, " WHERE %s", prelude_string_get_string(where));
+                if ( ret < 0 )
+                        goto error;
+        }
+
+        ret = preludedb_sql_select_modifiers_to_string(select, query);
+        if ( ret < 0 )
+                goto error;
+
+        ret = prelude_string_get_string_released(query, plan);
+
+ error:
+        prelude_string_destroy(query);
+        if ( where )
+                prelude_string_destroy(where);
+        classic_sql_join_destroy(join);
+        preludedb_sql_select_destroy(select);
+
+        return ret;
+}
+
+
+
+static int classic_get_values(preludedb_t *db, preludedb_path_selection_t *selection,
+                              idmef_criteria_t *criteria, int distinct, int limit, int offset, void **res)
+{
+        int ret, rollup;
+        char *plan = NULL;
+        prelude_string_t *key;
+        preludedb_sql_params_t *params;
+        preludedb_sql_t *sql = preludedb_get_sql(db);
+
+        ret = prelude_string_new(&key);
+        if ( ret < 0 )
+                return ret;
+
+        ret = preludedb_sql_params_new(&params);
+        if ( ret < 0 ) {
+                prelude_string_destroy(key);
+                return ret;
+        }
+
+        /*
+         * Whether the rollups apply depends on the criteria values, which
+         * are not part of the key.
+         */
+        rollup = classic_rollup_match_values(preludedb_get_data(db), selection, criteria, distinct);
+
+        ret = prelude_string_sprintf(key, "%s %d ", rollup ? "rollup" : "values", distinct);
+        if ( ret < 0 )
+                goto error;
+
+        ret = plan_key_add_selection(key, selection);
+        if ( ret < 0 )
+                goto error;
+
+        if ( criteria ) {
+                ret = plan_key_add_criteria(sql, criteria, key, params);
+                if ( ret < 0 )
+                        goto error;
+        }
+
+        ret = preludedb_sql_plan_cache_get(sql, prelude_string_get_string(key), &plan);
+        if ( ret == 0 ) {
+                if ( rollup )
+                        ret = classic_rollup_build_values_plan(preludedb_get_data(db), sql, selection, criteria, &plan);
+                else
+                        ret = build_values_plan(db, selection, criteria, distinct, &plan);
+
+                if ( ret >= 0 )
+                        ret = preludedb_sql_plan_cache_set(sql, prelude_string_get_string(key), plan);
+        }
+
+        if ( ret >= 0 )
+                ret = run_plan(db, plan, params, limit, offset, (preludedb_sql_table_t **) res);
+
+ error:
+        if ( plan )
+                free(plan);
+
+        prelude_string_destroy(key);
+        preludedb_sql_params_destroy(params);
+
+        return ret;
+}
+
+
+/*
+ * Messages are counted within the class the criteria refer to, alerts
+ * being counted when there are none.
+ */
+static idmef_class_id_t get_count_message_type(idmef_criteria_t *criteria)
+{
+        while ( criteria && ! idmef_criteria_is_criterion(criteria) )
+                criteria = idmef_criteria_get_left(criteria) ? idmef_criteria_get_left(criteria) : idmef_criteria_get_right(criteria);
+
+        if ( criteria && idmef_path_get_class(idmef_criteria_get_path(criteria), 0) == IDMEF_CLASS_ID_HEARTBEAT )
+                return IDMEF_CLASS_ID_HEARTBEAT;
+
+        return IDMEF_CLASS_ID_ALERT;
+}
+
+
+
+/*
+ * Build "SELECT @fields FROM ... WHERE ...", with the criteria values
+ * written as placeholders if @template is set, or within the query otherwise.
+ */
+static int build_count_plan(preludedb_t *db, idmef_criteria_t *criteria, const char *fields,
+                            prelude_bool_t template, char **plan)
 {
-        prelude_string_t *query;
-        prelude_string_t *where = NULL;
+        int ret;
         classic_sql_join_t *join;
+        prelude_string_t *query, *where = NULL;
         preludedb_sql_t *sql = preludedb_get_sql(db);
-        preludedb_sql_select_t *select;
-        int ret;
 
         ret = prelude_string_new(&query);
         if ( ret < 0 )
@@ -148,47 +1107,23 @@ static int get_message_idents(preludedb_t *db, idmef_class_id_t message_type,
                 return ret;
         }
 
-        ret = preludedb_sql_select_new(db, &select);
-        if ( ret < 0 ) {
-                prelude_string_destroy(query);
-                classic_sql_join_destroy(join);
-                return ret;
-        }
-
-        classic_sql_join_set_top_class(join, message_type);
-
-        ret = preludedb_sql_select_add_field(select, "DISTINCT(top_table._ident)");
-        if ( ret < 0 )
-                goto error;
-
-        if ( order ) {
-                ret = get_message_idents_set_order(message_type, order, join, select);
-                if ( ret < 0 )
-                        return ret;
-        }
+        classic_sql_join_set_top_class(join, get_count_message_type(criteria));
 
         if ( criteria ) {
                 ret = prelude_string_new(&where);
                 if ( ret < 0 )
                         goto error;
 
-                ret = classic_path_resolve_criteria(sql, criteria, join, where);
-                if ( ret < 0 ) {
-                        prelude_string_destroy(where);
+                if ( template )
+                        ret = classic_path_resolve_criteria_template(sql, criteria, join, where);
+                else
+                        ret = classic_path_resolve_criteria(sql, criteria, join, where);
+
+                if ( ret < 0 )
                         goto error;
-                }
         }
 
-        ret = prelude_string_sprintf(query, "SELECT ");
-        if ( ret < 0 )
-                goto error;
-
-        ret = preludedb_sql_select_fields_to_string(select, query);
-        if ( ret < 0 )
-                goto error;
-
-
-        ret = prelude_string_cat(query, " FROM ");
+        ret = prelude_string_sprintf(query, "SELECT %s FROM ", fields);
         if ( ret < 0 )
                 goto error;
 
@@ -197,180 +1132,326 @@ static int get_message_idents(preludedb_t *db, idmef_class_id_t message_type,
                 goto error;
 
         if ( where ) {
-                ret = prelude_string_cat(query, " WHERE ");
-                if ( ret < 0 )
-                        goto error;
-
-                ret = prelude_string_cat(query, prelude_string_get_string(where));
+                ret = prelude_string_sprintf(query, " WHERE %s", prelude_string_get_string(where));
                 if ( ret < 0 )
                         goto error;
         }
 
-        ret = preludedb_sql_select_modifiers_to_string(select, query);
-        if ( ret < 0 )
-                goto error;
-
-        ret = preludedb_sql_build_limit_offset_string(sql, limit, offset, query);
-        if ( ret < 0 )
-                goto error;
-
-        ret = preludedb_sql_query(sql, prelude_string_get_string(query), table);
+        ret = prelude_string_get_string_released(query, plan);
 
  error:
         prelude_string_destroy(query);
         if ( where )
                 prelude_string_destroy(where);
         classic_sql_join_destroy(join);
-        preludedb_sql_select_destroy(select);
 
         return ret;
 }
 
 
 
-static int classic_get_alert_idents(preludedb_t *db, idmef_criteria_t *criteria,
-                                    int limit, int offset, const preludedb_path_selection_t *order,
-                                    void **res)
+static int get_count_estimate_pgsql(preludedb_sql_table_t *table, uint64_t *count)
 {
-        return get_message_idents(db, IDMEF_CLASS_ID_ALERT, criteria, limit, offset, order,
-                                  (preludedb_sql_table_t **) res);
-}
+        int ret;
+        const char *ptr;
+        prelude_string_t *str;
+        preludedb_sql_row_t *row;
+        preludedb_sql_field_t *field;
 
+        ret = preludedb_sql_table_get_row(table, 0, &row);
+        if ( ret <= 0 )
+                return ret;
 
+        ret = preludedb_sql_row_get_field(row, 0, &field);
+        if ( ret <= 0 )
+                return ret;
 
-static int classic_get_heartbeat_idents(preludedb_t *db, idmef_criteria_t *criteria,
-                                        int limit, int offset, const preludedb_path_selection_t *order,
-                                        void **res)
-{
-        return get_message_idents(db, IDMEF_CLASS_ID_HEARTBEAT, criteria, limit, offset, order,
-                                  (preludedb_sql_table_t **) res);
-}
+        ret = prelude_string_new(&str);
+        if ( ret < 0 )
+                return ret;
 
+        /*
+         * The first line of the plan holds the estimated number of rows
+         * of the whole query, as in "Unique  (cost=... rows=1234 width=8)".
+         */
+        ret = preludedb_sql_field_to_string(field, str);
+        if ( ret >= 0 ) {
+                ptr = strstr(prelude_string_get_string(str), " rows=");
+                if ( ptr ) {
+                        *count = strtoull(ptr + 6, NULL, 10);
+                        ret = 1;
+                } else
+                        ret = 0;
+        }
 
+        prelude_string_destroy(str);
 
-static size_t classic_get_message_ident_count(void *res)
-{
-        return preludedb_sql_table_get_row_count(res);
+        return ret;
 }
 
 
 
-static int classic_get_message_ident(void *res, unsigned int row_index, uint64_t *ident)
+static int get_count_estimate_mysql(preludedb_sql_table_t *table, uint64_t *count)
 {
+        int ret, rows_col, filtered_col;
+        uint64_t rows;
+        double filtered, estimate = 1;
+        unsigned int i = 0;
+        prelude_bool_t found = FALSE;
         preludedb_sql_row_t *row;
         preludedb_sql_field_t *field;
-        int ret;
 
-        ret = preludedb_sql_table_get_row(res, row_index, &row);
-        if ( ret <= 0 )
-                return ret;
+        rows_col = preludedb_sql_table_get_column_num(table, "rows");
+        if ( rows_col < 0 )
+                return 0;
 
-        ret = preludedb_sql_row_get_field(row, 0, &field);
-        if ( ret <= 0 )
-                return ret;
+        filtered_col = preludedb_sql_table_get_column_num(table, "filtered");
 
-        ret = preludedb_sql_field_to_uint64(field, ident);
+        /*
+         * Each line of the plan gives the number of rows read from a table
+         * for each row of the preceding ones, of which "filtered" percents
+         * are kept. Their product is the estimated number of result rows.
+         */
+        while ( (ret = preludedb_sql_table_get_row(table, i++, &row)) > 0 ) {
+                ret = preludedb_sql_row_get_field(row, rows_col, &field);
+                if ( ret < 0 )
+                        return ret;
 
-        return (ret < 0) ? ret : 1;
-}
+                if ( ret == 0 )
+                        continue;
 
+                ret = preludedb_sql_field_to_uint64(field, &rows);
+                if ( ret < 0 )
+                        return ret;
 
-static void classic_destroy_message_idents_resource(void *res)
-{
-        preludedb_sql_table_destroy(res);
+                estimate *= rows;
+                found = TRUE;
+
+                if ( filtered_col < 0 )
+                        continue;
+
+                ret = preludedb_sql_row_get_field(row, filtered_col, &field);
+                if ( ret < 0 )
+                        return ret;
+
+                if ( ret > 0 ) {
+                        ret = preludedb_sql_field_to_double(field, &filtered);
+                        if ( ret < 0 )
+                                return ret;
+
+                        estimate = estimate * filtered / 100;
+                }
+        }
+
+        if ( ret < 0 )
+                return ret;
+
+        /*
+         * No line with a row count means that MySQL found the query can
+         * not return anything, as with "Impossible WHERE".
+         */
+        *count = (found) ? (uint64_t) (estimate + 0.5) : 0;
+
+        return 1;
 }
 
 
 
-static int classic_get_values(preludedb_t *db, preludedb_path_selection_t *selection,
-                              idmef_criteria_t *criteria, int distinct, int limit, int offset, void **res)
+/*
+ * Estimate the number of matching messages from the planner statistics,
+ * at a cost which does not depend on it. Returns 0 if the backend has
+ * no such estimate, as SQLite.
+ */
+static int get_count_estimate(preludedb_t *db, idmef_criteria_t *criteria, uint64_t *count)
 {
-        prelude_string_t *where = NULL;
-        prelude_string_t *query;
-        classic_sql_join_t *join;
-        preludedb_sql_select_t *select;
         int ret;
+        char *plan;
+        prelude_string_t *query;
+        preludedb_sql_table_t *table;
+        preludedb_sql_t *sql = preludedb_get_sql(db);
+        const char *type = preludedb_sql_get_type(sql);
+        prelude_bool_t pgsql = (strcmp(type, "pgsql") == 0);
 
-        ret = classic_sql_join_new(&join);
+        if ( ! pgsql && strcmp(type, "mysql") != 0 )
+                return 0;
+
+        /*
+         * The values are written within the query, for the estimate to
+         * account for them.
+         */
+        ret = build_count_plan(db, criteria, criteria ? "DISTINCT top_table._ident" : "top_table._ident", FALSE, &plan);
         if ( ret < 0 )
                 return ret;
 
-        ret = preludedb_sql_select_new(db, &select);
+        ret = prelude_string_new(&query);
         if ( ret < 0 ) {
-                classic_sql_join_destroy(join);
+                free(plan);
                 return ret;
         }
 
-        ret = prelude_string_new(&query);
+        ret = prelude_string_sprintf(query, "EXPLAIN %s", plan);
+        free(plan);
+
         if ( ret < 0 ) {
-                classic_sql_join_destroy(join);
-                preludedb_sql_select_destroy(select);
+                prelude_string_destroy(query);
                 return ret;
         }
 
-        ret = preludedb_sql_select_add_selection(select, selection, join);
-        if ( ret < 0 )
-                goto error;
+        ret = preludedb_sql_query(sql, prelude_string_get_string(query), &table);
+        prelude_string_destroy(query);
 
-        if ( criteria ) {
-                ret = prelude_string_new(&where);
-                if ( ret < 0 )
-                        goto error;
+        if ( ret <= 0 )
+                return ret;
 
-                ret = classic_path_resolve_criteria(preludedb_get_sql(db), criteria, join, where);
-                if ( ret < 0 )
-                        goto error;
+        if ( pgsql )
+                ret = get_count_estimate_pgsql(table, count);
+        else
+                ret = get_count_estimate_mysql(table, count);
+
+        preludedb_sql_table_destroy(table);
+
+        return ret;
+}
+
+
+
+/*
+ * With a @threshold, the idents are selected in a derived table limited to
+ * one more than @threshold rows, so that the database stops looking for
+ * matching messages there. The limit being an int, thresholds from INT_MAX
+ * fall back to an unbounded count, as documented for preludedb_count().
+ */
+static int get_count_exact(preludedb_t *db, idmef_criteria_t *criteria, uint64_t threshold, uint64_t *count)
+{
+        int ret;
+        char *plan = NULL;
+        prelude_string_t *key, *query = NULL;
+        preludedb_sql_params_t *params;
+        preludedb_sql_table_t *table;
+        preludedb_sql_row_t *row;
+        preludedb_sql_field_t *field;
+        preludedb_sql_t *sql = preludedb_get_sql(db);
+        prelude_bool_t bounded = (threshold > 0 && threshold < INT_MAX);
+        const char *fields;
+
+        if ( bounded )
+                fields = criteria ? "DISTINCT top_table._ident" : "top_table._ident";
+        else
+                fields = criteria ? "COUNT(DISTINCT top_table._ident)" : "COUNT(*)";
+
+        ret = preludedb_sql_params_new(&params);
+        if ( ret < 0 )
+                return ret;
+
+        ret = prelude_string_new(&key);
+        if ( ret < 0 ) {
+                preludedb_sql_params_destroy(params);
+                return ret;
         }
 
-        ret = prelude_string_cat(query, "SELECT ");
+        ret = prelude_string_sprintf(key, "count %d %d ", get_count_message_type(criteria), bounded);
         if ( ret < 0 )
                 goto error;
 
-        if ( distinct ) {
-                ret = prelude_string_cat(query, "DISTINCT ");
+        if ( criteria ) {
+                ret = plan_key_add_criteria(sql, criteria, key, params);
                 if ( ret < 0 )
                         goto error;
         }
 
-        ret = preludedb_sql_select_fields_to_string(select, query);
-        if ( ret < 0 )
-                goto error;
+        ret = preludedb_sql_plan_cache_get(sql, prelude_string_get_string(key), &plan);
+        if ( ret == 0 ) {
+                ret = build_count_plan(db, criteria, fields, TRUE, &plan);
+                if ( ret >= 0 )
+                        ret = preludedb_sql_plan_cache_set(sql, prelude_string_get_string(key), plan);
+        }
 
-        ret = prelude_string_cat(query, " FROM ");
         if ( ret < 0 )
                 goto error;
 
-        ret = classic_sql_join_to_string(join, query);
+        ret = prelude_string_new(&query);
         if ( ret < 0 )
                 goto error;
 
-        if ( where ) {
-                ret = prelude_string_sprintf(query, " WHERE %s", prelude_string_get_string(where));
+        if ( bounded ) {
+                ret = prelude_string_sprintf(query, "SELECT COUNT(*) FROM (%s", plan);
                 if ( ret < 0 )
                         goto error;
-        }
 
-        ret = preludedb_sql_select_modifiers_to_string(select, query);
+                ret = preludedb_sql_build_limit_offset_string(sql, threshold + 1, -1, query);
+                if ( ret < 0 )
+                        goto error;
+
+                ret = prelude_string_cat(query, ") AS counted");
+        } else
+                ret = prelude_string_cat(query, plan);
+
         if ( ret < 0 )
                 goto error;
 
-        ret = preludedb_sql_build_limit_offset_string(preludedb_get_sql(db), limit, offset, query);
-        if ( ret < 0 )
+        ret = preludedb_sql_query_params(sql, prelude_string_get_string(query),
+                                         preludedb_sql_params_get(params), preludedb_sql_params_get_count(params), &table);
+        if ( ret <= 0 ) {
+                if ( ret == 0 )
+                        ret = preludedb_error(PRELUDEDB_ERROR_GENERIC);
                 goto error;
+        }
+
+        ret = preludedb_sql_table_get_row(table, 0, &row);
+        if ( ret > 0 )
+                ret = preludedb_sql_row_get_field(row, 0, &field);
 
-        ret = preludedb_sql_query(preludedb_get_sql(db), prelude_string_get_string(query), (preludedb_sql_table_t **) res);
+        if ( ret > 0 )
+                ret = preludedb_sql_field_to_uint64(field, count);
+        else if ( ret == 0 )
+                ret = preludedb_error(PRELUDEDB_ERROR_GENERIC);
+
+        preludedb_sql_table_destroy(table);
 
  error:
-        prelude_string_destroy(query);
-        if ( where )
-                prelude_string_destroy(where);
-        classic_sql_join_destroy(join);
-        preludedb_sql_select_destroy(select);
+        if ( plan )
+                free(plan);
+
+        if ( query )
+                prelude_string_destroy(query);
+
+        prelude_string_destroy(key);
+        preludedb_sql_params_destroy(params);
 
         return ret;
 }
 
 
+
+static int classic_count(preludedb_t *db, idmef_criteria_t *criteria, int flags, uint64_t threshold, uint64_t *count)
+{
+        int ret, result = 0;
+
+        if ( flags & PRELUDEDB_COUNT_FLAGS_ESTIMATE ) {
+                ret = get_count_estimate(db, criteria, count);
+                if ( ret < 0 )
+                        return ret;
+
+                if ( ret > 0 )
+                        result |= PRELUDEDB_COUNT_FLAGS_ESTIMATE;
+        }
+
+        if ( ! (result & PRELUDEDB_COUNT_FLAGS_ESTIMATE) ) {
+                ret = get_count_exact(db, criteria, threshold, count);
+                if ( ret < 0 )
+                        return ret;
+        }
+
+        if ( threshold > 0 && *count > threshold ) {
+                *count = threshold;
+                result |= PRELUDEDB_COUNT_FLAGS_EXCEEDED;
+        }
+
+        return result;
+}
+
+
+
 static int get_value_time(preludedb_selected_path_t *selected,
                           preludedb_sql_row_t *row, preludedb_sql_field_t *field, int cnt, idmef_time_t **time)
 {
@@ -417,7 +1498,12 @@ static int get_value_time(preludedb_selected_path_t *selected,
         if ( ret < 0 )
                 return ret;
 
-        preludedb_sql_time_from_timestamp(*time, preludedb_sql_field_get_value(field), gmtoff, usec);
+        ret = preludedb_sql_field_to_time(field, *time, gmtoff, usec);
+        if ( ret < 0 ) {
+                idmef_time_destroy(*time);
+                return ret;
+        }
+
         return retrieved;
 }
 
@@ -481,7 +1567,9 @@ static int get_value(preludedb_sql_t *sql, preludedb_sql_row_t *row, int cnt, pr
         char *char_val;
         unsigned char *unescaped = NULL;
         size_t len;
+        prelude_string_t *str = NULL;
         preludedb_sql_field_t *field;
+        preludedb_sql_field_type_t ftype;
         idmef_value_type_id_t type, orig_type;
         unsigned int retrieved = 1;
         int ret;
@@ -499,10 +1587,29 @@ static int get_value(preludedb_sql_t *sql, preludedb_sql_row_t *row, int cnt, pr
         char_val = preludedb_sql_field_get_value(field);
         len = preludedb_sql_field_get_len(field);
 
+        /*
+         * Numbers returned in binary form are handed out as text.
+         */
+        ftype = preludedb_sql_field_get_type(field);
+        if ( type != IDMEF_VALUE_TYPE_TIME && ftype != PRELUDEDB_SQL_FIELD_TYPE_TEXT && ftype != PRELUDEDB_SQL_FIELD_TYPE_BINARY ) {
+                ret = prelude_string_new(&str);
+                if ( ret < 0 )
+                        return ret;
+
+                ret = preludedb_sql_field_to_string(field, str);
+                if ( ret < 0 ) {
+                        prelude_string_destroy(str);
+                        return ret;
+                }
+
+                char_val = (char *) prelude_string_get_string(str);
+                len = prelude_string_get_len(str);
+        }
+
         if ( type == IDMEF_VALUE_TYPE_DATA ) {
                 ret = get_data(sql, row, field, cnt, selected, &type, &unescaped, &len);
                 if ( ret < 0 )
-                        return ret;
+                        goto out;
 
                 retrieved += ret;
                 if ( ret )
@@ -522,7 +1629,7 @@ static int get_value(preludedb_sql_t *sql, preludedb_sql_row_t *row, int cnt, pr
                         ret = get_value_time(selected, row, field, cnt, &time);
 
                 if ( ret < 0 )
-                        return ret;
+                        goto out;
 
                 retrieved += ret;
                 ret = cb(out, time, 0, type);
@@ -535,9 +1642,13 @@ static int get_value(preludedb_sql_t *sql, preludedb_sql_row_t *row, int cnt, pr
                 break;
         }
 
+ out:
         if ( unescaped )
                 free(unescaped);
 
+        if ( str )
+                prelude_string_destroy(str);
+
         return (ret < 0) ? ret : retrieved;
 }
 
@@ -632,6 +1743,37 @@ static int classic_check_schema_version(const char *version)
 
 
 
+/*
+ * The rollups are set up once per database, and kept as its data.
+ */
+static int classic_init(preludedb_t *db)
+{
+        int ret;
+        classic_rollup_t *rollup;
+
+        ret = classic_rollup_new(preludedb_get_sql(db), &rollup);
+        if ( ret < 0 )
+                return ret;
+
+        preludedb_set_data(db, rollup);
+
+        return 0;
+}
+
+
+
+static void classic_destroy(preludedb_t *db)
+{
+        classic_rollup_t *rollup = preludedb_get_data(db);
+
+        if ( rollup )
+                classic_rollup_destroy(rollup);
+
+        preludedb_set_data(db, NULL);
+}
+
+
+
 int classic_LTX_preludedb_plugin_init(prelude_plugin_entry_t *pe, void *data)
 {
         int ret;
@@ -645,7 +1787,10 @@ int classic_LTX_preludedb_plugin_init(prelude_plugin_entry_t *pe, void *data)
         prelude_plugin_entry_set_plugin(pe, (void *) plugin);
 
         preludedb_plugin_format_set_check_schema_version_func(plugin, classic_check_schema_version);
+        preludedb_plugin_format_set_init_func(plugin, classic_init);
+        preludedb_plugin_format_set_destroy_func(plugin, classic_destroy);
         preludedb_plugin_format_set_get_alert_idents_func(plugin, classic_get_alert_idents);
+        preludedb_plugin_format_set_get_alert_idents_after_func(plugin, classic_get_alert_idents_after);
         preludedb_plugin_format_set_get_heartbeat_idents_func(plugin, classic_get_heartbeat_idents);
         preludedb_plugin_format_set_get_message_ident_count_func(plugin, classic_get_message_ident_count);
         preludedb_plugin_format_set_get_message_ident_func(plugin, classic_get_message_ident);
@@ -653,15 +1798,23 @@ int classic_LTX_preludedb_plugin_init(prelude_plugin_entry_t *pe, void *data)
                                                                          classic_destroy_message_idents_resource);
         preludedb_plugin_format_set_get_alert_func(plugin, classic_get_alert);
         preludedb_plugin_format_set_get_heartbeat_func(plugin, classic_get_heartbeat);
+        preludedb_plugin_format_set_get_alerts_func(plugin, classic_get_alerts);
+        preludedb_plugin_format_set_get_heartbeats_func(plugin, classic_get_heartbeats);
         preludedb_plugin_format_set_delete_alert_func(plugin, classic_delete_alert);
         preludedb_plugin_format_set_delete_alert_from_list_func(plugin, classic_delete_alert_from_list);
         preludedb_plugin_format_set_delete_alert_from_result_idents_func(plugin, classic_delete_alert_from_result_idents);
         preludedb_plugin_format_set_delete_heartbeat_func(plugin, classic_delete_heartbeat);
         preludedb_plugin_format_set_delete_heartbeat_from_list_func(plugin, classic_delete_heartbeat_from_list);
         preludedb_plugin_format_set_delete_heartbeat_from_result_idents_func(plugin, classic_delete_heartbeat_from_result_idents);
+        preludedb_plugin_format_set_drop_partitions_before_func(plugin, classic_drop_partitions_before);
+        preludedb_plugin_format_set_update_func(plugin, classic_update);
+        preludedb_plugin_format_set_update_from_list_func(plugin, classic_update_from_list);
+        preludedb_plugin_format_set_update_from_result_idents_func(plugin, classic_update_from_result_idents);
 
         preludedb_plugin_format_set_insert_message_func(plugin, classic_insert);
+        preludedb_plugin_format_set_insert_messages_func(plugin, classic_insert_messages);
         preludedb_plugin_format_set_get_values_func(plugin, classic_get_values);
+        preludedb_plugin_format_set_count_func(plugin, classic_count);
         preludedb_plugin_format_set_get_result_values_row_func(plugin, classic_get_result_values_row);
         preludedb_plugin_format_set_get_result_values_field_func(plugin, classic_get_result_values_field);
         preludedb_plugin_format_set_get_result_values_count_func(plugin, classic_get_result_values_count);
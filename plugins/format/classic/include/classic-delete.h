@@ -24,6 +24,10 @@
 #ifndef _LIBPRELUDEDB_CLASSIC_DELETE_H
 #define _LIBPRELUDEDB_CLASSIC_DELETE_H
 
+ssize_t classic_get_string_from_ident_list(prelude_string_t **out, uint64_t *ident, size_t size);
+
+ssize_t classic_get_string_from_result_ident(prelude_string_t **out, preludedb_result_idents_t *res);
+
 int classic_delete_alert(preludedb_t *db, uint64_t ident);
 
 ssize_t classic_delete_alert_from_list(preludedb_t *db, uint64_t *ident, size_t size);
@@ -36,4 +40,6 @@ ssize_t classic_delete_heartbeat_from_list(preludedb_t *db, uint64_t *ident, siz
 
 ssize_t classic_delete_heartbeat_from_result_idents(preludedb_t *db, preludedb_result_idents_t *results);
 
+int classic_drop_partitions_before(preludedb_t *db, const idmef_time_t *time);
+
 #endif /* _LIBPRELUDEDB_CLASSIC_DELETE_H */
@@ -28,4 +28,8 @@ int classic_get_alert(preludedb_t *db, uint64_t ident, idmef_message_t **message
 
 int classic_get_heartbeat(preludedb_t *db, uint64_t ident, idmef_message_t **message);
 
+ssize_t classic_get_alerts(preludedb_t *db, uint64_t *idents, size_t size, idmef_message_t **messages);
+
+ssize_t classic_get_heartbeats(preludedb_t *db, uint64_t *idents, size_t size, idmef_message_t **messages);
+
 #endif /* ! _LIBPRELUDEDB_CLASSIC_GET_H  */
@@ -27,4 +27,6 @@
 
 int classic_insert(preludedb_t *db, idmef_message_t *message);
 
+ssize_t classic_insert_messages(preludedb_t *db, idmef_message_t **messages, size_t size);
+
 #endif /* _LIBPRELUDEDB_CLASSIC_INSERT_H */
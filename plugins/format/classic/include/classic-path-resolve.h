@@ -27,9 +27,19 @@
 
 int classic_path_resolve(preludedb_selected_path_t *selpath, preludedb_selected_object_t *object, void *data, prelude_string_t *output);
 
+int classic_path_resolve_column(const idmef_path_t *path, classic_sql_join_t *join, prelude_string_t *output);
+
 int classic_path_resolve_criteria(preludedb_sql_t *sql,
 				  idmef_criteria_t *criteria,
 				  classic_sql_join_t *join, prelude_string_t *output);
 
+int classic_path_resolve_criteria_template(preludedb_sql_t *sql,
+					   idmef_criteria_t *criteria,
+					   classic_sql_join_t *join, prelude_string_t *output);
+
+int classic_path_resolve_update(const idmef_path_t *path, const char *idents, prelude_string_t *output);
+
+int classic_path_resolve_update_condition(const idmef_path_t *path, prelude_string_t *output);
+
 
 #endif /* _LIBPRELUDEDB_CLASSIC_PATH_RESOLVE_H */
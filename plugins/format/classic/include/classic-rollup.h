@@ -0,0 +1,52 @@
+/*****
+*
+* Copyright (C) 2020 CS GROUP - France. All Rights Reserved.
+*
+* This file is part of the PreludeDB library.
+*
+* This program is free software; you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation; either version 2, or (at your option)
+* any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License along
+* with this program; if not, write to the Free Software Foundation, Inc.,
+* 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+*
+*****/
+
+#ifndef _LIBPRELUDEDB_CLASSIC_ROLLUP_H
+#define _LIBPRELUDEDB_CLASSIC_ROLLUP_H
+
+typedef struct classic_rollup classic_rollup_t;
+
+int classic_rollup_new(preludedb_sql_t *sql, classic_rollup_t **rollup);
+
+void classic_rollup_destroy(classic_rollup_t *rollup);
+
+void classic_rollup_clear(classic_rollup_t *rollup);
+
+int classic_rollup_add_message(classic_rollup_t *rollup, idmef_message_t *message);
+
+int classic_rollup_remove_alerts(classic_rollup_t *rollup, preludedb_sql_t *sql, const char *idents);
+
+int classic_rollup_add_alerts(classic_rollup_t *rollup, preludedb_sql_t *sql, const char *idents);
+
+prelude_bool_t classic_rollup_has_paths(classic_rollup_t *rollup, const idmef_path_t * const *paths, size_t size);
+
+int classic_rollup_flush(classic_rollup_t *rollup, preludedb_sql_t *sql);
+
+int classic_rollup_trim(classic_rollup_t *rollup, preludedb_sql_t *sql);
+
+int classic_rollup_match_values(classic_rollup_t *rollup, preludedb_path_selection_t *selection,
+                                idmef_criteria_t *criteria, int distinct);
+
+int classic_rollup_build_values_plan(classic_rollup_t *rollup, preludedb_sql_t *sql, preludedb_path_selection_t *selection,
+                                     idmef_criteria_t *criteria, char **plan);
+
+#endif /* _LIBPRELUDEDB_CLASSIC_ROLLUP_H */
@@ -0,0 +1,18 @@
+# Optional rollup table of the classic schema, used when the "rollups"
+# setting lists the alert paths to keep counts for. Load it after mysql.sql.
+# Paths listed once alerts exist are only used for the hours following
+# their first use, as recorded in Prelude_RollupDimension.
+
+CREATE TABLE Prelude_Rollup (
+ _dimension VARCHAR(255) NOT NULL,
+ _bucket DATETIME NOT NULL,
+ _hash BIGINT NOT NULL,
+ _value TEXT NULL,
+ _count BIGINT NOT NULL,
+ PRIMARY KEY (_dimension,_bucket,_hash)
+) ENGINE=InnoDB;
+
+CREATE TABLE Prelude_RollupDimension (
+ _dimension VARCHAR(255) NOT NULL PRIMARY KEY,
+ _since DATETIME NOT NULL
+) ENGINE=InnoDB;
@@ -0,0 +1,128 @@
+-- Partitioned layout of the classic schema, for PostgreSQL >= 11.
+--
+-- To be loaded into an empty database, right after pgsql.sql: every
+-- Prelude_* table is turned into a table partitioned on the message ident.
+--
+-- Each partition owns a 2^32 wide range of idents. When a new period starts
+-- (see _partition_interval), prelude_partition_rotate() creates the next
+-- partitions and moves the alert and heartbeat sequences to the start of
+-- their range, so that a partition only holds the messages stored during
+-- its period. Old messages are then removed by dropping whole partitions,
+-- through preludedb_drop_partitions_before() or prelude_partition_drop_before(),
+-- which also rotates partitions when needed. Rotation can be scheduled apart,
+-- by running "SELECT prelude_partition_rotate();" at the start of each period.
+
+BEGIN;
+
+CREATE TABLE _partition (
+ _number INT8 NOT NULL PRIMARY KEY,
+ start_time TIMESTAMP NOT NULL
+);
+
+
+-- Period covered by a partition, '1 week' for instance.
+CREATE TABLE _partition_interval (
+ value INTERVAL NOT NULL
+);
+INSERT INTO _partition_interval (value) VALUES ('1 day');
+
+
+
+CREATE FUNCTION prelude_partition_tables() RETURNS SETOF TEXT AS $$
+        SELECT c.relname::TEXT FROM pg_class c JOIN pg_namespace n ON n.oid = c.relnamespace
+         WHERE n.nspname = current_schema() AND c.relkind = 'p' AND c.relname LIKE 'prelude\_%';
+$$ LANGUAGE SQL;
+
+
+
+CREATE FUNCTION prelude_partition_create(number INT8) RETURNS VOID AS $$
+DECLARE
+        t TEXT;
+BEGIN
+        FOR t IN SELECT prelude_partition_tables() LOOP
+                EXECUTE format('CREATE TABLE %I PARTITION OF %I FOR VALUES FROM (%s) TO (%s)',
+                               t || '_p' || number, t, number << 32, (number + 1) << 32);
+        END LOOP;
+
+        INSERT INTO _partition (_number, start_time) VALUES (number, now() AT TIME ZONE 'UTC');
+END;
+$$ LANGUAGE plpgsql;
+
+
+
+-- Start a new partition if the latest one is older than the partition
+-- interval. Returns whether a partition was created.
+CREATE FUNCTION prelude_partition_rotate() RETURNS BOOLEAN AS $$
+DECLARE
+        latest _partition%ROWTYPE;
+BEGIN
+        LOCK TABLE _partition IN EXCLUSIVE MODE;
+
+        SELECT * INTO latest FROM _partition ORDER BY _number DESC LIMIT 1;
+        IF latest.start_time + (SELECT value FROM _partition_interval LIMIT 1) > now() AT TIME ZONE 'UTC' THEN
+                RETURN FALSE;
+        END IF;
+
+        PERFORM prelude_partition_create(latest._number + 1);
+        PERFORM setval(pg_get_serial_sequence('prelude_alert', '_ident'), (latest._number + 1) << 32, FALSE);
+        PERFORM setval(pg_get_serial_sequence('prelude_heartbeat', '_ident'), (latest._number + 1) << 32, FALSE);
+
+        RETURN TRUE;
+END;
+$$ LANGUAGE plpgsql;
+
+
+
+-- Drop the partitions whose messages were all stored before @before_time, that
+-- is the ones followed by a partition started at, or before, @before_time.
+-- Returns the number of dropped partitions.
+CREATE FUNCTION prelude_partition_drop_before(before_time TIMESTAMP) RETURNS INT4 AS $$
+DECLARE
+        p RECORD;
+        t TEXT;
+        dropped INT4 := 0;
+BEGIN
+        PERFORM prelude_partition_rotate();
+
+        FOR p IN SELECT a._number FROM _partition a JOIN _partition b ON b._number = a._number + 1
+                  WHERE b.start_time <= before_time ORDER BY a._number LOOP
+                FOR t IN SELECT prelude_partition_tables() LOOP
+                        EXECUTE format('DROP TABLE %I', t || '_p' || p._number);
+                END LOOP;
+
+                DELETE FROM _partition WHERE _number = p._number;
+                dropped := dropped + 1;
+        END LOOP;
+
+        RETURN dropped;
+END;
+$$ LANGUAGE plpgsql;
+
+
+
+DO $$
+DECLARE
+        t TEXT;
+        seq TEXT;
+        ident_column TEXT;
+BEGIN
+        FOR t IN SELECT c.relname FROM pg_class c JOIN pg_namespace n ON n.oid = c.relnamespace
+                  WHERE n.nspname = current_schema() AND c.relkind = 'r' AND c.relname LIKE 'prelude\_%' LOOP
+                ident_column := CASE WHEN t IN ('prelude_alert', 'prelude_heartbeat') THEN '_ident' ELSE '_message_ident' END;
+
+                EXECUTE format('ALTER TABLE %I RENAME TO %I', t, t || '_flat');
+                EXECUTE format('CREATE TABLE %I (LIKE %I INCLUDING ALL) PARTITION BY RANGE (%I)', t, t || '_flat', ident_column);
+
+                IF ident_column = '_ident' THEN
+                        seq := pg_get_serial_sequence(t || '_flat', ident_column);
+                        EXECUTE format('ALTER SEQUENCE %s OWNED BY %I.%I', seq, t, ident_column);
+                END IF;
+
+                EXECUTE format('DROP TABLE %I', t || '_flat');
+        END LOOP;
+END;
+$$;
+
+SELECT prelude_partition_create(0);
+
+COMMIT;
@@ -0,0 +1,19 @@
+-- Optional rollup table of the classic schema, used when the "rollups"
+-- setting lists the alert paths to keep counts for. Load it after pgsql.sql.
+-- Paths listed once alerts exist are only used for the hours following
+-- their first use, as recorded in Prelude_RollupDimension.
+-- Requires PostgreSQL >= 9.5.
+
+CREATE TABLE Prelude_Rollup (
+ _dimension VARCHAR(255) NOT NULL,
+ _bucket TIMESTAMP NOT NULL,
+ _hash INT8 NOT NULL,
+ _value TEXT NULL,
+ _count INT8 NOT NULL,
+ PRIMARY KEY (_dimension,_bucket,_hash)
+) ;
+
+CREATE TABLE Prelude_RollupDimension (
+ _dimension VARCHAR(255) NOT NULL PRIMARY KEY,
+ _since TIMESTAMP NOT NULL
+) ;
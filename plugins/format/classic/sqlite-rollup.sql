@@ -0,0 +1,19 @@
+-- Optional rollup table of the classic schema, used when the "rollups"
+-- setting lists the alert paths to keep counts for. Load it after sqlite.sql.
+-- Paths listed once alerts exist are only used for the hours following
+-- their first use, as recorded in Prelude_RollupDimension.
+-- Requires SQLite >= 3.24.
+
+CREATE TABLE Prelude_Rollup (
+ _dimension TEXT NOT NULL,
+ _bucket DATETIME NOT NULL,
+ _hash INTEGER NOT NULL,
+ _value TEXT NULL,
+ _count INTEGER NOT NULL,
+ PRIMARY KEY (_dimension,_bucket,_hash)
+) ;
+
+CREATE TABLE Prelude_RollupDimension (
+ _dimension TEXT NOT NULL PRIMARY KEY,
+ _since DATETIME NOT NULL
+) ;
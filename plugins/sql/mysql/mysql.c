@@ -56,6 +56,10 @@
 # define mysql_field_count mysql_num_fields
 #endif /* ! MYSQL_VERSION_ID */
 
+#if defined(MYSQL_VERSION_ID) && MYSQL_VERSION_ID >= 80001 && MYSQL_VERSION_ID < 100000
+typedef bool my_bool;
+#endif
+
 
 
 typedef struct {
@@ -70,14 +74,27 @@ typedef struct {
 } mysql_session_t;
 
 
+/*
+ * Result of a query. For a prepared statement, result only holds the
+ * result set metadata and rows are fetched from the statement itself.
+ * A streamed result is read from the server as rows are fetched.
+ */
+typedef struct {
+        MYSQL_RES *result;
+        MYSQL_STMT *statement;
+        MYSQL_BIND *bind;
+        prelude_bool_t stream;
+} mysql_table_t;
+
+
 
 int mysql_LTX_prelude_plugin_version(void);
 int mysql_LTX_preludedb_plugin_init(prelude_plugin_entry_t *pe, void *data);
 
 
-static prelude_bool_t is_connection_broken(void *session)
+static prelude_bool_t is_connection_broken(unsigned int error)
 {
-        switch (mysql_errno(session)) {
+        switch (error) {
 
         case CR_CONNECTION_ERROR:
         case CR_SERVER_GONE_ERROR:
@@ -98,7 +115,7 @@ static int handle_error(void *session, prelude_error_code_t code)
 {
         int ret;
 
-        if ( is_connection_broken(session) )
+        if ( is_connection_broken(mysql_errno(session)) )
                 code = PRELUDEDB_ERROR_CONNECTION;
 
         if ( mysql_errno(session) )
@@ -111,6 +128,19 @@ static int handle_error(void *session, prelude_error_code_t code)
 
 
 
+static int handle_stmt_error(MYSQL_STMT *statement, prelude_error_code_t code)
+{
+        if ( is_connection_broken(mysql_stmt_errno(statement)) )
+                code = PRELUDEDB_ERROR_CONNECTION;
+
+        if ( mysql_stmt_errno(statement) )
+                return preludedb_error_verbose(code, "%s", mysql_stmt_error(statement));
+
+        return preludedb_error(code);
+}
+
+
+
 static int check_timezone_support(void *session)
 {
         int ret;
@@ -181,6 +211,31 @@ static void sql_close(void *session)
 }
 
 
+/*
+ * mysql_real_escape_string() only uses backslash sequences, unless the
+ * NO_BACKSLASH_ESCAPES mode is set, and depends on the character set for
+ * those with multibyte characters ending with an ASCII byte.
+ */
+static int sql_get_escape_flags(void *session)
+{
+        unsigned int i;
+        const char *charset;
+        static const char *unsafe_charsets[] = { "big5", "sjis", "cp932", "gbk", "gb18030" };
+
+        if ( ((MYSQL *) session)->server_status & SERVER_STATUS_NO_BACKSLASH_ESCAPES )
+                return preludedb_error(PRELUDEDB_ERROR_GENERIC);
+
+        charset = mysql_character_set_name(session);
+        for ( i = 0; charset && i < sizeof(unsafe_charsets) / sizeof(*unsafe_charsets); i++ ) {
+                if ( strcmp(charset, unsafe_charsets[i]) == 0 )
+                        return preludedb_error(PRELUDEDB_ERROR_GENERIC);
+        }
+
+        return PRELUDEDB_PLUGIN_SQL_ESCAPE_BACKSLASH | PRELUDEDB_PLUGIN_SQL_ESCAPE_BINARY_AS_STRING;
+}
+
+
+
 static int sql_escape_binary(void *session, const unsigned char *input, size_t input_size, char **output)
 {
         size_t rsize;
@@ -256,6 +311,29 @@ static int sql_query_prepare(preludedb_sql_t *sql, preludedb_sql_query_t *query,
 
 
 
+static int table_new(preludedb_sql_table_t **table, MYSQL_RES *result, MYSQL_STMT *statement, MYSQL_BIND *bind)
+{
+        int ret;
+        mysql_table_t *data;
+
+        data = malloc(sizeof(*data));
+        if ( ! data )
+                return preludedb_error_from_errno(errno);
+
+        data->result = result;
+        data->statement = statement;
+        data->bind = bind;
+        data->stream = FALSE;
+
+        ret = preludedb_sql_table_new(table, data);
+        if ( ret < 0 )
+                free(data);
+
+        return ret;
+}
+
+
+
 static int sql_query(void *session, const char *query, preludedb_sql_table_t **table)
 {
         int ret;
@@ -297,7 +375,7 @@ static int sql_query(void *session, const char *query, preludedb_sql_table_t **t
                 return 0;
         }
 
-        ret = preludedb_sql_table_new(table, result);
+        ret = table_new(table, result, NULL, NULL);
         if ( ret < 0 ) {
                 mysql_free_result(result);
                 return ret;
@@ -308,6 +386,162 @@ static int sql_query(void *session, const char *query, preludedb_sql_table_t **t
 
 
 
+/*
+ * The result is not stored client side: the session stays busy until
+ * the table is destroyed, which discards the remaining rows.
+ */
+static int sql_query_stream(void *session, const char *query, preludedb_sql_table_t **table)
+{
+        int ret;
+        MYSQL_RES *result;
+
+        ret = mysql_query(session, query);
+        if ( ret != 0 )
+                return handle_error(session, PRELUDEDB_ERROR_QUERY);
+
+        result = mysql_use_result(session);
+        if ( ! result ) {
+                if ( mysql_field_count(session) > 0 )
+                        return handle_error(session, PRELUDEDB_ERROR_QUERY);
+
+                return (int) mysql_affected_rows(session);
+        }
+
+        ret = table_new(table, result, NULL, NULL);
+        if ( ret < 0 ) {
+                mysql_free_result(result);
+                return ret;
+        }
+
+        ((mysql_table_t *) preludedb_sql_table_get_data(*table))->stream = TRUE;
+
+        return 1;
+}
+
+
+
+static int sql_statement_prepare(void *session, const char *query, unsigned int nparams, void **statement)
+{
+        int ret;
+
+        *statement = mysql_stmt_init(session);
+        if ( ! *statement )
+                return handle_error(session, PRELUDEDB_ERROR_QUERY);
+
+        ret = mysql_stmt_prepare(*statement, query, strlen(query));
+        if ( ret != 0 ) {
+                ret = handle_stmt_error(*statement, PRELUDEDB_ERROR_QUERY);
+                mysql_stmt_close(*statement);
+                return ret;
+        }
+
+        return 0;
+}
+
+
+
+static int sql_statement_execute(void *session, void *statement, const preludedb_sql_param_t *params,
+                                 unsigned int nparams, preludedb_sql_table_t **table)
+{
+        int ret;
+        unsigned int i, ncolumns;
+        my_bool *is_null;
+        MYSQL_BIND *bind;
+        MYSQL_RES *metadata;
+        my_ulonglong nrows;
+        unsigned long *lengths;
+
+        bind = calloc(nparams + 1, sizeof(*bind));
+        if ( ! bind )
+                return preludedb_error_from_errno(errno);
+
+        for ( i = 0; i < nparams; i++ ) {
+                if ( ! params[i].value ) {
+                        bind[i].buffer_type = MYSQL_TYPE_NULL;
+                        continue;
+                }
+
+                bind[i].buffer_type = (params[i].type == PRELUDEDB_SQL_PARAM_TYPE_BINARY) ? MYSQL_TYPE_BLOB : MYSQL_TYPE_STRING;
+                bind[i].buffer = (void *) params[i].value;
+                bind[i].buffer_length = params[i].len;
+        }
+
+        ret = mysql_stmt_bind_param(statement, bind);
+        if ( ret == 0 )
+                ret = mysql_stmt_execute(statement);
+
+        free(bind);
+
+        if ( ret != 0 )
+                return handle_stmt_error(statement, PRELUDEDB_ERROR_QUERY);
+
+        metadata = mysql_stmt_result_metadata(statement);
+        if ( ! metadata )
+                return (int) mysql_stmt_affected_rows(statement);
+
+        if ( mysql_stmt_store_result(statement) != 0 ) {
+                ret = handle_stmt_error(statement, PRELUDEDB_ERROR_QUERY);
+                goto error;
+        }
+
+        nrows = mysql_stmt_num_rows(statement);
+        if ( nrows == 0 || ! table ) {
+                mysql_stmt_free_result(statement);
+                mysql_free_result(metadata);
+                return 0;
+        }
+
+        /*
+         * Columns are bound without buffer, their length is retrieved on
+         * fetch and the values are then read with mysql_stmt_fetch_column().
+         * The length and NULL indicators are stored after the bind array.
+         */
+        ncolumns = mysql_num_fields(metadata);
+
+        bind = calloc(ncolumns, sizeof(*bind) + sizeof(unsigned long) + sizeof(my_bool));
+        if ( ! bind ) {
+                ret = preludedb_error_from_errno(errno);
+                goto error;
+        }
+
+        lengths = (unsigned long *) &bind[ncolumns];
+        is_null = (my_bool *) &lengths[ncolumns];
+
+        for ( i = 0; i < ncolumns; i++ ) {
+                bind[i].buffer_type = MYSQL_TYPE_STRING;
+                bind[i].length = &lengths[i];
+                bind[i].is_null = &is_null[i];
+        }
+
+        if ( mysql_stmt_bind_result(statement, bind) != 0 ) {
+                ret = handle_stmt_error(statement, PRELUDEDB_ERROR_QUERY);
+                free(bind);
+                goto error;
+        }
+
+        ret = table_new(table, metadata, statement, bind);
+        if ( ret < 0 ) {
+                free(bind);
+                goto error;
+        }
+
+        return (int) nrows;
+
+ error:
+        mysql_stmt_free_result(statement);
+        mysql_free_result(metadata);
+        return ret;
+}
+
+
+
+static void sql_statement_destroy(void *session, void *statement)
+{
+        mysql_stmt_close(statement);
+}
+
+
+
 static int sql_get_last_insert_ident(void *session, uint64_t *ident)
 {
         *ident = mysql_insert_id(session);
@@ -318,9 +552,24 @@ static int sql_get_last_insert_ident(void *session, uint64_t *ident)
 }
 
 
+static inline MYSQL_RES *get_result(preludedb_sql_table_t *table)
+{
+        return ((mysql_table_t *) preludedb_sql_table_get_data(table))->result;
+}
+
+
+
 static void sql_table_destroy(void *session, preludedb_sql_table_t *table)
 {
-        mysql_free_result(preludedb_sql_table_get_data(table));
+        mysql_table_t *data = preludedb_sql_table_get_data(table);
+
+        if ( data->statement ) {
+                mysql_stmt_free_result(data->statement);
+                free(data->bind);
+        }
+
+        mysql_free_result(data->result);
+        free(data);
 }
 
 
@@ -336,7 +585,7 @@ static const char *sql_get_column_name(void *session, preludedb_sql_table_t *tab
 {
         MYSQL_FIELD *field;
 
-        field = get_field(preludedb_sql_table_get_data(table), column_num);
+        field = get_field(get_result(table), column_num);
 
         return field ? field->name : NULL;
 }
@@ -347,7 +596,7 @@ static int sql_get_column_num(void *session, preludedb_sql_table_t *table, const
 {
         int fields_num, i;
         MYSQL_FIELD *fields;
-        MYSQL_RES *result = preludedb_sql_table_get_data(table);
+        MYSQL_RES *result = get_result(table);
 
         fields = mysql_fetch_fields(result);
         if ( ! fields )
@@ -366,23 +615,152 @@ static int sql_get_column_num(void *session, preludedb_sql_table_t *table, const
 
 static unsigned int sql_get_column_count(void *session, preludedb_sql_table_t *table)
 {
-        return mysql_num_fields(preludedb_sql_table_get_data(table));
+        return mysql_num_fields(get_result(table));
 }
 
 
 
 static unsigned int sql_get_row_count(void *session, preludedb_sql_table_t *table)
 {
-        return (unsigned int) mysql_num_rows(preludedb_sql_table_get_data(table));
+        mysql_table_t *data = preludedb_sql_table_get_data(table);
+
+        if ( data->statement )
+                return (unsigned int) mysql_stmt_num_rows(data->statement);
+
+        return (unsigned int) mysql_num_rows(data->result);
 }
 
 
 static void sql_destroy_row(void *session, preludedb_sql_table_t *table, preludedb_sql_row_t *row)
 {
-        free(preludedb_sql_row_get_data(row));
+        unsigned int i, column_count;
+        mysql_row_data_t *myrow = preludedb_sql_row_get_data(row);
+        mysql_table_t *data = preludedb_sql_table_get_data(table);
+
+        /*
+         * Values fetched from a prepared statement, or from a streamed
+         * result, are owned by the row.
+         */
+        if ( data->statement || data->stream ) {
+                column_count = preludedb_sql_table_get_column_count(table);
+
+                for ( i = 0; i < column_count; i++ )
+                        free(((char **) myrow->row)[i]);
+        }
+
+        free(myrow);
 }
 
 
+
+static int fetch_statement_row(mysql_table_t *data, unsigned int column_count, mysql_row_data_t **out)
+{
+        int ret;
+        char **values;
+        unsigned int i;
+        MYSQL_BIND bind;
+        unsigned long length;
+        mysql_row_data_t *myrow;
+
+        ret = mysql_stmt_fetch(data->statement);
+        if ( ret == MYSQL_NO_DATA )
+                return 0;
+
+        if ( ret != 0 && ret != MYSQL_DATA_TRUNCATED )
+                return handle_stmt_error(data->statement, PRELUDEDB_ERROR_GENERIC);
+
+        myrow = malloc(offsetof(mysql_row_data_t, lengths) + column_count * (sizeof(unsigned long) + sizeof(char *)));
+        if ( ! myrow )
+                return preludedb_error_from_errno(errno);
+
+        values = (char **) &myrow->lengths[column_count];
+        myrow->row = (void *) values;
+
+        for ( i = 0; i < column_count; i++ ) {
+                myrow->lengths[i] = *data->bind[i].length;
+
+                if ( *data->bind[i].is_null ) {
+                        values[i] = NULL;
+                        continue;
+                }
+
+                values[i] = malloc(myrow->lengths[i] + 1);
+                if ( ! values[i] ) {
+                        ret = preludedb_error_from_errno(errno);
+                        goto error;
+                }
+
+                memset(&bind, 0, sizeof(bind));
+                bind.buffer_type = MYSQL_TYPE_STRING;
+                bind.buffer = values[i];
+                bind.buffer_length = myrow->lengths[i] + 1;
+                bind.length = &length;
+
+                if ( mysql_stmt_fetch_column(data->statement, &bind, i, 0) != 0 ) {
+                        ret = handle_stmt_error(data->statement, PRELUDEDB_ERROR_GENERIC);
+                        i++;
+                        goto error;
+                }
+
+                values[i][myrow->lengths[i]] = '\0';
+        }
+
+        *out = myrow;
+        return 1;
+
+ error:
+        while ( i-- > 0 )
+                free(values[i]);
+
+        free(myrow);
+        return ret;
+}
+
+
+/*
+ * Rows of a streamed result are only valid until the next one is
+ * fetched, whereas a row can be referenced for longer: copy its values.
+ */
+static int copy_row(MYSQL_ROW row, unsigned long *lengths, unsigned int column_count, mysql_row_data_t **out)
+{
+        char **values;
+        unsigned int i;
+        mysql_row_data_t *myrow;
+
+        myrow = malloc(offsetof(mysql_row_data_t, lengths) + column_count * (sizeof(unsigned long) + sizeof(char *)));
+        if ( ! myrow )
+                return preludedb_error_from_errno(errno);
+
+        values = (char **) &myrow->lengths[column_count];
+        myrow->row = (void *) values;
+
+        for ( i = 0; i < column_count; i++ ) {
+                myrow->lengths[i] = lengths[i];
+
+                if ( ! row[i] ) {
+                        values[i] = NULL;
+                        continue;
+                }
+
+                values[i] = malloc(lengths[i] + 1);
+                if ( ! values[i] ) {
+                        while ( i-- > 0 )
+                                free(values[i]);
+
+                        free(myrow);
+                        return preludedb_error_from_errno(errno);
+                }
+
+                memcpy(values[i], row[i], lengths[i]);
+                values[i][lengths[i]] = '\0';
+        }
+
+        *out = myrow;
+        return 0;
+}
+
+
+
 static int sql_fetch_row(void *session, preludedb_sql_table_t *table, unsigned int row_index, preludedb_sql_row_t **rrow)
 {
         int ret;
@@ -390,12 +768,30 @@ static int sql_fetch_row(void *session, preludedb_sql_table_t *table, unsigned i
         mysql_row_data_t *myrow;
         unsigned long *lengths;
         unsigned int column_count, i;
-        MYSQL_RES *result = preludedb_sql_table_get_data(table);
+        mysql_table_t *data = preludedb_sql_table_get_data(table);
 
         column_count = preludedb_sql_table_get_column_count(table);
 
         while ( preludedb_sql_table_get_fetched_row_count(table) <= row_index ) {
-                row = mysql_fetch_row(result);
+                if ( data->statement ) {
+                        ret = fetch_statement_row(data, column_count, &myrow);
+                        if ( ret <= 0 )
+                                return ret;
+
+                        ret = preludedb_sql_table_new_row(table, rrow, preludedb_sql_table_get_fetched_row_count(table));
+                        if ( ret < 0 ) {
+                                for ( i = 0; i < column_count; i++ )
+                                        free(((char **) myrow->row)[i]);
+
+                                free(myrow);
+                                return ret;
+                        }
+
+                        preludedb_sql_row_set_data(*rrow, myrow);
+                        continue;
+                }
+
+                row = mysql_fetch_row(data->result);
                 if ( ! row ) {
                         ret = mysql_errno(session);
                         if ( ret )
@@ -404,10 +800,28 @@ static int sql_fetch_row(void *session, preludedb_sql_table_t *table, unsigned i
                         return 0;
                 }
 
-                lengths = mysql_fetch_lengths(result);
+                lengths = mysql_fetch_lengths(data->result);
                 if ( ! lengths )
                         return preludedb_error(PRELUDEDB_ERROR_GENERIC);
 
+                if ( data->stream ) {
+                        ret = copy_row(row, lengths, column_count, &myrow);
+                        if ( ret < 0 )
+                                return ret;
+
+                        ret = preludedb_sql_table_new_row(table, rrow, preludedb_sql_table_get_fetched_row_count(table));
+                        if ( ret < 0 ) {
+                                for ( i = 0; i < column_count; i++ )
+                                        free(((char **) myrow->row)[i]);
+
+                                free(myrow);
+                                return ret;
+                        }
+
+                        preludedb_sql_row_set_data(*rrow, myrow);
+                        continue;
+                }
+
                 ret = preludedb_sql_table_new_row(table, rrow, preludedb_sql_table_get_fetched_row_count(table));
                 if ( ret < 0 )
                         return ret;
@@ -437,7 +851,7 @@ static int sql_fetch_field(void *session, preludedb_sql_table_t *table, preluded
         void *data;
         size_t dlen = 0;
 
-        if ( column_num >= mysql_num_fields(preludedb_sql_table_get_data(table)) )
+        if ( column_num >= mysql_num_fields(get_result(table)) )
                 return preludedb_error(PRELUDEDB_ERROR_INVALID_COLUMN_NUM);
 
         data = d->row[column_num];
@@ -676,6 +1090,11 @@ int mysql_LTX_preludedb_plugin_init(prelude_plugin_entry_t *pe, void *data)
         preludedb_plugin_sql_set_build_time_timezone_string_func(plugin, sql_build_time_timezone_string);
         preludedb_plugin_sql_set_build_limit_offset_string_func(plugin, sql_build_limit_offset_string);
         preludedb_plugin_sql_set_get_last_insert_ident_func(plugin, sql_get_last_insert_ident);
+        preludedb_plugin_sql_set_statement_prepare_func(plugin, sql_statement_prepare);
+        preludedb_plugin_sql_set_statement_execute_func(plugin, sql_statement_execute);
+        preludedb_plugin_sql_set_statement_destroy_func(plugin, sql_statement_destroy);
+        preludedb_plugin_sql_set_get_escape_flags_func(plugin, sql_get_escape_flags);
+        preludedb_plugin_sql_set_query_stream_func(plugin, sql_query_stream);
 
         return 0;
 }
@@ -30,6 +30,7 @@
 #include <stdarg.h>
 #include <unistd.h>
 #include <errno.h>
+#include <poll.h>
 #include <sys/types.h>
 
 #include <libprelude/prelude-error.h>
@@ -44,6 +45,57 @@
 #include "preludedb.h"
 
 
+/*
+ * Types of the columns decoded natively when results are returned in
+ * binary form (see catalog/pg_type.h).
+ */
+#define PGSQL_TYPE_BYTEA        17
+#define PGSQL_TYPE_CHAR         18
+#define PGSQL_TYPE_NAME         19
+#define PGSQL_TYPE_INT8         20
+#define PGSQL_TYPE_INT2         21
+#define PGSQL_TYPE_INT4         23
+#define PGSQL_TYPE_TEXT         25
+#define PGSQL_TYPE_FLOAT4       700
+#define PGSQL_TYPE_FLOAT8       701
+#define PGSQL_TYPE_BPCHAR       1042
+#define PGSQL_TYPE_VARCHAR      1043
+#define PGSQL_TYPE_TIMESTAMP    1114
+#define PGSQL_TYPE_TIMESTAMPTZ  1184
+
+
+/*
+ * binary is -1 until the statement columns were checked, then tells
+ * whether its results can be fetched in binary form.
+ */
+typedef struct {
+        char name[64];
+        int binary;
+} pgsql_statement_t;
+
+
+/*
+ * Connection running asynchronous queries. result holds the last result
+ * of the query being completed, until libpq reports its end.
+ */
+typedef struct {
+        PGconn *conn;
+        PGresult *result;
+        prelude_bool_t pipeline;
+} pgsql_async_t;
+
+
+/*
+ * For a streamed result, conn is the connection rows are read from, one
+ * result per row, and result the first of them, which describes the columns.
+ */
+typedef struct {
+        PGresult *result;
+        PGconn *conn;
+        prelude_bool_t done;
+} pgsql_table_t;
+
+
 int pgsql_LTX_prelude_plugin_version(void);
 int pgsql_LTX_preludedb_plugin_init(prelude_plugin_entry_t *pe, void *data);
 
@@ -80,12 +132,11 @@ static int handle_error(prelude_error_code_t code, PGconn *conn)
 }
 
 
-static int _sql_query(void *session, const char *query, PGresult **result)
+static int get_result(void *session, PGresult **result)
 {
         char *tmp;
         int status, ntuple = 0;
 
-        *result = PQexec(session, query);
         if ( ! *result )
                 return handle_error(PRELUDEDB_ERROR_QUERY, session);
 
@@ -112,6 +163,14 @@ static int _sql_query(void *session, const char *query, PGresult **result)
 
 
 
+static int _sql_query(void *session, const char *query, PGresult **result)
+{
+        *result = PQexec(session, query);
+        return get_result(session, result);
+}
+
+
+
 static int sql_query_prepare(preludedb_sql_t *sql, preludedb_sql_query_t *query, prelude_string_t *output)
 {
         int ret;
@@ -135,6 +194,35 @@ static int sql_query_prepare(preludedb_sql_t *sql, preludedb_sql_query_t *query,
 
 
 
+static int table_new(preludedb_sql_table_t **table, PGresult *result, PGconn *conn)
+{
+        int ret;
+        pgsql_table_t *data;
+
+        data = malloc(sizeof(*data));
+        if ( ! data )
+                return preludedb_error_from_errno(errno);
+
+        data->result = result;
+        data->conn = conn;
+        data->done = FALSE;
+
+        ret = preludedb_sql_table_new(table, data);
+        if ( ret < 0 )
+                free(data);
+
+        return ret;
+}
+
+
+
+static inline PGresult *table_get_result(preludedb_sql_table_t *table)
+{
+        return ((pgsql_table_t *) preludedb_sql_table_get_data(table))->result;
+}
+
+
+
 static int sql_query(void *session, const char *query, preludedb_sql_table_t **table)
 {
         int ret, ret2;
@@ -147,7 +235,391 @@ static int sql_query(void *session, const char *query, preludedb_sql_table_t **t
         if ( ! table )
                 PQclear(result);
         else {
-                ret2 = preludedb_sql_table_new(table, result);
+                ret2 = table_new(table, result, NULL);
+                if ( ret2 < 0 ) {
+                        PQclear(result);
+                        return ret2;
+                }
+        }
+
+        return ret;
+}
+
+
+
+#ifdef HAVE_PQSETSINGLEROWMODE
+static void stream_drain(PGconn *conn)
+{
+        PGresult *result;
+
+        while ( (result = PQgetResult(conn)) )
+                PQclear(result);
+}
+
+
+
+/*
+ * Rows are retrieved one at a time: the first result carries the first
+ * row, if any, and the description of the columns.
+ */
+static int sql_query_stream(void *session, const char *query, preludedb_sql_table_t **table)
+{
+        int ret;
+        PGresult *result;
+
+        if ( ! PQsendQuery(session, query) )
+                return handle_error(PRELUDEDB_ERROR_QUERY, session);
+
+        if ( ! PQsetSingleRowMode(session) ) {
+                stream_drain(session);
+                return preludedb_error_verbose(PRELUDEDB_ERROR_QUERY, "could not enable single row mode");
+        }
+
+        result = PQgetResult(session);
+        if ( result && PQresultStatus(result) == PGRES_SINGLE_TUPLE ) {
+                ret = table_new(table, result, session);
+                if ( ret < 0 ) {
+                        PQclear(result);
+                        stream_drain(session);
+                        return ret;
+                }
+
+                return 1;
+        }
+
+        ret = get_result(session, &result);
+        stream_drain(session);
+
+        return ret;
+}
+
+
+
+static int stream_fetch_row(pgsql_table_t *data, preludedb_sql_table_t *table, unsigned int row_index, preludedb_sql_row_t **row)
+{
+        int ret;
+        PGresult *result;
+
+        while ( preludedb_sql_table_get_fetched_row_count(table) <= row_index ) {
+                if ( preludedb_sql_table_get_fetched_row_count(table) == 0 )
+                        result = data->result;
+                else {
+                        result = PQgetResult(data->conn);
+                        if ( ! result || PQresultStatus(result) != PGRES_SINGLE_TUPLE ) {
+                                ret = (result && PQresultStatus(result) == PGRES_TUPLES_OK) ? 0 : handle_error(PRELUDEDB_ERROR_QUERY, data->conn);
+
+                                PQclear(result);
+                                stream_drain(data->conn);
+                                data->done = TRUE;
+
+                                return ret;
+                        }
+                }
+
+                ret = preludedb_sql_table_new_row(table, row, preludedb_sql_table_get_fetched_row_count(table));
+                if ( ret < 0 ) {
+                        if ( result != data->result )
+                                PQclear(result);
+
+                        return ret;
+                }
+
+                preludedb_sql_row_set_data(*row, result);
+        }
+
+        return 1;
+}
+#endif
+
+
+
+static prelude_bool_t is_ident_char(char c)
+{
+        return (isalnum((unsigned char) c) || c == '_' || c & 0x80) ? TRUE : FALSE;
+}
+
+
+
+/*
+ * If a string constant, quoted identifier or comment starts at @query,
+ * return a pointer past its end, NULL otherwise. This follows the PostgreSQL
+ * lexer: backslash escapes apply in E'' strings, and in all strings when
+ * standard_conforming_strings is off (@scs is FALSE); dollar quoted strings
+ * end with their opening tag; block comments nest.
+ */
+static const char *skip_literal(const char *base, const char *query, prelude_bool_t scs)
+{
+        size_t len;
+        int depth = 0;
+        const char *end;
+        prelude_bool_t backslash;
+
+        if ( query[0] == '-' && query[1] == '-' )
+                return query + strcspn(query, "\n");
+
+        if ( query[0] == '/' && query[1] == '*' ) {
+                for ( ; *query; query++ ) {
+                        if ( query[0] == '/' && query[1] == '*' ) {
+                                depth++;
+                                query++;
+                        }
+
+                        else if ( query[0] == '*' && query[1] == '/' ) {
+                                query++;
+                                if ( --depth == 0 )
+                                        return query + 1;
+                        }
+                }
+
+                return query;
+        }
+
+        /*
+         * $tag$ or $$, but not a $n parameter nor a '$' within an identifier.
+         */
+        if ( *query == '$' && ! isdigit((unsigned char) query[1]) && (query == base || ! is_ident_char(query[-1])) ) {
+                for ( end = query + 1; is_ident_char(*end); end++ );
+                if ( *end != '$' )
+                        return NULL;
+
+                len = end - query + 1;
+
+                for ( end = query + len; *end; end++ ) {
+                        if ( strncmp(end, query, len) == 0 )
+                                return end + len;
+                }
+
+                return end;
+        }
+
+        if ( *query == '"' ) {
+                end = strchr(query + 1, '"');
+                return (end) ? end + 1 : query + strlen(query);
+        }
+
+        if ( *query != '\'' )
+                return NULL;
+
+        backslash = ! scs;
+        if ( query > base && (query[-1] == 'E' || query[-1] == 'e') && (query - 1 == base || ! is_ident_char(query[-2])) )
+                backslash = TRUE;
+
+        for ( query++; *query; query++ ) {
+                if ( *query == '\\' && backslash && query[1] )
+                        query++;
+
+                else if ( *query == '\'' )
+                        return query + 1;
+        }
+
+        return query;
+}
+
+
+
+/*
+ * Turn the '?' placeholders of @query into PostgreSQL $n ones, leaving
+ * string constants, quoted identifiers and comments untouched.
+ */
+static int convert_placeholders(void *session, const char *query, prelude_string_t *output)
+{
+        int ret;
+        unsigned int i = 0;
+        prelude_bool_t scs;
+        const char *base = query, *start = query, *end, *value;
+
+        value = PQparameterStatus(session, "standard_conforming_strings");
+        scs = (value && strcmp(value, "on") == 0) ? TRUE : FALSE;
+
+        while ( *query ) {
+                end = skip_literal(base, query, scs);
+                if ( end ) {
+                        query = end;
+                        continue;
+                }
+
+                if ( *query != '?' ) {
+                        query++;
+                        continue;
+                }
+
+                ret = prelude_string_ncat(output, start, query - start);
+                if ( ret < 0 )
+                        return ret;
+
+                ret = prelude_string_sprintf(output, "$%u", ++i);
+                if ( ret < 0 )
+                        return ret;
+
+                start = ++query;
+        }
+
+        return prelude_string_cat(output, start);
+}
+
+
+
+static int sql_statement_prepare(void *session, const char *query, unsigned int nparams, void **statement)
+{
+        int ret;
+        PGresult *result;
+        pgsql_statement_t *st;
+        prelude_string_t *str;
+        static unsigned int statement_count = 0;
+
+        ret = prelude_string_new(&str);
+        if ( ret < 0 )
+                return ret;
+
+        ret = convert_placeholders(session, query, str);
+        if ( ret < 0 ) {
+                prelude_string_destroy(str);
+                return ret;
+        }
+
+        st = malloc(sizeof(*st));
+        if ( ! st ) {
+                prelude_string_destroy(str);
+                return preludedb_error_from_errno(errno);
+        }
+
+        /*
+         * The address of the statement makes the name unique among the
+         * living statements, the counter among the deallocated ones.
+         */
+        snprintf(st->name, sizeof(st->name), "preludedb_%p_%u", (void *) st, statement_count++);
+        st->binary = -1;
+
+        result = PQprepare(session, st->name, prelude_string_get_string(str), nparams, NULL);
+        prelude_string_destroy(str);
+
+        ret = get_result(session, &result);
+        if ( ret < 0 ) {
+                free(st);
+                return ret;
+        }
+
+        *statement = st;
+
+        return 0;
+}
+
+
+
+static int get_field_type(Oid type, preludedb_sql_field_type_t *ftype)
+{
+        switch ( type ) {
+        case PGSQL_TYPE_INT2:
+        case PGSQL_TYPE_INT4:
+        case PGSQL_TYPE_INT8:
+                *ftype = PRELUDEDB_SQL_FIELD_TYPE_INTEGER;
+                return 0;
+
+        case PGSQL_TYPE_FLOAT4:
+        case PGSQL_TYPE_FLOAT8:
+                *ftype = PRELUDEDB_SQL_FIELD_TYPE_FLOAT;
+                return 0;
+
+        case PGSQL_TYPE_TIMESTAMP:
+        case PGSQL_TYPE_TIMESTAMPTZ:
+                *ftype = PRELUDEDB_SQL_FIELD_TYPE_TIMESTAMP;
+                return 0;
+
+        case PGSQL_TYPE_BYTEA:
+                *ftype = PRELUDEDB_SQL_FIELD_TYPE_BINARY;
+                return 0;
+
+        /*
+         * Character types have the same binary and text representation.
+         */
+        case PGSQL_TYPE_CHAR:
+        case PGSQL_TYPE_NAME:
+        case PGSQL_TYPE_TEXT:
+        case PGSQL_TYPE_BPCHAR:
+        case PGSQL_TYPE_VARCHAR:
+                *ftype = PRELUDEDB_SQL_FIELD_TYPE_TEXT;
+                return 0;
+
+        default:
+                return -1;
+        }
+}
+
+
+
+/*
+ * Results are only fetched in binary form when every column has a type
+ * decoded natively, numeric or user defined types staying in text form.
+ * Servers still using floating point timestamps are left aside as well.
+ */
+static int statement_check_binary(PGconn *conn, pgsql_statement_t *st)
+{
+        int i, nfields;
+        PGresult *result;
+        const char *datetimes;
+        preludedb_sql_field_type_t type;
+
+        result = PQdescribePrepared(conn, st->name);
+        if ( ! result || PQresultStatus(result) != PGRES_COMMAND_OK ) {
+                if ( result )
+                        PQclear(result);
+
+                return handle_error(PRELUDEDB_ERROR_QUERY, conn);
+        }
+
+        datetimes = PQparameterStatus(conn, "integer_datetimes");
+        st->binary = (datetimes && strcmp(datetimes, "on") == 0);
+
+        nfields = PQnfields(result);
+        for ( i = 0; i < nfields && st->binary; i++ ) {
+                if ( get_field_type(PQftype(result, i), &type) < 0 )
+                        st->binary = FALSE;
+        }
+
+        PQclear(result);
+
+        return 0;
+}
+
+
+
+static int statement_execute(PGconn *session, pgsql_statement_t *statement, const preludedb_sql_param_t *params,
+                             unsigned int nparams, int result_format, preludedb_sql_table_t **table)
+{
+        int ret, ret2;
+        unsigned int i;
+        PGresult *result;
+        const char **values;
+        int *lengths, *formats;
+
+        values = malloc(nparams * (sizeof(*values) + 2 * sizeof(int)) + 1);
+        if ( ! values )
+                return preludedb_error_from_errno(errno);
+
+        lengths = (int *) &values[nparams];
+        formats = &lengths[nparams];
+
+        /*
+         * Binary values (e.g. bytea) are sent in binary format, avoiding
+         * their escaped hexadecimal representation.
+         */
+        for ( i = 0; i < nparams; i++ ) {
+                values[i] = params[i].value;
+                lengths[i] = params[i].len;
+                formats[i] = (params[i].type == PRELUDEDB_SQL_PARAM_TYPE_BINARY) ? 1 : 0;
+        }
+
+        result = PQexecPrepared(session, statement->name, nparams, values, lengths, formats, result_format);
+        free(values);
+
+        ret = get_result(session, &result);
+        if ( ret <= 0 || ! result )
+                return ret;
+
+        if ( ! table )
+                PQclear(result);
+        else {
+                ret2 = table_new(table, result, NULL);
                 if ( ret2 < 0 ) {
                         PQclear(result);
                         return ret2;
@@ -159,6 +631,46 @@ static int sql_query(void *session, const char *query, preludedb_sql_table_t **t
 
 
 
+static int sql_statement_execute(void *session, void *statement, const preludedb_sql_param_t *params,
+                                 unsigned int nparams, preludedb_sql_table_t **table)
+{
+        return statement_execute(session, statement, params, nparams, 0, table);
+}
+
+
+
+static int sql_statement_execute_binary(void *session, void *statement, const preludedb_sql_param_t *params,
+                                        unsigned int nparams, preludedb_sql_table_t **table)
+{
+        int ret;
+        pgsql_statement_t *st = statement;
+
+        if ( st->binary < 0 ) {
+                ret = statement_check_binary(session, st);
+                if ( ret < 0 )
+                        return ret;
+        }
+
+        return statement_execute(session, st, params, nparams, st->binary ? 1 : 0, table);
+}
+
+
+
+static void sql_statement_destroy(void *session, void *statement)
+{
+        char query[128];
+        pgsql_statement_t *st = statement;
+
+        if ( session && PQstatus(session) == CONNECTION_OK ) {
+                snprintf(query, sizeof(query), "DEALLOCATE \"%s\"", st->name);
+                PQclear(PQexec(session, query));
+        }
+
+        free(st);
+}
+
+
+
 static int sql_get_last_insert_ident(void *session, uint64_t *ident)
 {
         int ret;
@@ -186,6 +698,200 @@ static int sql_get_last_insert_ident(void *session, uint64_t *ident)
 
 
 
+static int sql_reserve_idents(void *session, const char *table, const char *column, uint64_t *idents, size_t count)
+{
+        int ret, i;
+        PGresult *result;
+        char query[512];
+
+        /*
+         * Pull the values straight out of the sequence backing the column:
+         * they will never be handed out again, whatever client inserts next.
+         */
+        ret = snprintf(query, sizeof(query),
+                       "SELECT nextval(pg_get_serial_sequence('%s', '%s')) FROM generate_series(1, %" PRELUDE_PRIu64 ");",
+                       table, column, (uint64_t) count);
+        if ( ret < 0 || (size_t) ret >= sizeof(query) )
+                return preludedb_error(PRELUDEDB_ERROR_GENERIC);
+
+        ret = _sql_query(session, query, &result);
+        if ( ret <= 0 )
+                return ret;
+
+        for ( i = 0; i < ret; i++ ) {
+                if ( sscanf(PQgetvalue(result, i, 0), "%" PRELUDE_SCNu64, &idents[i]) <= 0 ) {
+                        PQclear(result);
+                        return preludedb_error_verbose(PRELUDEDB_ERROR_INVALID_VALUE, "reserved sequence value is invalid");
+                }
+        }
+
+        PQclear(result);
+
+        return ret;
+}
+
+
+
+/*
+ * Rows sent with COPY are accumulated up to this size before being handed
+ * to libpq.
+ */
+#define COPY_BUFFER_SIZE (64 * 1024)
+
+
+/*
+ * Append @param to @buf in the COPY text format, where the backslash
+ * introduces escape sequences. Binary values are bytea, written in the
+ * hex format.
+ */
+static int copy_add_value(prelude_string_t *buf, const preludedb_sql_param_t *param)
+{
+        int ret;
+        size_t i, n;
+        char hex[128];
+        const char *esc, *value = param->value;
+        static const char digits[] = "0123456789abcdef";
+
+        if ( ! value )
+                return prelude_string_ncat(buf, "\\N", 2);
+
+        if ( param->type == PRELUDEDB_SQL_PARAM_TYPE_BINARY ) {
+                ret = prelude_string_ncat(buf, "\\\\x", 3);
+
+                for ( i = 0; i < param->len && ret >= 0; i += n ) {
+                        for ( n = 0; n < sizeof(hex) / 2 && i + n < param->len; n++ ) {
+                                hex[n * 2] = digits[(unsigned char) value[i + n] >> 4];
+                                hex[n * 2 + 1] = digits[(unsigned char) value[i + n] & 0x0f];
+                        }
+
+                        ret = prelude_string_ncat(buf, hex, n * 2);
+                }
+
+                return ret;
+        }
+
+        for ( i = n = 0; i < param->len; i++ ) {
+                switch ( value[i] ) {
+                case '\\':
+                        esc = "\\\\";
+                        break;
+                case '\t':
+                        esc = "\\t";
+                        break;
+                case '\n':
+                        esc = "\\n";
+                        break;
+                case '\r':
+                        esc = "\\r";
+                        break;
+                default:
+                        continue;
+                }
+
+                if ( i > n ) {
+                        ret = prelude_string_ncat(buf, value + n, i - n);
+                        if ( ret < 0 )
+                                return ret;
+                }
+
+                ret = prelude_string_ncat(buf, esc, 2);
+                if ( ret < 0 )
+                        return ret;
+
+                n = i + 1;
+        }
+
+        return (i > n) ? prelude_string_ncat(buf, value + n, i - n) : 0;
+}
+
+
+
+static int copy_put(PGconn *conn, prelude_string_t *buf)
+{
+        int ret;
+
+        ret = PQputCopyData(conn, prelude_string_get_string(buf), prelude_string_get_len(buf));
+        prelude_string_clear(buf);
+
+        return (ret == 1) ? 0 : handle_error(PRELUDEDB_ERROR_QUERY, conn);
+}
+
+
+
+/*
+ * Stream the rows with COPY ... FROM STDIN, in text format: values are
+ * only known as text here, the binary format would require encoding each
+ * one according to its column type.
+ */
+static int sql_copy(void *session, const char *table, const char *fields,
+                    const preludedb_sql_param_t *params, unsigned int ncolumns, unsigned int nrows)
+{
+        int ret;
+        unsigned int i, j;
+        PGresult *result;
+        prelude_string_t *buf;
+
+        ret = prelude_string_new(&buf);
+        if ( ret < 0 )
+                return ret;
+
+        ret = prelude_string_sprintf(buf, "COPY %s (%s) FROM STDIN", table, fields);
+        if ( ret < 0 )
+                goto error;
+
+        result = PQexec(session, prelude_string_get_string(buf));
+        if ( ! result || PQresultStatus(result) != PGRES_COPY_IN ) {
+                ret = handle_error(PRELUDEDB_ERROR_QUERY, session);
+                if ( result )
+                        PQclear(result);
+                goto error;
+        }
+
+        PQclear(result);
+        prelude_string_clear(buf);
+
+        for ( i = 0; i < nrows && ret >= 0; i++ ) {
+                for ( j = 0; j < ncolumns && ret >= 0; j++ ) {
+                        if ( j > 0 )
+                                ret = prelude_string_ncat(buf, "\t", 1);
+
+                        if ( ret >= 0 )
+                                ret = copy_add_value(buf, &params[i * ncolumns + j]);
+                }
+
+                if ( ret >= 0 )
+                        ret = prelude_string_ncat(buf, "\n", 1);
+
+                if ( ret >= 0 && prelude_string_get_len(buf) >= COPY_BUFFER_SIZE )
+                        ret = copy_put(session, buf);
+        }
+
+        if ( ret >= 0 && ! prelude_string_is_empty(buf) )
+                ret = copy_put(session, buf);
+
+        /*
+         * On failure, the COPY is aborted server side, and the error the
+         * server reports is dropped in favor of the original one.
+         */
+        if ( PQputCopyEnd(session, (ret < 0) ? "aborted by client" : NULL) != 1 && ret >= 0 )
+                ret = handle_error(PRELUDEDB_ERROR_QUERY, session);
+
+        result = PQgetResult(session);
+        if ( ret >= 0 )
+                ret = get_result(session, &result);
+        else if ( result )
+                PQclear(result);
+
+        while ( (result = PQgetResult(session)) )
+                PQclear(result);
+
+ error:
+        prelude_string_destroy(buf);
+        return ret;
+}
+
+
+
 static int check_settings(PGconn *session)
 {
         int ret;
@@ -268,6 +974,143 @@ static void sql_close(void *session)
 }
 
 
+
+static int sql_async_open(preludedb_sql_settings_t *settings, void **async)
+{
+        int ret;
+        void *conn;
+        pgsql_async_t *a;
+
+        ret = sql_open(settings, &conn);
+        if ( ret < 0 )
+                return ret;
+
+        if ( PQsetnonblocking(conn, 1) != 0 ) {
+                ret = handle_error(PRELUDEDB_ERROR_CONNECTION, conn);
+                PQfinish(conn);
+                return ret;
+        }
+
+        a = calloc(1, sizeof(*a));
+        if ( ! a ) {
+                PQfinish(conn);
+                return preludedb_error_from_errno(errno);
+        }
+
+        a->conn = conn;
+#ifdef HAVE_PQENTERPIPELINEMODE
+        a->pipeline = PQenterPipelineMode(conn) ? TRUE : FALSE;
+#endif
+
+        *async = a;
+
+        return 0;
+}
+
+
+
+static void sql_async_close(void *async)
+{
+        pgsql_async_t *a = async;
+
+        if ( a->result )
+                PQclear(a->result);
+
+        PQfinish(a->conn);
+        free(a);
+}
+
+
+
+/*
+ * In pipeline mode, each query is followed by a synchronization point,
+ * so that a failing query does not abort the ones sent after it.
+ */
+static int sql_async_send(void *async, const char *query)
+{
+        pgsql_async_t *a = async;
+
+#ifdef HAVE_PQENTERPIPELINEMODE
+        if ( a->pipeline ) {
+                if ( ! PQsendQueryParams(a->conn, query, 0, NULL, NULL, NULL, NULL, 0) || ! PQpipelineSync(a->conn) )
+                        return handle_error(PRELUDEDB_ERROR_QUERY, a->conn);
+        } else
+#endif
+        if ( ! PQsendQuery(a->conn, query) )
+                return handle_error(PRELUDEDB_ERROR_QUERY, a->conn);
+
+        if ( PQflush(a->conn) < 0 )
+                return handle_error(PRELUDEDB_ERROR_CONNECTION, a->conn);
+
+        return a->pipeline ? 1 : 0;
+}
+
+
+
+static int sql_async_poll(void *async, int *status, preludedb_sql_table_t **table)
+{
+        int ret;
+        PGresult *result;
+        pgsql_async_t *a = async;
+
+        if ( PQflush(a->conn) < 0 || ! PQconsumeInput(a->conn) )
+                return handle_error(PRELUDEDB_ERROR_CONNECTION, a->conn);
+
+        while ( ! PQisBusy(a->conn) ) {
+                result = PQgetResult(a->conn);
+                if ( result ) {
+#ifdef HAVE_PQENTERPIPELINEMODE
+                        if ( PQresultStatus(result) == PGRES_PIPELINE_SYNC ) {
+                                PQclear(result);
+                                continue;
+                        }
+#endif
+                        if ( a->result )
+                                PQclear(a->result);
+
+                        a->result = result;
+                        continue;
+                }
+
+                /*
+                 * The query is complete.
+                 */
+                result = a->result;
+                a->result = NULL;
+
+                *status = get_result(a->conn, &result);
+                if ( *status > 0 && result ) {
+                        ret = table_new(table, result, NULL);
+                        if ( ret < 0 ) {
+                                PQclear(result);
+                                *status = ret;
+                        }
+                }
+
+                return 1;
+        }
+
+        return 0;
+}
+
+
+
+static int sql_async_get_fd(void *async, int *events)
+{
+        pgsql_async_t *a = async;
+
+        *events = POLLIN;
+
+        /*
+         * Part of the queries could not be sent yet.
+         */
+        if ( PQflush(a->conn) == 1 )
+                *events |= POLLOUT;
+
+        return PQsocket(a->conn);
+}
+
+
 static int sql_escape(void *session, const char *input, size_t input_size, char **output)
 {
 #ifdef HAVE_PQESCAPESTRINGCONN
@@ -368,14 +1211,45 @@ static int sql_build_limit_offset_string(void *session, int limit, int offset, p
 
 static void sql_table_destroy(void *session, preludedb_sql_table_t *table)
 {
-        PQclear(preludedb_sql_table_get_data(table));
+        pgsql_table_t *data = preludedb_sql_table_get_data(table);
+#ifdef HAVE_PQSETSINGLEROWMODE
+        char errbuf[256];
+        PGcancel *cancel;
+
+        /*
+         * Rows left have to be read before the connection can be used
+         * again: have the server stop sending them.
+         */
+        if ( data->conn && ! data->done ) {
+                cancel = PQgetCancel(data->conn);
+                if ( cancel ) {
+                        PQcancel(cancel, errbuf, sizeof(errbuf));
+                        PQfreeCancel(cancel);
+                }
+
+                stream_drain(data->conn);
+        }
+#endif
+
+        PQclear(data->result);
+        free(data);
+}
+
+
+
+static void sql_row_destroy(void *session, preludedb_sql_table_t *table, preludedb_sql_row_t *row)
+{
+        pgsql_table_t *data = preludedb_sql_table_get_data(table);
+
+        if ( data->conn && preludedb_sql_row_get_data(row) != data->result )
+                PQclear(preludedb_sql_row_get_data(row));
 }
 
 
 
 static const char *sql_get_column_name(void *session, preludedb_sql_table_t *table, unsigned int column_num)
 {
-        return PQfname(preludedb_sql_table_get_data(table), column_num);
+        return PQfname(table_get_result(table), column_num);
 }
 
 
@@ -384,7 +1258,7 @@ static int sql_get_column_num(void *session, preludedb_sql_table_t *table, const
 {
         int ret;
 
-        ret = PQfnumber(preludedb_sql_table_get_data(table), column_name);
+        ret = PQfnumber(table_get_result(table), column_name);
         if ( ret < 0 )
                 return prelude_error_verbose(PRELUDEDB_ERROR_GENERIC, "unknown column '%s'", column_name);
 
@@ -395,14 +1269,14 @@ static int sql_get_column_num(void *session, preludedb_sql_table_t *table, const
 
 static unsigned int sql_get_column_count(void *session, preludedb_sql_table_t *table)
 {
-        return PQnfields(preludedb_sql_table_get_data(table));
+        return PQnfields(table_get_result(table));
 }
 
 
 
 static unsigned int sql_get_row_count(void *session, preludedb_sql_table_t *table)
 {
-        return PQntuples(preludedb_sql_table_get_data(table));
+        return PQntuples(table_get_result(table));
 }
 
 
@@ -411,8 +1285,14 @@ static int sql_fetch_row(void *s, preludedb_sql_table_t *table, unsigned int row
 {
         int ret;
         unsigned int row_count;
+        pgsql_table_t *data = preludedb_sql_table_get_data(table);
+
+#ifdef HAVE_PQSETSINGLEROWMODE
+        if ( data->conn )
+                return stream_fetch_row(data, table, row_index, row);
+#endif
 
-        row_count = PQntuples(preludedb_sql_table_get_data(table));
+        row_count = PQntuples(data->result);
         if ( row_index < row_count ) {
                 ret = preludedb_sql_table_new_row(table, row, row_index);
                 if ( ret < 0 )
@@ -432,11 +1312,20 @@ static int sql_fetch_field(void *session, preludedb_sql_table_t *table, preluded
 {
         char *value;
         void *valaddr = preludedb_sql_row_get_data(row);
-        PGresult *result = preludedb_sql_table_get_data(table);
-        int nfields, len;
+        pgsql_table_t *data = preludedb_sql_table_get_data(table);
+        PGresult *result = data->result;
+        int ret, nfields, len;
+        preludedb_sql_field_type_t type;
         unsigned int row_index;
 
-        row_index = (unsigned int) (unsigned long) valaddr;
+        /*
+         * Streamed rows each come with their own result.
+         */
+        if ( data->conn ) {
+                result = valaddr;
+                row_index = 0;
+        } else
+                row_index = (unsigned int) (unsigned long) valaddr;
 
         nfields = PQnfields(result);
         if ( nfields < 0 || column_num >= (unsigned int) nfields )
@@ -450,7 +1339,16 @@ static int sql_fetch_field(void *session, preludedb_sql_table_t *table, preluded
                 len = PQgetlength(result, row_index, column_num);
         }
 
-        return preludedb_sql_row_new_field(row, field, column_num, value, len);
+        ret = preludedb_sql_row_new_field(row, field, column_num, value, len);
+        if ( ret <= 0 || PQfformat(result, column_num) != 1 )
+                return ret;
+
+        if ( get_field_type(PQftype(result, column_num), &type) < 0 )
+                return preludedb_error_verbose(PRELUDEDB_ERROR_GENERIC, "unsupported binary type for column %u", column_num);
+
+        preludedb_sql_field_set_type(*field, type);
+
+        return ret;
 }
 
 
@@ -657,6 +1555,33 @@ static long sql_get_server_version(void *session)
 
 
 
+/*
+ * Strings are escaped by doubling quotes as long as backslashes are not
+ * special, and the client encoding has no multibyte character ending
+ * with an ASCII byte. Binary data are written in hex form from 9.0 on.
+ */
+static int sql_get_escape_flags(void *session)
+{
+        unsigned int i;
+        const char *scs, *encoding;
+        static const char *unsafe_encodings[] = { "SJIS", "SHIFT_JIS_2004", "BIG5", "GBK", "UHC", "GB18030", "JOHAB" };
+
+        scs = PQparameterStatus(session, "standard_conforming_strings");
+        encoding = PQparameterStatus(session, "client_encoding");
+
+        if ( ! scs || strcmp(scs, "on") != 0 || ! encoding )
+                return preludedb_error(PRELUDEDB_ERROR_GENERIC);
+
+        for ( i = 0; i < sizeof(unsafe_encodings) / sizeof(*unsafe_encodings); i++ ) {
+                if ( strcmp(encoding, unsafe_encodings[i]) == 0 )
+                        return preludedb_error(PRELUDEDB_ERROR_GENERIC);
+        }
+
+        return (PQserverVersion(session) >= 90000) ? PRELUDEDB_PLUGIN_SQL_ESCAPE_BINARY_BYTEA_HEX : 0;
+}
+
+
+
 int pgsql_LTX_preludedb_plugin_init(prelude_plugin_entry_t *pe, void *data)
 {
         int ret;
@@ -677,6 +1602,7 @@ int pgsql_LTX_preludedb_plugin_init(prelude_plugin_entry_t *pe, void *data)
         preludedb_plugin_sql_set_query_prepare_func(plugin, sql_query_prepare);
         preludedb_plugin_sql_set_query_func(plugin, sql_query);
         preludedb_plugin_sql_set_get_server_version_func(plugin, sql_get_server_version);
+        preludedb_plugin_sql_set_get_escape_flags_func(plugin, sql_get_escape_flags);
         preludedb_plugin_sql_set_table_destroy_func(plugin, sql_table_destroy);
         preludedb_plugin_sql_set_get_column_count_func(plugin, sql_get_column_count);
         preludedb_plugin_sql_set_get_row_count_func(plugin, sql_get_row_count);
@@ -684,6 +1610,7 @@ int pgsql_LTX_preludedb_plugin_init(prelude_plugin_entry_t *pe, void *data)
         preludedb_plugin_sql_set_get_column_num_func(plugin, sql_get_column_num);
         preludedb_plugin_sql_set_get_operator_string_func(plugin, get_operator_string);
         preludedb_plugin_sql_set_fetch_row_func(plugin, sql_fetch_row);
+        preludedb_plugin_sql_set_row_destroy_func(plugin, sql_row_destroy);
         preludedb_plugin_sql_set_fetch_field_func(plugin, sql_fetch_field);
         preludedb_plugin_sql_set_build_constraint_string_func(plugin, sql_build_constraint_string);
         preludedb_plugin_sql_set_build_time_extract_string_func(plugin, sql_build_time_extract_string);
@@ -692,6 +1619,20 @@ int pgsql_LTX_preludedb_plugin_init(prelude_plugin_entry_t *pe, void *data)
         preludedb_plugin_sql_set_build_time_interval_string_func(plugin, sql_build_time_interval_string);
         preludedb_plugin_sql_set_build_limit_offset_string_func(plugin, sql_build_limit_offset_string);
         preludedb_plugin_sql_set_get_last_insert_ident_func(plugin, sql_get_last_insert_ident);
+        preludedb_plugin_sql_set_reserve_idents_func(plugin, sql_reserve_idents);
+        preludedb_plugin_sql_set_statement_prepare_func(plugin, sql_statement_prepare);
+        preludedb_plugin_sql_set_statement_execute_func(plugin, sql_statement_execute);
+        preludedb_plugin_sql_set_statement_execute_binary_func(plugin, sql_statement_execute_binary);
+        preludedb_plugin_sql_set_statement_destroy_func(plugin, sql_statement_destroy);
+#ifdef HAVE_PQSETSINGLEROWMODE
+        preludedb_plugin_sql_set_query_stream_func(plugin, sql_query_stream);
+#endif
+        preludedb_plugin_sql_set_async_open_func(plugin, sql_async_open);
+        preludedb_plugin_sql_set_async_close_func(plugin, sql_async_close);
+        preludedb_plugin_sql_set_async_send_func(plugin, sql_async_send);
+        preludedb_plugin_sql_set_async_poll_func(plugin, sql_async_poll);
+        preludedb_plugin_sql_set_async_get_fd_func(plugin, sql_async_get_fd);
+        preludedb_plugin_sql_set_copy_func(plugin, sql_copy);
 
         return 0;
 }
@@ -24,6 +24,7 @@
 #include "config.h"
 
 #include <stdio.h>
+#include <ctype.h>
 #include <string.h>
 #include <stdlib.h>
 #include <stdarg.h>
@@ -43,6 +44,12 @@
 
 #define SQLITE_BUSY_TIMEOUT INT_MAX
 
+#if SQLITE_VERSION_NUMBER >= 3003009
+# define sqlite3_prepare_statement sqlite3_prepare_v2
+#else
+# define sqlite3_prepare_statement sqlite3_prepare
+#endif
+
 
 /*
  * Up to SQLite 3.2.2, there was no way to create an user defined
@@ -60,31 +67,150 @@
 
 
 
+/*
+ * Result of a query: the statement is stepped as rows are fetched. A
+ * prepared statement is only reset once done with, so that it can be
+ * executed again.
+ */
+typedef struct {
+        sqlite3_stmt *statement;
+        prelude_bool_t prepared;
+} sqlite3_table_t;
+
+
 int sqlite3_LTX_prelude_plugin_version(void);
 int sqlite3_LTX_preludedb_plugin_init(prelude_plugin_entry_t *pe, void *data);
 
 
 
+static void regex_destroy(void *regex)
+{
+        regfree(regex);
+        free(regex);
+}
+
+
+
+/*
+ * The compiled pattern is attached to the pattern argument, and reused by
+ * SQLite for as long as that argument does not change: a constant pattern
+ * is only compiled once per statement execution, rather than once per row.
+ */
 static void sqlite3_regexp(sqlite3_context *context, int argc, sqlite3_value **argv)
 {
         int ret;
-        regex_t regex;
+        regex_t *regex;
+        prelude_bool_t compiled = FALSE;
+        const char *pattern, *value;
 
         if ( argc != 2 ) {
                 sqlite3_result_error(context, "Invalid argument count", -1);
                 return;
         }
 
-        ret = regcomp(&regex, (const char *) sqlite3_value_text(argv[0]), REG_EXTENDED | REG_NOSUB);
-        if ( ret != 0 ) {
-                sqlite3_result_error(context, "error compiling regular expression", -1);
+        pattern = (const char *) sqlite3_value_text(argv[0]);
+        value = (const char *) sqlite3_value_text(argv[1]);
+        if ( ! pattern || ! value ) {
+                sqlite3_result_null(context);
                 return;
         }
 
-        ret = regexec(&regex, (const char *) sqlite3_value_text(argv[1]), 0, NULL, 0);
-        regfree(&regex);
+        regex = sqlite3_get_auxdata(context, 0);
+        if ( ! regex ) {
+                regex = malloc(sizeof(*regex));
+                if ( ! regex ) {
+                        sqlite3_result_error_nomem(context);
+                        return;
+                }
+
+                ret = regcomp(regex, pattern, REG_EXTENDED | REG_NOSUB);
+                if ( ret != 0 ) {
+                        free(regex);
+                        sqlite3_result_error(context, "error compiling regular expression", -1);
+                        return;
+                }
 
+                compiled = TRUE;
+        }
+
+        ret = regexec(regex, value, 0, NULL, 0);
         sqlite3_result_int(context, (ret == REG_NOMATCH) ? 0 : 1 );
+
+        /*
+         * SQLite might release the pattern right away, so that it is only
+         * handed over once done with.
+         */
+        if ( compiled )
+                sqlite3_set_auxdata(context, 0, regex, regex_destroy);
+}
+
+
+
+/*
+ * Pragmas set from the settings of the same name. The "ingest" profile
+ * gives them defaults suited to sustained insertion: the write-ahead log
+ * lets readers run along with the writer, and only syncs at checkpoints
+ * with synchronous=NORMAL, rather than on each commit.
+ */
+static const struct {
+        const char *setting;
+        const char *ingest;
+} pragmas[] = {
+        { PRELUDEDB_SQL_SETTING_JOURNAL_MODE, "WAL"       },
+        { PRELUDEDB_SQL_SETTING_SYNCHRONOUS,  "NORMAL"    },
+        { PRELUDEDB_SQL_SETTING_CACHE_SIZE,   "-65536"    },
+        { PRELUDEDB_SQL_SETTING_MMAP_SIZE,    "268435456" },
+        { PRELUDEDB_SQL_SETTING_TEMP_STORE,   "MEMORY"    },
+};
+
+
+
+static int set_pragmas(sqlite3 *session, preludedb_sql_settings_t *settings)
+{
+        int ret;
+        char query[128];
+        unsigned int i;
+        char *errmsg = NULL;
+        const char *profile, *value, *ptr;
+        prelude_bool_t ingest = FALSE;
+
+        profile = preludedb_sql_settings_get_profile(settings);
+        if ( profile ) {
+                if ( strcmp(profile, "ingest") != 0 )
+                        return preludedb_error_verbose(PRELUDEDB_ERROR_INVALID_SETTINGS_STRING, "unknown profile '%s'", profile);
+
+                ingest = TRUE;
+        }
+
+        for ( i = 0; i < sizeof(pragmas) / sizeof(*pragmas); i++ ) {
+                value = preludedb_sql_settings_get(settings, pragmas[i].setting);
+                if ( ! value && ingest )
+                        value = pragmas[i].ingest;
+
+                if ( ! value )
+                        continue;
+
+                /*
+                 * Values are substituted within the query, only allow
+                 * keywords and numbers.
+                 */
+                for ( ptr = value; *ptr && (isalnum((unsigned char) *ptr) || *ptr == '-'); ptr++ );
+
+                if ( ! *value || *ptr )
+                        return preludedb_error_verbose(PRELUDEDB_ERROR_INVALID_SETTINGS_STRING,
+                                                       "invalid value '%s' for setting '%s'", value, pragmas[i].setting);
+
+                snprintf(query, sizeof(query), "PRAGMA %s=%s", pragmas[i].setting, value);
+
+                ret = sqlite3_exec(session, query, NULL, NULL, &errmsg);
+                if ( ret != SQLITE_OK ) {
+                        ret = preludedb_error_verbose(PRELUDEDB_ERROR_CONNECTION, "%s: %s", query, errmsg ? errmsg : sqlite3_errmsg(session));
+                        sqlite3_free(errmsg);
+                        return ret;
+                }
+        }
+
+        return 0;
 }
 
 
@@ -118,6 +244,12 @@ static int sql_open(preludedb_sql_settings_t *settings, void **session)
 
         sqlite3_busy_timeout(*session, SQLITE_BUSY_TIMEOUT);
 
+        ret = set_pragmas(*session, settings);
+        if ( ret < 0 ) {
+                sqlite3_close(*session);
+                return ret;
+        }
+
         return 0;
 }
 
@@ -153,6 +285,16 @@ static int sql_escape(void *session, const char *input, size_t input_size, char
 
 
 
+/*
+ * Same escaping as sql_escape(), which does not depend on the session.
+ */
+static int sql_get_escape_flags(void *session)
+{
+        return 0;
+}
+
+
+
 static int sql_build_limit_offset_string(void *session, int limit, int offset, prelude_string_t *output)
 {
         if ( limit >= 0 ) {
@@ -170,32 +312,76 @@ static int sql_build_limit_offset_string(void *session, int limit, int offset, p
 
 
 
-static int sql_table_field_copy(preludedb_sql_row_t *row, sqlite3_stmt *statement, unsigned int col)
+/*
+ * Column values only live until the statement is stepped again: they are
+ * all copied at once, in a single buffer owned by the row, fields pointing
+ * into it. The buffer starts with one byte per column, telling whether
+ * the column is NULL.
+ */
+static int sql_row_copy(preludedb_sql_row_t *row, sqlite3_stmt *statement)
 {
-        char *data = NULL;
+        int ret;
+        void *ptr;
+        char *null, *data;
+        size_t len, size = 0;
         preludedb_sql_field_t *field;
-        size_t len;
+        unsigned int i, count = sqlite3_column_count(statement);
+
+        null = malloc(count ? count : 1);
+        if ( ! null )
+                return preludedb_error_from_errno(errno);
+
+        /*
+         * Types are checked before any conversion, the text or blob value
+         * being retrieved before its length, as SQLite recommends.
+         */
+        for ( i = 0; i < count; i++ ) {
+                null[i] = (sqlite3_column_type(statement, i) == SQLITE_NULL);
+                if ( null[i] )
+                        continue;
+
+                sqlite3_column_blob(statement, i);
+                size += sqlite3_column_bytes(statement, i) + 1;
+        }
+
+        ptr = realloc(null, count + size + 1);
+        if ( ! ptr ) {
+                free(null);
+                return preludedb_error_from_errno(errno);
+        }
 
-        len = sqlite3_column_bytes(statement, col);
-        if ( len ) {
-                if ( len + 1 < len )
-                        return -1;
+        null = ptr;
+        data = null + count;
 
-                data = malloc(len + 1);
-                if ( ! data )
-                        return preludedb_error_from_errno(errno);
+        preludedb_sql_row_set_data(row, null);
 
-                memcpy(data, sqlite3_column_blob(statement, col), len);
+        for ( i = 0; i < count; i++ ) {
+                if ( null[i] ) {
+                        ret = preludedb_sql_row_new_field(row, &field, i, NULL, 0);
+                        if ( ret < 0 )
+                                return ret;
+
+                        continue;
+                }
+
+                len = sqlite3_column_bytes(statement, i);
+                memcpy(data, sqlite3_column_blob(statement, i), len);
                 data[len] = '\0';
+
+                ret = preludedb_sql_row_new_field(row, &field, i, data, len);
+                if ( ret < 0 )
+                        return ret;
+
+                data += len + 1;
         }
 
-        return preludedb_sql_row_new_field(row, &field, col, data, len);
+        return 0;
 }
 
 
-static void sql_field_destroy(void *session, preludedb_sql_table_t *table, preludedb_sql_row_t *row, preludedb_sql_field_t *field)
+static void sql_row_destroy(void *session, preludedb_sql_table_t *table, preludedb_sql_row_t *row)
 {
-        free(preludedb_sql_field_get_value(field));
+        free(preludedb_sql_row_get_data(row));
 }
 
 
@@ -206,9 +392,46 @@ static int sql_get_last_insert_ident(void *session, uint64_t *ident)
 }
 
 
+static inline sqlite3_stmt *get_statement(preludedb_sql_table_t *table)
+{
+        return ((sqlite3_table_t *) preludedb_sql_table_get_data(table))->statement;
+}
+
+
+
+static int table_new(preludedb_sql_table_t **table, sqlite3_stmt *statement, prelude_bool_t prepared)
+{
+        int ret;
+        sqlite3_table_t *data;
+
+        data = malloc(sizeof(*data));
+        if ( ! data )
+                return preludedb_error_from_errno(errno);
+
+        data->statement = statement;
+        data->prepared = prepared;
+
+        ret = preludedb_sql_table_new(table, data);
+        if ( ret < 0 )
+                free(data);
+
+        return ret;
+}
+
+
+
 static void sql_table_destroy(void *session, preludedb_sql_table_t *table)
 {
-        sqlite3_finalize(preludedb_sql_table_get_data(table));
+        sqlite3_table_t *data = preludedb_sql_table_get_data(table);
+
+        if ( ! data->prepared )
+                sqlite3_finalize(data->statement);
+        else {
+                sqlite3_reset(data->statement);
+                sqlite3_clear_bindings(data->statement);
+        }
+
+        free(data);
 }
 
 
@@ -236,9 +459,11 @@ static int sql_query(void *session, const char *query, preludedb_sql_table_t **t
                 if ( sqlite3_column_count(statement) == 0 )
                         return 0;
 
-                ret = preludedb_sql_table_new(table, statement);
-                if ( ret < 0 )
+                ret = table_new(table, statement, FALSE);
+                if ( ret < 0 ) {
+                        sqlite3_finalize(statement);
                         return ret;
+                }
 
                 ret = 1;
         }
@@ -248,12 +473,83 @@ static int sql_query(void *session, const char *query, preludedb_sql_table_t **t
 
 
 
+static int sql_statement_prepare(void *session, const char *query, unsigned int nparams, void **statement)
+{
+        int ret;
+
+        ret = sqlite3_prepare_statement(session, query, -1, (sqlite3_stmt **) statement, NULL);
+        if ( ret != SQLITE_OK )
+                return preludedb_error_verbose(PRELUDEDB_ERROR_QUERY, "%s", sqlite3_errmsg(session));
+
+        return 0;
+}
+
+
+
+static int sql_statement_execute(void *session, void *statement, const preludedb_sql_param_t *params,
+                                 unsigned int nparams, preludedb_sql_table_t **table)
+{
+        int ret;
+        unsigned int i;
+        prelude_bool_t has_result = (sqlite3_column_count(statement) > 0);
+
+        /*
+         * Statements returning rows are stepped after we return, once the
+         * caller parameters are gone: their values have to be copied.
+         */
+        for ( i = 0; i < nparams; i++ ) {
+                if ( ! params[i].value )
+                        ret = sqlite3_bind_null(statement, i + 1);
+
+                else if ( params[i].type == PRELUDEDB_SQL_PARAM_TYPE_BINARY )
+                        ret = sqlite3_bind_blob(statement, i + 1, params[i].value, params[i].len,
+                                                has_result ? SQLITE_TRANSIENT : SQLITE_STATIC);
+                else
+                        ret = sqlite3_bind_text(statement, i + 1, params[i].value, params[i].len,
+                                                has_result ? SQLITE_TRANSIENT : SQLITE_STATIC);
+
+                if ( ret != SQLITE_OK ) {
+                        sqlite3_clear_bindings(statement);
+                        return preludedb_error_verbose(PRELUDEDB_ERROR_QUERY, "%s", sqlite3_errmsg(session));
+                }
+        }
+
+        if ( has_result && table ) {
+                ret = table_new(table, statement, TRUE);
+                if ( ret < 0 ) {
+                        sqlite3_clear_bindings(statement);
+                        return ret;
+                }
+
+                return 1;
+        }
+
+        while ( (ret = sqlite3_step(statement)) == SQLITE_ROW );
+
+        sqlite3_reset(statement);
+        sqlite3_clear_bindings(statement);
+
+        if ( ret != SQLITE_DONE )
+                return preludedb_error_verbose(PRELUDEDB_ERROR_QUERY, "%s", sqlite3_errmsg(session));
+
+        return has_result ? 0 : sqlite3_changes(session);
+}
+
+
+
+static void sql_statement_destroy(void *session, void *statement)
+{
+        sqlite3_finalize(statement);
+}
+
+
+
 static const char *sql_get_column_name(void *session, preludedb_sql_table_t *table, unsigned int column_num)
 {
         if ( column_num >= preludedb_sql_table_get_column_count(table) )
                 return NULL;
 
-        return sqlite3_column_name(preludedb_sql_table_get_data(table), column_num);
+        return sqlite3_column_name(get_statement(table), column_num);
 }
 
 
@@ -263,7 +559,7 @@ static int sql_get_column_num(void *session, preludedb_sql_table_t *table, const
         unsigned int i;
 
         for ( i = 0; i < preludedb_sql_table_get_column_count(table); i++ ) {
-                ret = strcmp(column_name, sqlite3_column_name(preludedb_sql_table_get_data(table), i));
+                ret = strcmp(column_name, sqlite3_column_name(get_statement(table), i));
                 if ( ret == 0 )
                         return i;
         }
@@ -275,15 +571,15 @@ static int sql_get_column_num(void *session, preludedb_sql_table_t *table, const
 
 static unsigned int sql_get_column_count(void *session, preludedb_sql_table_t *table)
 {
-        return sqlite3_column_count(preludedb_sql_table_get_data(table));
+        return sqlite3_column_count(get_statement(table));
 }
 
 
 
 static int sql_fetch_row(void *session, preludedb_sql_table_t *table, unsigned int row_index, preludedb_sql_row_t **row)
 {
-        int ret, i;
-        sqlite3_stmt *statement = preludedb_sql_table_get_data(table);
+        int ret;
+        sqlite3_stmt *statement = get_statement(table);
 
         while ( preludedb_sql_table_get_fetched_row_count(table) <= row_index ) {
                 ret = sqlite3_step(statement);
@@ -299,11 +595,9 @@ static int sql_fetch_row(void *session, preludedb_sql_table_t *table, unsigned i
                 if ( ret < 0 )
                         return ret;
 
-                for ( i = 0; i < sqlite3_column_count(statement); i++ ) {
-                        ret = sql_table_field_copy(*row, statement, i);
-                        if ( ret < 0 )
-                                return preludedb_error_from_errno(errno);
-                }
+                ret = sql_row_copy(*row, statement);
+                if ( ret < 0 )
+                        return ret;
         }
 
         return 1;
@@ -507,9 +801,10 @@ int sqlite3_LTX_preludedb_plugin_init(prelude_plugin_entry_t *pe, void *data)
         preludedb_plugin_sql_set_open_func(plugin, sql_open);
         preludedb_plugin_sql_set_close_func(plugin, sql_close);
         preludedb_plugin_sql_set_escape_func(plugin, sql_escape);
+        preludedb_plugin_sql_set_get_escape_flags_func(plugin, sql_get_escape_flags);
         preludedb_plugin_sql_set_query_func(plugin, sql_query);
         preludedb_plugin_sql_set_get_server_version_func(plugin, sql_get_server_version);
-        preludedb_plugin_sql_set_field_destroy_func(plugin, sql_field_destroy);
+        preludedb_plugin_sql_set_row_destroy_func(plugin, sql_row_destroy);
         preludedb_plugin_sql_set_table_destroy_func(plugin, sql_table_destroy);
         preludedb_plugin_sql_set_get_column_count_func(plugin, sql_get_column_count);
         preludedb_plugin_sql_set_get_column_name_func(plugin, sql_get_column_name);
@@ -522,6 +817,9 @@ int sqlite3_LTX_preludedb_plugin_init(prelude_plugin_entry_t *pe, void *data)
         preludedb_plugin_sql_set_build_time_interval_string_func(plugin, sql_build_time_interval_string);
         preludedb_plugin_sql_set_build_limit_offset_string_func(plugin, sql_build_limit_offset_string);
         preludedb_plugin_sql_set_get_last_insert_ident_func(plugin, sql_get_last_insert_ident);
+        preludedb_plugin_sql_set_statement_prepare_func(plugin, sql_statement_prepare);
+        preludedb_plugin_sql_set_statement_execute_func(plugin, sql_statement_execute);
+        preludedb_plugin_sql_set_statement_destroy_func(plugin, sql_statement_destroy);
 
         return 0;
 }
@@ -31,13 +31,17 @@ struct preludedb_plugin_format {
 
         preludedb_plugin_format_check_schema_version_func_t check_schema_version;
         preludedb_plugin_format_get_alert_idents_func_t get_alert_idents;
+        preludedb_plugin_format_get_alert_idents_after_func_t get_alert_idents_after;
         preludedb_plugin_format_get_heartbeat_idents_func_t get_heartbeat_idents;
         preludedb_plugin_format_get_message_ident_count_func_t get_message_ident_count;
         preludedb_plugin_format_get_message_ident_func_t get_message_ident;
         preludedb_plugin_format_destroy_message_idents_resource_func_t destroy_message_idents_resource;
         preludedb_plugin_format_get_alert_func_t get_alert;
         preludedb_plugin_format_get_heartbeat_func_t get_heartbeat;
+        preludedb_plugin_format_get_alerts_func_t get_alerts;
+        preludedb_plugin_format_get_heartbeats_func_t get_heartbeats;
         preludedb_plugin_format_delete_func_t delete;
+        preludedb_plugin_format_drop_partitions_before_func_t drop_partitions_before;
         preludedb_plugin_format_delete_alert_func_t delete_alert;
         preludedb_plugin_format_delete_alert_from_list_func_t delete_alert_from_list;
         preludedb_plugin_format_delete_alert_from_result_idents_func_t delete_alert_from_result_idents;
@@ -45,7 +49,9 @@ struct preludedb_plugin_format {
         preludedb_plugin_format_delete_heartbeat_from_list_func_t delete_heartbeat_from_list;
         preludedb_plugin_format_delete_heartbeat_from_result_idents_func_t delete_heartbeat_from_result_idents;
         preludedb_plugin_format_insert_message_func_t insert_message;
+        preludedb_plugin_format_insert_messages_func_t insert_messages;
         preludedb_plugin_format_get_values_func_t get_values;
+        preludedb_plugin_format_count_func_t count;
         preludedb_plugin_format_get_result_values_count_func_t get_result_values_count;
         preludedb_plugin_format_get_result_values_row_func_t get_result_values_row;
         preludedb_plugin_format_get_result_values_field_func_t get_result_values_field;
@@ -40,6 +40,11 @@ typedef int (*preludedb_plugin_format_get_alert_idents_func_t)(preludedb_t *db,
                                                                int limit, int offset, const preludedb_path_selection_t *order,
                                                                void **res);
 
+typedef int (*preludedb_plugin_format_get_alert_idents_after_func_t)(preludedb_t *db, idmef_criteria_t *criteria,
+                                                                     const char *cursor, int limit,
+                                                                     preludedb_result_idents_order_t order,
+                                                                     void **res, char **next_cursor);
+
 typedef int (*preludedb_plugin_format_get_heartbeat_idents_func_t)(preludedb_t *db, idmef_criteria_t *criteria,
                                                                    int limit, int offset, const preludedb_path_selection_t *order,
                                                                    void **res);
@@ -49,7 +54,10 @@ typedef int (*preludedb_plugin_format_get_message_ident_func_t)(void *res, unsig
 typedef void (*preludedb_plugin_format_destroy_message_idents_resource_func_t)(void *res);
 typedef int (*preludedb_plugin_format_get_alert_func_t)(preludedb_t *db, uint64_t ident, idmef_message_t **message);
 typedef int (*preludedb_plugin_format_get_heartbeat_func_t)(preludedb_t *db, uint64_t ident, idmef_message_t **message);
+typedef ssize_t (*preludedb_plugin_format_get_alerts_func_t)(preludedb_t *db, uint64_t *idents, size_t size, idmef_message_t **messages);
+typedef ssize_t (*preludedb_plugin_format_get_heartbeats_func_t)(preludedb_t *db, uint64_t *idents, size_t size, idmef_message_t **messages);
 typedef int (*preludedb_plugin_format_delete_func_t)(preludedb_t *db, idmef_criteria_t *criteria);
+typedef int (*preludedb_plugin_format_drop_partitions_before_func_t)(preludedb_t *db, const idmef_time_t *time);
 typedef int (*preludedb_plugin_format_delete_alert_func_t)(preludedb_t *db, uint64_t ident);
 typedef ssize_t (*preludedb_plugin_format_delete_alert_from_list_func_t)(preludedb_t *db, uint64_t *idents, size_t size);
 typedef ssize_t (*preludedb_plugin_format_delete_alert_from_result_idents_func_t)(preludedb_t *db,
@@ -59,6 +67,7 @@ typedef ssize_t (*preludedb_plugin_format_delete_heartbeat_from_list_func_t)(pre
 typedef ssize_t (*preludedb_plugin_format_delete_heartbeat_from_result_idents_func_t)(preludedb_t *db,
                                                                                       preludedb_result_idents_t *results);
 typedef int (*preludedb_plugin_format_insert_message_func_t)(preludedb_t *db, idmef_message_t *message);
+typedef ssize_t (*preludedb_plugin_format_insert_messages_func_t)(preludedb_t *db, idmef_message_t **messages, size_t size);
 
 typedef int (*preludedb_plugin_format_get_result_values_count_func_t)(preludedb_result_values_t *results);
 
@@ -71,6 +80,9 @@ typedef int (*preludedb_plugin_format_get_values_func_t)(preludedb_t *db, prelud
 
 typedef void (*preludedb_plugin_format_destroy_values_resource_func_t)(void *res);
 
+typedef int (*preludedb_plugin_format_count_func_t)(preludedb_t *db, idmef_criteria_t *criteria,
+                                                    int flags, uint64_t threshold, uint64_t *count);
+
 typedef int (*preludedb_plugin_format_update_func_t)(preludedb_t *db, const idmef_path_t * const *paths, const idmef_value_t * const *values, size_t pvsize,
                                                      idmef_criteria_t *criteria, preludedb_path_selection_t *order, int limit, int offset);
 
@@ -97,6 +109,9 @@ void preludedb_plugin_format_set_check_schema_version_func(preludedb_plugin_form
 void preludedb_plugin_format_set_get_alert_idents_func(preludedb_plugin_format_t *plugin,
                                                        preludedb_plugin_format_get_alert_idents_func_t func);
 
+void preludedb_plugin_format_set_get_alert_idents_after_func(preludedb_plugin_format_t *plugin,
+                                                             preludedb_plugin_format_get_alert_idents_after_func_t func);
+
 void preludedb_plugin_format_set_get_heartbeat_idents_func(preludedb_plugin_format_t *plugin,
                                                            preludedb_plugin_format_get_heartbeat_idents_func_t func);
 
@@ -113,8 +128,15 @@ void preludedb_plugin_format_set_get_alert_func(preludedb_plugin_format_t *plugi
 
 void preludedb_plugin_format_set_get_heartbeat_func(preludedb_plugin_format_t *plugin, preludedb_plugin_format_get_heartbeat_func_t func);
 
+void preludedb_plugin_format_set_get_alerts_func(preludedb_plugin_format_t *plugin, preludedb_plugin_format_get_alerts_func_t func);
+
+void preludedb_plugin_format_set_get_heartbeats_func(preludedb_plugin_format_t *plugin, preludedb_plugin_format_get_heartbeats_func_t func);
+
 void preludedb_plugin_format_set_delete_func(preludedb_plugin_format_t *plugin, preludedb_plugin_format_delete_func_t func);
 
+void preludedb_plugin_format_set_drop_partitions_before_func(preludedb_plugin_format_t *plugin,
+                                                             preludedb_plugin_format_drop_partitions_before_func_t func);
+
 void preludedb_plugin_format_set_delete_alert_func(preludedb_plugin_format_t *plugin, preludedb_plugin_format_delete_alert_func_t func);
 
 void preludedb_plugin_format_set_delete_alert_from_list_func(preludedb_plugin_format_t *plugin,
@@ -147,9 +169,15 @@ ssize_t _preludedb_plugin_format_delete_heartbeat_from_result_idents(preludedb_p
 void preludedb_plugin_format_set_insert_message_func(preludedb_plugin_format_t *plugin,
                                                      preludedb_plugin_format_insert_message_func_t func);
 
+void preludedb_plugin_format_set_insert_messages_func(preludedb_plugin_format_t *plugin,
+                                                      preludedb_plugin_format_insert_messages_func_t func);
+
 void preludedb_plugin_format_set_get_values_func(preludedb_plugin_format_t *plugin,
                                                  preludedb_plugin_format_get_values_func_t func);
 
+void preludedb_plugin_format_set_count_func(preludedb_plugin_format_t *plugin,
+                                            preludedb_plugin_format_count_func_t func);
+
 void preludedb_plugin_format_set_get_result_values_count_func(preludedb_plugin_format_t *plugin,
                                                               preludedb_plugin_format_get_result_values_count_func_t func);
 
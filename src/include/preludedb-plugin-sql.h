@@ -33,6 +33,18 @@
 typedef struct preludedb_plugin_sql preludedb_plugin_sql_t;
 
 
+/*
+ * How a session escapes values, for the SQL layer to do it on its own,
+ * see preludedb_plugin_sql_set_get_escape_flags_func(). Quotes are always
+ * doubled, and strings cut at their first NUL byte, unless BACKSLASH is set.
+ */
+typedef enum {
+        PRELUDEDB_PLUGIN_SQL_ESCAPE_BACKSLASH        = 0x01, /* MySQL backslash sequences */
+        PRELUDEDB_PLUGIN_SQL_ESCAPE_BINARY_AS_STRING = 0x02, /* binary data escaped as strings */
+        PRELUDEDB_PLUGIN_SQL_ESCAPE_BINARY_BYTEA_HEX = 0x04, /* binary data as PostgreSQL '\x' hex */
+} preludedb_plugin_sql_escape_flags_t;
+
+
 typedef int (*preludedb_plugin_sql_open_func_t)(preludedb_sql_settings_t *settings, void **session);
 typedef void (*preludedb_plugin_sql_close_func_t)(void *session);
 typedef int (*preludedb_plugin_sql_escape_func_t)(void *session, const char *input, size_t input_size, char **output);
@@ -70,6 +82,22 @@ typedef const char *(*preludedb_plugin_sql_get_operator_string_func_t)(idmef_cri
 typedef int (*preludedb_plugin_sql_build_timestamp_string_func_t)(void *session, const struct tm *t, char *out, size_t size);
 typedef long (*preludedb_plugin_sql_get_server_version_func_t)(void *session);
 typedef int (*preludedb_plugin_sql_get_last_insert_ident_func_t)(void *session, uint64_t *ident);
+typedef int (*preludedb_plugin_sql_reserve_idents_func_t)(void *session, const char *table, const char *column,
+                                                          uint64_t *idents, size_t count);
+typedef int (*preludedb_plugin_sql_statement_prepare_func_t)(void *session, const char *query, unsigned int nparams, void **statement);
+typedef int (*preludedb_plugin_sql_statement_execute_func_t)(void *session, void *statement,
+                                                             const preludedb_sql_param_t *params, unsigned int nparams,
+                                                             preludedb_sql_table_t **table);
+typedef void (*preludedb_plugin_sql_statement_destroy_func_t)(void *session, void *statement);
+typedef int (*preludedb_plugin_sql_query_stream_func_t)(void *session, const char *query, preludedb_sql_table_t **table);
+typedef int (*preludedb_plugin_sql_async_open_func_t)(preludedb_sql_settings_t *settings, void **async);
+typedef void (*preludedb_plugin_sql_async_close_func_t)(void *async);
+typedef int (*preludedb_plugin_sql_async_send_func_t)(void *async, const char *query);
+typedef int (*preludedb_plugin_sql_async_poll_func_t)(void *async, int *status, preludedb_sql_table_t **table);
+typedef int (*preludedb_plugin_sql_async_get_fd_func_t)(void *async, int *events);
+typedef int (*preludedb_plugin_sql_copy_func_t)(void *session, const char *table, const char *fields,
+                                                const preludedb_sql_param_t *params, unsigned int ncolumns, unsigned int nrows);
+typedef int (*preludedb_plugin_sql_get_escape_flags_func_t)(void *session);
 
 
 void preludedb_plugin_sql_set_open_func(preludedb_plugin_sql_t *plugin, preludedb_plugin_sql_open_func_t func);
@@ -203,6 +231,69 @@ void preludedb_plugin_sql_set_get_last_insert_ident_func(preludedb_plugin_sql_t
 
 int _preludedb_plugin_sql_get_last_insert_ident(preludedb_plugin_sql_t *plugin, void *session, uint64_t *ident);
 
+void preludedb_plugin_sql_set_reserve_idents_func(preludedb_plugin_sql_t *plugin, preludedb_plugin_sql_reserve_idents_func_t func);
+
+int _preludedb_plugin_sql_reserve_idents(preludedb_plugin_sql_t *plugin, void *session, const char *table, const char *column,
+                                         uint64_t *idents, size_t count);
+
+void preludedb_plugin_sql_set_statement_prepare_func(preludedb_plugin_sql_t *plugin, preludedb_plugin_sql_statement_prepare_func_t func);
+
+int _preludedb_plugin_sql_statement_prepare(preludedb_plugin_sql_t *plugin, void *session, const char *query,
+                                            unsigned int nparams, void **statement);
+
+void preludedb_plugin_sql_set_statement_execute_func(preludedb_plugin_sql_t *plugin, preludedb_plugin_sql_statement_execute_func_t func);
+
+int _preludedb_plugin_sql_statement_execute(preludedb_plugin_sql_t *plugin, void *session, void *statement,
+                                            const preludedb_sql_param_t *params, unsigned int nparams,
+                                            prelude_bool_t binary, preludedb_sql_table_t **table);
+
+void preludedb_plugin_sql_set_statement_execute_binary_func(preludedb_plugin_sql_t *plugin, preludedb_plugin_sql_statement_execute_func_t func);
+
+void preludedb_plugin_sql_set_statement_destroy_func(preludedb_plugin_sql_t *plugin, preludedb_plugin_sql_statement_destroy_func_t func);
+
+void _preludedb_plugin_sql_statement_destroy(preludedb_plugin_sql_t *plugin, void *session, void *statement);
+
+void preludedb_plugin_sql_set_query_stream_func(preludedb_plugin_sql_t *plugin, preludedb_plugin_sql_query_stream_func_t func);
+
+int _preludedb_plugin_sql_query_stream(preludedb_plugin_sql_t *plugin, void *session, const char *query, preludedb_sql_table_t **table);
+
+prelude_bool_t _preludedb_plugin_sql_has_query_stream(preludedb_plugin_sql_t *plugin);
+
+void preludedb_plugin_sql_set_async_open_func(preludedb_plugin_sql_t *plugin, preludedb_plugin_sql_async_open_func_t func);
+
+int _preludedb_plugin_sql_async_open(preludedb_plugin_sql_t *plugin, preludedb_sql_settings_t *settings, void **async);
+
+void preludedb_plugin_sql_set_async_close_func(preludedb_plugin_sql_t *plugin, preludedb_plugin_sql_async_close_func_t func);
+
+void _preludedb_plugin_sql_async_close(preludedb_plugin_sql_t *plugin, void *async);
+
+void preludedb_plugin_sql_set_async_send_func(preludedb_plugin_sql_t *plugin, preludedb_plugin_sql_async_send_func_t func);
+
+int _preludedb_plugin_sql_async_send(preludedb_plugin_sql_t *plugin, void *async, const char *query);
+
+void preludedb_plugin_sql_set_async_poll_func(preludedb_plugin_sql_t *plugin, preludedb_plugin_sql_async_poll_func_t func);
+
+int _preludedb_plugin_sql_async_poll(preludedb_plugin_sql_t *plugin, void *async, int *status, preludedb_sql_table_t **table);
+
+void preludedb_plugin_sql_set_async_get_fd_func(preludedb_plugin_sql_t *plugin, preludedb_plugin_sql_async_get_fd_func_t func);
+
+int _preludedb_plugin_sql_async_get_fd(preludedb_plugin_sql_t *plugin, void *async, int *events);
+
+prelude_bool_t _preludedb_plugin_sql_has_async(preludedb_plugin_sql_t *plugin);
+
+void preludedb_plugin_sql_set_copy_func(preludedb_plugin_sql_t *plugin, preludedb_plugin_sql_copy_func_t func);
+
+int _preludedb_plugin_sql_copy(preludedb_plugin_sql_t *plugin, void *session, const char *table, const char *fields,
+                               const preludedb_sql_param_t *params, unsigned int ncolumns, unsigned int nrows);
+
+prelude_bool_t _preludedb_plugin_sql_has_copy(preludedb_plugin_sql_t *plugin);
+
+void preludedb_plugin_sql_set_get_escape_flags_func(preludedb_plugin_sql_t *plugin, preludedb_plugin_sql_get_escape_flags_func_t func);
+
+int _preludedb_plugin_sql_get_escape_flags(preludedb_plugin_sql_t *plugin, void *session);
+
+prelude_bool_t _preludedb_plugin_sql_has_escape_binary(preludedb_plugin_sql_t *plugin);
+
 int preludedb_plugin_sql_new(preludedb_plugin_sql_t **plugin);
 
 #ifdef __cplusplus
@@ -36,6 +36,18 @@
 #define PRELUDEDB_SQL_SETTING_TYPE "type"
 #define PRELUDEDB_SQL_SETTING_FILE "file"
 #define PRELUDEDB_SQL_SETTING_LOG "log"
+#define PRELUDEDB_SQL_SETTING_IDENT_RESERVE "ident_reserve"
+#define PRELUDEDB_SQL_SETTING_POOL_SIZE "pool_size"
+#define PRELUDEDB_SQL_SETTING_STATEMENT_CACHE "statement_cache"
+#define PRELUDEDB_SQL_SETTING_PLAN_CACHE "plan_cache"
+#define PRELUDEDB_SQL_SETTING_BINARY_RESULTS "binary_results"
+#define PRELUDEDB_SQL_SETTING_PROFILE "profile"
+#define PRELUDEDB_SQL_SETTING_JOURNAL_MODE "journal_mode"
+#define PRELUDEDB_SQL_SETTING_SYNCHRONOUS "synchronous"
+#define PRELUDEDB_SQL_SETTING_CACHE_SIZE "cache_size"
+#define PRELUDEDB_SQL_SETTING_MMAP_SIZE "mmap_size"
+#define PRELUDEDB_SQL_SETTING_TEMP_STORE "temp_store"
+#define PRELUDEDB_SQL_SETTING_ROLLUPS "rollups"
 
 typedef struct preludedb_sql_settings preludedb_sql_settings_t;
 
@@ -75,6 +87,42 @@ const char *preludedb_sql_settings_get_type(const preludedb_sql_settings_t *sett
 int preludedb_sql_settings_set_file(preludedb_sql_settings_t *settings, const char *value);
 const char *preludedb_sql_settings_get_file(const preludedb_sql_settings_t *settings);
 
+int preludedb_sql_settings_set_ident_reserve(preludedb_sql_settings_t *settings, const char *value);
+const char *preludedb_sql_settings_get_ident_reserve(const preludedb_sql_settings_t *settings);
+
+int preludedb_sql_settings_set_pool_size(preludedb_sql_settings_t *settings, const char *value);
+const char *preludedb_sql_settings_get_pool_size(const preludedb_sql_settings_t *settings);
+
+int preludedb_sql_settings_set_statement_cache(preludedb_sql_settings_t *settings, const char *value);
+const char *preludedb_sql_settings_get_statement_cache(const preludedb_sql_settings_t *settings);
+
+int preludedb_sql_settings_set_plan_cache(preludedb_sql_settings_t *settings, const char *value);
+const char *preludedb_sql_settings_get_plan_cache(const preludedb_sql_settings_t *settings);
+
+int preludedb_sql_settings_set_binary_results(preludedb_sql_settings_t *settings, const char *value);
+const char *preludedb_sql_settings_get_binary_results(const preludedb_sql_settings_t *settings);
+
+int preludedb_sql_settings_set_profile(preludedb_sql_settings_t *settings, const char *value);
+const char *preludedb_sql_settings_get_profile(const preludedb_sql_settings_t *settings);
+
+int preludedb_sql_settings_set_journal_mode(preludedb_sql_settings_t *settings, const char *value);
+const char *preludedb_sql_settings_get_journal_mode(const preludedb_sql_settings_t *settings);
+
+int preludedb_sql_settings_set_synchronous(preludedb_sql_settings_t *settings, const char *value);
+const char *preludedb_sql_settings_get_synchronous(const preludedb_sql_settings_t *settings);
+
+int preludedb_sql_settings_set_cache_size(preludedb_sql_settings_t *settings, const char *value);
+const char *preludedb_sql_settings_get_cache_size(const preludedb_sql_settings_t *settings);
+
+int preludedb_sql_settings_set_mmap_size(preludedb_sql_settings_t *settings, const char *value);
+const char *preludedb_sql_settings_get_mmap_size(const preludedb_sql_settings_t *settings);
+
+int preludedb_sql_settings_set_temp_store(preludedb_sql_settings_t *settings, const char *value);
+const char *preludedb_sql_settings_get_temp_store(const preludedb_sql_settings_t *settings);
+
+int preludedb_sql_settings_set_rollups(preludedb_sql_settings_t *settings, const char *value);
+const char *preludedb_sql_settings_get_rollups(const preludedb_sql_settings_t *settings);
+
          
 #ifdef __cplusplus
   }
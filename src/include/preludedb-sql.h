@@ -79,9 +79,24 @@ typedef enum {
         PRELUDEDB_SQL_QUERY_OPTION_LIMIT      = 1,
         PRELUDEDB_SQL_QUERY_OPTION_OFFSET     = 2,
         PRELUDEDB_SQL_QUERY_OPTION_FOR_UPDATE = 3,
+        PRELUDEDB_SQL_QUERY_OPTION_STREAM     = 4,
 } preludedb_sql_query_option_t;
 
 
+/*
+ * Representation of a field value. Fields are text unless the backend
+ * returned them in binary form (see the "binary_results" setting), in
+ * which case numbers and timestamps are stored big endian.
+ */
+typedef enum {
+        PRELUDEDB_SQL_FIELD_TYPE_TEXT      = 0, /* text representation */
+        PRELUDEDB_SQL_FIELD_TYPE_INTEGER   = 1, /* signed integer, 2, 4 or 8 bytes */
+        PRELUDEDB_SQL_FIELD_TYPE_FLOAT     = 2, /* IEEE 754 number, 4 or 8 bytes */
+        PRELUDEDB_SQL_FIELD_TYPE_TIMESTAMP = 3, /* 8 bytes integer, microseconds since 2000-01-01 00:00:00 UTC */
+        PRELUDEDB_SQL_FIELD_TYPE_BINARY    = 4, /* raw, unescaped, bytes */
+} preludedb_sql_field_type_t;
+
+
 typedef struct preludedb_sql preludedb_sql_t;
 typedef struct preludedb_sql_query preludedb_sql_query_t;
 
@@ -89,6 +104,28 @@ typedef struct preludedb_sql_table preludedb_sql_table_t;
 typedef struct preludedb_sql_row preludedb_sql_row_t;
 typedef struct preludedb_sql_field preludedb_sql_field_t;
 
+typedef struct preludedb_sql_metrics preludedb_sql_metrics_t;
+typedef struct preludedb_sql_metrics_statement preludedb_sql_metrics_statement_t;
+
+
+typedef enum {
+        PRELUDEDB_SQL_PARAM_TYPE_TEXT   = 0,
+        PRELUDEDB_SQL_PARAM_TYPE_BINARY = 1
+} preludedb_sql_param_type_t;
+
+/*
+ * A value bound to a '?' placeholder of a parameterized query,
+ * a NULL @value stands for SQL NULL. Text values must be NUL
+ * terminated, binary values are sent as is for @len bytes.
+ */
+typedef struct {
+        const char *value;
+        size_t len;
+        preludedb_sql_param_type_t type;
+} preludedb_sql_param_t;
+
+typedef struct preludedb_sql_params preludedb_sql_params_t;
+
 int preludedb_sql_row_new_field(preludedb_sql_row_t *row, preludedb_sql_field_t **field, int num, char *value, size_t len);
 
 preludedb_sql_field_t *preludedb_sql_field_ref(preludedb_sql_field_t *field);
@@ -120,7 +157,24 @@ void preludedb_sql_destroy(preludedb_sql_t *sql);
 int preludedb_sql_enable_query_logging(preludedb_sql_t *sql, const char *filename);
 void preludedb_sql_disable_query_logging(preludedb_sql_t *sql);
 
+int preludedb_sql_get_metrics(preludedb_sql_t *sql, preludedb_sql_metrics_t **metrics);
+void preludedb_sql_reset_metrics(preludedb_sql_t *sql);
+void preludedb_sql_metrics_destroy(preludedb_sql_metrics_t *metrics);
+uint64_t preludedb_sql_metrics_get_escaped_bytes(preludedb_sql_metrics_t *metrics);
+preludedb_sql_metrics_statement_t *preludedb_sql_metrics_get_next_statement(preludedb_sql_metrics_t *metrics,
+                                                                            preludedb_sql_metrics_statement_t *statement);
+
+const char *preludedb_sql_metrics_statement_get_name(preludedb_sql_metrics_statement_t *statement);
+uint64_t preludedb_sql_metrics_statement_get_calls(preludedb_sql_metrics_statement_t *statement);
+uint64_t preludedb_sql_metrics_statement_get_errors(preludedb_sql_metrics_statement_t *statement);
+uint64_t preludedb_sql_metrics_statement_get_rows(preludedb_sql_metrics_statement_t *statement);
+uint64_t preludedb_sql_metrics_statement_get_fetched_rows(preludedb_sql_metrics_statement_t *statement);
+uint64_t preludedb_sql_metrics_statement_get_total_time(preludedb_sql_metrics_statement_t *statement);
+uint64_t preludedb_sql_metrics_statement_get_max_time(preludedb_sql_metrics_statement_t *statement);
+uint64_t preludedb_sql_metrics_statement_get_percentile(preludedb_sql_metrics_statement_t *statement, double percentile);
+
 int preludedb_sql_query(preludedb_sql_t *sql, const char *query, preludedb_sql_table_t **table);
+int preludedb_sql_query_stream(preludedb_sql_t *sql, const char *query, preludedb_sql_table_t **table);
 int preludedb_sql_query_new(preludedb_sql_query_t **query, const char *querystr);
 int preludedb_sql_query_set_option(preludedb_sql_query_t *query, int cmd, ...);
 int preludedb_sql_query_get_option(preludedb_sql_query_t *query, int cmd, void *data);
@@ -134,11 +188,48 @@ void preludedb_sql_query_destroy(preludedb_sql_query_t *query);
 int preludedb_sql_query_sprintf(preludedb_sql_t *sql, preludedb_sql_table_t **table, const char *format, ...)
                                 __attribute__ ((__format__ (__printf__, 3, 4)));
 
+int preludedb_sql_query_params(preludedb_sql_t *sql, const char *query,
+                               const preludedb_sql_param_t *params, unsigned int nparams,
+                               preludedb_sql_table_t **table);
+
+int preludedb_sql_query_stream_params(preludedb_sql_t *sql, const char *query,
+                                      const preludedb_sql_param_t *params, unsigned int nparams,
+                                      preludedb_sql_table_t **table);
+
+typedef void (*preludedb_sql_async_cb_func_t)(preludedb_sql_t *sql, int ret, preludedb_sql_table_t *table, void *data);
+
+int preludedb_sql_query_async(preludedb_sql_t *sql, const char *query, preludedb_sql_async_cb_func_t cb, void *data);
+int preludedb_sql_async_get_fd(preludedb_sql_t *sql, int *events);
+int preludedb_sql_async_process(preludedb_sql_t *sql);
+int preludedb_sql_async_wait(preludedb_sql_t *sql);
+
+int preludedb_sql_params_new(preludedb_sql_params_t **params);
+void preludedb_sql_params_destroy(preludedb_sql_params_t *params);
+const preludedb_sql_param_t *preludedb_sql_params_get(preludedb_sql_params_t *params);
+unsigned int preludedb_sql_params_get_count(preludedb_sql_params_t *params);
+int preludedb_sql_params_add_string(preludedb_sql_params_t *params, const char *value);
+
+int preludedb_sql_plan_cache_get(preludedb_sql_t *sql, const char *key, char **query);
+int preludedb_sql_plan_cache_set(preludedb_sql_t *sql, const char *key, const char *query);
+
 int preludedb_sql_insert(preludedb_sql_t *sql, const char *table, const char *fields, const char *format, ...)
                          __attribute__ ((__format__ (__printf__, 4, 5)));
 
+int preludedb_sql_insert_buffered(preludedb_sql_t *sql, const char *table, const char *fields, const char *format, ...)
+                                  __attribute__ ((__format__ (__printf__, 4, 5)));
+
+int preludedb_sql_insert_params(preludedb_sql_t *sql, const char *table, const char *fields,
+                                const preludedb_sql_param_t *params, unsigned int nparams);
+
+int preludedb_sql_write_params(preludedb_sql_t *sql, const char *query,
+                               const preludedb_sql_param_t *params, unsigned int nparams);
+
+int preludedb_sql_insert_flush(preludedb_sql_t *sql);
+
 int preludedb_sql_get_last_insert_ident(preludedb_sql_t *sql, uint64_t *ident);
 
+int preludedb_sql_reserve_ident(preludedb_sql_t *sql, const char *table, const char *column, uint64_t *ident);
+
 int preludedb_sql_build_limit_offset_string(preludedb_sql_t *sql, int limit, int offset, prelude_string_t *output);
 
 int preludedb_sql_transaction_start(preludedb_sql_t *sql);
@@ -147,6 +238,7 @@ int preludedb_sql_transaction_abort(preludedb_sql_t *sql);
 
 int preludedb_sql_escape_fast(preludedb_sql_t *sql, const char *input, size_t input_size, char **output);
 int preludedb_sql_escape(preludedb_sql_t *sql, const char *input, char **output);
+ssize_t preludedb_sql_escape_to_buffer(preludedb_sql_t *sql, const char *input, size_t input_size, char *output, size_t output_size);
 int preludedb_sql_escape_binary(preludedb_sql_t *sql, const unsigned char *input, size_t input_size, char **output);
 int preludedb_sql_unescape_binary(preludedb_sql_t *sql, const char *input, size_t input_size,
                                   unsigned char **output, size_t *output_size);
@@ -155,7 +247,7 @@ void preludedb_sql_table_destroy(preludedb_sql_table_t *table);
 const char *preludedb_sql_table_get_column_name(preludedb_sql_table_t *table, unsigned int column_num);
 int preludedb_sql_table_get_column_num(preludedb_sql_table_t *table, const char *column_name);
 unsigned int preludedb_sql_table_get_column_count(preludedb_sql_table_t *table);
-unsigned int preludedb_sql_table_get_row_count(preludedb_sql_table_t *table);
+int preludedb_sql_table_get_row_count(preludedb_sql_table_t *table);
 unsigned int preludedb_sql_table_get_fetched_row_count(preludedb_sql_table_t *table);
 
 int preludedb_sql_table_get_row(preludedb_sql_table_t *table, unsigned int row_index, preludedb_sql_row_t **row);
@@ -169,6 +261,8 @@ int preludedb_sql_row_fetch_field_by_name(preludedb_sql_row_t *row, const char *
 
 char *preludedb_sql_field_get_value(preludedb_sql_field_t *field);
 size_t preludedb_sql_field_get_len(preludedb_sql_field_t *field);
+void preludedb_sql_field_set_type(preludedb_sql_field_t *field, preludedb_sql_field_type_t type);
+preludedb_sql_field_type_t preludedb_sql_field_get_type(preludedb_sql_field_t *field);
 int preludedb_sql_field_to_int8(preludedb_sql_field_t *field, int8_t *value);
 int preludedb_sql_field_to_uint8(preludedb_sql_field_t *field, uint8_t *value);
 int preludedb_sql_field_to_int16(preludedb_sql_field_t *field, int16_t *value);
@@ -180,6 +274,8 @@ int preludedb_sql_field_to_uint64(preludedb_sql_field_t *field, uint64_t *value)
 int preludedb_sql_field_to_float(preludedb_sql_field_t *field, float *value);
 int preludedb_sql_field_to_double(preludedb_sql_field_t *field, double *value);
 int preludedb_sql_field_to_string(preludedb_sql_field_t *field, prelude_string_t *output);
+int preludedb_sql_field_to_time(preludedb_sql_field_t *field, idmef_time_t *time, int32_t gmtoff, uint32_t usec);
+int preludedb_sql_field_to_binary(preludedb_sql_t *sql, preludedb_sql_field_t *field, unsigned char **output, size_t *output_size);
 
 const char *preludedb_sql_criteria_operator_to_string(idmef_criteria_operator_t op);
 
@@ -196,6 +292,14 @@ int preludedb_sql_build_criterion_string(preludedb_sql_t *sql,
                                          const char *field,
                                          idmef_criterion_operator_t idmef_operator, idmef_criterion_value_t *value);
 
+int preludedb_sql_build_criterion_template(preludedb_sql_t *sql,
+                                           prelude_string_t *output,
+                                           const char *field,
+                                           idmef_criterion_operator_t idmef_operator, idmef_criterion_value_t *value);
+
+int preludedb_sql_params_add_criterion(preludedb_sql_params_t *params, preludedb_sql_t *sql,
+                                       idmef_criterion_operator_t idmef_operator, idmef_criterion_value_t *value);
+
 int preludedb_sql_time_from_timestamp(idmef_time_t *time, const char *time_buf, int32_t gmtoff, uint32_t usec);
 int preludedb_sql_time_to_timestamp(preludedb_sql_t *sql,
                                     const idmef_time_t *time,
@@ -50,6 +50,11 @@ typedef enum {
         PRELUDEDB_RESULT_IDENTS_ORDER_BY_CREATE_TIME_ASC = 2
 } preludedb_result_idents_order_t;
 
+typedef enum {
+        PRELUDEDB_COUNT_FLAGS_ESTIMATE = 0x01,
+        PRELUDEDB_COUNT_FLAGS_EXCEEDED = 0x02
+} preludedb_count_flags_t;
+
 
 #define PRELUDEDB_ERRBUF_SIZE 512
 
@@ -92,6 +97,7 @@ preludedb_sql_t *preludedb_get_sql(preludedb_t *db);
 void preludedb_result_idents_destroy(preludedb_result_idents_t *result);
 int preludedb_result_idents_get(preludedb_result_idents_t *result, unsigned int row_index, uint64_t *ident);
 unsigned int preludedb_result_idents_get_count(preludedb_result_idents_t *result);
+const char *preludedb_result_idents_get_cursor(preludedb_result_idents_t *result);
 preludedb_result_idents_t *preludedb_result_idents_ref(preludedb_result_idents_t *results);
 
 void preludedb_result_values_destroy(preludedb_result_values_t *result);
@@ -100,10 +106,18 @@ char *preludedb_get_error(preludedb_t *db, preludedb_error_t error, char *errbuf
 
 int preludedb_insert_message(preludedb_t *db, idmef_message_t *message);
 
+ssize_t preludedb_insert_messages(preludedb_t *db, idmef_message_t **messages, size_t size);
+
+ssize_t preludedb_load_messages(preludedb_t *db, idmef_message_t **messages, size_t size);
+
 void preludedb_set_data(preludedb_t *db, void *data);
 
 void *preludedb_get_data(preludedb_t *db);
 
+void preludedb_set_result_streaming(preludedb_t *db, prelude_bool_t enabled);
+
+prelude_bool_t preludedb_get_result_streaming(preludedb_t *db);
+
 int preludedb_get_alert_idents(preludedb_t *db, idmef_criteria_t *criteria,
                                int limit, int offset,
                                preludedb_result_idents_order_t order,
@@ -112,6 +126,10 @@ int preludedb_get_alert_idents2(preludedb_t *db, idmef_criteria_t *criteria,
                                int limit, int offset,
                                const preludedb_path_selection_t *order,
                                preludedb_result_idents_t **result);
+int preludedb_get_alert_idents_after(preludedb_t *db, idmef_criteria_t *criteria,
+                                     const char *cursor, int limit,
+                                     preludedb_result_idents_order_t order,
+                                     preludedb_result_idents_t **result);
 int preludedb_get_heartbeat_idents(preludedb_t *db, idmef_criteria_t *criteria,
                                    int limit, int offset,
                                    preludedb_result_idents_order_t order,
@@ -124,8 +142,18 @@ int preludedb_get_heartbeat_idents2(preludedb_t *db, idmef_criteria_t *criteria,
 int preludedb_get_alert(preludedb_t *db, uint64_t ident, idmef_message_t **message);
 int preludedb_get_heartbeat(preludedb_t *db, uint64_t ident, idmef_message_t **message);
 
+ssize_t preludedb_get_alerts(preludedb_t *db, uint64_t *idents, size_t size, idmef_message_t **messages);
+ssize_t preludedb_get_heartbeats(preludedb_t *db, uint64_t *idents, size_t size, idmef_message_t **messages);
+
 int preludedb_delete(preludedb_t *db, idmef_criteria_t *criteria);
 
+int preludedb_drop_partitions_before(preludedb_t *db, const idmef_time_t *time);
+
+typedef int (*preludedb_delete_progress_cb_func_t)(preludedb_t *db, uint64_t deleted, void *data);
+
+ssize_t preludedb_delete2(preludedb_t *db, idmef_criteria_t *criteria, size_t chunk_size,
+                          preludedb_delete_progress_cb_func_t cb, void *data);
+
 int preludedb_delete_alert(preludedb_t *db, uint64_t ident);
 
 ssize_t preludedb_delete_alert_from_list(preludedb_t *db, uint64_t *idents, size_t isize);
@@ -144,6 +172,8 @@ int preludedb_get_values(preludedb_t *db, preludedb_path_selection_t *path_selec
                          idmef_criteria_t *criteria, prelude_bool_t distinct, int limit, int offset,
                          preludedb_result_values_t **result);
 
+int preludedb_count(preludedb_t *db, idmef_criteria_t *criteria, int flags, uint64_t threshold, uint64_t *count);
+
 ssize_t preludedb_update_from_list(preludedb_t *db,
                                    const idmef_path_t * const *paths, const idmef_value_t * const *values, size_t pvsize,
                                    uint64_t *idents, size_t isize);
@@ -44,6 +44,13 @@ void preludedb_plugin_format_set_get_alert_idents_func(preludedb_plugin_format_t
 }
 
 
+void preludedb_plugin_format_set_get_alert_idents_after_func(preludedb_plugin_format_t *plugin,
+                                                             preludedb_plugin_format_get_alert_idents_after_func_t func)
+{
+        plugin->get_alert_idents_after = func;
+}
+
+
 void preludedb_plugin_format_set_get_heartbeat_idents_func(preludedb_plugin_format_t *plugin,
                                                            preludedb_plugin_format_get_heartbeat_idents_func_t func)
 {
@@ -86,12 +93,33 @@ void preludedb_plugin_format_set_get_heartbeat_func(preludedb_plugin_format_t *p
 }
 
 
+
+void preludedb_plugin_format_set_get_alerts_func(preludedb_plugin_format_t *plugin, preludedb_plugin_format_get_alerts_func_t func)
+{
+        plugin->get_alerts = func;
+}
+
+
+
+void preludedb_plugin_format_set_get_heartbeats_func(preludedb_plugin_format_t *plugin, preludedb_plugin_format_get_heartbeats_func_t func)
+{
+        plugin->get_heartbeats = func;
+}
+
+
 void preludedb_plugin_format_set_delete_func(preludedb_plugin_format_t *plugin, preludedb_plugin_format_delete_func_t func)
 {
         plugin->delete = func;
 }
 
 
+void preludedb_plugin_format_set_drop_partitions_before_func(preludedb_plugin_format_t *plugin,
+                                                             preludedb_plugin_format_drop_partitions_before_func_t func)
+{
+        plugin->drop_partitions_before = func;
+}
+
+
 void preludedb_plugin_format_set_delete_alert_func(preludedb_plugin_format_t *plugin, preludedb_plugin_format_delete_alert_func_t func)
 {
         plugin->delete_alert = func;
@@ -140,6 +168,13 @@ void preludedb_plugin_format_set_insert_message_func(preludedb_plugin_format_t *
 }
 
 
+void preludedb_plugin_format_set_insert_messages_func(preludedb_plugin_format_t *plugin,
+                                                      preludedb_plugin_format_insert_messages_func_t func)
+{
+        plugin->insert_messages = func;
+}
+
+
 
 void preludedb_plugin_format_set_get_values_func(preludedb_plugin_format_t *plugin,
                                                  preludedb_plugin_format_get_values_func_t func)
@@ -148,6 +183,13 @@ void preludedb_plugin_format_set_get_values_func(preludedb_plugin_format_t *plug
 }
 
 
+void preludedb_plugin_format_set_count_func(preludedb_plugin_format_t *plugin,
+                                            preludedb_plugin_format_count_func_t func)
+{
+        plugin->count = func;
+}
+
+
 void preludedb_plugin_format_set_get_result_values_count_func(preludedb_plugin_format_t *plugin,
                                                               preludedb_plugin_format_get_result_values_count_func_t func)
 {
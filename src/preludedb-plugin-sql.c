@@ -63,6 +63,19 @@ struct preludedb_plugin_sql {
         preludedb_plugin_sql_get_server_version_func_t get_server_version;
         preludedb_plugin_sql_get_last_insert_ident_func_t get_last_insert_ident;
         preludedb_plugin_sql_build_time_timezone_string_func_t build_time_timezone_string;
+        preludedb_plugin_sql_reserve_idents_func_t reserve_idents;
+        preludedb_plugin_sql_statement_prepare_func_t statement_prepare;
+        preludedb_plugin_sql_statement_execute_func_t statement_execute;
+        preludedb_plugin_sql_statement_execute_func_t statement_execute_binary;
+        preludedb_plugin_sql_statement_destroy_func_t statement_destroy;
+        preludedb_plugin_sql_query_stream_func_t query_stream;
+        preludedb_plugin_sql_async_open_func_t async_open;
+        preludedb_plugin_sql_async_close_func_t async_close;
+        preludedb_plugin_sql_async_send_func_t async_send;
+        preludedb_plugin_sql_async_poll_func_t async_poll;
+        preludedb_plugin_sql_async_get_fd_func_t async_get_fd;
+        preludedb_plugin_sql_copy_func_t copy;
+        preludedb_plugin_sql_get_escape_flags_func_t get_escape_flags;
 };
 
 
@@ -195,6 +208,256 @@ int _preludedb_plugin_sql_get_last_insert_ident(preludedb_plugin_sql_t *plugin,
 }
 
 
+void preludedb_plugin_sql_set_reserve_idents_func(preludedb_plugin_sql_t *plugin, preludedb_plugin_sql_reserve_idents_func_t func)
+{
+        plugin->reserve_idents = func;
+}
+
+
+int _preludedb_plugin_sql_reserve_idents(preludedb_plugin_sql_t *plugin, void *session, const char *table, const char *column,
+                                         uint64_t *idents, size_t count)
+{
+        if ( ! plugin->reserve_idents )
+                return PRELUDEDB_ENOTSUP("reserve_idents");
+
+        return plugin->reserve_idents(session, table, column, idents, count);
+}
+
+
+void preludedb_plugin_sql_set_statement_prepare_func(preludedb_plugin_sql_t *plugin, preludedb_plugin_sql_statement_prepare_func_t func)
+{
+        plugin->statement_prepare = func;
+}
+
+
+/*
+ * Prepare @query, whose @nparams parameters are referenced through '?'
+ * placeholders, for later execution on @session.
+ */
+int _preludedb_plugin_sql_statement_prepare(preludedb_plugin_sql_t *plugin, void *session, const char *query,
+                                            unsigned int nparams, void **statement)
+{
+        if ( ! plugin->statement_prepare || ! plugin->statement_execute || ! plugin->statement_destroy )
+                return PRELUDEDB_ENOTSUP("statement_prepare");
+
+        return plugin->statement_prepare(session, query, nparams, statement);
+}
+
+
+void preludedb_plugin_sql_set_statement_execute_func(preludedb_plugin_sql_t *plugin, preludedb_plugin_sql_statement_execute_func_t func)
+{
+        plugin->statement_execute = func;
+}
+
+
+/*
+ * Statements are executed with their results in binary form when @binary
+ * is set and the plugin supports it, in text form otherwise.
+ */
+int _preludedb_plugin_sql_statement_execute(preludedb_plugin_sql_t *plugin, void *session, void *statement,
+                                            const preludedb_sql_param_t *params, unsigned int nparams,
+                                            prelude_bool_t binary, preludedb_sql_table_t **table)
+{
+        if ( binary && plugin->statement_execute_binary )
+                return plugin->statement_execute_binary(session, statement, params, nparams, table);
+
+        return plugin->statement_execute(session, statement, params, nparams, table);
+}
+
+
+void preludedb_plugin_sql_set_statement_execute_binary_func(preludedb_plugin_sql_t *plugin, preludedb_plugin_sql_statement_execute_func_t func)
+{
+        plugin->statement_execute_binary = func;
+}
+
+
+void preludedb_plugin_sql_set_statement_destroy_func(preludedb_plugin_sql_t *plugin, preludedb_plugin_sql_statement_destroy_func_t func)
+{
+        plugin->statement_destroy = func;
+}
+
+
+/*
+ * @session is NULL when the session @statement was prepared on has
+ * already been closed: only the client side resources are to be released.
+ */
+void _preludedb_plugin_sql_statement_destroy(preludedb_plugin_sql_t *plugin, void *session, void *statement)
+{
+        plugin->statement_destroy(session, statement);
+}
+
+
+void preludedb_plugin_sql_set_query_stream_func(preludedb_plugin_sql_t *plugin, preludedb_plugin_sql_query_stream_func_t func)
+{
+        plugin->query_stream = func;
+}
+
+
+/*
+ * Run @query on @session, rows being transferred as they are fetched
+ * from the resulting table. @session stays busy until the table is
+ * destroyed.
+ */
+int _preludedb_plugin_sql_query_stream(preludedb_plugin_sql_t *plugin, void *session, const char *query, preludedb_sql_table_t **table)
+{
+        if ( ! plugin->query_stream )
+                return PRELUDEDB_ENOTSUP("query_stream");
+
+        return plugin->query_stream(session, query, table);
+}
+
+
+prelude_bool_t _preludedb_plugin_sql_has_query_stream(preludedb_plugin_sql_t *plugin)
+{
+        return plugin->query_stream ? TRUE : FALSE;
+}
+
+
+void preludedb_plugin_sql_set_async_open_func(preludedb_plugin_sql_t *plugin, preludedb_plugin_sql_async_open_func_t func)
+{
+        plugin->async_open = func;
+}
+
+
+/*
+ * Open a connection dedicated to asynchronous queries. The plugin
+ * functions working on sessions are never called on it.
+ */
+int _preludedb_plugin_sql_async_open(preludedb_plugin_sql_t *plugin, preludedb_sql_settings_t *settings, void **async)
+{
+        if ( ! _preludedb_plugin_sql_has_async(plugin) )
+                return PRELUDEDB_ENOTSUP("async_open");
+
+        return plugin->async_open(settings, async);
+}
+
+
+void preludedb_plugin_sql_set_async_close_func(preludedb_plugin_sql_t *plugin, preludedb_plugin_sql_async_close_func_t func)
+{
+        plugin->async_close = func;
+}
+
+
+/*
+ * Results of queries still in progress are to be discarded.
+ */
+void _preludedb_plugin_sql_async_close(preludedb_plugin_sql_t *plugin, void *async)
+{
+        plugin->async_close(async);
+}
+
+
+void preludedb_plugin_sql_set_async_send_func(preludedb_plugin_sql_t *plugin, preludedb_plugin_sql_async_send_func_t func)
+{
+        plugin->async_send = func;
+}
+
+
+/*
+ * Send @query without waiting for its completion. Returns 1 if other
+ * queries can be sent before this one completes (pipelining), 0 if not,
+ * or a negative value if an error occurred.
+ */
+int _preludedb_plugin_sql_async_send(preludedb_plugin_sql_t *plugin, void *async, const char *query)
+{
+        return plugin->async_send(async, query);
+}
+
+
+void preludedb_plugin_sql_set_async_poll_func(preludedb_plugin_sql_t *plugin, preludedb_plugin_sql_async_poll_func_t func)
+{
+        plugin->async_poll = func;
+}
+
+
+/*
+ * Read whatever is available from the connection, without blocking.
+ * Returns 1 once the oldest query sent completed, its result being stored
+ * in @status, as returned by the query function, and @table, which must
+ * not depend on the connection. Returns 0 if that query is still in
+ * progress, or a negative value if the connection failed.
+ */
+int _preludedb_plugin_sql_async_poll(preludedb_plugin_sql_t *plugin, void *async, int *status, preludedb_sql_table_t **table)
+{
+        return plugin->async_poll(async, status, table);
+}
+
+
+void preludedb_plugin_sql_set_async_get_fd_func(preludedb_plugin_sql_t *plugin, preludedb_plugin_sql_async_get_fd_func_t func)
+{
+        plugin->async_get_fd = func;
+}
+
+
+/*
+ * Returns the file descriptor of the connection, @events being set to
+ * the poll(2) events to wait for.
+ */
+int _preludedb_plugin_sql_async_get_fd(preludedb_plugin_sql_t *plugin, void *async, int *events)
+{
+        return plugin->async_get_fd(async, events);
+}
+
+
+prelude_bool_t _preludedb_plugin_sql_has_async(preludedb_plugin_sql_t *plugin)
+{
+        return (plugin->async_open && plugin->async_close && plugin->async_send &&
+                plugin->async_poll && plugin->async_get_fd) ? TRUE : FALSE;
+}
+
+
+void preludedb_plugin_sql_set_copy_func(preludedb_plugin_sql_t *plugin, preludedb_plugin_sql_copy_func_t func)
+{
+        plugin->copy = func;
+}
+
+
+/*
+ * Load @nrows rows of @ncolumns values into @table through the backend
+ * bulk load facility.
+ */
+int _preludedb_plugin_sql_copy(preludedb_plugin_sql_t *plugin, void *session, const char *table, const char *fields,
+                               const preludedb_sql_param_t *params, unsigned int ncolumns, unsigned int nrows)
+{
+        if ( ! plugin->copy )
+                return PRELUDEDB_ENOTSUP("copy");
+
+        return plugin->copy(session, table, fields, params, ncolumns, nrows);
+}
+
+
+prelude_bool_t _preludedb_plugin_sql_has_copy(preludedb_plugin_sql_t *plugin)
+{
+        return plugin->copy ? TRUE : FALSE;
+}
+
+
+void preludedb_plugin_sql_set_get_escape_flags_func(preludedb_plugin_sql_t *plugin, preludedb_plugin_sql_get_escape_flags_func_t func)
+{
+        plugin->get_escape_flags = func;
+}
+
+
+/*
+ * Get the preludedb_plugin_sql_escape_flags_t describing how @session
+ * escapes values, or a negative value when this depends on the session
+ * in a way the SQL layer cannot reproduce (e.g. multibyte encodings).
+ */
+int _preludedb_plugin_sql_get_escape_flags(preludedb_plugin_sql_t *plugin, void *session)
+{
+        if ( ! plugin->get_escape_flags )
+                return PRELUDEDB_ENOTSUP("get_escape_flags");
+
+        return plugin->get_escape_flags(session);
+}
+
+
+prelude_bool_t _preludedb_plugin_sql_has_escape_binary(preludedb_plugin_sql_t *plugin)
+{
+        return plugin->escape_binary ? TRUE : FALSE;
+}
+
+
 void preludedb_plugin_sql_set_query_prepare_func(preludedb_plugin_sql_t *plugin, preludedb_plugin_sql_query_prepare_func_t func)
 {
         plugin->query_prepare = func;
@@ -238,3 +238,15 @@ convenient_functions(pass, PRELUDEDB_SQL_SETTING_PASS, NULL)
 convenient_functions(type, PRELUDEDB_SQL_SETTING_TYPE, NULL)
 convenient_functions(file, PRELUDEDB_SQL_SETTING_FILE, NULL)
 convenient_functions(log, PRELUDEDB_SQL_SETTING_LOG, NULL)
+convenient_functions(ident_reserve, PRELUDEDB_SQL_SETTING_IDENT_RESERVE, NULL)
+convenient_functions(pool_size, PRELUDEDB_SQL_SETTING_POOL_SIZE, NULL)
+convenient_functions(statement_cache, PRELUDEDB_SQL_SETTING_STATEMENT_CACHE, "64")
+convenient_functions(plan_cache, PRELUDEDB_SQL_SETTING_PLAN_CACHE, "64")
+convenient_functions(binary_results, PRELUDEDB_SQL_SETTING_BINARY_RESULTS, "0")
+convenient_functions(profile, PRELUDEDB_SQL_SETTING_PROFILE, NULL)
+convenient_functions(journal_mode, PRELUDEDB_SQL_SETTING_JOURNAL_MODE, NULL)
+convenient_functions(synchronous, PRELUDEDB_SQL_SETTING_SYNCHRONOUS, NULL)
+convenient_functions(cache_size, PRELUDEDB_SQL_SETTING_CACHE_SIZE, NULL)
+convenient_functions(mmap_size, PRELUDEDB_SQL_SETTING_MMAP_SIZE, NULL)
+convenient_functions(temp_store, PRELUDEDB_SQL_SETTING_TEMP_STORE, NULL)
+convenient_functions(rollups, PRELUDEDB_SQL_SETTING_ROLLUPS, NULL)
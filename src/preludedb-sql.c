@@ -29,11 +29,13 @@
 #include <sys/stat.h>
 #include <unistd.h>
 #include <string.h>
+#include <ctype.h>
 #include <dirent.h>
 #include <errno.h>
 #include <assert.h>
 #include <unistd.h>
 #include <fcntl.h>
+#include <poll.h>
 
 #if TIME_WITH_SYS_TIME
 # include <sys/time.h>
@@ -62,12 +64,31 @@
 #include "preludedb.h"
 
 
+#ifndef MIN
+# define MIN(x, y) (((x) < (y)) ? (x) : (y))
+#endif
+
 #ifndef MAX
 # define MAX(x, y) (((x) > (y)) ? (x) : (y))
 #endif
 
 #define SQL_NULL_FIELD (void *) 0xdeadbeef
 
+/*
+ * Buffered rows for a given table are sent as soon as their VALUES list
+ * grows beyond this size, so that a single statement stays well below
+ * the backend maximum packet/statement size.
+ */
+#define SQL_INSERT_BUFFER_MAX_SIZE (512 * 1024)
+
+/*
+ * Maximum number of parameters bound to a single multi-row INSERT, this
+ * is the lowest default limit (SQLITE_MAX_VARIABLE_NUMBER).
+ */
+#define SQL_INSERT_PARAMS_MAX 999
+
+#define SQL_INSERT_PARAM_NULL ((size_t) -1)
+
 
 typedef enum {
         PRELUDEDB_SQL_STATUS_CONNECTED    = 0x01,
@@ -88,38 +109,248 @@ typedef enum {
         }
 
 
+/*
+ * Prepared statements are cached per session, most recently used first.
+ * A statement whose results are still referenced by a table is busy: it
+ * is neither executed again nor evicted until the table is destroyed.
+ *
+ * The cache is only modified with the session lock held, its own lock
+ * guards the busy state, which tables release without the session lock.
+ */
+typedef struct {
+        prelude_list_t statements;
+        unsigned int count;
+        gl_lock_t mutex;
+} sql_statement_cache_t;
+
+
+typedef struct {
+        prelude_list_t list;
+        sql_statement_cache_t *cache;
+        gl_lock_t *mutex;
+        char *query;
+        void *statement;
+        prelude_bool_t busy;
+} sql_statement_t;
+
+
+/*
+ * Query templates built by format plugins, indexed by a key describing the
+ * request they answer, most recently used first. Unlike prepared statements,
+ * plans do not depend on a session and are shared by all of them.
+ */
+typedef struct {
+        prelude_list_t list;
+        char *key;
+        char *query;
+} sql_plan_t;
+
+
+/*
+ * Metrics of the queries sharing a shape, their verb and main table (e.g.
+ * "insert Prelude_Alert"). Latencies, in microseconds, are kept in a
+ * log-linear histogram: values below 16 have a bucket of their own, each
+ * power of two above is split into 8 buckets, for a 12.5% precision.
+ */
+#define METRICS_SUB_BUCKET_BITS 3
+#define METRICS_SUB_BUCKET_COUNT (1 << METRICS_SUB_BUCKET_BITS)
+#define METRICS_MAX_MAGNITUDE 40
+#define METRICS_BUCKET_COUNT ((METRICS_MAX_MAGNITUDE - METRICS_SUB_BUCKET_BITS + 1) * METRICS_SUB_BUCKET_COUNT)
+
+struct preludedb_sql_metrics_statement {
+        prelude_list_t list;
+        char *name;
+        uint64_t calls;
+        uint64_t errors;
+        uint64_t rows;
+        uint64_t fetched_rows;
+        uint64_t total_time;
+        uint64_t max_time;
+        uint64_t buckets[METRICS_BUCKET_COUNT];
+};
+
+
+struct preludedb_sql_metrics {
+        prelude_list_t statements;
+        uint64_t escaped_bytes;
+};
+
+
+/*
+ * A query submitted through preludedb_sql_query_async(). Completed queries
+ * are reported in submission order.
+ */
+#define SQL_ASYNC_QUEUED 0
+#define SQL_ASYNC_SENT   1
+#define SQL_ASYNC_DONE   2
+
+typedef struct {
+        prelude_list_t list;
+        char *query;
+        preludedb_sql_async_cb_func_t cb;
+        void *data;
+        int state;
+        int status;
+        preludedb_sql_table_t *table;
+        struct timeval start;
+} sql_async_query_t;
+
+
+/*
+ * A reader session from the connection pool. A session is checked out by a
+ * single query, and stays so along with the table it returns, so that read
+ * queries running on different sessions do not wait on each other, nor on
+ * the writer session held by a transaction. The generation is increased
+ * each time the session is closed. A session that is reset while checked
+ * out is closed once it is checked in.
+ */
+typedef struct {
+        prelude_bool_t busy;
+        prelude_bool_t reset;
+        preludedb_sql_status_t status;
+        void *session;
+        unsigned int generation;
+        sql_statement_cache_t statements;
+} sql_pool_session_t;
+
+
+/*
+ * Slots of the tables using the main session, or no session at all
+ * (asynchronous query results). Pool sessions use their index.
+ */
+#define SQL_SESSION_MAIN -1
+#define SQL_SESSION_NONE -2
+
+
 struct preludedb_sql {
         char *type;
         preludedb_sql_settings_t *settings;
         preludedb_plugin_sql_t *plugin;
         preludedb_sql_status_t status;
         void *session;
+        unsigned int generation;
         FILE *logfile;
         prelude_bool_t internal_transaction_disabled;
         gl_recursive_lock_t mutex;
         int refcount;
         void *data;
+        prelude_list_t insert_buffers;
+        prelude_bool_t bulk_load;
+        prelude_list_t ident_pools;
+        size_t ident_reserve;
+
+        sql_statement_cache_t statements;
+        unsigned int statement_cache_size;
+        prelude_bool_t binary_results;
+        int escape_flags;
+
+        gl_lock_t metrics_mutex;
+        prelude_hash_t *metrics_hash;
+        preludedb_sql_metrics_t metrics;
+
+        gl_lock_t plan_mutex;
+        prelude_list_t plans;
+        unsigned int plan_count;
+        unsigned int plan_cache_size;
+
+        /*
+         * Asynchronous queries run on a connection of their own, opened
+         * on first use. async_mutex guards all the fields below.
+         */
+        gl_lock_t async_mutex;
+        void *async;
+        prelude_list_t async_queries;
+        unsigned int async_sent;
+        prelude_bool_t async_pipeline;
+
+        gl_lock_t pool_mutex;
+        sql_pool_session_t *pool;
+        unsigned int pool_size;
+
+        /*
+         * The transaction state, also checked by the threads not holding
+         * the session lock, which a transaction keeps until it ends.
+         */
+        gl_lock_t transaction_mutex;
+        prelude_bool_t transaction;
+#if USE_POSIX_THREADS
+        pthread_t transaction_owner;
+#endif
 };
 
 
+typedef struct {
+        size_t offset;
+        size_t len;
+        preludedb_sql_param_type_t type;
+} sql_insert_param_t;
+
+
+typedef struct {
+        prelude_list_t list;
+        char *table;
+        char *fields;
+        prelude_string_t *values;
+        unsigned int count;
+
+        /*
+         * Rows queued through preludedb_sql_insert_params(): the values
+         * are copied one after the other in data and bound on flush.
+         */
+        unsigned int ncolumns;
+        unsigned int param_rows;
+        sql_insert_param_t *params;
+        unsigned int nparams;
+        unsigned int params_size;
+        char *data;
+        size_t data_len;
+        size_t data_size;
+} sql_insert_buffer_t;
+
+
+typedef struct {
+        prelude_list_t list;
+        char *table;
+        size_t count;
+        size_t pos;
+        uint64_t idents[];
+} sql_ident_pool_t;
+
+
 struct preludedb_sql_table {
         preludedb_sql_t *sql;
         void *data;
+        sql_statement_t *statement;
+        preludedb_sql_metrics_statement_t *metrics;
 
         preludedb_sql_row_t **rows;
         unsigned int nrow;
+        unsigned int rows_size;
         unsigned int row_count;
         unsigned int column_count;
 
         uint32_t refcount;
         uint8_t done;
+
+        /*
+         * The session the table comes from is referred to by its slot and
+         * generation, see table_session_get().
+         */
+        int session_slot;
+        unsigned int generation;
+
+        /*
+         * Streamed tables only keep the last fetched row, in rows[0].
+         */
+        uint8_t stream;
 };
 
 
 struct preludedb_sql_field {
         char *value;
         uint32_t len;
-        uint32_t index;
+        uint16_t index;
+        uint16_t type;
 };
 
 
@@ -128,10 +359,24 @@ struct preludedb_sql_row {
         void *data;
         uint32_t index;
         uint32_t refcount;
+
+        /*
+         * Set once a streamed table moved on to the next row while this
+         * one was still referenced: these references now own the row.
+         */
+        uint8_t detached;
         preludedb_sql_field_t fields[1];
 };
 
 
+struct preludedb_sql_params {
+        preludedb_sql_param_t *params;
+        char **values;
+        unsigned int count;
+        unsigned int size;
+};
+
+
 struct preludedb_sql_query {
         int refcount;
         char *string;
@@ -139,6 +384,7 @@ struct preludedb_sql_query {
         int64_t limit;
         int64_t offset;
         int for_update;
+        int stream;
 };
 
 
@@ -148,6 +394,8 @@ int _preludedb_sql_transaction_end(preludedb_sql_t *sql);
 int _preludedb_sql_transaction_abort(preludedb_sql_t *sql);
 void _preludedb_sql_enable_internal_transaction(preludedb_sql_t *sql);
 void _preludedb_sql_disable_internal_transaction(preludedb_sql_t *sql);
+int _preludedb_sql_bulk_load_start(preludedb_sql_t *sql, prelude_bool_t *previous);
+void _preludedb_sql_bulk_load_end(preludedb_sql_t *sql, prelude_bool_t previous);
 
 
 extern prelude_list_t _sql_plugin_list;
@@ -159,567 +407,2972 @@ static inline preludedb_sql_row_t *field2row(preludedb_sql_field_t *field)
 }
 
 
-static inline void update_sql_from_errno(preludedb_sql_t *sql, preludedb_error_t error)
+static void statement_cache_init(sql_statement_cache_t *cache)
 {
-        if ( preludedb_error_check(error, PRELUDEDB_ERROR_CONNECTION) ) {
-                _preludedb_plugin_sql_close(sql->plugin, sql->session);
-                sql->status &= ~PRELUDEDB_SQL_STATUS_CONNECTED;
-        }
+        prelude_list_init(&cache->statements);
+        cache->count = 0;
+        gl_lock_init(cache->mutex);
 }
 
 
-void preludedb_sql_set_data(preludedb_sql_t *sql, void *data)
+
+static void statement_destroy(preludedb_sql_t *sql, void *session, sql_statement_t *st)
 {
-        prelude_return_if_fail(sql);
-        sql->data = data;
+        _preludedb_plugin_sql_statement_destroy(sql->plugin, session, st->statement);
+        free(st->query);
+        free(st);
 }
 
 
 
-void *preludedb_sql_get_data(preludedb_sql_t *sql)
+/*
+ * Called with the session lock held, before @session is closed. Busy
+ * statements are detached, and released along with their table.
+ */
+static void statement_cache_clear(preludedb_sql_t *sql, sql_statement_cache_t *cache, void *session)
 {
-        prelude_return_val_if_fail(sql, NULL);
-        return sql->data;
-}
+        prelude_list_t *tmp, *bkp;
+        sql_statement_t *st;
+        prelude_bool_t busy;
 
+        prelude_list_for_each_safe(&cache->statements, tmp, bkp) {
+                st = prelude_list_entry(tmp, sql_statement_t, list);
 
-/**
- * preludedb_sql_new:
- * @new: Pointer to a sql object to initialize.
- * @type: Type of the database.
- * @settings: Settings for the choosen database.
- *
- * This function initialize the @new object, load and setup the plugin that
- * handle the database named @type with the configuration stored in @settings.
- *
- * Returns: 0 on success or a negative value if an error occur.
- */
-int preludedb_sql_new(preludedb_sql_t **new, const char *type, preludedb_sql_settings_t *settings)
-{
-        *new = calloc(1, sizeof(**new));
-        if ( ! *new )
-                return preludedb_error_from_errno(errno);
+                prelude_list_del(&st->list);
 
-        (*new)->refcount = 1;
-        gl_recursive_lock_init(((*new)->mutex));
+                gl_lock_lock(cache->mutex);
+                busy = st->busy;
+                st->cache = NULL;
+                gl_lock_unlock(cache->mutex);
 
-        if ( ! type ) {
-                type = preludedb_sql_settings_get_type(settings);
-                if ( ! type ) {
-                        free(*new);
-                        return preludedb_error_verbose(PRELUDEDB_ERROR_INVALID_SETTINGS_STRING, "No database type specified");
-                }
+                if ( ! busy )
+                        statement_destroy(sql, session, st);
         }
 
-        (*new)->type = strdup(type);
-        if ( ! (*new)->type ) {
-                free(*new);
-                return preludedb_error_from_errno(errno);
-        }
+        cache->count = 0;
+}
 
-        (*new)->settings = settings;
 
-        (*new)->plugin = (preludedb_plugin_sql_t *) prelude_plugin_search_by_name(&_sql_plugin_list, type);
-        if ( ! (*new)->plugin ) {
-                free((*new)->type);
-                free(*new);
-                return preludedb_error_verbose(PRELUDEDB_ERROR_CANNOT_LOAD_SQL_PLUGIN, "Could not load sql plugin '%s'", type);
-        }
 
-        if ( preludedb_sql_settings_get_log(settings) )
-                preludedb_sql_enable_query_logging(*new, preludedb_sql_settings_get_log(settings));
+static void statement_release(preludedb_sql_t *sql, sql_statement_t *st)
+{
+        prelude_bool_t detached;
 
-        return 0;
+        gl_lock_lock(*st->mutex);
+        st->busy = FALSE;
+        detached = (st->cache == NULL);
+        gl_lock_unlock(*st->mutex);
+
+        if ( detached )
+                statement_destroy(sql, NULL, st);
 }
 
 
 
-preludedb_sql_t *preludedb_sql_ref(preludedb_sql_t *sql)
+/*
+ * Close the main session. The tables retrieved from it are left without
+ * session.
+ */
+static void session_close(preludedb_sql_t *sql)
 {
-        sql->refcount++;
-        return sql;
+        statement_cache_clear(sql, &sql->statements, sql->session);
+        _preludedb_plugin_sql_close(sql->plugin, sql->session);
+        sql->status &= ~PRELUDEDB_SQL_STATUS_CONNECTED;
+        sql->generation++;
 }
 
 
 
+static inline void update_sql_from_errno(preludedb_sql_t *sql, preludedb_error_t error)
+{
+        if ( preludedb_error_check(error, PRELUDEDB_ERROR_CONNECTION) )
+                session_close(sql);
+}
 
-/**
- * preludedb_sql_destroy:
- * @sql: Pointer to a sql object.
- *
- * Destroy @sql and the underlying plugin.
- */
-void preludedb_sql_destroy(preludedb_sql_t *sql)
+
+static void insert_buffer_destroy(sql_insert_buffer_t *buf)
 {
-        if ( --sql->refcount > 0 )
-                return;
+        prelude_list_del(&buf->list);
+        prelude_string_destroy(buf->values);
+        free(buf->params);
+        free(buf->data);
+        free(buf->fields);
+        free(buf->table);
+        free(buf);
+}
 
-        if ( sql->status & PRELUDEDB_SQL_STATUS_CONNECTED )
-                _preludedb_plugin_sql_close(sql->plugin, sql->session);
 
-        if ( sql->logfile )
-                fclose(sql->logfile);
 
-        gl_recursive_lock_destroy(sql->mutex);
-        preludedb_sql_settings_destroy(sql->settings);
+static void insert_buffer_clear(preludedb_sql_t *sql)
+{
+        prelude_list_t *tmp, *bkp;
 
-        free(sql->type);
-        free(sql);
+        prelude_list_for_each_safe(&sql->insert_buffers, tmp, bkp)
+                insert_buffer_destroy(prelude_list_entry(tmp, sql_insert_buffer_t, list));
 }
 
 
 
-/**
- * preludedb_sql_enable_query_logging:
- * @sql: Pointer to a sql object.
- * @filename: Where the logs will be written.
- *
- * Log all queries in the specified file.
- *
- * Returns: 0 on success, or a negative value if an error occur.
- */
-int preludedb_sql_enable_query_logging(preludedb_sql_t *sql, const char *filename)
+static void plan_cache_clear(preludedb_sql_t *sql)
 {
-        int fd, ret;
-
-        if ( ! filename ) {
-                sql->logfile = stdout;
-                return 0;
-        }
+        sql_plan_t *plan;
+        prelude_list_t *tmp, *bkp;
 
-        sql->logfile = fopen(filename, "a");
-        if ( ! sql->logfile )
-                return preludedb_error_verbose(prelude_error_code_from_errno(errno),
-                                               "Could not open '%s' for writing: %s", filename, strerror(errno));
+        prelude_list_for_each_safe(&sql->plans, tmp, bkp) {
+                plan = prelude_list_entry(tmp, sql_plan_t, list);
 
-        fd = fileno(sql->logfile);
+                prelude_list_del(&plan->list);
+                free(plan->key);
+                free(plan->query);
+                free(plan);
+        }
 
-        ret = fcntl(fd, F_GETFD);
-        if ( ret < 0 )
-                return 0;
+        sql->plan_count = 0;
+}
 
-        fcntl(fd, F_SETFD, ret | FD_CLOEXEC);
 
-        return 0;
-}
 
+static void table_free(preludedb_sql_table_t *table);
 
 
-/**
- * preludedb_sql_disable_query_logging:
- * @sql: Pointer to a sql object.
- *
- * Disable query logging.
+/*
+ * Queries left are dropped without their callback being called: the
+ * object they would be reported on is being destroyed. Their tables do
+ * not hold a reference on @sql yet.
  */
-void preludedb_sql_disable_query_logging(preludedb_sql_t *sql)
+static void async_clear(preludedb_sql_t *sql)
 {
-        if ( sql->logfile && sql->logfile != stdout )
-                fclose(sql->logfile);
-
-        sql->logfile = NULL;
-}
+        sql_async_query_t *q;
+        prelude_list_t *tmp, *bkp;
 
+        prelude_list_for_each_safe(&sql->async_queries, tmp, bkp) {
+                q = prelude_list_entry(tmp, sql_async_query_t, list);
 
+                prelude_list_del(&q->list);
+                if ( q->table )
+                        table_free(q->table);
 
-
-int preludedb_sql_close(preludedb_sql_t *sql)
-{
-        if ( sql->status & PRELUDEDB_SQL_STATUS_CONNECTED ) {
-                _preludedb_plugin_sql_close(sql->plugin, sql->session);
-                sql->status &= ~PRELUDEDB_SQL_STATUS_CONNECTED;
+                free(q->query);
+                free(q);
         }
 
-        return 0;
+        if ( sql->async )
+                _preludedb_plugin_sql_async_close(sql->plugin, sql->async);
 }
 
 
 
-int preludedb_sql_connect(preludedb_sql_t *sql)
+static void ident_pool_clear(preludedb_sql_t *sql)
 {
-        int ret;
+        prelude_list_t *tmp, *bkp;
+        sql_ident_pool_t *pool;
 
-        if ( sql->status & PRELUDEDB_SQL_STATUS_CONNECTED ) {
-                _preludedb_plugin_sql_close(sql->plugin, sql->session);
-                sql->status &= ~PRELUDEDB_SQL_STATUS_CONNECTED;
+        prelude_list_for_each_safe(&sql->ident_pools, tmp, bkp) {
+                pool = prelude_list_entry(tmp, sql_ident_pool_t, list);
+
+                prelude_list_del(&pool->list);
+                free(pool->table);
+                free(pool);
         }
+}
 
-        ret = _preludedb_plugin_sql_open(sql->plugin, sql->settings, &sql->session);
-        if ( ret < 0 )
-                return ret;
 
-        sql->status = PRELUDEDB_SQL_STATUS_CONNECTED;
 
-        return 0;
-}
+static int pool_new(preludedb_sql_t *sql, const char *size)
+{
+        unsigned int i;
 
+        /*
+         * The pool size include the writer session, reader sessions only
+         * make sense starting with a pool of two.
+         */
+        sql->pool_size = strtoul(size, NULL, 10);
+        if ( sql->pool_size <= 1 ) {
+                sql->pool_size = 0;
+                return 0;
+        }
 
+        sql->pool_size--;
 
-int preludedb_sql_table_new(preludedb_sql_table_t **new, void *data)
-{
-        *new = malloc(sizeof(**new));
-        if ( ! *new )
+        sql->pool = calloc(sql->pool_size, sizeof(*sql->pool));
+        if ( ! sql->pool )
                 return preludedb_error_from_errno(errno);
 
-        (*new)->rows = NULL;
-        (*new)->nrow = 0;
-        (*new)->row_count = 0;
-        (*new)->column_count = 0;
-        (*new)->done = FALSE;
-        (*new)->refcount = 1;
-        (*new)->data = data;
+        for ( i = 0; i < sql->pool_size; i++ )
+                statement_cache_init(&sql->pool[i].statements);
+
+        gl_lock_init(sql->pool_mutex);
 
         return 0;
 }
 
 
 
-void *preludedb_sql_table_get_data(preludedb_sql_table_t *table)
+static void pool_session_close(preludedb_sql_t *sql, sql_pool_session_t *ps)
 {
-        return table->data;
+        statement_cache_clear(sql, &ps->statements, ps->session);
+        _preludedb_plugin_sql_close(sql->plugin, ps->session);
+        ps->status &= ~PRELUDEDB_SQL_STATUS_CONNECTED;
+        ps->generation++;
 }
 
 
 
-/**
- * preludedb_sql_query_set_option:
- * @query: Pointer to a query object.
- * @cmd: The code of the option to set.
- * @...: Variable argument list containing the value.
- *
- * Set the value of the specified option for the query @query.
- * This value needs to be cast to the appropriate type by the caller.
- *
- * Returns: 0 on success or a negative value if an error occurs.
- */
-int preludedb_sql_query_set_option(preludedb_sql_query_t *query, int cmd, ...)
+static void pool_destroy(preludedb_sql_t *sql)
 {
-        va_list va;
+        unsigned int i;
 
-        va_start(va, cmd);
+        if ( ! sql->pool )
+                return;
 
-        switch (cmd) {
-                case PRELUDEDB_SQL_QUERY_OPTION_LIMIT:
-                    query->limit = va_arg(va, int64_t);
-                    break;
+        for ( i = 0; i < sql->pool_size; i++ ) {
+                if ( sql->pool[i].status & PRELUDEDB_SQL_STATUS_CONNECTED )
+                        pool_session_close(sql, &sql->pool[i]);
 
-                case PRELUDEDB_SQL_QUERY_OPTION_OFFSET:
-                    query->offset = va_arg(va, int64_t);
-                    break;
+                gl_lock_destroy(sql->pool[i].statements.mutex);
+        }
 
-                case PRELUDEDB_SQL_QUERY_OPTION_FOR_UPDATE:
-                    query->for_update = TRUE;
-                    break;
+        gl_lock_destroy(sql->pool_mutex);
+        free(sql->pool);
+}
 
-                default:
-                    return prelude_error_verbose(PRELUDE_ERROR_GENERIC, "could not set query option: unknown value '%d'", cmd);
+
+
+/*
+ * Pick an idle reader session. Returns its slot, or -1 when they are all
+ * held by results still in use.
+ */
+static int pool_checkout(preludedb_sql_t *sql)
+{
+        int slot = -1;
+        unsigned int i;
+
+        gl_lock_lock(sql->pool_mutex);
+
+        for ( i = 0; i < sql->pool_size; i++ ) {
+                if ( ! sql->pool[i].busy ) {
+                        sql->pool[i].busy = TRUE;
+                        slot = i;
+                        break;
+                }
         }
 
-        va_end(va);
+        gl_lock_unlock(sql->pool_mutex);
 
-        return 0;
+        return slot;
 }
 
 
 
-/**
- * preludedb_sql_query_get_option:
- * @query: Pointer to a query object.
- * @cmd: The code of the option to retrieve.
- * @ret: Pointer to an address where to store the option value.
- *
+static void pool_checkin(preludedb_sql_t *sql, int slot)
+{
+        sql_pool_session_t *ps = &sql->pool[slot];
+
+        gl_lock_lock(sql->pool_mutex);
+
+        if ( ps->reset && ps->status & PRELUDEDB_SQL_STATUS_CONNECTED )
+                pool_session_close(sql, ps);
+
+        ps->reset = FALSE;
+        ps->busy = FALSE;
+
+        gl_lock_unlock(sql->pool_mutex);
+}
+
+
+
+/*
+ * Close the reader sessions, so that they reconnect with the main session.
+ * The sessions held by a result are closed when it is released.
+ */
+static void pool_reset(preludedb_sql_t *sql)
+{
+        unsigned int i;
+
+        if ( ! sql->pool )
+                return;
+
+        gl_lock_lock(sql->pool_mutex);
+
+        for ( i = 0; i < sql->pool_size; i++ ) {
+                if ( sql->pool[i].busy )
+                        sql->pool[i].reset = TRUE;
+
+                else if ( sql->pool[i].status & PRELUDEDB_SQL_STATUS_CONNECTED )
+                        pool_session_close(sql, &sql->pool[i]);
+        }
+
+        gl_lock_unlock(sql->pool_mutex);
+}
+
+
+
+static void set_transaction(preludedb_sql_t *sql, prelude_bool_t running)
+{
+        gl_lock_lock(sql->transaction_mutex);
+
+        sql->transaction = running;
+#if USE_POSIX_THREADS
+        if ( running )
+                sql->transaction_owner = pthread_self();
+#endif
+
+        gl_lock_unlock(sql->transaction_mutex);
+}
+
+
+
+static prelude_bool_t in_transaction(preludedb_sql_t *sql)
+{
+        prelude_bool_t running;
+
+        gl_lock_lock(sql->transaction_mutex);
+        running = sql->transaction;
+        gl_lock_unlock(sql->transaction_mutex);
+
+        return running;
+}
+
+
+
+/*
+ * Whether the calling thread is the one running the current transaction,
+ * in which case its queries have to go through the transaction session.
+ * Without a way to identify threads, assume it is.
+ */
+static prelude_bool_t is_transaction_owner(preludedb_sql_t *sql)
+{
+        prelude_bool_t owner;
+
+        gl_lock_lock(sql->transaction_mutex);
+
+        owner = sql->transaction;
+#if USE_POSIX_THREADS
+        if ( owner )
+                owner = pthread_equal(sql->transaction_owner, pthread_self()) ? TRUE : FALSE;
+#endif
+
+        gl_lock_unlock(sql->transaction_mutex);
+
+        return owner;
+}
+
+
+
+void preludedb_sql_set_data(preludedb_sql_t *sql, void *data)
+{
+        prelude_return_if_fail(sql);
+        sql->data = data;
+}
+
+
+
+void *preludedb_sql_get_data(preludedb_sql_t *sql)
+{
+        prelude_return_val_if_fail(sql, NULL);
+        return sql->data;
+}
+
+
+
+/*
+ * Highest value falling in @bucket.
+ */
+static uint64_t metrics_get_bucket_value(unsigned int bucket)
+{
+        unsigned int magnitude;
+
+        if ( bucket < 2 * METRICS_SUB_BUCKET_COUNT )
+                return bucket;
+
+        magnitude = bucket / METRICS_SUB_BUCKET_COUNT + METRICS_SUB_BUCKET_BITS - 1;
+
+        return (((uint64_t) (bucket % METRICS_SUB_BUCKET_COUNT + METRICS_SUB_BUCKET_COUNT + 1)) <<
+                (magnitude - METRICS_SUB_BUCKET_BITS)) - 1;
+}
+
+
+
+static void metrics_clear(preludedb_sql_metrics_t *metrics)
+{
+        prelude_list_t *tmp, *bkp;
+        preludedb_sql_metrics_statement_t *st;
+
+        prelude_list_for_each_safe(&metrics->statements, tmp, bkp) {
+                st = prelude_list_entry(tmp, preludedb_sql_metrics_statement_t, list);
+
+                prelude_list_del(&st->list);
+                free(st->name);
+                free(st);
+        }
+}
+
+
+
+static void locks_destroy(preludedb_sql_t *sql)
+{
+        gl_lock_destroy(sql->metrics_mutex);
+        gl_lock_destroy(sql->statements.mutex);
+        gl_lock_destroy(sql->plan_mutex);
+        gl_lock_destroy(sql->async_mutex);
+        gl_lock_destroy(sql->transaction_mutex);
+        gl_recursive_lock_destroy(sql->mutex);
+}
+
+
+
+/**
+ * preludedb_sql_new:
+ * @new: Pointer to a sql object to initialize.
+ * @type: Type of the database.
+ * @settings: Settings for the choosen database.
+ *
+ * This function initialize the @new object, load and setup the plugin that
+ * handle the database named @type with the configuration stored in @settings.
+ *
+ * Returns: 0 on success or a negative value if an error occur.
+ */
+int preludedb_sql_new(preludedb_sql_t **new, const char *type, preludedb_sql_settings_t *settings)
+{
+        int ret;
+
+        *new = calloc(1, sizeof(**new));
+        if ( ! *new )
+                return preludedb_error_from_errno(errno);
+
+        (*new)->refcount = 1;
+        (*new)->escape_flags = -1;
+        gl_recursive_lock_init(((*new)->mutex));
+        prelude_list_init(&(*new)->insert_buffers);
+        prelude_list_init(&(*new)->ident_pools);
+        statement_cache_init(&(*new)->statements);
+        prelude_list_init(&(*new)->plans);
+        gl_lock_init((*new)->plan_mutex);
+        prelude_list_init(&(*new)->async_queries);
+        gl_lock_init((*new)->async_mutex);
+        prelude_list_init(&(*new)->metrics.statements);
+        gl_lock_init((*new)->metrics_mutex);
+        gl_lock_init((*new)->transaction_mutex);
+
+        if ( ! type ) {
+                type = preludedb_sql_settings_get_type(settings);
+                if ( ! type ) {
+                        ret = preludedb_error_verbose(PRELUDEDB_ERROR_INVALID_SETTINGS_STRING, "No database type specified");
+                        goto error;
+                }
+        }
+
+        (*new)->type = strdup(type);
+        if ( ! (*new)->type ) {
+                ret = preludedb_error_from_errno(errno);
+                goto error;
+        }
+
+        (*new)->settings = settings;
+
+        (*new)->plugin = (preludedb_plugin_sql_t *) prelude_plugin_search_by_name(&_sql_plugin_list, type);
+        if ( ! (*new)->plugin ) {
+                ret = preludedb_error_verbose(PRELUDEDB_ERROR_CANNOT_LOAD_SQL_PLUGIN, "Could not load sql plugin '%s'", type);
+                goto error;
+        }
+
+        if ( preludedb_sql_settings_get_pool_size(settings) ) {
+                ret = pool_new(*new, preludedb_sql_settings_get_pool_size(settings));
+                if ( ret < 0 )
+                        goto error;
+        }
+
+        if ( preludedb_sql_settings_get_log(settings) )
+                preludedb_sql_enable_query_logging(*new, preludedb_sql_settings_get_log(settings));
+
+        if ( preludedb_sql_settings_get_ident_reserve(settings) )
+                (*new)->ident_reserve = strtoul(preludedb_sql_settings_get_ident_reserve(settings), NULL, 10);
+
+        (*new)->statement_cache_size = strtoul(preludedb_sql_settings_get_statement_cache(settings), NULL, 10);
+        (*new)->plan_cache_size = strtoul(preludedb_sql_settings_get_plan_cache(settings), NULL, 10);
+        (*new)->binary_results = (strtoul(preludedb_sql_settings_get_binary_results(settings), NULL, 10) != 0);
+
+        return 0;
+
+ error:
+        pool_destroy(*new);
+        locks_destroy(*new);
+        free((*new)->type);
+        free(*new);
+
+        return ret;
+}
+
+
+
+preludedb_sql_t *preludedb_sql_ref(preludedb_sql_t *sql)
+{
+        sql->refcount++;
+        return sql;
+}
+
+
+
+
+/**
+ * preludedb_sql_destroy:
+ * @sql: Pointer to a sql object.
+ *
+ * Destroy @sql and the underlying plugin.
+ */
+void preludedb_sql_destroy(preludedb_sql_t *sql)
+{
+        if ( --sql->refcount > 0 )
+                return;
+
+        if ( sql->status & PRELUDEDB_SQL_STATUS_CONNECTED )
+                session_close(sql);
+
+        if ( sql->logfile )
+                fclose(sql->logfile);
+
+        insert_buffer_clear(sql);
+        ident_pool_clear(sql);
+        plan_cache_clear(sql);
+        async_clear(sql);
+        pool_destroy(sql);
+        metrics_clear(&sql->metrics);
+        if ( sql->metrics_hash )
+                prelude_hash_destroy(sql->metrics_hash);
+
+        locks_destroy(sql);
+        preludedb_sql_settings_destroy(sql->settings);
+
+        free(sql->type);
+        free(sql);
+}
+
+
+
+/**
+ * preludedb_sql_enable_query_logging:
+ * @sql: Pointer to a sql object.
+ * @filename: Where the logs will be written.
+ *
+ * Log all queries in the specified file.
+ *
+ * Returns: 0 on success, or a negative value if an error occur.
+ */
+int preludedb_sql_enable_query_logging(preludedb_sql_t *sql, const char *filename)
+{
+        int fd, ret;
+
+        if ( ! filename ) {
+                sql->logfile = stdout;
+                return 0;
+        }
+
+        sql->logfile = fopen(filename, "a");
+        if ( ! sql->logfile )
+                return preludedb_error_verbose(prelude_error_code_from_errno(errno),
+                                               "Could not open '%s' for writing: %s", filename, strerror(errno));
+
+        fd = fileno(sql->logfile);
+
+        ret = fcntl(fd, F_GETFD);
+        if ( ret < 0 )
+                return 0;
+
+        fcntl(fd, F_SETFD, ret | FD_CLOEXEC);
+
+        return 0;
+}
+
+
+
+/**
+ * preludedb_sql_disable_query_logging:
+ * @sql: Pointer to a sql object.
+ *
+ * Disable query logging.
+ */
+void preludedb_sql_disable_query_logging(preludedb_sql_t *sql)
+{
+        if ( sql->logfile && sql->logfile != stdout )
+                fclose(sql->logfile);
+
+        sql->logfile = NULL;
+}
+
+
+
+/**
+ * preludedb_sql_get_metrics:
+ * @sql: Pointer to a sql object.
+ * @metrics: Where the snapshot of the metrics will be stored.
+ *
+ * Take a snapshot of the metrics accounted for the queries run through @sql
+ * since its creation, or the last call to preludedb_sql_reset_metrics().
+ * The snapshot has to be released with preludedb_sql_metrics_destroy().
+ *
+ * Returns: 0 on success or a negative value if an error occur.
+ */
+int preludedb_sql_get_metrics(preludedb_sql_t *sql, preludedb_sql_metrics_t **metrics)
+{
+        int ret = 0;
+        prelude_list_t *tmp;
+        preludedb_sql_metrics_statement_t *st, *copy;
+
+        prelude_return_val_if_fail(sql, prelude_error(PRELUDE_ERROR_ASSERTION));
+        prelude_return_val_if_fail(metrics, prelude_error(PRELUDE_ERROR_ASSERTION));
+
+        *metrics = calloc(1, sizeof(**metrics));
+        if ( ! *metrics )
+                return preludedb_error_from_errno(errno);
+
+        prelude_list_init(&(*metrics)->statements);
+
+        gl_lock_lock(sql->metrics_mutex);
+
+        (*metrics)->escaped_bytes = sql->metrics.escaped_bytes;
+
+        prelude_list_for_each(&sql->metrics.statements, tmp) {
+                st = prelude_list_entry(tmp, preludedb_sql_metrics_statement_t, list);
+
+                copy = malloc(sizeof(*copy));
+                if ( ! copy ) {
+                        ret = preludedb_error_from_errno(errno);
+                        break;
+                }
+
+                memcpy(copy, st, sizeof(*copy));
+
+                copy->name = strdup(st->name);
+                if ( ! copy->name ) {
+                        free(copy);
+                        ret = preludedb_error_from_errno(errno);
+                        break;
+                }
+
+                prelude_list_add_tail(&(*metrics)->statements, &copy->list);
+        }
+
+        gl_lock_unlock(sql->metrics_mutex);
+
+        if ( ret < 0 )
+                preludedb_sql_metrics_destroy(*metrics);
+
+        return ret;
+}
+
+
+
+/**
+ * preludedb_sql_reset_metrics:
+ * @sql: Pointer to a sql object.
+ *
+ * Reset the metrics accounted for the queries run through @sql.
+ */
+void preludedb_sql_reset_metrics(preludedb_sql_t *sql)
+{
+        prelude_list_t *tmp;
+        preludedb_sql_metrics_statement_t *st;
+
+        prelude_return_if_fail(sql);
+
+        /*
+         * Statements are kept, tables being fetched still refer to them.
+         */
+        gl_lock_lock(sql->metrics_mutex);
+
+        sql->metrics.escaped_bytes = 0;
+
+        prelude_list_for_each(&sql->metrics.statements, tmp) {
+                st = prelude_list_entry(tmp, preludedb_sql_metrics_statement_t, list);
+                memset(&st->calls, 0, sizeof(*st) - offsetof(preludedb_sql_metrics_statement_t, calls));
+        }
+
+        gl_lock_unlock(sql->metrics_mutex);
+}
+
+
+
+/**
+ * preludedb_sql_metrics_destroy:
+ * @metrics: Pointer to a metrics snapshot.
+ *
+ * Destroy a snapshot returned by preludedb_sql_get_metrics().
+ */
+void preludedb_sql_metrics_destroy(preludedb_sql_metrics_t *metrics)
+{
+        prelude_return_if_fail(metrics);
+
+        metrics_clear(metrics);
+        free(metrics);
+}
+
+
+
+/**
+ * preludedb_sql_metrics_get_escaped_bytes:
+ * @metrics: Pointer to a metrics snapshot.
+ *
+ * Returns: the number of bytes escaped through the sql object.
+ */
+uint64_t preludedb_sql_metrics_get_escaped_bytes(preludedb_sql_metrics_t *metrics)
+{
+        prelude_return_val_if_fail(metrics, 0);
+        return metrics->escaped_bytes;
+}
+
+
+
+/**
+ * preludedb_sql_metrics_get_next_statement:
+ * @metrics: Pointer to a metrics snapshot.
+ * @statement: Pointer to the previous statement, or NULL to get the first one.
+ *
+ * Iterate through the statements accounted in @metrics, one per query
+ * shape: the lowercased query verb, followed by its main table if any
+ * (e.g. "select Prelude_Alert").
+ *
+ * Returns: the next statement, or NULL if there are no more.
+ */
+preludedb_sql_metrics_statement_t *preludedb_sql_metrics_get_next_statement(preludedb_sql_metrics_t *metrics,
+                                                                            preludedb_sql_metrics_statement_t *statement)
+{
+        prelude_list_t *tmp;
+
+        prelude_return_val_if_fail(metrics, NULL);
+
+        tmp = (statement) ? statement->list.next : metrics->statements.next;
+        if ( tmp == &metrics->statements )
+                return NULL;
+
+        return prelude_list_entry(tmp, preludedb_sql_metrics_statement_t, list);
+}
+
+
+
+const char *preludedb_sql_metrics_statement_get_name(preludedb_sql_metrics_statement_t *statement)
+{
+        prelude_return_val_if_fail(statement, NULL);
+        return statement->name;
+}
+
+
+
+uint64_t preludedb_sql_metrics_statement_get_calls(preludedb_sql_metrics_statement_t *statement)
+{
+        prelude_return_val_if_fail(statement, 0);
+        return statement->calls;
+}
+
+
+
+uint64_t preludedb_sql_metrics_statement_get_errors(preludedb_sql_metrics_statement_t *statement)
+{
+        prelude_return_val_if_fail(statement, 0);
+        return statement->errors;
+}
+
+
+
+/**
+ * preludedb_sql_metrics_statement_get_rows:
+ * @statement: Pointer to a metrics statement.
+ *
+ * Returns: the number of rows affected or returned, as reported by the backend.
+ */
+uint64_t preludedb_sql_metrics_statement_get_rows(preludedb_sql_metrics_statement_t *statement)
+{
+        prelude_return_val_if_fail(statement, 0);
+        return statement->rows;
+}
+
+
+
+/**
+ * preludedb_sql_metrics_statement_get_fetched_rows:
+ * @statement: Pointer to a metrics statement.
+ *
+ * Returns: the number of rows fetched from the results, accounted once they are destroyed.
+ */
+uint64_t preludedb_sql_metrics_statement_get_fetched_rows(preludedb_sql_metrics_statement_t *statement)
+{
+        prelude_return_val_if_fail(statement, 0);
+        return statement->fetched_rows;
+}
+
+
+
+/**
+ * preludedb_sql_metrics_statement_get_total_time:
+ * @statement: Pointer to a metrics statement.
+ *
+ * Returns: the time spent running the statements, in microseconds.
+ */
+uint64_t preludedb_sql_metrics_statement_get_total_time(preludedb_sql_metrics_statement_t *statement)
+{
+        prelude_return_val_if_fail(statement, 0);
+        return statement->total_time;
+}
+
+
+
+uint64_t preludedb_sql_metrics_statement_get_max_time(preludedb_sql_metrics_statement_t *statement)
+{
+        prelude_return_val_if_fail(statement, 0);
+        return statement->max_time;
+}
+
+
+
+/**
+ * preludedb_sql_metrics_statement_get_percentile:
+ * @statement: Pointer to a metrics statement.
+ * @percentile: Percentile to compute, between 0 and 100.
+ *
+ * Compute a latency percentile from the histogram of @statement. The
+ * result is the upper bound of the histogram bucket the percentile falls
+ * in, at most 12.5% above the exact value.
+ *
+ * Returns: the latency percentile in microseconds, 0 if no statement was run.
+ */
+uint64_t preludedb_sql_metrics_statement_get_percentile(preludedb_sql_metrics_statement_t *statement, double percentile)
+{
+        unsigned int i;
+        uint64_t rank, count = 0;
+
+        prelude_return_val_if_fail(statement, 0);
+
+        if ( statement->calls == 0 )
+                return 0;
+
+        if ( percentile <= 0 )
+                percentile = 0;
+
+        else if ( percentile >= 100 )
+                return statement->max_time;
+
+        rank = (uint64_t) (statement->calls * percentile / 100);
+        if ( rank < statement->calls )
+                rank++;
+
+        for ( i = 0; i < METRICS_BUCKET_COUNT; i++ ) {
+                count += statement->buckets[i];
+                if ( count >= rank )
+                        return MIN(metrics_get_bucket_value(i), statement->max_time);
+        }
+
+        return statement->max_time;
+}
+
+
+
+
+int preludedb_sql_close(preludedb_sql_t *sql)
+{
+        gl_recursive_lock_lock(sql->mutex);
+
+        if ( sql->status & PRELUDEDB_SQL_STATUS_CONNECTED )
+                session_close(sql);
+
+        pool_reset(sql);
+
+        gl_recursive_lock_unlock(sql->mutex);
+
+        return 0;
+}
+
+
+
+int preludedb_sql_connect(preludedb_sql_t *sql)
+{
+        int ret;
+
+        gl_recursive_lock_lock(sql->mutex);
+
+        if ( sql->status & PRELUDEDB_SQL_STATUS_CONNECTED )
+                session_close(sql);
+
+        pool_reset(sql);
+
+        ret = _preludedb_plugin_sql_open(sql->plugin, sql->settings, &sql->session);
+        if ( ret >= 0 ) {
+                sql->status = PRELUDEDB_SQL_STATUS_CONNECTED;
+                sql->escape_flags = _preludedb_plugin_sql_get_escape_flags(sql->plugin, sql->session);
+        }
+
+        gl_recursive_lock_unlock(sql->mutex);
+
+        return (ret < 0) ? ret : 0;
+}
+
+
+
+int preludedb_sql_table_new(preludedb_sql_table_t **new, void *data)
+{
+        *new = malloc(sizeof(**new));
+        if ( ! *new )
+                return preludedb_error_from_errno(errno);
+
+        (*new)->rows = NULL;
+        (*new)->nrow = 0;
+        (*new)->row_count = 0;
+        (*new)->column_count = 0;
+        (*new)->done = FALSE;
+        (*new)->stream = FALSE;
+        (*new)->session_slot = SQL_SESSION_NONE;
+        (*new)->generation = 0;
+        (*new)->statement = NULL;
+        (*new)->metrics = NULL;
+        (*new)->refcount = 1;
+        (*new)->data = data;
+
+        return 0;
+}
+
+
+
+void *preludedb_sql_table_get_data(preludedb_sql_table_t *table)
+{
+        return table->data;
+}
+
+
+
+/**
+ * preludedb_sql_query_set_option:
+ * @query: Pointer to a query object.
+ * @cmd: The code of the option to set.
+ * @...: Variable argument list containing the value.
+ *
+ * Set the value of the specified option for the query @query.
+ * This value needs to be cast to the appropriate type by the caller.
+ *
+ * Returns: 0 on success or a negative value if an error occurs.
+ */
+int preludedb_sql_query_set_option(preludedb_sql_query_t *query, int cmd, ...)
+{
+        va_list va;
+
+        va_start(va, cmd);
+
+        switch (cmd) {
+                case PRELUDEDB_SQL_QUERY_OPTION_LIMIT:
+                    query->limit = va_arg(va, int64_t);
+                    break;
+
+                case PRELUDEDB_SQL_QUERY_OPTION_OFFSET:
+                    query->offset = va_arg(va, int64_t);
+                    break;
+
+                case PRELUDEDB_SQL_QUERY_OPTION_FOR_UPDATE:
+                    query->for_update = TRUE;
+                    break;
+
+                case PRELUDEDB_SQL_QUERY_OPTION_STREAM:
+                    query->stream = TRUE;
+                    break;
+
+                default:
+                    return prelude_error_verbose(PRELUDE_ERROR_GENERIC, "could not set query option: unknown value '%d'", cmd);
+        }
+
+        va_end(va);
+
+        return 0;
+}
+
+
+
+/**
+ * preludedb_sql_query_get_option:
+ * @query: Pointer to a query object.
+ * @cmd: The code of the option to retrieve.
+ * @ret: Pointer to an address where to store the option value.
+ *
  * Get the value of the specified option for the query @query.
  * This value will need to be cast to the appropriate type by the caller.
  *
- * Returns: 0 on success or a negative value if an error occurs.
+ * Returns: 0 on success or a negative value if an error occurs.
+ */
+int preludedb_sql_query_get_option(preludedb_sql_query_t *query, int cmd, void *ret)
+{
+        switch (cmd) {
+                case PRELUDEDB_SQL_QUERY_OPTION_LIMIT:
+                    if ( ret )
+                            (*(int64_t *) ret) = query->limit;
+
+                    return (query->limit != -1) ? 1 : 0;
+
+                case PRELUDEDB_SQL_QUERY_OPTION_OFFSET:
+                    if ( ret )
+                            (*(int64_t *) ret) = query->offset;
+                    return (query->offset != -1) ? 1 : 0;
+
+                case PRELUDEDB_SQL_QUERY_OPTION_FOR_UPDATE:
+                    if ( ret )
+                            (*(int *) ret) = query->for_update;
+
+                    return (query->for_update) ? 1 : 0;
+
+                case PRELUDEDB_SQL_QUERY_OPTION_STREAM:
+                    if ( ret )
+                            (*(int *) ret) = query->stream;
+
+                    return (query->stream) ? 1 : 0;
+
+                default:
+                    return prelude_error_verbose(PRELUDE_ERROR_GENERIC, "could not get query option: unknown value '%d'", cmd);
+        }
+
+        return 0;
+}
+
+
+
+/**
+ * preludedb_sql_query_new:
+ * @new: Pointer to a query object to initialize.
+ * @querystr: The SQL query.
+ *
+ * This function initialize the @new object.
+ *
+ * Returns: 0 on success or a negative value if an error occurs.
+ */
+int preludedb_sql_query_new(preludedb_sql_query_t **new, const char *querystr)
+{
+        *new = calloc(sizeof(**new), 1);
+        if ( ! *new )
+                return preludedb_error_from_errno(errno);
+
+        (*new)->string = strdup(querystr);
+        if ( ! (*new)->string ) {
+                free(*new);
+                return preludedb_error_from_errno(errno);
+        }
+
+        (*new)->limit = (*new)->offset = -1;
+        (*new)->refcount = 1;
+
+        return 0;
+}
+
+
+
+preludedb_sql_query_t *preludedb_sql_query_ref(preludedb_sql_query_t *query)
+{
+        query->refcount++;
+        return query;
+}
+
+
+
+/**
+ * preludedb_sql_query_get_string:
+ * @sql: Pointer to a sql object.
+ * @query: Pointer to a query object.
+ *
+ * Get the original query string for the query @query.
+ *
+ * Returns: a pointer to the query string.
+ */
+const char *preludedb_sql_query_get_string(preludedb_sql_query_t *query)
+{
+        return query->string;
+}
+
+
+
+/**
+ * preludedb_sql_query_prepare:
+ * @sql: Pointer to a sql object.
+ * @query: Pointer to a query object.
+ * @output: Where the final query string will be stored.
+ *
+ * Get the final query string for the query @query.
+ *
+ * Returns: 0 on success or a negative value if an error occurs.
+ */
+int preludedb_sql_query_prepare(preludedb_sql_t *sql, preludedb_sql_query_t *query, prelude_string_t *output)
+{
+        return _preludedb_plugin_sql_query_prepare(sql, query, output);
+}
+
+
+
+/**
+ * preludedb_sql_query_execute:
+ * @sql: Pointer to a sql object.
+ * @query: Pointer to a query object.
+ * @table: Pointer to a table where the query result will be stored if the type of query returns
+ * results (i.e a SELECT can result, but an INSERT never results) and if the query is successful.
+ *
+ * Execute a SQL query. Queries with the %PRELUDEDB_SQL_QUERY_OPTION_STREAM
+ * option set are run through preludedb_sql_query_stream().
+ *
+ * Returns: number of affected rows, -1 if an error occured.
+ */
+int preludedb_sql_query_execute(preludedb_sql_t *sql, preludedb_sql_query_t *query, preludedb_sql_table_t **table)
+{
+        int ret;
+        prelude_string_t *output;
+
+        ret = prelude_string_new(&output);
+        if ( ret < 0 )
+                return ret;
+
+        ret = preludedb_sql_query_prepare(sql, query, output);
+        if ( ret < 0 ) {
+                prelude_string_destroy(output);
+                return ret;
+        }
+
+        if ( query->stream )
+                ret = preludedb_sql_query_stream(sql, prelude_string_get_string(output), table);
+        else
+                ret = preludedb_sql_query(sql, prelude_string_get_string(output), table);
+
+        prelude_string_destroy(output);
+        return ret;
+}
+
+
+
+/**
+ * preludedb_sql_query_destroy:
+ * @table: Pointer to a query object.
+ *
+ * Destroy the @query object.
+ */
+void preludedb_sql_query_destroy(preludedb_sql_query_t *query)
+{
+        if ( --query->refcount > 0 )
+                return;
+
+        free(query->string);
+        free(query);
+}
+
+
+
+/*
+ * Get the shape of @query: its lowercased verb, followed by the table it
+ * works on for INSERT, SELECT, UPDATE, DELETE and COPY.
+ */
+static void get_query_shape(const char *query, char *shape, size_t size)
+{
+        size_t len = 0;
+        const char *table = NULL, *end;
+
+        while ( isspace((unsigned char) *query) || *query == '(' )
+                query++;
+
+        while ( isalpha((unsigned char) query[len]) && len + 1 < size ) {
+                shape[len] = tolower((unsigned char) query[len]);
+                len++;
+        }
+
+        shape[len] = 0;
+
+        if ( strcmp(shape, "insert") == 0 )
+                table = strstr(query, " INTO ");
+
+        else if ( strcmp(shape, "select") == 0 || strcmp(shape, "delete") == 0 )
+                table = strstr(query, " FROM ");
+
+        else if ( strcmp(shape, "update") == 0 || strcmp(shape, "copy") == 0 )
+                table = query + len;
+
+        if ( ! table )
+                return;
+
+        if ( *table == ' ' && ! (strcmp(shape, "update") == 0 || strcmp(shape, "copy") == 0) )
+                table += 6;
+
+        while ( isspace((unsigned char) *table) || *table == '"' || *table == '`' )
+                table++;
+
+        for ( end = table; isalnum((unsigned char) *end) || *end == '_' || *end == '.'; end++ );
+
+        if ( end > table )
+                snprintf(shape + len, size - len, " %.*s", (int) (end - table), table);
+}
+
+
+
+static unsigned int metrics_get_bucket(uint64_t value)
+{
+        unsigned int magnitude = METRICS_SUB_BUCKET_BITS + 1;
+
+        if ( value < 2 * METRICS_SUB_BUCKET_COUNT )
+                return value;
+
+        if ( value >> METRICS_MAX_MAGNITUDE )
+                value = ((uint64_t) 1 << METRICS_MAX_MAGNITUDE) - 1;
+
+        while ( value >> (magnitude + 1) )
+                magnitude++;
+
+        return (magnitude - METRICS_SUB_BUCKET_BITS + 1) * METRICS_SUB_BUCKET_COUNT +
+               (value >> (magnitude - METRICS_SUB_BUCKET_BITS)) - METRICS_SUB_BUCKET_COUNT;
+}
+
+
+
+/*
+ * Find the metrics of the @shape statements, creating them if needed.
+ * Called with the metrics lock held.
+ */
+static preludedb_sql_metrics_statement_t *metrics_get_statement(preludedb_sql_t *sql, const char *shape)
+{
+        int ret;
+        preludedb_sql_metrics_statement_t *st;
+
+        if ( ! sql->metrics_hash ) {
+                ret = prelude_hash_new(&sql->metrics_hash, NULL, NULL, NULL, NULL);
+                if ( ret < 0 )
+                        return NULL;
+        }
+
+        st = prelude_hash_get(sql->metrics_hash, shape);
+        if ( st )
+                return st;
+
+        st = calloc(1, sizeof(*st));
+        if ( ! st )
+                return NULL;
+
+        st->name = strdup(shape);
+        if ( ! st->name ) {
+                free(st);
+                return NULL;
+        }
+
+        ret = prelude_hash_set(sql->metrics_hash, st->name, st);
+        if ( ret < 0 ) {
+                free(st->name);
+                free(st);
+                return NULL;
+        }
+
+        prelude_list_add_tail(&sql->metrics.statements, &st->list);
+
+        return st;
+}
+
+
+
+/*
+ * Account a query in the metrics of its shape and the query log. The
+ * table it returned, if any, reports the rows fetched from it once
+ * destroyed.
+ */
+static void log_query(preludedb_sql_t *sql, struct timeval *start, struct timeval *end, const char *query,
+                      int ret, preludedb_sql_table_t *table)
+{
+        char shape[128];
+        uint64_t elapsed;
+        preludedb_sql_metrics_statement_t *st;
+
+        elapsed = (end->tv_sec - start->tv_sec) * (int64_t) 1000000 + (end->tv_usec - start->tv_usec);
+        if ( (int64_t) elapsed < 0 )
+                elapsed = 0;
+
+        get_query_shape(query, shape, sizeof(shape));
+
+        gl_lock_lock(sql->metrics_mutex);
+
+        st = metrics_get_statement(sql, shape);
+        if ( st ) {
+                st->calls++;
+                st->total_time += elapsed;
+                st->buckets[metrics_get_bucket(elapsed)]++;
+
+                if ( elapsed > st->max_time )
+                        st->max_time = elapsed;
+
+                if ( ret < 0 )
+                        st->errors++;
+                else
+                        st->rows += ret;
+
+                if ( ret > 0 && table )
+                        table->metrics = st;
+        }
+
+        gl_lock_unlock(sql->metrics_mutex);
+
+        if ( ! sql->logfile )
+                return;
+
+        fprintf(sql->logfile, "%fs %s\n",
+                (end->tv_sec + (double) end->tv_usec / 1000000) -
+                (start->tv_sec + (double) start->tv_usec / 1000000), query);
+
+        fflush(sql->logfile);
+}
+
+
+
+static inline void metrics_add_escaped_bytes(preludedb_sql_t *sql, size_t size)
+{
+        gl_lock_lock(sql->metrics_mutex);
+        sql->metrics.escaped_bytes += size;
+        gl_lock_unlock(sql->metrics_mutex);
+}
+
+
+
+/*
+ * Look @query up in @cache, preparing it on @session on a miss. Returns 0
+ * when no prepared statement can be used (cache disabled or full of busy
+ * statements, statement busy, or backend without prepared statements).
+ */
+static int statement_get(preludedb_sql_t *sql, void *session, sql_statement_cache_t *cache,
+                         const char *query, unsigned int nparams, sql_statement_t **out)
+{
+        int ret;
+        void *statement;
+        prelude_list_t *tmp;
+        sql_statement_t *st;
+        prelude_bool_t busy;
+
+        if ( sql->statement_cache_size == 0 )
+                return 0;
+
+        prelude_list_for_each(&cache->statements, tmp) {
+                st = prelude_list_entry(tmp, sql_statement_t, list);
+
+                if ( strcmp(st->query, query) != 0 )
+                        continue;
+
+                gl_lock_lock(cache->mutex);
+                busy = st->busy;
+                gl_lock_unlock(cache->mutex);
+
+                if ( busy )
+                        return 0;
+
+                prelude_list_del(&st->list);
+                prelude_list_add(&cache->statements, &st->list);
+
+                *out = st;
+                return 1;
+        }
+
+        if ( cache->count >= sql->statement_cache_size ) {
+                st = NULL;
+
+                gl_lock_lock(cache->mutex);
+
+                prelude_list_for_each_reversed(&cache->statements, tmp) {
+                        st = prelude_list_entry(tmp, sql_statement_t, list);
+                        if ( ! st->busy )
+                                break;
+
+                        st = NULL;
+                }
+
+                gl_lock_unlock(cache->mutex);
+
+                if ( ! st )
+                        return 0;
+
+                prelude_list_del(&st->list);
+                statement_destroy(sql, session, st);
+                cache->count--;
+        }
+
+        ret = _preludedb_plugin_sql_statement_prepare(sql->plugin, session, query, nparams, &statement);
+        if ( ret < 0 )
+                return (prelude_error_get_code(ret) == PRELUDE_ERROR_ENOSYS) ? 0 : ret;
+
+        st = calloc(1, sizeof(*st));
+        if ( ! st ) {
+                _preludedb_plugin_sql_statement_destroy(sql->plugin, session, statement);
+                return preludedb_error_from_errno(errno);
+        }
+
+        st->query = strdup(query);
+        if ( ! st->query ) {
+                _preludedb_plugin_sql_statement_destroy(sql->plugin, session, statement);
+                free(st);
+                return preludedb_error_from_errno(errno);
+        }
+
+        st->cache = cache;
+        st->mutex = &cache->mutex;
+        st->statement = statement;
+
+        prelude_list_add(&cache->statements, &st->list);
+        cache->count++;
+
+        *out = st;
+
+        return 1;
+}
+
+
+
+/*
+ * If a string literal, quoted identifier or comment starts at @query, return
+ * a pointer past its end, NULL otherwise. Within literals, a backslash escapes
+ * the next character when the backend says so, when its rules are unknown
+ * (@escape_flags < 0), and in PostgreSQL E'' strings. Should this guess be
+ * wrong, placeholders get hidden rather than exposed, and the placeholder
+ * count check fails.
+ */
+static const char *skip_literal(const char *base, const char *query, int escape_flags)
+{
+        char quote;
+        const char *end;
+        prelude_bool_t backslash;
+
+        if ( query[0] == '-' && query[1] == '-' )
+                return query + strcspn(query, "\n");
+
+        if ( query[0] == '/' && query[1] == '*' ) {
+                end = strstr(query + 2, "*/");
+                return (end) ? end + 2 : query + strlen(query);
+        }
+
+        if ( *query != '\'' && *query != '"' && *query != '`' )
+                return NULL;
+
+        quote = *query;
+        backslash = FALSE;
+
+        if ( quote != '`' && (escape_flags < 0 || escape_flags & PRELUDEDB_PLUGIN_SQL_ESCAPE_BACKSLASH) )
+                backslash = TRUE;
+
+        else if ( quote == '\'' && query > base && (query[-1] == 'E' || query[-1] == 'e') &&
+                  (query - 1 == base || (! isalnum((unsigned char) query[-2]) && query[-2] != '_')) )
+                backslash = TRUE;
+
+        for ( query++; *query; query++ ) {
+                if ( *query == '\\' && backslash && query[1] )
+                        query++;
+
+                else if ( *query == quote )
+                        return query + 1;
+        }
+
+        return query;
+}
+
+
+
+/*
+ * Substitute each '?' placeholder from @query with the matching escaped
+ * parameter, for backends or situations where no prepared statement is used.
+ * Literals and comments are skipped following the backend escaping rules.
+ */
+static int build_params_query(preludedb_sql_t *sql, void *session, const char *query,
+                              const preludedb_sql_param_t *params, unsigned int nparams, prelude_string_t *output)
+{
+        int ret;
+        char *escaped;
+        const char *base = query, *start = query, *end;
+        unsigned int i = 0;
+
+        while ( *query ) {
+                end = skip_literal(base, query, sql->escape_flags);
+                if ( end ) {
+                        query = end;
+                        continue;
+                }
+
+                if ( *query != '?' ) {
+                        query++;
+                        continue;
+                }
+
+                if ( i == nparams )
+                        return preludedb_error_verbose(PRELUDEDB_ERROR_QUERY, "query '%s' expects more than %u parameters", base, nparams);
+
+                ret = prelude_string_ncat(output, start, query - start);
+                if ( ret < 0 )
+                        return ret;
+
+                if ( ! params[i].value )
+                        ret = prelude_string_cat(output, "NULL");
+                else {
+                        if ( params[i].type == PRELUDEDB_SQL_PARAM_TYPE_BINARY )
+                                ret = _preludedb_plugin_sql_escape_binary(sql->plugin, session, (const unsigned char *) params[i].value,
+                                                                          params[i].len, &escaped);
+                        else
+                                ret = _preludedb_plugin_sql_escape(sql->plugin, session, params[i].value, params[i].len, &escaped);
+                        if ( ret < 0 )
+                                return ret;
+
+                        ret = prelude_string_cat(output, escaped);
+                        free(escaped);
+                }
+
+                if ( ret < 0 )
+                        return ret;
+
+                start = ++query;
+                i++;
+        }
+
+        if ( i != nparams )
+                return preludedb_error_verbose(PRELUDEDB_ERROR_QUERY, "query expects %u parameters, %u given", i, nparams);
+
+        return prelude_string_cat(output, start);
+}
+
+
+
+static int session_query(preludedb_sql_t *sql, void *session, sql_statement_cache_t *cache,
+                         const char *query, const preludedb_sql_param_t *params, unsigned int nparams,
+                         preludedb_sql_table_t **table)
+{
+        int ret;
+        prelude_string_t *str;
+        sql_statement_t *st = NULL;
+
+        if ( ! params )
+                return _preludedb_plugin_sql_query(sql->plugin, session, query, table);
+
+        ret = statement_get(sql, session, cache, query, nparams, &st);
+        if ( ret < 0 )
+                return ret;
+
+        if ( ret == 0 ) {
+                ret = prelude_string_new(&str);
+                if ( ret < 0 )
+                        return ret;
+
+                ret = build_params_query(sql, session, query, params, nparams, str);
+                if ( ret >= 0 )
+                        ret = _preludedb_plugin_sql_query(sql->plugin, session, prelude_string_get_string(str), table);
+
+                prelude_string_destroy(str);
+                return ret;
+        }
+
+        ret = _preludedb_plugin_sql_statement_execute(sql->plugin, session, st->statement, params, nparams,
+                                                      sql->binary_results, table);
+        if ( ret < 0 ) {
+                /*
+                 * The statement might have been invalidated server side
+                 * (e.g. schema change), have it prepared again next time.
+                 */
+                if ( ! preludedb_error_check(ret, PRELUDEDB_ERROR_CONNECTION) ) {
+                        prelude_list_del(&st->list);
+                        statement_destroy(sql, session, st);
+                        cache->count--;
+                }
+
+                return ret;
+        }
+
+        if ( ret > 0 && table && *table ) {
+                gl_lock_lock(cache->mutex);
+                st->busy = TRUE;
+                gl_lock_unlock(cache->mutex);
+
+                (*table)->statement = st;
+        }
+
+        return ret;
+}
+
+
+
+static int _preludedb_sql_query(preludedb_sql_t *sql, const char *query,
+                                const preludedb_sql_param_t *params, unsigned int nparams, preludedb_sql_table_t **table)
+{
+        int ret;
+        unsigned int generation;
+        struct timeval start, end;
+
+        gl_recursive_lock_lock(sql->mutex);
+        assert_connected(sql);
+
+        gettimeofday(&start, NULL);
+
+        ret = session_query(sql, sql->session, &sql->statements, query, params, nparams, table);
+        if ( ret < 0 ) {
+                update_sql_from_errno(sql, ret);
+
+                if ( ! (sql->status & PRELUDEDB_SQL_STATUS_CONNECTED) ) {
+                        assert_connected(sql);
+
+                        ret = session_query(sql, sql->session, &sql->statements, query, params, nparams, table);
+                        if ( ret < 0 )
+                                update_sql_from_errno(sql, ret);
+                }
+        }
+
+        gettimeofday(&end, NULL);
+        generation = sql->generation;
+        gl_recursive_lock_unlock(sql->mutex);
+
+        log_query(sql, &start, &end, query, ret, (ret > 0 && table) ? *table : NULL);
+
+        if ( ret <= 0 )
+                return ret;
+
+        if ( table && *table ) {
+                (*table)->sql = preludedb_sql_ref(sql);
+                (*table)->session_slot = SQL_SESSION_MAIN;
+                (*table)->generation = generation;
+        }
+
+        return ret;
+}
+
+
+
+static int pool_session_connect(preludedb_sql_t *sql, sql_pool_session_t *ps)
+{
+        int ret;
+
+        if ( ps->status & PRELUDEDB_SQL_STATUS_CONNECTED )
+                return 0;
+
+        ret = _preludedb_plugin_sql_open(sql->plugin, sql->settings, &ps->session);
+        if ( ret < 0 )
+                return ret;
+
+        ps->status = PRELUDEDB_SQL_STATUS_CONNECTED;
+
+        return 0;
+}
+
+
+
+static int pool_session_query(preludedb_sql_t *sql, sql_pool_session_t *ps, const char *query,
+                              const preludedb_sql_param_t *params, unsigned int nparams, preludedb_sql_table_t **table)
+{
+        int ret, retry = 1;
+
+        do {
+                ret = pool_session_connect(sql, ps);
+                if ( ret < 0 )
+                        return ret;
+
+                ret = session_query(sql, ps->session, &ps->statements, query, params, nparams, table);
+                if ( ret >= 0 || ! preludedb_error_check(ret, PRELUDEDB_ERROR_CONNECTION) )
+                        return ret;
+
+                pool_session_close(sql, ps);
+
+        } while ( retry-- );
+
+        return ret;
+}
+
+
+
+/*
+ * Run @query on the reader session checked out in @slot, which the
+ * returned table keeps until it is destroyed.
+ */
+static int pool_query(preludedb_sql_t *sql, int slot, const char *query,
+                      const preludedb_sql_param_t *params, unsigned int nparams, preludedb_sql_table_t **table)
+{
+        int ret;
+        struct timeval start, end;
+        sql_pool_session_t *ps = &sql->pool[slot];
+
+        gettimeofday(&start, NULL);
+        ret = pool_session_query(sql, ps, query, params, nparams, table);
+        gettimeofday(&end, NULL);
+
+        log_query(sql, &start, &end, query, ret, (ret > 0 && table) ? *table : NULL);
+
+        if ( ret <= 0 || ! table || ! *table ) {
+                pool_checkin(sql, slot);
+                return ret;
+        }
+
+        (*table)->sql = preludedb_sql_ref(sql);
+        (*table)->session_slot = slot;
+        (*table)->generation = ps->generation;
+
+        return ret;
+}
+
+
+
+static int insert_buffer_flush_values(preludedb_sql_t *sql, sql_insert_buffer_t *buf)
+{
+        int ret;
+        prelude_string_t *query;
+
+        ret = prelude_string_new(&query);
+        if ( ret < 0 )
+                return ret;
+
+        ret = prelude_string_sprintf(query, "INSERT INTO %s (%s) VALUES%s", buf->table, buf->fields,
+                                     prelude_string_get_string(buf->values));
+        if ( ret >= 0 )
+                ret = _preludedb_sql_query(sql, prelude_string_get_string(query), NULL, 0, NULL);
+
+        prelude_string_destroy(query);
+
+        prelude_string_clear(buf->values);
+        buf->count = 0;
+
+        return ret;
+}
+
+
+
+static int build_insert_params_query(sql_insert_buffer_t *buf, unsigned int rows, prelude_string_t *query)
+{
+        int ret;
+        unsigned int i, j;
+
+        ret = prelude_string_sprintf(query, "INSERT INTO %s (%s) VALUES", buf->table, buf->fields);
+
+        for ( i = 0; i < rows && ret >= 0; i++ ) {
+                ret = prelude_string_cat(query, (i == 0) ? "(?" : ",(?");
+
+                for ( j = 1; j < buf->ncolumns && ret >= 0; j++ )
+                        ret = prelude_string_ncat(query, ",?", 2);
+
+                if ( ret >= 0 )
+                        ret = prelude_string_ncat(query, ")", 1);
+        }
+
+        return ret;
+}
+
+
+
+/*
+ * Send all the rows of @buf at once through the backend bulk load
+ * facility.
+ */
+static int insert_buffer_copy(preludedb_sql_t *sql, sql_insert_buffer_t *buf, const preludedb_sql_param_t *params)
+{
+        int ret;
+        char query[128];
+        struct timeval start, end;
+
+        gl_recursive_lock_lock(sql->mutex);
+        assert_connected(sql);
+
+        gettimeofday(&start, NULL);
+
+        ret = _preludedb_plugin_sql_copy(sql->plugin, sql->session, buf->table, buf->fields,
+                                         params, buf->ncolumns, buf->param_rows);
+        if ( ret < 0 )
+                update_sql_from_errno(sql, ret);
+
+        gettimeofday(&end, NULL);
+        gl_recursive_lock_unlock(sql->mutex);
+
+        snprintf(query, sizeof(query), "COPY %s", buf->table);
+        log_query(sql, &start, &end, query, ret, NULL);
+
+        return ret;
+}
+
+
+
+static int insert_buffer_flush_params(preludedb_sql_t *sql, sql_insert_buffer_t *buf)
+{
+        int ret;
+        unsigned int i, rows, max_rows, row = 0;
+        prelude_string_t *query;
+        preludedb_sql_param_t *params;
+
+        params = malloc(buf->nparams * sizeof(*params));
+        if ( ! params ) {
+                ret = preludedb_error_from_errno(errno);
+                goto error;
+        }
+
+        for ( i = 0; i < buf->nparams; i++ ) {
+                params[i].value = (buf->params[i].offset == SQL_INSERT_PARAM_NULL) ? NULL : buf->data + buf->params[i].offset;
+                params[i].len = buf->params[i].len;
+                params[i].type = buf->params[i].type;
+        }
+
+        if ( sql->bulk_load && _preludedb_plugin_sql_has_copy(sql->plugin) ) {
+                ret = insert_buffer_copy(sql, buf, params);
+                free(params);
+                goto error;
+        }
+
+        ret = prelude_string_new(&query);
+        if ( ret < 0 ) {
+                free(params);
+                goto error;
+        }
+
+        max_rows = SQL_INSERT_PARAMS_MAX / buf->ncolumns;
+        if ( max_rows == 0 )
+                max_rows = 1;
+
+        /*
+         * Rows are sent in batches of a power of two size, so that only a
+         * handful of distinct statements end up in the statement cache.
+         */
+        while ( row < buf->param_rows && ret >= 0 ) {
+                for ( rows = 1; rows * 2 <= buf->param_rows - row && rows * 2 <= max_rows; rows *= 2 );
+
+                prelude_string_clear(query);
+
+                ret = build_insert_params_query(buf, rows, query);
+                if ( ret >= 0 )
+                        ret = _preludedb_sql_query(sql, prelude_string_get_string(query),
+                                                   params + row * buf->ncolumns, rows * buf->ncolumns, NULL);
+
+                row += rows;
+        }
+
+        prelude_string_destroy(query);
+        free(params);
+
+ error:
+        buf->param_rows = buf->nparams = 0;
+        buf->data_len = 0;
+
+        return ret;
+}
+
+
+
+static int insert_buffer_flush(preludedb_sql_t *sql, sql_insert_buffer_t *buf)
+{
+        int ret = 0;
+
+        if ( buf->count > 0 )
+                ret = insert_buffer_flush_values(sql, buf);
+
+        if ( buf->param_rows > 0 ) {
+                if ( ret >= 0 )
+                        ret = insert_buffer_flush_params(sql, buf);
+                else
+                        buf->param_rows = buf->nparams = buf->data_len = 0;
+        }
+
+        return ret;
+}
+
+
+
+static int insert_buffer_flush_all(preludedb_sql_t *sql)
+{
+        int ret = 0;
+        prelude_list_t *tmp, *bkp;
+        sql_insert_buffer_t *buf;
+
+        prelude_list_for_each_safe(&sql->insert_buffers, tmp, bkp) {
+                buf = prelude_list_entry(tmp, sql_insert_buffer_t, list);
+
+                if ( ret >= 0 )
+                        ret = insert_buffer_flush(sql, buf);
+
+                insert_buffer_destroy(buf);
+        }
+
+        return ret;
+}
+
+
+
+static int sql_query(preludedb_sql_t *sql, const char *query,
+                     const preludedb_sql_param_t *params, unsigned int nparams, preludedb_sql_table_t **table)
+{
+        int ret, slot;
+
+        /*
+         * Queries returning results are dispatched to an idle reader session
+         * from the pool, unless they belong to a transaction run by this
+         * thread. Rows still buffered outside of a transaction are sent
+         * beforehand. When all the reader sessions are held by results
+         * still in use, the main session is used rather than waiting, as
+         * the caller might be the one holding them.
+         */
+        if ( table && sql->pool && ! is_transaction_owner(sql) && (slot = pool_checkout(sql)) >= 0 ) {
+                if ( ! in_transaction(sql) ) {
+                        gl_recursive_lock_lock(sql->mutex);
+                        ret = insert_buffer_flush_all(sql);
+                        gl_recursive_lock_unlock(sql->mutex);
+
+                        if ( ret < 0 ) {
+                                pool_checkin(sql, slot);
+                                return ret;
+                        }
+                }
+
+                return pool_query(sql, slot, query, params, nparams, table);
+        }
+
+        gl_recursive_lock_lock(sql->mutex);
+
+        /*
+         * Rows queued with preludedb_sql_insert_buffered() have to reach the
+         * server before anything that might read them back.
+         */
+        ret = insert_buffer_flush_all(sql);
+        if ( ret >= 0 )
+                ret = _preludedb_sql_query(sql, query, params, nparams, table);
+
+        gl_recursive_lock_unlock(sql->mutex);
+
+        return ret;
+}
+
+
+
+/**
+ * preludedb_sql_query:
+ * @sql: Pointer to a sql object.
+ * @query: The SQL query to execute.
+ * @table: Pointer to a table where the query result will be stored if the type of query returns
+ * results (i.e a SELECT can results, but an INSERT never results) and if the query is successful.
+ *
+ * Execute a SQL query.
+ *
+ * Returns: number of affected rows, -1 if an error occurred.
  */
-int preludedb_sql_query_get_option(preludedb_sql_query_t *query, int cmd, void *ret)
+int preludedb_sql_query(preludedb_sql_t *sql, const char *query, preludedb_sql_table_t **table)
 {
-        switch (cmd) {
-                case PRELUDEDB_SQL_QUERY_OPTION_LIMIT:
-                    if ( ret )
-                            (*(int64_t *) ret) = query->limit;
+        return sql_query(sql, query, NULL, 0, table);
+}
 
-                    return (query->limit != -1) ? 1 : 0;
 
-                case PRELUDEDB_SQL_QUERY_OPTION_OFFSET:
-                    if ( ret )
-                            (*(int64_t *) ret) = query->offset;
-                    return (query->offset != -1) ? 1 : 0;
 
-                case PRELUDEDB_SQL_QUERY_OPTION_FOR_UPDATE:
-                    if ( ret )
-                            (*(int *) ret) = query->for_update;
+/**
+ * preludedb_sql_query_params:
+ * @sql: Pointer to a sql object.
+ * @query: The SQL query to execute, referencing its parameters through '?' placeholders.
+ * @params: Array of parameters bound to the placeholders of @query, in order.
+ * @nparams: Number of elements in @params.
+ * @table: Pointer to a table where the query result will be stored if the type of query returns
+ * results (i.e a SELECT can results, but an INSERT never results) and if the query is successful.
+ *
+ * Execute a parameterized SQL query. The query is prepared once per session
+ * and kept in a cache of the most recently used statements (see the
+ * "statement_cache" setting), parameters being sent apart from the query,
+ * without any escaping. Backends without prepared statement support get the
+ * escaped parameters substituted within the query.
+ *
+ * With the "binary_results" setting, backends able to do so return the
+ * results of these queries in binary form, see preludedb_sql_field_get_type().
+ *
+ * Returns: number of affected rows, or a negative value if an error occurred.
+ */
+int preludedb_sql_query_params(preludedb_sql_t *sql, const char *query,
+                               const preludedb_sql_param_t *params, unsigned int nparams,
+                               preludedb_sql_table_t **table)
+{
+        static const preludedb_sql_param_t none;
 
-                    return (query->for_update) ? 1 : 0;
+        prelude_return_val_if_fail(sql && query && (params || nparams == 0), prelude_error(PRELUDE_ERROR_ASSERTION));
 
-                default:
-                    return prelude_error_verbose(PRELUDE_ERROR_GENERIC, "could not get query option: unknown value '%d'", cmd);
+        return sql_query(sql, query, params ? params : &none, nparams, table);
+}
+
+
+
+/*
+ * Streamed queries are not prepared, backends only streaming plain
+ * queries: parameters are substituted within the query. The query runs on
+ * the reader session checked out in @slot, which the returned table keeps
+ * until it is destroyed.
+ */
+static int stream_query(preludedb_sql_t *sql, int slot, const char *query,
+                        const preludedb_sql_param_t *params, unsigned int nparams, preludedb_sql_table_t **table)
+{
+        int ret, retry = 1;
+        const char *sent = query;
+        prelude_string_t *str = NULL;
+        struct timeval start, end;
+        sql_pool_session_t *ps = &sql->pool[slot];
+
+        if ( params ) {
+                ret = prelude_string_new(&str);
+                if ( ret < 0 )
+                        goto out;
+        }
+
+        gettimeofday(&start, NULL);
+
+        do {
+                ret = pool_session_connect(sql, ps);
+                if ( ret < 0 )
+                        break;
+
+                /*
+                 * Escaping depends on the session.
+                 */
+                if ( params ) {
+                        prelude_string_clear(str);
+
+                        ret = build_params_query(sql, ps->session, query, params, nparams, str);
+                        if ( ret < 0 )
+                                break;
+
+                        sent = prelude_string_get_string(str);
+                }
+
+                ret = _preludedb_plugin_sql_query_stream(sql->plugin, ps->session, sent, table);
+                if ( ret >= 0 || ! preludedb_error_check(ret, PRELUDEDB_ERROR_CONNECTION) )
+                        break;
+
+                pool_session_close(sql, ps);
+
+        } while ( retry-- );
+
+        gettimeofday(&end, NULL);
+
+        log_query(sql, &start, &end, sent, ret, (ret > 0 && table) ? *table : NULL);
+
+ out:
+        if ( str )
+                prelude_string_destroy(str);
+
+        if ( ret <= 0 ) {
+                pool_checkin(sql, slot);
+                return ret;
+        }
+
+        (*table)->sql = preludedb_sql_ref(sql);
+        (*table)->session_slot = slot;
+        (*table)->generation = ps->generation;
+        (*table)->stream = TRUE;
+
+        return ret;
+}
+
+
+
+static int sql_query_stream(preludedb_sql_t *sql, const char *query,
+                            const preludedb_sql_param_t *params, unsigned int nparams, preludedb_sql_table_t **table)
+{
+        int ret, slot;
+
+        if ( _preludedb_plugin_sql_has_query_stream(sql->plugin) && sql->pool && ! is_transaction_owner(sql) &&
+             (slot = pool_checkout(sql)) >= 0 ) {
+                /*
+                 * Rows queued for insertion outside of a transaction have
+                 * to be visible from the streaming session. Those of another
+                 * thread's transaction are not, and it is not waited for.
+                 */
+                if ( ! in_transaction(sql) ) {
+                        gl_recursive_lock_lock(sql->mutex);
+                        ret = insert_buffer_flush_all(sql);
+                        gl_recursive_lock_unlock(sql->mutex);
+
+                        if ( ret < 0 ) {
+                                pool_checkin(sql, slot);
+                                return ret;
+                        }
+                }
+
+                return stream_query(sql, slot, query, params, nparams, table);
+        }
+
+        ret = sql_query(sql, query, params, nparams, table);
+        if ( ret > 0 && *table )
+                (*table)->stream = TRUE;
+
+        return ret;
+}
+
+
+
+/**
+ * preludedb_sql_query_stream:
+ * @sql: Pointer to a sql object.
+ * @query: The SQL query to execute.
+ * @table: Pointer to a table where the query result will be stored if the query returns results.
+ *
+ * Execute a SQL query whose rows are transferred from the server as they are
+ * retrieved through preludedb_sql_table_fetch_row(), so that the memory used
+ * does not depend on the size of the result.
+ *
+ * Only the last fetched row is kept by @table: rows have to be retrieved in
+ * order, and a row remains available after the next one is fetched only as
+ * long as it, or one of its fields, is referenced. The number of rows is only
+ * known once all of them have been fetched.
+ *
+ * Where supported by the backend, the query runs on a reader session checked
+ * out from the pool (see preludedb_sql_settings_set_pool_size()), held until
+ * @table is destroyed. Without a free pool session, within a transaction
+ * owned by the calling thread, or with backends without streaming support,
+ * the query is run as usual and only the row retention rules above apply.
+ *
+ * Returns: 1 if the query returns results, which might be empty, 0 if it
+ * does not, or a negative value if an error occurred.
+ */
+int preludedb_sql_query_stream(preludedb_sql_t *sql, const char *query, preludedb_sql_table_t **table)
+{
+        prelude_return_val_if_fail(sql && query && table, prelude_error(PRELUDE_ERROR_ASSERTION));
+
+        return sql_query_stream(sql, query, NULL, 0, table);
+}
+
+
+
+/**
+ * preludedb_sql_query_stream_params:
+ * @sql: Pointer to a sql object.
+ * @query: The SQL query to execute, referencing its parameters through '?' placeholders.
+ * @params: Array of parameters bound to the placeholders of @query, in order.
+ * @nparams: Number of elements in @params.
+ * @table: Pointer to a table where the query result will be stored if the query returns results.
+ *
+ * Same as preludedb_sql_query_stream(), for a parameterized query as
+ * described in preludedb_sql_query_params().
+ *
+ * Returns: 1 if the query returns results, which might be empty, 0 if it
+ * does not, or a negative value if an error occurred.
+ */
+int preludedb_sql_query_stream_params(preludedb_sql_t *sql, const char *query,
+                                      const preludedb_sql_param_t *params, unsigned int nparams,
+                                      preludedb_sql_table_t **table)
+{
+        static const preludedb_sql_param_t none;
+
+        prelude_return_val_if_fail(sql && query && table && (params || nparams == 0), prelude_error(PRELUDE_ERROR_ASSERTION));
+
+        return sql_query_stream(sql, query, params ? params : &none, nparams, table);
+}
+
+
+
+/**
+ * preludedb_sql_plan_cache_get:
+ * @sql: Pointer to a sql object.
+ * @key: Key describing the request answered by the plan.
+ * @query: Pointer where to store a copy of the cached query template.
+ *
+ * Look up the query template previously stored for @key through
+ * preludedb_sql_plan_cache_set(). The caller is responsible for freeing
+ * @query.
+ *
+ * Returns: 1 if a plan was found, 0 if not, or a negative value if an error occurred.
+ */
+int preludedb_sql_plan_cache_get(preludedb_sql_t *sql, const char *key, char **query)
+{
+        int ret = 0;
+        sql_plan_t *plan;
+        prelude_list_t *tmp;
+
+        prelude_return_val_if_fail(sql && key && query, prelude_error(PRELUDE_ERROR_ASSERTION));
+
+        gl_lock_lock(sql->plan_mutex);
+
+        prelude_list_for_each(&sql->plans, tmp) {
+                plan = prelude_list_entry(tmp, sql_plan_t, list);
+
+                if ( strcmp(plan->key, key) != 0 )
+                        continue;
+
+                prelude_list_del(&plan->list);
+                prelude_list_add(&sql->plans, &plan->list);
+
+                *query = strdup(plan->query);
+                ret = (*query) ? 1 : preludedb_error_from_errno(errno);
+                break;
+        }
+
+        gl_lock_unlock(sql->plan_mutex);
+
+        return ret;
+}
+
+
+
+/**
+ * preludedb_sql_plan_cache_set:
+ * @sql: Pointer to a sql object.
+ * @key: Key describing the request answered by the plan.
+ * @query: Query template answering the request.
+ *
+ * Store @query as the plan for @key, evicting the least recently used plan
+ * once the cache holds as many plans as allowed by the "plan_cache" setting.
+ * A plan cache size of 0 disables the cache.
+ *
+ * Returns: 0 on success, or a negative value if an error occurred.
+ */
+int preludedb_sql_plan_cache_set(preludedb_sql_t *sql, const char *key, const char *query)
+{
+        sql_plan_t *plan;
+        prelude_list_t *tmp;
+
+        prelude_return_val_if_fail(sql && key && query, prelude_error(PRELUDE_ERROR_ASSERTION));
+
+        if ( sql->plan_cache_size == 0 )
+                return 0;
+
+        plan = malloc(sizeof(*plan));
+        if ( ! plan )
+                return preludedb_error_from_errno(errno);
+
+        plan->key = strdup(key);
+        plan->query = strdup(query);
+        if ( ! plan->key || ! plan->query ) {
+                free(plan->key);
+                free(plan->query);
+                free(plan);
+                return preludedb_error_from_errno(errno);
+        }
+
+        gl_lock_lock(sql->plan_mutex);
+
+        /*
+         * Another thread might have stored the same plan meanwhile.
+         */
+        prelude_list_for_each(&sql->plans, tmp) {
+                if ( strcmp(prelude_list_entry(tmp, sql_plan_t, list)->key, key) == 0 ) {
+                        gl_lock_unlock(sql->plan_mutex);
+
+                        free(plan->key);
+                        free(plan->query);
+                        free(plan);
+
+                        return 0;
+                }
         }
 
+        if ( sql->plan_count >= sql->plan_cache_size ) {
+                sql_plan_t *last = prelude_list_entry(sql->plans.prev, sql_plan_t, list);
+
+                prelude_list_del(&last->list);
+                free(last->key);
+                free(last->query);
+                free(last);
+                sql->plan_count--;
+        }
+
+        prelude_list_add(&sql->plans, &plan->list);
+        sql->plan_count++;
+
+        gl_lock_unlock(sql->plan_mutex);
+
         return 0;
 }
 
 
 
+/*
+ * Called with the async lock held: have the connection fail the queries
+ * in progress, and get closed. Queries not sent yet will be sent on a new
+ * connection.
+ */
+static void async_abort(preludedb_sql_t *sql, int error)
+{
+        prelude_list_t *tmp;
+        sql_async_query_t *q;
+
+        prelude_list_for_each(&sql->async_queries, tmp) {
+                q = prelude_list_entry(tmp, sql_async_query_t, list);
+
+                if ( q->state == SQL_ASYNC_SENT ) {
+                        q->state = SQL_ASYNC_DONE;
+                        q->status = error;
+                }
+        }
+
+        _preludedb_plugin_sql_async_close(sql->plugin, sql->async);
+        sql->async = NULL;
+        sql->async_sent = 0;
+}
+
+
+
+static int async_open(preludedb_sql_t *sql)
+{
+        int ret;
+
+        if ( sql->async )
+                return 0;
+
+        ret = _preludedb_plugin_sql_async_open(sql->plugin, sql->settings, &sql->async);
+        if ( ret < 0 )
+                sql->async = NULL;
+
+        return ret;
+}
+
+
+
+/*
+ * Called with the async lock held. Unless the backend pipelines queries,
+ * a query is only sent once the previous one completed.
+ */
+static void async_send(preludedb_sql_t *sql)
+{
+        int ret;
+        prelude_list_t *tmp;
+        sql_async_query_t *q;
+
+        prelude_list_for_each(&sql->async_queries, tmp) {
+                q = prelude_list_entry(tmp, sql_async_query_t, list);
+
+                if ( q->state != SQL_ASYNC_QUEUED )
+                        continue;
+
+                if ( sql->async_sent && ! sql->async_pipeline )
+                        break;
+
+                gettimeofday(&q->start, NULL);
+
+                ret = async_open(sql);
+                if ( ret >= 0 )
+                        ret = _preludedb_plugin_sql_async_send(sql->plugin, sql->async, q->query);
+
+                if ( ret < 0 ) {
+                        q->state = SQL_ASYNC_DONE;
+                        q->status = ret;
+                        continue;
+                }
+
+                q->state = SQL_ASYNC_SENT;
+                sql->async_pipeline = (ret > 0);
+                sql->async_sent++;
+        }
+}
+
+
+
+/*
+ * Called with the async lock held, retrieve the results available without
+ * blocking.
+ */
+static void async_poll(preludedb_sql_t *sql)
+{
+        int ret, status;
+        prelude_list_t *tmp;
+        sql_async_query_t *q;
+        preludedb_sql_table_t *table;
+
+        prelude_list_for_each(&sql->async_queries, tmp) {
+                q = prelude_list_entry(tmp, sql_async_query_t, list);
+
+                if ( q->state != SQL_ASYNC_SENT )
+                        continue;
+
+                table = NULL;
+
+                ret = _preludedb_plugin_sql_async_poll(sql->plugin, sql->async, &status, &table);
+                if ( ret < 0 ) {
+                        async_abort(sql, ret);
+                        return;
+                }
+
+                if ( ret == 0 )
+                        return;
+
+                /*
+                 * The reference on @sql is only taken once the table is
+                 * handed to the callback, see async_clear().
+                 */
+                if ( status > 0 && table ) {
+                        table->sql = sql;
+                        table->session_slot = SQL_SESSION_NONE;
+                        q->table = table;
+                }
+
+                q->state = SQL_ASYNC_DONE;
+                q->status = status;
+                sql->async_sent--;
+        }
+}
+
+
+
+/*
+ * Backends without asynchronous support run queued queries right away.
+ */
+static void async_run(preludedb_sql_t *sql)
+{
+        prelude_list_t *tmp;
+        sql_async_query_t *q;
+        preludedb_sql_table_t *table;
+
+        prelude_list_for_each(&sql->async_queries, tmp) {
+                q = prelude_list_entry(tmp, sql_async_query_t, list);
+
+                if ( q->state != SQL_ASYNC_QUEUED )
+                        continue;
+
+                table = NULL;
+                gettimeofday(&q->start, NULL);
+
+                q->status = sql_query(sql, q->query, NULL, 0, &table);
+                if ( q->status > 0 && table ) {
+                        /*
+                         * Same as tables from asynchronous connections.
+                         */
+                        preludedb_sql_destroy(table->sql);
+                        q->table = table;
+                }
+
+                q->state = SQL_ASYNC_DONE;
+        }
+}
+
+
+
 /**
- * preludedb_sql_query_new:
- * @new: Pointer to a query object to initialize.
- * @querystr: The SQL query.
+ * preludedb_sql_query_async:
+ * @sql: Pointer to a sql object.
+ * @query: The SQL query to execute.
+ * @cb: Function called once @query completed.
+ * @data: Data passed to @cb.
  *
- * This function initialize the @new object.
+ * Submit @query for execution without waiting for its completion. The
+ * query runs on a connection dedicated to asynchronous queries, several
+ * of them being pipelined when supported by the backend.
  *
- * Returns: 0 on success or a negative value if an error occurs.
+ * @cb is called from preludedb_sql_async_process() or preludedb_sql_async_wait(),
+ * in submission order, with the value preludedb_sql_query() would have
+ * returned and, if the query returned results, a table the callback is
+ * responsible for destroying.
+ *
+ * Backends without asynchronous support run the query as usual once
+ * preludedb_sql_async_process() is called.
+ *
+ * Returns: 0 on success, or a negative value if an error occurred.
  */
-int preludedb_sql_query_new(preludedb_sql_query_t **new, const char *querystr)
+int preludedb_sql_query_async(preludedb_sql_t *sql, const char *query, preludedb_sql_async_cb_func_t cb, void *data)
 {
-        *new = calloc(sizeof(**new), 1);
-        if ( ! *new )
+        int ret;
+        sql_async_query_t *q;
+
+        prelude_return_val_if_fail(sql && query && cb, prelude_error(PRELUDE_ERROR_ASSERTION));
+
+        q = calloc(1, sizeof(*q));
+        if ( ! q )
                 return preludedb_error_from_errno(errno);
 
-        (*new)->string = strdup(querystr);
-        if ( ! (*new)->string ) {
-                free(*new);
+        q->query = strdup(query);
+        if ( ! q->query ) {
+                free(q);
                 return preludedb_error_from_errno(errno);
         }
 
-        (*new)->limit = (*new)->offset = -1;
-        (*new)->refcount = 1;
+        q->cb = cb;
+        q->data = data;
+        q->state = SQL_ASYNC_QUEUED;
+
+        /*
+         * Rows queued for insertion have to be visible from the
+         * asynchronous connection.
+         */
+        if ( _preludedb_plugin_sql_has_async(sql->plugin) && ! is_transaction_owner(sql) ) {
+                gl_recursive_lock_lock(sql->mutex);
+                ret = insert_buffer_flush_all(sql);
+                gl_recursive_lock_unlock(sql->mutex);
+
+                if ( ret < 0 ) {
+                        free(q->query);
+                        free(q);
+                        return ret;
+                }
+        }
+
+        gl_lock_lock(sql->async_mutex);
+
+        prelude_list_add_tail(&sql->async_queries, &q->list);
+
+        if ( _preludedb_plugin_sql_has_async(sql->plugin) )
+                async_send(sql);
+
+        gl_lock_unlock(sql->async_mutex);
 
         return 0;
 }
 
 
 
-preludedb_sql_query_t *preludedb_sql_query_ref(preludedb_sql_query_t *query)
+/**
+ * preludedb_sql_async_get_fd:
+ * @sql: Pointer to a sql object.
+ * @events: Pointer where to store the poll(2) events to wait for.
+ *
+ * Retrieve the file descriptor of the connection used by asynchronous
+ * queries, so that it can be watched from an event loop, calling
+ * preludedb_sql_async_process() once it is ready.
+ *
+ * Returns: the file descriptor, or a negative value if an error occurred,
+ * or if the backend has no asynchronous support.
+ */
+int preludedb_sql_async_get_fd(preludedb_sql_t *sql, int *events)
 {
-        query->refcount++;
-        return query;
+        int ret;
+
+        prelude_return_val_if_fail(sql && events, prelude_error(PRELUDE_ERROR_ASSERTION));
+
+        gl_lock_lock(sql->async_mutex);
+
+        ret = async_open(sql);
+        if ( ret >= 0 )
+                ret = _preludedb_plugin_sql_async_get_fd(sql->plugin, sql->async, events);
+
+        gl_lock_unlock(sql->async_mutex);
+
+        return ret;
 }
 
 
 
 /**
- * preludedb_sql_query_get_string:
+ * preludedb_sql_async_process:
  * @sql: Pointer to a sql object.
- * @query: Pointer to a query object.
  *
- * Get the original query string for the query @query.
+ * Retrieve the results of asynchronous queries available without blocking,
+ * send the queries waiting for the completion of previous ones, and call
+ * the callback of completed queries.
  *
- * Returns: a pointer to the query string.
+ * Returns: the number of queries still in progress.
  */
-const char *preludedb_sql_query_get_string(preludedb_sql_query_t *query)
+int preludedb_sql_async_process(preludedb_sql_t *sql)
 {
-        return query->string;
+        int ret = 0;
+        prelude_list_t *tmp;
+        sql_async_query_t *q;
+        struct timeval end;
+
+        prelude_return_val_if_fail(sql, prelude_error(PRELUDE_ERROR_ASSERTION));
+
+        gl_lock_lock(sql->async_mutex);
+
+        if ( ! _preludedb_plugin_sql_has_async(sql->plugin) )
+                async_run(sql);
+        else {
+                async_poll(sql);
+                async_send(sql);
+        }
+
+        /*
+         * Callbacks are called without the lock held, so that they can
+         * submit new queries.
+         */
+        while ( ! prelude_list_is_empty(&sql->async_queries) ) {
+                q = prelude_list_entry(sql->async_queries.next, sql_async_query_t, list);
+                if ( q->state != SQL_ASYNC_DONE )
+                        break;
+
+                prelude_list_del(&q->list);
+                gl_lock_unlock(sql->async_mutex);
+
+                /*
+                 * Queries run synchronously were already accounted.
+                 */
+                if ( _preludedb_plugin_sql_has_async(sql->plugin) ) {
+                        gettimeofday(&end, NULL);
+                        log_query(sql, &q->start, &end, q->query, q->status, q->table);
+                }
+
+                if ( q->table )
+                        preludedb_sql_ref(sql);
+
+                q->cb(sql, q->status, q->table, q->data);
+
+                free(q->query);
+                free(q);
+
+                gl_lock_lock(sql->async_mutex);
+        }
+
+        prelude_list_for_each(&sql->async_queries, tmp)
+                ret++;
+
+        gl_lock_unlock(sql->async_mutex);
+
+        return ret;
 }
 
 
 
 /**
- * preludedb_sql_query_prepare:
+ * preludedb_sql_async_wait:
  * @sql: Pointer to a sql object.
- * @query: Pointer to a query object.
- * @output: Where the final query string will be stored.
  *
- * Get the final query string for the query @query.
+ * Block until all asynchronous queries submitted so far completed, and
+ * their callback was called.
  *
- * Returns: 0 on success or a negative value if an error occurs.
+ * Returns: 0 on success, or a negative value if an error occurred.
  */
-int preludedb_sql_query_prepare(preludedb_sql_t *sql, preludedb_sql_query_t *query, prelude_string_t *output)
+int preludedb_sql_async_wait(preludedb_sql_t *sql)
 {
-        return _preludedb_plugin_sql_query_prepare(sql, query, output);
+        int ret, events;
+        struct pollfd pfd;
+
+        prelude_return_val_if_fail(sql, prelude_error(PRELUDE_ERROR_ASSERTION));
+
+        while ( (ret = preludedb_sql_async_process(sql)) > 0 ) {
+                /*
+                 * Without asynchronous support, queries submitted from
+                 * the callbacks are run on the next iteration.
+                 */
+                if ( ! _preludedb_plugin_sql_has_async(sql->plugin) )
+                        continue;
+
+                ret = preludedb_sql_async_get_fd(sql, &events);
+                if ( ret < 0 )
+                        return ret;
+
+                pfd.fd = ret;
+                pfd.events = events;
+
+                ret = poll(&pfd, 1, -1);
+                if ( ret < 0 && errno != EINTR )
+                        return preludedb_error_from_errno(errno);
+        }
+
+        return ret;
 }
 
 
 
 /**
- * preludedb_sql_query_execute:
+ * preludedb_sql_query_sprintf:
  * @sql: Pointer to a sql object.
- * @query: Pointer to a query object.
- * @table: Pointer to a table where the query result will be stored if the type of query returns
- * results (i.e a SELECT can result, but an INSERT never results) and if the query is successful.
+ * @table: Pointer to a table where the query result will be stored if the type of query return
+ * results (i.e a SELECT can results, but an INSERT never results) and if the query is sucessfull.
+ * @format: The SQL query to execute in a printf format string.
+ * @...: Arguments referenced in @format.
  *
  * Execute a SQL query.
  *
- * Returns: number of affected rows, -1 if an error occured.
+ * Returns: 1 if the query returns results, 0 if it does not, or negative value if an error occur.
  */
-int preludedb_sql_query_execute(preludedb_sql_t *sql, preludedb_sql_query_t *query, preludedb_sql_table_t **table)
+int preludedb_sql_query_sprintf(preludedb_sql_t *sql, preludedb_sql_table_t **table,
+                                const char *format, ...)
 {
         int ret;
-        prelude_string_t *output;
+        va_list ap;
+        prelude_string_t *query;
 
-        ret = prelude_string_new(&output);
+        ret = prelude_string_new(&query);
         if ( ret < 0 )
                 return ret;
 
-        ret = preludedb_sql_query_prepare(sql, query, output);
-        if ( ret < 0 ) {
-                prelude_string_destroy(output);
-                return ret;
-        }
+        va_start(ap, format);
+        ret = prelude_string_vprintf(query, format, ap);
+        va_end(ap);
+
+        if ( ret < 0 )
+                goto error;
+
+        ret = preludedb_sql_query(sql, prelude_string_get_string(query), table);
+
+ error:
+        prelude_string_destroy(query);
 
-        ret = preludedb_sql_query(sql, prelude_string_get_string(output), table);
-        prelude_string_destroy(output);
         return ret;
 }
 
 
 
 /**
- * preludedb_sql_query_destroy:
- * @table: Pointer to a query object.
+ * preludedb_sql_insert:
+ * @sql: Pointer to a sql object.
+ * @table: the name of the table where to insert values.
+ * @fields: a list of comma separated field names where the values will be inserted.
+ * @format: The values to insert in a printf format string.
+ * @...: Argument referenced throught @format.
  *
- * Destroy the @query object.
+ * Insert values in a table.
+ *
+ * Returns: 0 on success or a negative value if an error occur.
  */
-void preludedb_sql_query_destroy(preludedb_sql_query_t *query)
+int preludedb_sql_insert(preludedb_sql_t *sql, const char *table, const char *fields,
+                         const char *format, ...)
 {
-        if ( --query->refcount > 0 )
-                return;
+        int ret;
+        va_list ap;
+        prelude_string_t *query;
 
-        free(query->string);
-        free(query);
+        ret = prelude_string_new(&query);
+        if ( ret < 0 )
+                return ret;
+
+        ret = prelude_string_sprintf(query, "INSERT INTO %s (%s) VALUES(", table, fields);
+        if ( ret < 0 )
+                goto error;
+
+        va_start(ap, format);
+        ret = prelude_string_vprintf(query, format, ap);
+        va_end(ap);
+        if ( ret < 0 )
+                goto error;
+
+        ret = prelude_string_cat(query, ")");
+        if ( ret < 0 )
+                goto error;
+
+        /*
+         * A plain insert does not read anything back, there is no need to
+         * flush rows queued with preludedb_sql_insert_buffered() first.
+         */
+        ret = _preludedb_sql_query(sql, prelude_string_get_string(query), NULL, 0, NULL);
+
+ error:
+        prelude_string_destroy(query);
+
+        return ret;
+}
+
+
+
+static int insert_buffer_get(preludedb_sql_t *sql, const char *table, const char *fields, sql_insert_buffer_t **out)
+{
+        int ret;
+        prelude_list_t *tmp;
+        sql_insert_buffer_t *buf;
+
+        prelude_list_for_each(&sql->insert_buffers, tmp) {
+                buf = prelude_list_entry(tmp, sql_insert_buffer_t, list);
+
+                if ( strcmp(buf->table, table) == 0 && strcmp(buf->fields, fields) == 0 ) {
+                        *out = buf;
+                        return 0;
+                }
+        }
+
+        buf = calloc(1, sizeof(*buf));
+        if ( ! buf )
+                return preludedb_error_from_errno(errno);
+
+        ret = prelude_string_new(&buf->values);
+        if ( ret < 0 ) {
+                free(buf);
+                return ret;
+        }
+
+        buf->table = strdup(table);
+        buf->fields = strdup(fields);
+        if ( ! buf->table || ! buf->fields ) {
+                prelude_list_init(&buf->list);
+                insert_buffer_destroy(buf);
+                return preludedb_error_from_errno(errno);
+        }
+
+        prelude_list_add_tail(&sql->insert_buffers, &buf->list);
+        *out = buf;
+
+        return 0;
 }
 
 
 
 /**
- * preludedb_sql_query:
+ * preludedb_sql_insert_buffered:
  * @sql: Pointer to a sql object.
- * @query: The SQL query to execute.
- * @table: Pointer to a table where the query result will be stored if the type of query returns
- * results (i.e a SELECT can results, but an INSERT never results) and if the query is successful.
+ * @table: the name of the table where to insert values.
+ * @fields: a list of comma separated field names where the values will be inserted.
+ * @format: The values to insert in a printf format string.
+ * @...: Argument referenced throught @format.
  *
- * Execute a SQL query.
+ * Queue a row for insertion in @table. Rows queued for the same @table and
+ * @fields are sent together as a single multi-row INSERT statement, either
+ * when preludedb_sql_insert_flush() is called, when the current transaction
+ * is committed, or before any other query is run through @sql.
  *
- * Returns: number of affected rows, -1 if an error occurred.
+ * Returns: 0 on success or a negative value if an error occur.
  */
-int preludedb_sql_query(preludedb_sql_t *sql, const char *query, preludedb_sql_table_t **table)
+int preludedb_sql_insert_buffered(preludedb_sql_t *sql, const char *table, const char *fields,
+                                  const char *format, ...)
 {
         int ret;
-        struct timeval start, end;
+        va_list ap;
+        sql_insert_buffer_t *buf;
 
         gl_recursive_lock_lock(sql->mutex);
-        assert_connected(sql);
 
-        gettimeofday(&start, NULL);
+        ret = insert_buffer_get(sql, table, fields, &buf);
+        if ( ret < 0 )
+                goto error;
 
-        ret = _preludedb_plugin_sql_query(sql->plugin, sql->session, query, table);
-        if ( ret < 0 ) {
-                update_sql_from_errno(sql, ret);
+        ret = prelude_string_cat(buf->values, (buf->count > 0) ? ",(" : "(");
+        if ( ret < 0 )
+                goto error;
 
-                if ( ! (sql->status & PRELUDEDB_SQL_STATUS_CONNECTED) ) {
-                        assert_connected(sql);
+        va_start(ap, format);
+        ret = prelude_string_vprintf(buf->values, format, ap);
+        va_end(ap);
+        if ( ret < 0 )
+                goto error;
 
-                        ret = _preludedb_plugin_sql_query(sql->plugin, sql->session, query, table);
-                        if ( ret < 0 )
-                                update_sql_from_errno(sql, ret);
-                }
+        ret = prelude_string_cat(buf->values, ")");
+        if ( ret < 0 )
+                goto error;
+
+        buf->count++;
+
+        if ( prelude_string_get_len(buf->values) >= SQL_INSERT_BUFFER_MAX_SIZE )
+                ret = insert_buffer_flush(sql, buf);
+
+ error:
+        gl_recursive_lock_unlock(sql->mutex);
+
+        return (ret < 0) ? ret : 0;
+}
+
+
+
+static int insert_buffer_add_param(sql_insert_buffer_t *buf, const preludedb_sql_param_t *param)
+{
+        void *ptr;
+        size_t size;
+        sql_insert_param_t *p;
+
+        if ( buf->nparams == buf->params_size ) {
+                size = buf->params_size ? buf->params_size * 2 : 64;
+
+                ptr = realloc(buf->params, size * sizeof(*buf->params));
+                if ( ! ptr )
+                        return preludedb_error_from_errno(errno);
+
+                buf->params = ptr;
+                buf->params_size = size;
+        }
+
+        p = &buf->params[buf->nparams];
+        p->type = param->type;
+        p->len = param->len;
+
+        if ( ! param->value ) {
+                p->offset = SQL_INSERT_PARAM_NULL;
+                buf->nparams++;
+                return 0;
         }
 
-        gettimeofday(&end, NULL);
-        gl_recursive_lock_unlock(sql->mutex);
+        /*
+         * Values are NUL terminated, as expected for text parameters.
+         */
+        if ( buf->data_len + param->len + 1 > buf->data_size ) {
+                size = buf->data_size ? buf->data_size : 4096;
+                while ( size < buf->data_len + param->len + 1 )
+                        size *= 2;
 
-        if ( sql->logfile ) {
-                fprintf(sql->logfile, "%fs %s\n",
-                        (end.tv_sec + (double) end.tv_usec / 1000000) -
-                        (start.tv_sec + (double) start.tv_usec / 1000000), query);
+                ptr = realloc(buf->data, size);
+                if ( ! ptr )
+                        return preludedb_error_from_errno(errno);
 
-                fflush(sql->logfile);
+                buf->data = ptr;
+                buf->data_size = size;
         }
 
-        if ( ret <= 0 )
-                return ret;
+        memcpy(buf->data + buf->data_len, param->value, param->len);
+        buf->data[buf->data_len + param->len] = 0;
 
-        if ( table && *table )
-                (*table)->sql = preludedb_sql_ref(sql);
+        p->offset = buf->data_len;
+        buf->data_len += param->len + 1;
+        buf->nparams++;
 
-        return ret;
+        return 0;
 }
 
 
 
 /**
- * preludedb_sql_query_sprintf:
+ * preludedb_sql_insert_params:
  * @sql: Pointer to a sql object.
- * @table: Pointer to a table where the query result will be stored if the type of query return
- * results (i.e a SELECT can results, but an INSERT never results) and if the query is sucessfull.
- * @format: The SQL query to execute in a printf format string.
- * @...: Arguments referenced in @format.
+ * @table: the name of the table where to insert values.
+ * @fields: a list of comma separated field names where the values will be inserted.
+ * @params: the values to insert, one per field.
+ * @nparams: the number of values in @params.
  *
- * Execute a SQL query.
+ * Queue a row for insertion in @table, like preludedb_sql_insert_buffered().
+ * The values are not escaped: they are bound as parameters of a multi-row
+ * INSERT statement, binary values being sent as is.
  *
- * Returns: 1 if the query returns results, 0 if it does not, or negative value if an error occur.
+ * Returns: 0 on success or a negative value if an error occur.
  */
-int preludedb_sql_query_sprintf(preludedb_sql_t *sql, preludedb_sql_table_t **table,
-                                const char *format, ...)
+int preludedb_sql_insert_params(preludedb_sql_t *sql, const char *table, const char *fields,
+                                const preludedb_sql_param_t *params, unsigned int nparams)
 {
         int ret;
-        va_list ap;
-        prelude_string_t *query;
+        unsigned int i;
+        sql_insert_buffer_t *buf;
 
-        ret = prelude_string_new(&query);
-        if ( ret < 0 )
-                return ret;
+        if ( nparams == 0 )
+                return preludedb_error_verbose(PRELUDEDB_ERROR_GENERIC, "no value to insert in '%s'", table);
 
-        va_start(ap, format);
-        ret = prelude_string_vprintf(query, format, ap);
-        va_end(ap);
+        gl_recursive_lock_lock(sql->mutex);
 
+        ret = insert_buffer_get(sql, table, fields, &buf);
         if ( ret < 0 )
                 goto error;
 
-        ret = preludedb_sql_query(sql, prelude_string_get_string(query), table);
+        if ( buf->param_rows == 0 )
+                buf->ncolumns = nparams;
+
+        else if ( buf->ncolumns != nparams ) {
+                ret = preludedb_error_verbose(PRELUDEDB_ERROR_GENERIC, "'%s' rows expect %u values, %u given",
+                                              table, buf->ncolumns, nparams);
+                goto error;
+        }
+
+        for ( i = 0; i < nparams; i++ ) {
+                ret = insert_buffer_add_param(buf, &params[i]);
+                if ( ret < 0 ) {
+                        buf->nparams -= i;
+                        goto error;
+                }
+        }
+
+        buf->param_rows++;
+
+        if ( buf->data_len >= SQL_INSERT_BUFFER_MAX_SIZE )
+                ret = insert_buffer_flush(sql, buf);
 
  error:
-        prelude_string_destroy(query);
+        gl_recursive_lock_unlock(sql->mutex);
 
-        return ret;
+        return (ret < 0) ? ret : 0;
 }
 
 
 
 /**
- * preludedb_sql_insert:
+ * preludedb_sql_write_params:
  * @sql: Pointer to a sql object.
- * @table: the name of the table where to insert values.
- * @fields: a list of comma separated field names where the values will be inserted.
- * @format: The values to insert in a printf format string.
- * @...: Argument referenced throught @format.
+ * @query: The SQL statement to execute, referencing its parameters through '?' placeholders.
+ * @params: Array of parameters bound to the placeholders of @query, in order.
+ * @nparams: Number of elements in @params.
  *
- * Insert values in a table.
+ * Execute a parameterized statement that writes rows without reading any
+ * back, like an INSERT whose ident is retrieved afterward, or an upsert.
+ * Unlike preludedb_sql_query_params(), rows queued with
+ * preludedb_sql_insert_buffered() or preludedb_sql_insert_params() are not
+ * flushed first, so that the batching of child rows is not broken by their
+ * parent: @query must not depend on the content of the tables rows are
+ * queued for.
  *
- * Returns: 0 on success or a negative value if an error occur.
+ * Returns: number of affected rows, or a negative value if an error occurred.
  */
-int preludedb_sql_insert(preludedb_sql_t *sql, const char *table, const char *fields,
-                         const char *format, ...)
+int preludedb_sql_write_params(preludedb_sql_t *sql, const char *query,
+                               const preludedb_sql_param_t *params, unsigned int nparams)
 {
-        int ret;
-        va_list ap;
-        prelude_string_t *query;
-
-        ret = prelude_string_new(&query);
-        if ( ret < 0 )
-                return ret;
+        prelude_return_val_if_fail(sql && query, prelude_error(PRELUDE_ERROR_ASSERTION));
 
-        ret = prelude_string_sprintf(query, "INSERT INTO %s (%s) VALUES(", table, fields);
-        if ( ret < 0 )
-                goto error;
+        return _preludedb_sql_query(sql, query, params, nparams, NULL);
+}
 
-        va_start(ap, format);
-        ret = prelude_string_vprintf(query, format, ap);
-        va_end(ap);
-        if ( ret < 0 )
-                goto error;
 
-        ret = prelude_string_cat(query, ")");
-        if ( ret < 0 )
-                goto error;
 
-        ret = preludedb_sql_query(sql, prelude_string_get_string(query), NULL);
+/**
+ * preludedb_sql_insert_flush:
+ * @sql: Pointer to a sql object.
+ *
+ * Send all the rows queued with preludedb_sql_insert_buffered().
+ *
+ * Returns: 0 on success or a negative value if an error occur.
+ */
+int preludedb_sql_insert_flush(preludedb_sql_t *sql)
+{
+        int ret;
 
- error:
-        prelude_string_destroy(query);
+        gl_recursive_lock_lock(sql->mutex);
+        ret = insert_buffer_flush_all(sql);
+        gl_recursive_lock_unlock(sql->mutex);
 
-        return ret;
+        return (ret < 0) ? ret : 0;
 }
 
 
@@ -744,6 +3397,102 @@ int preludedb_sql_get_last_insert_ident(preludedb_sql_t *sql, uint64_t *ident)
 
 
 
+static int ident_pool_get(preludedb_sql_t *sql, const char *table, sql_ident_pool_t **out)
+{
+        prelude_list_t *tmp;
+        sql_ident_pool_t *pool;
+
+        prelude_list_for_each(&sql->ident_pools, tmp) {
+                pool = prelude_list_entry(tmp, sql_ident_pool_t, list);
+
+                if ( strcmp(pool->table, table) == 0 ) {
+                        *out = pool;
+                        return 0;
+                }
+        }
+
+        pool = calloc(1, sizeof(*pool) + sql->ident_reserve * sizeof(*pool->idents));
+        if ( ! pool )
+                return preludedb_error_from_errno(errno);
+
+        pool->table = strdup(table);
+        if ( ! pool->table ) {
+                free(pool);
+                return preludedb_error_from_errno(errno);
+        }
+
+        prelude_list_add_tail(&sql->ident_pools, &pool->list);
+        *out = pool;
+
+        return 0;
+}
+
+
+
+/**
+ * preludedb_sql_reserve_ident:
+ * @sql: Pointer to a sql object.
+ * @table: the name of the table the ident is allocated for.
+ * @column: the name of the auto increment column within @table.
+ * @ident: Where the reserved ident is stored.
+ *
+ * When the "ident_reserve" setting is set to a non zero value, idents for
+ * @table are reserved from the database by blocks of this size and handed
+ * out locally, so that the caller can insert rows with an explicit ident
+ * instead of retrieving it with preludedb_sql_get_last_insert_ident().
+ *
+ * Returns: 1 if an ident was reserved, 0 if ident reservation is disabled or
+ * not supported by the database backend, or a negative value if an error occur.
+ */
+int preludedb_sql_reserve_ident(preludedb_sql_t *sql, const char *table, const char *column, uint64_t *ident)
+{
+        int ret;
+        sql_ident_pool_t *pool;
+
+        if ( ! sql->ident_reserve )
+                return 0;
+
+        gl_recursive_lock_lock(sql->mutex);
+
+        ret = ident_pool_get(sql, table, &pool);
+        if ( ret < 0 )
+                goto out;
+
+        if ( pool->pos == pool->count ) {
+                assert_connected(sql);
+
+                ret = _preludedb_plugin_sql_reserve_idents(sql->plugin, sql->session, table, column, pool->idents, sql->ident_reserve);
+                if ( ret < 0 ) {
+                        update_sql_from_errno(sql, ret);
+
+                        if ( prelude_error_get_code(ret) == PRELUDE_ERROR_ENOSYS ) {
+                                sql->ident_reserve = 0;
+                                ident_pool_clear(sql);
+                                ret = 0;
+                        }
+
+                        goto out;
+                }
+
+                pool->count = ret;
+                pool->pos = 0;
+
+                if ( pool->count == 0 ) {
+                        ret = preludedb_error_verbose(PRELUDEDB_ERROR_GENERIC, "could not reserve idents for table '%s'", table);
+                        goto out;
+                }
+        }
+
+        *ident = pool->idents[pool->pos++];
+        ret = 1;
+
+ out:
+        gl_recursive_lock_unlock(sql->mutex);
+        return ret;
+}
+
+
+
 /**
  * preludedb_sql_build_limit_offset_string:
  * @sql: Pointer to a sql object.
@@ -776,8 +3525,10 @@ int _preludedb_sql_transaction_start(preludedb_sql_t *sql)
         ret = preludedb_sql_query(sql, "BEGIN", NULL);
         if ( ret < 0 )
                 gl_recursive_lock_unlock(sql->mutex);
-        else
+        else {
+                set_transaction(sql, TRUE);
                 sql->status |= PRELUDEDB_SQL_STATUS_TRANSACTION;
+        }
 
         return ret;
 }
@@ -809,8 +3560,15 @@ int _preludedb_sql_transaction_end(preludedb_sql_t *sql)
         if ( ! (sql->status & PRELUDEDB_SQL_STATUS_TRANSACTION) )
                 return preludedb_error(PRELUDEDB_ERROR_NOT_IN_TRANSACTION);
 
+        ret = insert_buffer_flush_all(sql);
+        if ( ret < 0 ) {
+                _preludedb_sql_transaction_abort(sql);
+                return ret;
+        }
+
         ret = preludedb_sql_query(sql, "COMMIT", NULL);
         sql->status &= ~PRELUDEDB_SQL_STATUS_TRANSACTION;
+        set_transaction(sql, FALSE);
 
         gl_recursive_lock_unlock(sql->mutex);
 
@@ -849,7 +3607,9 @@ int _preludedb_sql_transaction_abort(preludedb_sql_t *sql)
         if ( _prelude_thread_get_error() )
                 original_error = strdup(_prelude_thread_get_error());
 
+        insert_buffer_clear(sql);
         sql->status &= ~PRELUDEDB_SQL_STATUS_TRANSACTION;
+        set_transaction(sql, FALSE);
 
         if ( original_error && ! (sql->status & PRELUDEDB_SQL_STATUS_CONNECTED) ) {
                 ret = preludedb_error_verbose(PRELUDEDB_ERROR_QUERY, "%s. No ROLLBACK possible due to connection closure",
@@ -895,6 +3655,173 @@ int preludedb_sql_transaction_abort(preludedb_sql_t *sql)
 
 
 
+#define ESCAPE_ONES  0x0101010101010101ULL
+#define ESCAPE_HIGHS 0x8080808080808080ULL
+
+#define escape_has_zero(v)    (((v) - ESCAPE_ONES) & ~(v) & ESCAPE_HIGHS)
+#define escape_has_byte(v, c) escape_has_zero((v) ^ (ESCAPE_ONES * (unsigned char) (c)))
+
+
+static inline prelude_bool_t escape_is_special(unsigned char c, prelude_bool_t backslash)
+{
+        if ( c == '\'' || c == 0 )
+                return TRUE;
+
+        return backslash && (c == '\\' || c == '"' || c == '\n' || c == '\r' || c == '\032');
+}
+
+
+
+/*
+ * Get the length of the leading part of @input that can be copied as is,
+ * eight bytes at a time.
+ */
+static size_t escape_span(const char *input, size_t len, prelude_bool_t backslash)
+{
+        uint64_t v;
+        size_t i = 0;
+
+        for ( ; i + sizeof(v) <= len; i += sizeof(v) ) {
+                memcpy(&v, input + i, sizeof(v));
+
+                if ( escape_has_byte(v, '\'') || escape_has_zero(v) )
+                        break;
+
+                if ( backslash && (escape_has_byte(v, '\\') || escape_has_byte(v, '"') || escape_has_byte(v, '\n') ||
+                                   escape_has_byte(v, '\r') || escape_has_byte(v, '\032')) )
+                        break;
+        }
+
+        while ( i < len && ! escape_is_special(input[i], backslash) )
+                i++;
+
+        return i;
+}
+
+
+
+/*
+ * Escape @input as a quoted string into @output, which must hold at least
+ * ESCAPE_STRING_SIZE(@input_size) bytes, following @flags rather than
+ * asking the session. Returns the length of the escaped string.
+ */
+#define ESCAPE_STRING_SIZE(size) ((size) * 2 + 3)
+
+static size_t escape_string(int flags, const char *input, size_t input_size, char *output)
+{
+        size_t n;
+        char *out = output;
+        const char *end = input + input_size;
+        prelude_bool_t backslash = flags & PRELUDEDB_PLUGIN_SQL_ESCAPE_BACKSLASH;
+
+        *out++ = '\'';
+
+        while ( input < end ) {
+                n = escape_span(input, end - input, backslash);
+
+                memcpy(out, input, n);
+                out += n;
+                input += n;
+
+                if ( input == end )
+                        break;
+
+                if ( ! backslash ) {
+                        if ( *input == 0 )
+                                break;
+
+                        *out++ = '\'';
+                        *out++ = *input++;
+                        continue;
+                }
+
+                *out++ = '\\';
+
+                switch ( *input ) {
+                case 0:
+                        *out++ = '0';
+                        break;
+
+                case '\n':
+                        *out++ = 'n';
+                        break;
+
+                case '\r':
+                        *out++ = 'r';
+                        break;
+
+                case '\032':
+                        *out++ = 'Z';
+                        break;
+
+                default:
+                        *out++ = *input;
+                        break;
+                }
+
+                input++;
+        }
+
+        *out++ = '\'';
+        *out = 0;
+
+        return out - output;
+}
+
+
+
+/*
+ * Escape binary data without the session, when its escaping flags allow
+ * it. Returns 1 if done, 0 if the session has to be asked.
+ */
+static int escape_binary(preludedb_sql_t *sql, int flags, const unsigned char *input, size_t input_size, char **output)
+{
+        size_t i;
+        char *out;
+        static const char hex[] = "0123456789abcdef";
+
+        if ( ! _preludedb_plugin_sql_has_escape_binary(sql->plugin) ) {
+                int ret = _preludedb_plugin_sql_escape_binary(sql->plugin, NULL, input, input_size, output);
+                return (ret < 0) ? ret : 1;
+        }
+
+        if ( flags < 0 || ! (flags & (PRELUDEDB_PLUGIN_SQL_ESCAPE_BINARY_AS_STRING|PRELUDEDB_PLUGIN_SQL_ESCAPE_BINARY_BYTEA_HEX)) )
+                return 0;
+
+        if ( ESCAPE_STRING_SIZE(input_size) <= input_size )
+                return preludedb_error(PRELUDEDB_ERROR_GENERIC);
+
+        /*
+         * The bytea hexadecimal form is one byte longer than the largest
+         * escaped string.
+         */
+        *output = malloc(ESCAPE_STRING_SIZE(input_size) + 2);
+        if ( ! *output )
+                return preludedb_error_from_errno(errno);
+
+        if ( flags & PRELUDEDB_PLUGIN_SQL_ESCAPE_BINARY_AS_STRING ) {
+                escape_string(flags, (const char *) input, input_size, *output);
+                return 1;
+        }
+
+        out = *output;
+        *out++ = '\'';
+        *out++ = '\\';
+        *out++ = 'x';
+
+        for ( i = 0; i < input_size; i++ ) {
+                *out++ = hex[input[i] >> 4];
+                *out++ = hex[input[i] & 0x0f];
+        }
+
+        *out++ = '\'';
+        *out = 0;
+
+        return 1;
+}
+
+
+
 /**
  * preludedb_sql_escape_fast:
  * @sql: Pointer to a sql object.
@@ -902,7 +3829,8 @@ int preludedb_sql_transaction_abort(preludedb_sql_t *sql)
  * @input_size: Buffer size.
  * @output: Where the new escaped buffer will be stored.
  *
- * Escape a string buffer.
+ * Escape a string buffer. Once connected, backends describing how they
+ * escape values have them escaped without taking the session lock.
  *
  * Returns: 0 on success or a negative value if an error occur.
  */
@@ -915,6 +3843,19 @@ int preludedb_sql_escape_fast(preludedb_sql_t *sql, const char *input, size_t in
                 return *output ? 0 : preludedb_error_from_errno(errno);
         }
 
+        if ( sql->escape_flags >= 0 ) {
+                if ( ESCAPE_STRING_SIZE(input_size) <= input_size )
+                        return preludedb_error(PRELUDEDB_ERROR_GENERIC);
+
+                *output = malloc(ESCAPE_STRING_SIZE(input_size));
+                if ( ! *output )
+                        return preludedb_error_from_errno(errno);
+
+                escape_string(sql->escape_flags, input, input_size, *output);
+                metrics_add_escaped_bytes(sql, input_size);
+                return 0;
+        }
+
         gl_recursive_lock_lock(sql->mutex);
 
         assert_connected(sql);
@@ -922,6 +3863,9 @@ int preludedb_sql_escape_fast(preludedb_sql_t *sql, const char *input, size_t in
 
         gl_recursive_lock_unlock(sql->mutex);
 
+        if ( ret >= 0 )
+                metrics_add_escaped_bytes(sql, input_size);
+
         return ret;
 }
 
@@ -944,6 +3888,55 @@ int preludedb_sql_escape(preludedb_sql_t *sql, const char *input, char **output)
 
 
 
+/**
+ * preludedb_sql_escape_to_buffer:
+ * @sql: Pointer to a sql object.
+ * @input: Buffer to escape.
+ * @input_size: Buffer size.
+ * @output: Where the escaped string will be written.
+ * @output_size: Size of @output, at least twice @input_size plus 3 bytes.
+ *
+ * Escape a string buffer into @output, quotes included, without any
+ * allocation when the backend describes how it escapes values.
+ *
+ * Returns: the length of the escaped string, or a negative value if an error occur.
+ */
+ssize_t preludedb_sql_escape_to_buffer(preludedb_sql_t *sql, const char *input, size_t input_size,
+                                       char *output, size_t output_size)
+{
+        int ret;
+        size_t len;
+        char *escaped;
+
+        if ( ! input ) {
+                if ( output_size < sizeof("NULL") )
+                        return preludedb_error(PRELUDEDB_ERROR_GENERIC);
+
+                strcpy(output, "NULL");
+                return sizeof("NULL") - 1;
+        }
+
+        if ( ESCAPE_STRING_SIZE(input_size) <= input_size || output_size < ESCAPE_STRING_SIZE(input_size) )
+                return preludedb_error_verbose(PRELUDEDB_ERROR_GENERIC, "escape buffer too small");
+
+        if ( sql->escape_flags >= 0 ) {
+                metrics_add_escaped_bytes(sql, input_size);
+                return escape_string(sql->escape_flags, input, input_size, output);
+        }
+
+        ret = preludedb_sql_escape_fast(sql, input, input_size, &escaped);
+        if ( ret < 0 )
+                return ret;
+
+        len = strlen(escaped);
+        memcpy(output, escaped, len + 1);
+        free(escaped);
+
+        return len;
+}
+
+
+
 /**
  * preludedb_sql_escape_binary:
  * @sql: Pointer to a sql object.
@@ -965,14 +3958,25 @@ int preludedb_sql_escape_binary(preludedb_sql_t *sql, const unsigned char *input
                 return *output ? 0 : preludedb_error_from_errno(errno);
         }
 
-        gl_recursive_lock_lock(sql->mutex);
+        ret = escape_binary(sql, sql->escape_flags, input, input_size, output);
+        if ( ret < 0 )
+                return ret;
 
-        assert_connected(sql);
-        ret = _preludedb_plugin_sql_escape_binary(sql->plugin, sql->session, input, input_size, output);
+        if ( ret == 0 ) {
+                gl_recursive_lock_lock(sql->mutex);
 
-        gl_recursive_lock_unlock(sql->mutex);
+                assert_connected(sql);
+                ret = _preludedb_plugin_sql_escape_binary(sql->plugin, sql->session, input, input_size, output);
 
-        return ret;
+                gl_recursive_lock_unlock(sql->mutex);
+
+                if ( ret < 0 )
+                        return ret;
+        }
+
+        metrics_add_escaped_bytes(sql, input_size);
+
+        return 0;
 }
 
 
@@ -1006,6 +4010,40 @@ int preludedb_sql_unescape_binary(preludedb_sql_t *sql, const char *input, size_
 
 
 
+/*
+ * Number of entries of the rows array: a streamed table only has one.
+ */
+static inline unsigned int table_get_slot_count(preludedb_sql_table_t *table)
+{
+        if ( table->stream )
+                return table->rows ? 1 : 0;
+
+        return table->nrow;
+}
+
+
+
+/*
+ * Give up the table reference on the last row fetched from a streamed
+ * table. If the row is still referenced, it is left to these references.
+ */
+static void stream_release_row(preludedb_sql_table_t *table)
+{
+        preludedb_sql_row_t *row = table->rows[0];
+
+        table->rows[0] = NULL;
+
+        if ( row->refcount == 1 ) {
+                preludedb_sql_row_destroy(row);
+                return;
+        }
+
+        row->detached = TRUE;
+        row->refcount--;
+}
+
+
+
 preludedb_sql_table_t *preludedb_sql_table_ref(preludedb_sql_table_t *table)
 {
         prelude_return_val_if_fail(table, NULL);
@@ -1016,6 +4054,98 @@ preludedb_sql_table_t *preludedb_sql_table_ref(preludedb_sql_table_t *table)
 
 
 
+/*
+ * Retrieve the session @table comes from, the main session being locked
+ * until table_session_release(), which has to be called in any case. Pool
+ * sessions are held by the table they returned. Fails when the session
+ * was closed since the table was retrieved.
+ */
+static int table_session_get(preludedb_sql_table_t *table, void **session)
+{
+        sql_pool_session_t *ps;
+        preludedb_sql_t *sql = table->sql;
+
+        *session = NULL;
+
+        if ( table->session_slot == SQL_SESSION_MAIN ) {
+                gl_recursive_lock_lock(sql->mutex);
+
+                if ( table->generation != sql->generation )
+                        return preludedb_error_verbose(PRELUDEDB_ERROR_CONNECTION, "the session of this result was closed");
+
+                *session = sql->session;
+        }
+
+        else if ( table->session_slot >= 0 ) {
+                ps = &sql->pool[table->session_slot];
+
+                if ( table->generation != ps->generation )
+                        return preludedb_error_verbose(PRELUDEDB_ERROR_CONNECTION, "the session of this result was closed");
+
+                *session = ps->session;
+        }
+
+        return 0;
+}
+
+
+
+static void table_session_release(preludedb_sql_table_t *table)
+{
+        if ( table->session_slot == SQL_SESSION_MAIN )
+                gl_recursive_lock_unlock(table->sql->mutex);
+}
+
+
+
+/*
+ * Close the session of @table after a connection error, while it is held.
+ */
+static void table_session_error(preludedb_sql_table_t *table, int error)
+{
+        if ( ! preludedb_error_check(error, PRELUDEDB_ERROR_CONNECTION) )
+                return;
+
+        if ( table->session_slot == SQL_SESSION_MAIN )
+                session_close(table->sql);
+
+        else if ( table->session_slot >= 0 )
+                pool_session_close(table->sql, &table->sql->pool[table->session_slot]);
+}
+
+
+
+/*
+ * Release @table, without dropping the reference it holds on its sql
+ * object. The resources of a table whose session was closed are released
+ * without it.
+ */
+static void table_free(preludedb_sql_table_t *table)
+{
+        unsigned int i;
+        void *session;
+
+        for ( i = 0; i < table_get_slot_count(table); i++ )
+                if ( table->rows[i] )
+                        preludedb_sql_row_destroy(table->rows[i]);
+
+        free(table->rows);
+
+        table_session_get(table, &session);
+        _preludedb_plugin_sql_table_destroy(table->sql->plugin, session, table);
+        table_session_release(table);
+
+        if ( table->statement )
+                statement_release(table->sql, table->statement);
+
+        if ( table->session_slot >= 0 )
+                pool_checkin(table->sql, table->session_slot);
+
+        free(table);
+}
+
+
+
 /**
  * preludedb_sql_table_destroy:
  * @table: Pointer to a table object.
@@ -1024,35 +4154,76 @@ preludedb_sql_table_t *preludedb_sql_table_ref(preludedb_sql_table_t *table)
  */
 void preludedb_sql_table_destroy(preludedb_sql_table_t *table)
 {
-        unsigned int i;
+        preludedb_sql_t *sql;
 
         if ( --table->refcount > 0 )
                 return;
 
-        for ( i = 0; i < table->nrow; i++ )
-                if ( table->rows[i] )
-                        preludedb_sql_row_destroy(table->rows[i]);
+        sql = table->sql;
 
-        free(table->rows);
+        if ( table->metrics && sql ) {
+                gl_lock_lock(sql->metrics_mutex);
+                table->metrics->fetched_rows += table->nrow;
+                gl_lock_unlock(sql->metrics_mutex);
+        }
 
-        _preludedb_plugin_sql_table_destroy(table->sql->plugin, table->sql->session, table);
-        preludedb_sql_destroy(table->sql);
-        free(table);
+        table_free(table);
+        preludedb_sql_destroy(sql);
+}
+
+
+
+static int stream_new_row(preludedb_sql_table_t *table, preludedb_sql_row_t **row, unsigned int row_index, size_t fieldsize)
+{
+        if ( ! table->rows ) {
+                table->rows = calloc(1, sizeof(*table->rows));
+                if ( ! table->rows )
+                        return preludedb_error_from_errno(errno);
+        }
+
+        else if ( table->rows[0] )
+                stream_release_row(table);
+
+        *row = calloc(1, offsetof(preludedb_sql_row_t, fields) + fieldsize);
+        if ( ! *row )
+                return preludedb_error_from_errno(errno);
+
+        (*row)->refcount = 1;
+        (*row)->table = table;
+        (*row)->index = row_index;
+
+        table->rows[0] = *row;
+        table->nrow = row_index + 1;
+
+        return 0;
 }
 
 
 
 int preludedb_sql_table_new_row(preludedb_sql_table_t *table, preludedb_sql_row_t **row, unsigned int row_index)
 {
-        unsigned int i;
+        void *ptr;
+        unsigned int i, size;
         unsigned int nindex = MAX(row_index, table->nrow) + 1;
         size_t fieldsize = preludedb_sql_table_get_column_count(table) * sizeof(preludedb_sql_field_t);
 
+        if ( table->stream )
+                return stream_new_row(table, row, row_index, fieldsize);
+
         if ( row_index >= table->nrow ) {
+                /*
+                 * Grow geometrically, rows being mostly fetched one by one.
+                 */
+                if ( nindex > table->rows_size ) {
+                        size = MAX(nindex, table->rows_size ? table->rows_size * 2 : 16);
 
-                table->rows = realloc(table->rows, sizeof(*table->rows) * nindex);
-                if ( ! table->rows )
-                        return preludedb_error_from_errno(errno);
+                        ptr = realloc(table->rows, sizeof(*table->rows) * size);
+                        if ( ! ptr )
+                                return preludedb_error_from_errno(errno);
+
+                        table->rows = ptr;
+                        table->rows_size = size;
+                }
 
                 for ( i = table->nrow; i < nindex; i++ )
                         table->rows[i] = NULL;
@@ -1092,7 +4263,7 @@ unsigned int preludedb_sql_row_get_field_count(preludedb_sql_row_t *row)
 
 preludedb_sql_row_t *preludedb_sql_row_ref(preludedb_sql_row_t *row)
 {
-        if ( row->refcount == 1 )
+        if ( row->refcount == 1 && ! row->detached )
                 preludedb_sql_table_ref(row->table);
 
         row->refcount++;
@@ -1104,21 +4275,35 @@ preludedb_sql_row_t *preludedb_sql_row_ref(preludedb_sql_row_t *row)
 void preludedb_sql_row_destroy(preludedb_sql_row_t *row)
 {
         unsigned int i;
+        void *session;
+        preludedb_sql_table_t *table = row->table;
 
         if ( --row->refcount > 0 ) {
-                if ( row->refcount == 1 )
-                        preludedb_sql_table_destroy(row->table);
+                if ( row->refcount == 1 && ! row->detached )
+                        preludedb_sql_table_destroy(table);
                 return;
         }
 
-        _preludedb_plugin_sql_row_destroy(row->table->sql->plugin, row->table->sql->session, row->table, row);
+        table_session_get(table, &session);
+        _preludedb_plugin_sql_row_destroy(table->sql->plugin, session, table, row);
+        table_session_release(table);
 
-        for ( i = 0; i < preludedb_sql_table_get_column_count(row->table); i++ ) {
+        for ( i = 0; i < preludedb_sql_table_get_column_count(table); i++ ) {
                 if ( row->fields[i].value )
                         preludedb_sql_field_destroy(&(row->fields[i]));
         }
 
-        row->table->rows[row->index] = NULL;
+        if ( row->detached ) {
+                free(row);
+                preludedb_sql_table_destroy(table);
+                return;
+        }
+
+        if ( table->stream )
+                table->rows[0] = NULL;
+        else
+                table->rows[row->index] = NULL;
+
         free(row);
 }
 
@@ -1135,6 +4320,7 @@ int preludedb_sql_row_new_field(preludedb_sql_row_t *row, preludedb_sql_field_t
         }
 
         ftbl[num].index = num;
+        ftbl[num].type = PRELUDEDB_SQL_FIELD_TYPE_TEXT;
         ftbl[num].value = value;
         ftbl[num].len = len;
         *field = &ftbl[num];
@@ -1153,6 +4339,7 @@ preludedb_sql_field_t *preludedb_sql_field_ref(preludedb_sql_field_t *field)
 
 void preludedb_sql_field_destroy(preludedb_sql_field_t *field)
 {
+        void *session;
         preludedb_sql_row_t *row;
 
         if ( field->value == SQL_NULL_FIELD )
@@ -1160,8 +4347,12 @@ void preludedb_sql_field_destroy(preludedb_sql_field_t *field)
 
         row = field2row(field);
 
-        if ( row->refcount == 0 )
-                _preludedb_plugin_sql_field_destroy(row->table->sql->plugin, row->table->sql->session, row->table, row, field);
+        if ( row->refcount == 0 ) {
+                table_session_get(row->table, &session);
+                _preludedb_plugin_sql_field_destroy(row->table->sql->plugin, session, row->table, row, field);
+                table_session_release(row->table);
+        }
+
         else
                 preludedb_sql_row_destroy(row);
 }
@@ -1179,7 +4370,15 @@ void preludedb_sql_field_destroy(preludedb_sql_field_t *field)
  */
 const char *preludedb_sql_table_get_column_name(preludedb_sql_table_t *table, unsigned int column_num)
 {
-        return _preludedb_plugin_sql_get_column_name(table->sql->plugin, table->sql->session, table, column_num);
+        void *session;
+        const char *name = NULL;
+
+        if ( table_session_get(table, &session) >= 0 )
+                name = _preludedb_plugin_sql_get_column_name(table->sql->plugin, session, table, column_num);
+
+        table_session_release(table);
+
+        return name;
 }
 
 
@@ -1195,7 +4394,16 @@ const char *preludedb_sql_table_get_column_name(preludedb_sql_table_t *table, un
  */
 int preludedb_sql_table_get_column_num(preludedb_sql_table_t *table, const char *column_name)
 {
-        return _preludedb_plugin_sql_get_column_num(table->sql->plugin, table->sql->session, table, column_name);
+        int ret;
+        void *session;
+
+        ret = table_session_get(table, &session);
+        if ( ret >= 0 )
+                ret = _preludedb_plugin_sql_get_column_num(table->sql->plugin, session, table, column_name);
+
+        table_session_release(table);
+
+        return ret;
 }
 
 
@@ -1210,8 +4418,13 @@ int preludedb_sql_table_get_column_num(preludedb_sql_table_t *table, const char
  */
 unsigned int preludedb_sql_table_get_column_count(preludedb_sql_table_t *table)
 {
-        if ( ! table->column_count )
-                table->column_count = _preludedb_plugin_sql_get_column_count(table->sql->plugin, table->sql->session, table);
+        void *session;
+
+        if ( ! table->column_count ) {
+                table_session_get(table, &session);
+                table->column_count = _preludedb_plugin_sql_get_column_count(table->sql->plugin, session, table);
+                table_session_release(table);
+        }
 
         return table->column_count;
 }
@@ -1224,18 +4437,37 @@ unsigned int preludedb_sql_table_get_column_count(preludedb_sql_table_t *table)
  *
  * Get the the number of row in the table.
  * Depending on the database backend, this might require retrieving all rows.
+ * The row count of a streamed table is only available once all its rows
+ * have been fetched.
  *
- * Returns: the number of columns.
+ * Returns: the number of rows, or a negative value if an error occurred,
+ * such as for a streamed table whose rows were not all fetched.
  */
-unsigned int preludedb_sql_table_get_row_count(preludedb_sql_table_t *table)
+int preludedb_sql_table_get_row_count(preludedb_sql_table_t *table)
 {
         int ret;
+        void *session;
         preludedb_sql_row_t *row;
 
         if ( table->row_count )
                 return table->row_count;
 
-        ret = _preludedb_plugin_sql_get_row_count(table->sql->plugin, table->sql->session, table);
+        /*
+         * Counting the rows of a streamed table would consume them.
+         */
+        if ( table->stream ) {
+                if ( table->done )
+                        return table->nrow;
+
+                return preludedb_error_verbose(PRELUDEDB_ERROR_GENERIC, "row count of a streamed table is unknown until all rows are fetched");
+        }
+
+        ret = table_session_get(table, &session);
+        if ( ret >= 0 )
+                ret = _preludedb_plugin_sql_get_row_count(table->sql->plugin, session, table);
+
+        table_session_release(table);
+
         if ( ret >= 0 ) {
                 table->row_count = ret;
                 return ret;
@@ -1285,10 +4517,20 @@ unsigned int preludedb_sql_table_get_row_count(preludedb_sql_table_t *table)
 int preludedb_sql_table_get_row(preludedb_sql_table_t *table, unsigned int row_index, preludedb_sql_row_t **row)
 {
         int ret;
+        void *session;
 
         if ( row_index == (unsigned int) -1 )
                 row_index = table->nrow;
 
+        if ( table->stream && row_index < table->nrow ) {
+                if ( row_index + 1 == table->nrow && table->rows[0] ) {
+                        *row = table->rows[0];
+                        return 1;
+                }
+
+                return preludedb_error_verbose(PRELUDEDB_ERROR_INDEX, "Row '%u' is no longer available from streamed table", row_index);
+        }
+
         if ( row_index < table->nrow && table->rows[row_index] ) {
                 *row = table->rows[row_index];
                 return 1;
@@ -1301,12 +4543,18 @@ int preludedb_sql_table_get_row(preludedb_sql_table_t *table, unsigned int row_i
                 return preludedb_error_verbose(PRELUDEDB_ERROR_INDEX, "Invalid row '%u'", row_index);
         }
 
-        ret = _preludedb_plugin_sql_fetch_row(table->sql->plugin, table->sql->session, table, row_index, row);
-        if ( ret < 0 ) {
-                update_sql_from_errno(table->sql, ret);
-                return ret;
+        ret = table_session_get(table, &session);
+        if ( ret >= 0 ) {
+                ret = _preludedb_plugin_sql_fetch_row(table->sql->plugin, session, table, row_index, row);
+                if ( ret < 0 )
+                        table_session_error(table, ret);
         }
 
+        table_session_release(table);
+
+        if ( ret < 0 )
+                return ret;
+
         if ( ret == 0 ) {
                 table->done = TRUE;
                 return 0;
@@ -1348,6 +4596,7 @@ int preludedb_sql_table_fetch_row(preludedb_sql_table_t *table, preludedb_sql_ro
 int preludedb_sql_row_get_field(preludedb_sql_row_t *row, int column_num, preludedb_sql_field_t **field)
 {
         int ret;
+        void *session;
         unsigned int ccount;
 
         ccount = preludedb_sql_table_get_column_count(row->table);
@@ -1368,13 +4617,15 @@ int preludedb_sql_row_get_field(preludedb_sql_row_t *row, int column_num, prelud
         }
 
 
-        ret = _preludedb_plugin_sql_fetch_field(row->table->sql->plugin,
-                                                row->table->sql->session, row->table, row, column_num, field);
-        if ( ret < 0 ) {
-                update_sql_from_errno(row->table->sql, ret);
-                return ret;
+        ret = table_session_get(row->table, &session);
+        if ( ret >= 0 ) {
+                ret = _preludedb_plugin_sql_fetch_field(row->table->sql->plugin, session, row->table, row, column_num, field);
+                if ( ret < 0 )
+                        table_session_error(row->table, ret);
         }
 
+        table_session_release(row->table);
+
         return ret;
 }
 
@@ -1472,6 +4723,165 @@ size_t preludedb_sql_field_get_len(preludedb_sql_field_t *field)
 
 
 
+/**
+ * preludedb_sql_field_set_type:
+ * @field: Pointer to a field object.
+ * @type: Representation of the field value.
+ *
+ * Set how the value of @field is represented, for backends returning
+ * binary values. Fields are %PRELUDEDB_SQL_FIELD_TYPE_TEXT by default.
+ */
+void preludedb_sql_field_set_type(preludedb_sql_field_t *field, preludedb_sql_field_type_t type)
+{
+        field->type = type;
+}
+
+
+
+/**
+ * preludedb_sql_field_get_type:
+ * @field: Pointer to a field object.
+ *
+ * Get how the value of @field is represented. Anything but
+ * %PRELUDEDB_SQL_FIELD_TYPE_TEXT and %PRELUDEDB_SQL_FIELD_TYPE_BINARY
+ * should be read through the preludedb_sql_field_to_*() functions.
+ *
+ * Returns: the field type.
+ */
+preludedb_sql_field_type_t preludedb_sql_field_get_type(preludedb_sql_field_t *field)
+{
+        return field->type;
+}
+
+
+
+static inline uint64_t field_get_big_endian(const preludedb_sql_field_t *field)
+{
+        uint32_t i;
+        uint64_t value = 0;
+
+        for ( i = 0; i < field->len; i++ )
+                value = (value << 8) | (unsigned char) field->value[i];
+
+        return value;
+}
+
+
+
+static int field_get_binary_integer(const preludedb_sql_field_t *field, int64_t *value)
+{
+        uint64_t v;
+
+        if ( field->len != 2 && field->len != 4 && field->len != 8 )
+                return preludedb_error(PRELUDEDB_ERROR_INVALID_VALUE);
+
+        v = field_get_big_endian(field);
+        if ( field->len < 8 && (v >> (field->len * 8 - 1)) )
+                v |= ~(uint64_t) 0 << (field->len * 8);
+
+        *value = (int64_t) v;
+
+        return 0;
+}
+
+
+
+/*
+ * Seconds are rounded down, microseconds being stored apart.
+ * 946684800 is 2000-01-01 00:00:00 UTC, the binary timestamps epoch.
+ */
+static int field_get_binary_timestamp(const preludedb_sql_field_t *field, time_t *sec)
+{
+        int64_t value;
+
+        if ( field->type != PRELUDEDB_SQL_FIELD_TYPE_TIMESTAMP || field->len != 8 )
+                return preludedb_error(PRELUDEDB_ERROR_INVALID_VALUE);
+
+        value = (int64_t) field_get_big_endian(field);
+
+        *sec = value / 1000000 + 946684800;
+        if ( value % 1000000 < 0 )
+                (*sec)--;
+
+        return 0;
+}
+
+
+
+static int field_get_binary_double(const preludedb_sql_field_t *field, double *value)
+{
+        int ret;
+        float f;
+        double d;
+        int64_t i;
+        uint32_t v32;
+        uint64_t v64;
+
+        if ( field->type == PRELUDEDB_SQL_FIELD_TYPE_INTEGER ) {
+                ret = field_get_binary_integer(field, &i);
+                if ( ret < 0 )
+                        return ret;
+
+                *value = i;
+                return 0;
+        }
+
+        if ( field->type != PRELUDEDB_SQL_FIELD_TYPE_FLOAT )
+                return preludedb_error(PRELUDEDB_ERROR_INVALID_VALUE);
+
+        if ( field->len == sizeof(v32) ) {
+                v32 = field_get_big_endian(field);
+                memcpy(&f, &v32, sizeof(f));
+                *value = f;
+        }
+
+        else if ( field->len == sizeof(v64) ) {
+                v64 = field_get_big_endian(field);
+                memcpy(&d, &v64, sizeof(d));
+                *value = d;
+        }
+
+        else return preludedb_error(PRELUDEDB_ERROR_INVALID_VALUE);
+
+        return 0;
+}
+
+
+
+/*
+ * Integers come as plain decimal strings from all backends: parse them
+ * straight from the field buffer, whose length is known. Returns -1 for
+ * anything else, left to the strto*() functions.
+ */
+static inline int field_parse_integer(const preludedb_sql_field_t *field, prelude_bool_t *negative, uint64_t *value)
+{
+        uint64_t v = 0;
+        const char *ptr = field->value, *end = field->value + field->len;
+
+        *negative = (ptr < end && *ptr == '-');
+        if ( *negative )
+                ptr++;
+
+        /*
+         * 19 digits never overflow 64 bits.
+         */
+        if ( ptr == end || end - ptr > 19 )
+                return -1;
+
+        for ( ; ptr < end; ptr++ ) {
+                if ( *ptr < '0' || *ptr > '9' )
+                        return -1;
+
+                v = v * 10 + (*ptr - '0');
+        }
+
+        *value = v;
+
+        return 0;
+}
+
+
+
 /**
  * preludedb_sql_field_to_{int8,uint8,int16,uint16,int32,uint32,int64,uint64,float,double}:
  * @field: Pointer to a field object.
@@ -1485,7 +4895,30 @@ size_t preludedb_sql_field_get_len(preludedb_sql_field_t *field)
 int preludedb_sql_field_to_ ## name(preludedb_sql_field_t *field, name ## _t *value)            \
 {                                                                                               \
         rtype tmp;                                                                              \
+        uint64_t digits;                                                                        \
         char *eptr = NULL;                                                                      \
+        prelude_bool_t negative;                                                                \
+        int64_t binary;                                                                         \
+                                                                                                \
+        if ( field->type == PRELUDEDB_SQL_FIELD_TYPE_INTEGER ) {                                \
+                if ( field_get_binary_integer(field, &binary) < 0 ||                            \
+                     binary < min || (binary > 0 && (uint64_t) binary > (uint64_t) max) )       \
+                        return preludedb_error(PRELUDEDB_ERROR_INVALID_VALUE);                  \
+                                                                                                \
+                *value = (name ## _t) binary;                                                   \
+                return 0;                                                                       \
+        }                                                                                       \
+                                                                                                \
+        if ( field->type != PRELUDEDB_SQL_FIELD_TYPE_TEXT )                                     \
+                return preludedb_error(PRELUDEDB_ERROR_INVALID_VALUE);                          \
+                                                                                                \
+        if ( field_parse_integer(field, &negative, &digits) == 0 ) {                            \
+                if ( negative ? (min >= 0 || digits > (uint64_t) max + 1) : digits > (uint64_t) max ) \
+                        return preludedb_error(PRELUDEDB_ERROR_INVALID_VALUE);                  \
+                                                                                                \
+                *value = negative ? (name ## _t) (0 - digits) : (name ## _t) digits;            \
+                return 0;                                                                       \
+        }                                                                                       \
                                                                                                 \
         if ( min >= 0 && *field->value == '-' )                                                 \
                 return preludedb_error(PRELUDEDB_ERROR_INVALID_VALUE);                          \
@@ -1511,8 +4944,19 @@ preludedb_sql_field_to(uint64, unsigned long long, strtoull, 0, PRELUDE_UINT64_M
 
 int preludedb_sql_field_to_float(preludedb_sql_field_t *field, float *value)
 {
+        int ret;
+        double d;
         char *eptr = NULL;
 
+        if ( field->type != PRELUDEDB_SQL_FIELD_TYPE_TEXT ) {
+                ret = field_get_binary_double(field, &d);
+                if ( ret < 0 )
+                        return ret;
+
+                *value = d;
+                return 0;
+        }
+
         errno = 0;
 
         *value = strtof(preludedb_sql_field_get_value(field), &eptr);
@@ -1528,6 +4972,9 @@ int preludedb_sql_field_to_double(preludedb_sql_field_t *field, double *value)
 {
         char *eptr = NULL;
 
+        if ( field->type != PRELUDEDB_SQL_FIELD_TYPE_TEXT )
+                return field_get_binary_double(field, value);
+
         errno = 0;
 
         *value = strtod(preludedb_sql_field_get_value(field), &eptr);
@@ -1549,7 +4996,105 @@ int preludedb_sql_field_to_double(preludedb_sql_field_t *field, double *value)
  */
 int preludedb_sql_field_to_string(preludedb_sql_field_t *field, prelude_string_t *output)
 {
-        return prelude_string_ncat(output, field->value, field->len);
+        int ret;
+        double d;
+        int64_t i;
+        time_t t;
+        struct tm tm;
+
+        switch ( field->type ) {
+        case PRELUDEDB_SQL_FIELD_TYPE_INTEGER:
+                ret = field_get_binary_integer(field, &i);
+                if ( ret < 0 )
+                        return ret;
+
+                return prelude_string_sprintf(output, "%" PRELUDE_PRId64, i);
+
+        case PRELUDEDB_SQL_FIELD_TYPE_FLOAT:
+                ret = field_get_binary_double(field, &d);
+                if ( ret < 0 )
+                        return ret;
+
+                return prelude_string_sprintf(output, "%.15g", d);
+
+        case PRELUDEDB_SQL_FIELD_TYPE_TIMESTAMP:
+                ret = field_get_binary_timestamp(field, &t);
+                if ( ret < 0 )
+                        return ret;
+
+                if ( ! gmtime_r(&t, &tm) )
+                        return preludedb_error_from_errno(errno);
+
+                return prelude_string_sprintf(output, "%04d-%02d-%02d %02d:%02d:%02d",
+                                              tm.tm_year + 1900, tm.tm_mon + 1, tm.tm_mday,
+                                              tm.tm_hour, tm.tm_min, tm.tm_sec);
+
+        default:
+                return prelude_string_ncat(output, field->value, field->len);
+        }
+}
+
+
+
+/**
+ * preludedb_sql_field_to_time:
+ * @field: Pointer to a field object holding a timestamp.
+ * @time: Pointer to a time object.
+ * @gmtoff: GMT offset.
+ * @usec: Microseconds.
+ *
+ * Set @time from the timestamp stored in @field, as
+ * preludedb_sql_time_from_timestamp() does, binary timestamps
+ * being decoded without going through their text representation.
+ *
+ * Returns: 0 on success, or a negative value if an error occur.
+ */
+int preludedb_sql_field_to_time(preludedb_sql_field_t *field, idmef_time_t *time, int32_t gmtoff, uint32_t usec)
+{
+        int ret;
+        time_t sec;
+
+        if ( field->type == PRELUDEDB_SQL_FIELD_TYPE_TEXT )
+                return preludedb_sql_time_from_timestamp(time, field->value, gmtoff, usec);
+
+        ret = field_get_binary_timestamp(field, &sec);
+        if ( ret < 0 )
+                return ret;
+
+        idmef_time_set_sec(time, sec);
+        idmef_time_set_usec(time, usec);
+        idmef_time_set_gmt_offset(time, gmtoff);
+
+        return 0;
+}
+
+
+
+/**
+ * preludedb_sql_field_to_binary:
+ * @sql: Pointer to a sql object.
+ * @field: Pointer to a field object holding binary data.
+ * @output: Pointer where to store the newly allocated data.
+ * @output_size: Pointer where to store the size of @output.
+ *
+ * Get the data stored in @field, unescaped as preludedb_sql_unescape_binary()
+ * does, unless the backend returned them as they are.
+ *
+ * Returns: 0 on success, or a negative value if an error occur.
+ */
+int preludedb_sql_field_to_binary(preludedb_sql_t *sql, preludedb_sql_field_t *field, unsigned char **output, size_t *output_size)
+{
+        if ( field->type != PRELUDEDB_SQL_FIELD_TYPE_BINARY )
+                return preludedb_sql_unescape_binary(sql, field->value, field->len, output, output_size);
+
+        *output = malloc(field->len ? field->len : 1);
+        if ( ! *output )
+                return preludedb_error_from_errno(errno);
+
+        memcpy(*output, field->value, field->len);
+        *output_size = field->len;
+
+        return 0;
 }
 
 
@@ -1928,6 +5473,267 @@ int preludedb_sql_build_criterion_string(preludedb_sql_t *sql,
 
 
 
+static int params_add(preludedb_sql_params_t *params, char *value)
+{
+        void *ptr;
+        unsigned int size;
+
+        if ( params->count == params->size ) {
+                size = params->size ? params->size * 2 : 8;
+
+                ptr = realloc(params->params, size * sizeof(*params->params));
+                if ( ! ptr )
+                        return preludedb_error_from_errno(errno);
+                params->params = ptr;
+
+                ptr = realloc(params->values, size * sizeof(*params->values));
+                if ( ! ptr )
+                        return preludedb_error_from_errno(errno);
+                params->values = ptr;
+
+                params->size = size;
+        }
+
+        params->values[params->count] = value;
+        params->params[params->count].value = value;
+        params->params[params->count].len = strlen(value);
+        params->params[params->count].type = PRELUDEDB_SQL_PARAM_TYPE_TEXT;
+        params->count++;
+
+        return 0;
+}
+
+
+
+/*
+ * Fixed values and regular expressions are bound. Broken down times are
+ * turned into backend specific constructs holding integers only, and
+ * NULL tests have no value: both are written within the query, with no
+ * user supplied text.
+ */
+static prelude_bool_t criterion_is_bindable(idmef_criterion_operator_t operator, idmef_criterion_value_t *value)
+{
+        idmef_criterion_value_type_t type;
+
+        if ( operator == IDMEF_CRITERION_OPERATOR_NULL || operator == IDMEF_CRITERION_OPERATOR_NOT_NULL )
+                return FALSE;
+
+        type = idmef_criterion_value_get_type(value);
+
+        return (type == IDMEF_CRITERION_VALUE_TYPE_VALUE || type == IDMEF_CRITERION_VALUE_TYPE_REGEX) ? TRUE : FALSE;
+}
+
+
+
+static int build_criterion_param_value(preludedb_sql_t *sql, const idmef_value_t *value,
+                                       idmef_criterion_operator_t operator, char **output)
+{
+        int ret;
+        size_t len;
+        prelude_string_t *string;
+
+        if ( idmef_value_get_type(value) == IDMEF_VALUE_TYPE_TIME ) {
+                char buf[PRELUDEDB_SQL_TIMESTAMP_STRING_SIZE];
+
+                ret = build_criterion_fixed_sql_time_value(sql, value, buf, sizeof(buf));
+                if ( ret < 0 )
+                        return ret;
+
+                /*
+                 * Strip the quotes from the timestamp literal.
+                 */
+                len = strlen(buf);
+                if ( len >= 2 && buf[0] == '\'' && buf[len - 1] == '\'' )
+                        *output = strndup(buf + 1, len - 2);
+                else
+                        *output = strdup(buf);
+
+                return (*output) ? 0 : preludedb_error_from_errno(errno);
+        }
+
+        if ( operator & IDMEF_CRITERION_OPERATOR_SUBSTR )
+                return build_criterion_fixed_sql_like_value(value, output);
+
+        ret = prelude_string_new(&string);
+        if ( ret < 0 )
+                return ret;
+
+        ret = idmef_value_to_string(value, string);
+        if ( ret >= 0 )
+                ret = prelude_string_get_string_released(string, output);
+
+        prelude_string_destroy(string);
+
+        return ret;
+}
+
+
+
+/**
+ * preludedb_sql_params_new:
+ * @params: Pointer where to store the created parameter list.
+ *
+ * Create a list of parameters, to be used with preludedb_sql_query_params().
+ *
+ * Returns: 0 on success, or a negative value if an error occurred.
+ */
+int preludedb_sql_params_new(preludedb_sql_params_t **params)
+{
+        *params = calloc(1, sizeof(**params));
+        if ( ! *params )
+                return preludedb_error_from_errno(errno);
+
+        return 0;
+}
+
+
+
+/**
+ * preludedb_sql_params_destroy:
+ * @params: Pointer to a parameter list.
+ *
+ * Destroy @params and the values it holds.
+ */
+void preludedb_sql_params_destroy(preludedb_sql_params_t *params)
+{
+        unsigned int i;
+
+        for ( i = 0; i < params->count; i++ )
+                free(params->values[i]);
+
+        free(params->values);
+        free(params->params);
+        free(params);
+}
+
+
+
+/**
+ * preludedb_sql_params_get:
+ * @params: Pointer to a parameter list.
+ *
+ * Returns: the array of parameters held by @params, or NULL if it is empty.
+ */
+const preludedb_sql_param_t *preludedb_sql_params_get(preludedb_sql_params_t *params)
+{
+        return params->params;
+}
+
+
+
+/**
+ * preludedb_sql_params_get_count:
+ * @params: Pointer to a parameter list.
+ *
+ * Returns: the number of parameters held by @params.
+ */
+unsigned int preludedb_sql_params_get_count(preludedb_sql_params_t *params)
+{
+        return params->count;
+}
+
+
+
+/**
+ * preludedb_sql_params_add_string:
+ * @params: Pointer to a parameter list.
+ * @value: The text value to bind.
+ *
+ * Append a copy of @value to @params, to be bound to the next '?' placeholder.
+ *
+ * Returns: 0 on success, or a negative value if an error occurred.
+ */
+int preludedb_sql_params_add_string(preludedb_sql_params_t *params, const char *value)
+{
+        int ret;
+        char *str;
+
+        str = strdup(value);
+        if ( ! str )
+                return preludedb_error_from_errno(errno);
+
+        ret = params_add(params, str);
+        if ( ret < 0 )
+                free(str);
+
+        return ret;
+}
+
+
+
+/**
+ * preludedb_sql_params_add_criterion:
+ * @params: Pointer to a parameter list.
+ * @sql: Pointer to a sql object.
+ * @operator: The criterion operator.
+ * @value: The criterion value.
+ *
+ * Append the parameter bound to the placeholder written by
+ * preludedb_sql_build_criterion_template() for the same criterion, if any.
+ *
+ * Returns: 1 if a parameter was added, 0 if the criterion value is written
+ * within the query, or a negative value if an error occurred.
+ */
+int preludedb_sql_params_add_criterion(preludedb_sql_params_t *params, preludedb_sql_t *sql,
+                                       idmef_criterion_operator_t operator, idmef_criterion_value_t *value)
+{
+        int ret;
+        char *str;
+
+        if ( ! criterion_is_bindable(operator, value) )
+                return 0;
+
+        if ( idmef_criterion_value_get_type(value) == IDMEF_CRITERION_VALUE_TYPE_REGEX ) {
+                str = strdup(idmef_criterion_value_get_regex(value));
+                if ( ! str )
+                        return preludedb_error_from_errno(errno);
+        }
+
+        else {
+                ret = build_criterion_param_value(sql, idmef_criterion_value_get_value(value), operator, &str);
+                if ( ret < 0 )
+                        return ret;
+        }
+
+        ret = params_add(params, str);
+        if ( ret < 0 ) {
+                free(str);
+                return ret;
+        }
+
+        return 1;
+}
+
+
+
+/**
+ * preludedb_sql_build_criterion_template:
+ * @sql: Pointer to a sql object.
+ * @output: Pointer to a string object, where the result content will be stored.
+ * @field: The sql field name.
+ * @operator: The criterion operator.
+ * @value: The criterion value.
+ *
+ * Same as preludedb_sql_build_criterion_string(), except that fixed values
+ * and regular expressions are replaced with a '?' placeholder, so that the
+ * resulting string does not depend on them. The matching parameter is obtained through
+ * preludedb_sql_params_add_criterion().
+ *
+ * Returns: 0 on success, or a negative value if an error occur.
+ */
+int preludedb_sql_build_criterion_template(preludedb_sql_t *sql,
+                                           prelude_string_t *output,
+                                           const char *field,
+                                           idmef_criterion_operator_t operator, idmef_criterion_value_t *value)
+{
+        if ( ! criterion_is_bindable(operator, value) )
+                return preludedb_sql_build_criterion_string(sql, output, field, operator, value);
+
+        return _preludedb_plugin_sql_build_constraint_string(sql->plugin, sql->session, output, field, operator, "?");
+}
+
+
+
 /**
  * preludedb_sql_time_from_timestamp:
  * @time: Pointer to a time object.
@@ -2107,6 +5913,40 @@ void _preludedb_sql_disable_internal_transaction(preludedb_sql_t *sql)
 
 
 
+/*
+ * Between these calls, rows queued with preludedb_sql_insert_params() are
+ * flushed through the backend bulk load facility, if it has one. The session
+ * lock is held in between, and rows queued beforehand are flushed first: the
+ * bulk load mode only ever applies to the rows of the calling thread.
+ */
+int _preludedb_sql_bulk_load_start(preludedb_sql_t *sql, prelude_bool_t *previous)
+{
+        int ret;
+
+        gl_recursive_lock_lock(sql->mutex);
+
+        ret = insert_buffer_flush_all(sql);
+        if ( ret < 0 ) {
+                gl_recursive_lock_unlock(sql->mutex);
+                return ret;
+        }
+
+        *previous = sql->bulk_load;
+        sql->bulk_load = TRUE;
+
+        return 0;
+}
+
+
+
+void _preludedb_sql_bulk_load_end(preludedb_sql_t *sql, prelude_bool_t previous)
+{
+        sql->bulk_load = previous;
+        gl_recursive_lock_unlock(sql->mutex);
+}
+
+
+
 void *_preludedb_sql_get_plugin(preludedb_sql_t *sql)
 {
         return sql->plugin;
@@ -26,6 +26,7 @@
 #include <stdio.h>
 #include <string.h>
 #include <stdlib.h>
+#include <limits.h>
 #include <sys/types.h>
 #include <libprelude/prelude.h>
 #include <libprelude/prelude-ident.h>
@@ -45,6 +46,11 @@
 #define PRELUDEDB_PLUGIN_SYMBOL "preludedb_plugin_init"
 #define PRELUDEDB_ENOTSUP(x) preludedb_error_verbose(prelude_error_code_from_errno(ENOSYS), "Database format does not support '%s' operation", x)
 
+/*
+ * Messages deleted per transaction by preludedb_delete().
+ */
+#define PRELUDEDB_DELETE_CHUNK_SIZE 10000
+
 
 struct preludedb {
         int refcount;
@@ -53,11 +59,13 @@ struct preludedb {
         preludedb_sql_t *sql;
         preludedb_plugin_format_t *plugin;
         void *data;
+        prelude_bool_t result_streaming;
 };
 
 struct preludedb_result_idents {
         preludedb_t *db;
         void *res;
+        char *cursor;
         int refcount;
 };
 
@@ -74,6 +82,8 @@ int _preludedb_sql_transaction_end(preludedb_sql_t *sql);
 int _preludedb_sql_transaction_abort(preludedb_sql_t *sql);
 void _preludedb_sql_enable_internal_transaction(preludedb_sql_t *sql);
 void _preludedb_sql_disable_internal_transaction(preludedb_sql_t *sql);
+int _preludedb_sql_bulk_load_start(preludedb_sql_t *sql, prelude_bool_t *previous);
+void _preludedb_sql_bulk_load_end(preludedb_sql_t *sql, prelude_bool_t previous);
 
 
 
@@ -281,6 +291,34 @@ void *preludedb_get_data(preludedb_t *db)
 
 
 
+/**
+ * preludedb_set_result_streaming:
+ * @db: Pointer to a db object.
+ * @enabled: Whether results should be streamed.
+ *
+ * Have the idents and values results retrieved from @db afterward streamed
+ * from the database (see preludedb_sql_query_stream()) instead of being
+ * transferred at once, bounding the memory used by large results.
+ *
+ * Rows of a streamed result have to be retrieved in order, and their count
+ * is only available once all of them have been retrieved.
+ */
+void preludedb_set_result_streaming(preludedb_t *db, prelude_bool_t enabled)
+{
+        prelude_return_if_fail(db);
+        db->result_streaming = enabled;
+}
+
+
+
+prelude_bool_t preludedb_get_result_streaming(preludedb_t *db)
+{
+        prelude_return_val_if_fail(db, FALSE);
+        return db->result_streaming;
+}
+
+
+
 /**
  * preludedb_new:
  * @db: Pointer to a db object to initialize.
@@ -492,6 +530,107 @@ int preludedb_insert_message(preludedb_t *db, idmef_message_t *message)
 
 
 
+/**
+ * preludedb_insert_messages:
+ * @db: Pointer to a db object.
+ * @messages: Array of IDMEF messages.
+ * @size: Number of element in @messages.
+ *
+ * Insert all the IDMEF messages from @messages into the database, within
+ * a single transaction. Depending on the format, rows belonging to the same
+ * table are grouped and sent using a reduced number of statements. NULL
+ * entries of @messages are skipped.
+ *
+ * Returns: the number of inserted messages, or a negative value if an error occur.
+ */
+ssize_t preludedb_insert_messages(preludedb_t *db, idmef_message_t **messages, size_t size)
+{
+        int ret;
+        size_t i;
+        ssize_t count = 0;
+
+        prelude_return_val_if_fail(db && (messages || size == 0), prelude_error(PRELUDE_ERROR_ASSERTION));
+
+        if ( size == 0 )
+                return 0;
+
+        if ( db->plugin->insert_messages )
+                return db->plugin->insert_messages(db, messages, size);
+
+        ret = preludedb_transaction_start(db);
+        if ( ret < 0 )
+                return ret;
+
+        for ( i = 0; i < size; i++ ) {
+                if ( ! messages[i] )
+                        continue;
+
+                ret = db->plugin->insert_message(db, messages[i]);
+                if ( ret < 0 ) {
+                        preludedb_transaction_abort(db);
+                        return ret;
+                }
+
+                count++;
+        }
+
+        ret = preludedb_transaction_end(db);
+        if ( ret < 0 )
+                return ret;
+
+        return count;
+}
+
+
+
+/**
+ * preludedb_load_messages:
+ * @db: Pointer to a db object.
+ * @messages: Array of IDMEF messages.
+ * @size: Number of element in @messages.
+ *
+ * Insert all the IDMEF messages from @messages, like preludedb_insert_messages(),
+ * for bulk loading: rows are streamed through the backend bulk load facility
+ * when it has one (COPY on PostgreSQL), instead of INSERT statements. Larger
+ * @messages arrays give better throughput.
+ *
+ * The bulk load mode only applies to this call: the sql object is locked
+ * until it returns, so that rows inserted by other threads keep going
+ * through regular INSERT statements.
+ *
+ * Returns: the number of inserted messages, or a negative value if an error occur.
+ */
+ssize_t preludedb_load_messages(preludedb_t *db, idmef_message_t **messages, size_t size)
+{
+        int tmp;
+        ssize_t ret;
+        prelude_bool_t previous;
+
+        prelude_return_val_if_fail(db && (messages || size == 0), prelude_error(PRELUDE_ERROR_ASSERTION));
+
+        ret = _preludedb_sql_bulk_load_start(db->sql, &previous);
+        if ( ret < 0 )
+                return ret;
+
+        ret = preludedb_insert_messages(db, messages, size);
+
+        /*
+         * Within a transaction handled by the caller, rows would otherwise
+         * only be sent on commit, once bulk loading is over.
+         */
+        if ( ret >= 0 ) {
+                tmp = preludedb_sql_insert_flush(db->sql);
+                if ( tmp < 0 )
+                        ret = tmp;
+        }
+
+        _preludedb_sql_bulk_load_end(db->sql, previous);
+
+        return ret;
+}
+
+
+
 preludedb_result_idents_t *preludedb_result_idents_ref(preludedb_result_idents_t *results)
 {
         prelude_return_val_if_fail(results, NULL);
@@ -517,6 +656,7 @@ void preludedb_result_idents_destroy(preludedb_result_idents_t *result)
         result->db->plugin->destroy_message_idents_resource(result->res);
         preludedb_destroy(result->db);
 
+        free(result->cursor);
         free(result);
 }
 
@@ -556,6 +696,24 @@ unsigned int preludedb_result_idents_get_count(preludedb_result_idents_t *result
 
 
 
+/**
+ * preludedb_result_idents_get_cursor:
+ * @result: Pointer to an idents result object.
+ *
+ * Retrieve the continuation token of a result obtained through
+ * preludedb_get_alert_idents_after(), to be given back as the cursor
+ * of the next call.
+ *
+ * Returns: the token, or NULL if @result holds the last page.
+ */
+const char *preludedb_result_idents_get_cursor(preludedb_result_idents_t *result)
+{
+        prelude_return_val_if_fail(result, NULL);
+        return result->cursor;
+}
+
+
+
 /**
  * preludedb_result_values_destroy:
  * @result: Pointer to a result values object.
@@ -763,6 +921,56 @@ int preludedb_get_alert_idents2(preludedb_t *db,
 
 
 
+/**
+ * preludedb_get_alert_idents_after:
+ * @db: Pointer to a db object.
+ * @criteria: Pointer to an idmef criteria.
+ * @cursor: Continuation token from a previous page, or NULL for the first page.
+ * @limit: Limit of results or -1 if no limit.
+ * @order: Result order.
+ * @result: Idents result.
+ *
+ * Same as preludedb_get_alert_idents(), except that pages are addressed by
+ * the position of the last alert of the previous page rather than by an offset,
+ * so that retrieving a deep page costs the same as retrieving the first one.
+ * Alerts sharing the same creation time are ordered by their ident.
+ *
+ * The token to use for the next page is available through
+ * preludedb_result_idents_get_cursor(). It must be used with the same
+ * @criteria and @order.
+ *
+ * Returns: the number of result or a negative value if an error occured.
+ */
+int preludedb_get_alert_idents_after(preludedb_t *db,
+                                     idmef_criteria_t *criteria, const char *cursor, int limit,
+                                     preludedb_result_idents_order_t order,
+                                     preludedb_result_idents_t **result)
+{
+        int ret;
+
+        prelude_return_val_if_fail(db && result, prelude_error(PRELUDE_ERROR_ASSERTION));
+
+        if ( ! db->plugin->get_alert_idents_after )
+                return PRELUDEDB_ENOTSUP("get_alert_idents_after");
+
+        *result = calloc(1, sizeof(**result));
+        if ( ! *result )
+                return preludedb_error_from_errno(errno);
+
+        ret = db->plugin->get_alert_idents_after(db, criteria, cursor, limit, order, &(*result)->res, &(*result)->cursor);
+        if ( ret <= 0 ) {
+                free(*result);
+                return ret;
+        }
+
+        (*result)->refcount++;
+        (*result)->db = preludedb_ref(db);
+
+        return ret;
+}
+
+
+
 /**
  * preludedb_get_heartbeat_idents:
  * @db: Pointer to a db object.
@@ -849,6 +1057,92 @@ int preludedb_get_heartbeat(preludedb_t *db, uint64_t ident, idmef_message_t **m
 }
 
 
+
+static ssize_t get_messages(preludedb_t *db, uint64_t *idents, size_t size, idmef_message_t **messages,
+                            preludedb_plugin_format_get_alert_func_t get_message)
+{
+        int ret;
+        size_t i, count = 0;
+
+        for ( i = 0; i < size; i++ ) {
+                ret = get_message(db, idents[i], &messages[i]);
+                if ( ret < 0 ) {
+                        messages[i] = NULL;
+
+                        if ( preludedb_error_check(ret, PRELUDEDB_ERROR_INVALID_MESSAGE_IDENT) )
+                                continue;
+
+                        while ( i-- > 0 ) {
+                                if ( messages[i] )
+                                        idmef_message_destroy(messages[i]);
+                        }
+
+                        return ret;
+                }
+
+                count++;
+        }
+
+        return count;
+}
+
+
+
+/**
+ * preludedb_get_alerts:
+ * @db: Pointer to a db object.
+ * @idents: Pointer to an array of idents.
+ * @size: Size of @idents.
+ * @messages: Array of @size idmef message pointers where the retrieved messages will be stored.
+ *
+ * Retrieve all the alerts whose ident is stored within @idents, @messages[i]
+ * receiving the alert matching @idents[i], or NULL if it does not exist.
+ * Depending on the format, the alerts are retrieved using a number of queries
+ * that does not depend on @size.
+ *
+ * Returns: the number of alerts retrieved, or a negative value if an error occur.
+ */
+ssize_t preludedb_get_alerts(preludedb_t *db, uint64_t *idents, size_t size, idmef_message_t **messages)
+{
+        prelude_return_val_if_fail(db && (size == 0 || (idents && messages)), prelude_error(PRELUDE_ERROR_ASSERTION));
+
+        if ( size == 0 )
+                return 0;
+
+        if ( db->plugin->get_alerts )
+                return db->plugin->get_alerts(db, idents, size, messages);
+
+        return get_messages(db, idents, size, messages, db->plugin->get_alert);
+}
+
+
+
+/**
+ * preludedb_get_heartbeats:
+ * @db: Pointer to a db object.
+ * @idents: Pointer to an array of idents.
+ * @size: Size of @idents.
+ * @messages: Array of @size idmef message pointers where the retrieved messages will be stored.
+ *
+ * Retrieve all the heartbeats whose ident is stored within @idents, @messages[i]
+ * receiving the heartbeat matching @idents[i], or NULL if it does not exist.
+ *
+ * Returns: the number of heartbeats retrieved, or a negative value if an error occur.
+ */
+ssize_t preludedb_get_heartbeats(preludedb_t *db, uint64_t *idents, size_t size, idmef_message_t **messages)
+{
+        prelude_return_val_if_fail(db && (size == 0 || (idents && messages)), prelude_error(PRELUDE_ERROR_ASSERTION));
+
+        if ( size == 0 )
+                return 0;
+
+        if ( db->plugin->get_heartbeats )
+                return db->plugin->get_heartbeats(db, idents, size, messages);
+
+        return get_messages(db, idents, size, messages, db->plugin->get_heartbeat);
+}
+
+
 /**
  * preludedb_delete_alert:
  * @db: Pointer to a db object.
@@ -958,19 +1252,62 @@ ssize_t preludedb_delete_heartbeat_from_result_idents(preludedb_t *db, preludedb
 
 
 
+static ssize_t delete_chunk(preludedb_t *db, idmef_class_id_t type, idmef_criteria_t *criteria, size_t chunk_size)
+{
+        ssize_t ret;
+        preludedb_result_idents_t *result;
+
+        if ( type == IDMEF_CLASS_ID_ALERT ) {
+                ret = preludedb_get_alert_idents2(db, criteria, chunk_size, -1, NULL, &result);
+                if ( ret <= 0 )
+                        return ret;
+
+                ret = preludedb_delete_alert_from_result_idents(db, result);
+        } else {
+                ret = preludedb_get_heartbeat_idents2(db, criteria, chunk_size, -1, NULL, &result);
+                if ( ret <= 0 )
+                        return ret;
+
+                ret = preludedb_delete_heartbeat_from_result_idents(db, result);
+        }
+
+        preludedb_result_idents_destroy(result);
+
+        return ret;
+}
+
+
+
 /**
- * preludedb_delete:
+ * preludedb_delete2:
  * @db: Pointer to a db object.
  * @criteria: Pointer to a criteria object.
+ * @chunk_size: Maximum number of messages deleted per transaction, 0 for the default.
+ * @cb: Function called after each deleted chunk, or NULL.
+ * @data: Data passed to @cb.
  *
- * Delete all database object matching @criteria.
+ * Delete all database object matching @criteria, by chunks of at most
+ * @chunk_size messages, each deleted within its own transaction so that
+ * tables are only locked for the duration of a chunk. Only the idents of
+ * the current chunk are kept in memory.
  *
- * Returns: a negative value if an error occured.
+ * Chunks are deleted until one deletes nothing. The deletion as a whole
+ * is not atomic: if it fails or is stopped, the chunks deleted before
+ * remain committed.
+ *
+ * After each chunk, @cb is given the total number of messages deleted so
+ * far. If it returns a negative value, the operation stops and this value
+ * is returned.
+ *
+ * Returns: the number of deleted messages, or a negative value if an error occured.
  */
-int preludedb_delete(preludedb_t *db, idmef_criteria_t *criteria)
+ssize_t preludedb_delete2(preludedb_t *db, idmef_criteria_t *criteria, size_t chunk_size,
+                          preludedb_delete_progress_cb_func_t cb, void *data)
 {
         int ret;
-        preludedb_result_idents_t *result;
+        ssize_t count;
+        size_t total = 0;
+        idmef_class_id_t type;
 
         prelude_return_val_if_fail(db, prelude_error(PRELUDE_ERROR_ASSERTION));
 
@@ -981,28 +1318,79 @@ int preludedb_delete(preludedb_t *db, idmef_criteria_t *criteria)
         if ( ret < 0 )
                 return ret;
 
-        if ( ret == IDMEF_CLASS_ID_ALERT ) {
-                ret = preludedb_get_alert_idents2(db, criteria, -1, 0, NULL, &result);
-                if ( ret <= 0 )
-                        return ret;
+        type = ret;
+        if ( type != IDMEF_CLASS_ID_ALERT && type != IDMEF_CLASS_ID_HEARTBEAT )
+                return preludedb_error_verbose(PRELUDEDB_ERROR_GENERIC, "criteria should only reference alert or heartbeat paths");
 
-                ret = preludedb_delete_alert_from_result_idents(db, result);
+        if ( chunk_size == 0 )
+                chunk_size = PRELUDEDB_DELETE_CHUNK_SIZE;
+
+        /*
+         * A chunk may be short while messages still match, e.g. when
+         * some were inserted meanwhile: only an empty chunk ends the loop.
+         */
+        while ( (count = delete_chunk(db, type, criteria, chunk_size)) > 0 ) {
+                total += count;
+
+                if ( cb ) {
+                        ret = cb(db, total, data);
+                        if ( ret < 0 )
+                                return ret;
+                }
         }
 
-        else if ( IDMEF_CLASS_ID_HEARTBEAT ) {
-                ret = preludedb_get_heartbeat_idents2(db, criteria, -1, 0, NULL, &result);
-                if ( ret <= 0 )
-                        return ret;
+        return (count < 0) ? count : (ssize_t) total;
+}
 
-                ret = preludedb_delete_heartbeat_from_result_idents(db, result);
-        }
 
-        preludedb_result_idents_destroy(result);
+
+/**
+ * preludedb_delete:
+ * @db: Pointer to a db object.
+ * @criteria: Pointer to a criteria object.
+ *
+ * Delete all database object matching @criteria, see preludedb_delete2().
+ *
+ * Returns: the number of deleted messages, capped to INT_MAX, or a negative
+ * value if an error occured. Use preludedb_delete2() for the full count.
+ */
+int preludedb_delete(preludedb_t *db, idmef_criteria_t *criteria)
+{
+        ssize_t ret;
+
+        ret = preludedb_delete2(db, criteria, 0, NULL, NULL);
+        if ( ret > INT_MAX )
+                return INT_MAX;
+
         return ret;
 }
 
 
 
+/**
+ * preludedb_drop_partitions_before:
+ * @db: Pointer to a db object.
+ * @time: Pointer to a time object.
+ *
+ * Drop the partitions of a partitioned database holding only messages
+ * stored before @time. Unlike preludedb_delete(), this does not depend on
+ * the number of messages removed.
+ *
+ * Returns: the number of dropped partitions, or a negative value if an error
+ * occured, such as the database not being partitioned.
+ */
+int preludedb_drop_partitions_before(preludedb_t *db, const idmef_time_t *time)
+{
+        prelude_return_val_if_fail(db && time, prelude_error(PRELUDE_ERROR_ASSERTION));
+
+        if ( ! db->plugin->drop_partitions_before )
+                return PRELUDEDB_ENOTSUP("drop_partitions_before");
+
+        return db->plugin->drop_partitions_before(db, time);
+}
+
+
+
 /**
  * preludedb_get_values:
  * @db: Pointer to a db object.
@@ -1046,6 +1434,42 @@ int preludedb_get_values(preludedb_t *db,
 
 
 
+/**
+ * preludedb_count:
+ * @db: Pointer to a db object.
+ * @criteria: Pointer to a criteria object, or NULL to count every alert.
+ * @flags: #preludedb_count_flags_t, only PRELUDEDB_COUNT_FLAGS_ESTIMATE is meaningful.
+ * @threshold: Count above which to stop counting, or 0 for no threshold.
+ * @count: Pointer where to store the number of messages matching @criteria.
+ *
+ * Count the messages matching @criteria, without retrieving them.
+ *
+ * With PRELUDEDB_COUNT_FLAGS_ESTIMATE, the count is estimated from the
+ * database statistics when the backend provides them, which does not
+ * depend on the number of matching messages. Otherwise, the messages are
+ * counted exactly.
+ *
+ * When more than @threshold messages match, counting stops there and
+ * @count is set to @threshold, as in "more than @threshold messages".
+ * Backends may not bound the exact count for a @threshold of INT_MAX or
+ * more, in which case every matching message is counted before @count is
+ * capped to @threshold.
+ *
+ * Returns: the #preludedb_count_flags_t describing @count, 0 meaning it is exact,
+ * or a negative value if an error occured.
+ */
+int preludedb_count(preludedb_t *db, idmef_criteria_t *criteria, int flags, uint64_t threshold, uint64_t *count)
+{
+        prelude_return_val_if_fail(db && count, prelude_error(PRELUDE_ERROR_ASSERTION));
+
+        if ( ! db->plugin->count )
+                return PRELUDEDB_ENOTSUP("count");
+
+        return db->plugin->count(db, criteria, flags, threshold, count);
+}
+
+
+
 void *preludedb_result_values_get_data(preludedb_result_values_t *results)
 {
         prelude_return_val_if_fail(results, NULL);
@@ -1127,8 +1551,12 @@ ssize_t preludedb_update_from_result_idents(preludedb_t *db,
  * @limit: Limit of results or -1 if no limit.
  * @offset: Offset in results or -1 if no offset.
  *
+ * Only the values that already exist in the database are updated: a
+ * message lacking the object an updated path belongs to, such as an
+ * alert without impact for alert.assessment.impact.severity, is skipped.
  *
- * Returns: the number of result or a negative value if an error occured.
+ * Returns: the number of updated messages, which skipped messages are not
+ * part of, or a negative value if an error occured.
  */
 
 int preludedb_update(preludedb_t *db,
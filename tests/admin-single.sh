@@ -0,0 +1,67 @@
+#!/bin/sh
+#
+# Copy, save and load back a single alert with several worker processes:
+# preludedb-admin has to hand one element batches to its workers as lists,
+# like any other.
+#
+# Runs on fresh SQLite databases created from the classic schema. The
+# Python bindings and the plugins are used from their installation
+# directory: the test is skipped when they are not installed.
+
+PYTHON=${PYTHON:-python3}
+SCHEMA="$top_srcdir/plugins/format/classic/sqlite.sql"
+ADMIN="$top_srcdir/preludedb-admin"
+
+src=admin-single-src.sqlite
+dst=admin-single-dst.sqlite
+load=admin-single-load.sqlite
+file=admin-single.idmef
+
+"$PYTHON" -c "import prelude, preludedb" 2>/dev/null || exit 77
+
+rm -f $src $dst $load $file
+
+"$PYTHON" - "$SCHEMA" $src $dst $load <<'END' || exit 1
+import sqlite3
+import sys
+
+import prelude
+import preludedb
+
+schema = open(sys.argv[1]).read()
+for filename in sys.argv[2:]:
+    db = sqlite3.connect(filename)
+    db.executescript(schema)
+    db.close()
+
+idmef = prelude.IDMEF()
+idmef.set("alert.messageid", "admin-single")
+idmef.set("alert.create_time", "2020-01-01T00:00:00Z")
+idmef.set("alert.classification.text", "Single alert")
+
+preludedb.DB(preludedb.SQL("type=sqlite3 file=%s" % sys.argv[2])).insert(idmef)
+END
+
+count() {
+        "$PYTHON" -c 'import sys, preludedb; print(len(preludedb.DB(preludedb.SQL("type=sqlite3 file=" + sys.argv[1])).getAlertIdents()))' "$1"
+}
+
+"$PYTHON" "$ADMIN" copy alert "type=sqlite3 file=$src" "type=sqlite3 file=$dst" --multiprocess 2 || exit 1
+
+result=`count $dst`
+if test "$result" != 1; then
+        echo "copy: $result alerts in the destination database, expected 1." >&2
+        exit 1
+fi
+
+"$PYTHON" "$ADMIN" save alert "type=sqlite3 file=$dst" $file --multiprocess 2 || exit 1
+"$PYTHON" "$ADMIN" load "type=sqlite3 file=$load" $file --multiprocess 2 || exit 1
+
+result=`count $load`
+if test "$result" != 1; then
+        echo "load: $result alerts in the loaded database, expected 1." >&2
+        exit 1
+fi
+
+rm -f $src $dst $load $file
+exit 0
@@ -0,0 +1,250 @@
+/*****
+*
+* Copyright (C) 2020 CS GROUP - France. All Rights Reserved.
+*
+* This file is part of the PreludeDB library.
+*
+* This program is free software; you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation; either version 2, or (at your option)
+* any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License along
+* with this program; if not, write to the Free Software Foundation, Inc.,
+* 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+*
+*****/
+
+/*
+ * Check that the child rows of the alerts inserted through a single
+ * preludedb_insert_messages() call are flushed once, as multi-row
+ * statements, rather than each time the next parent row is inserted,
+ * and that the NULL entries are not counted as inserted.
+ *
+ * Runs on a fresh SQLite database created from the classic schema.
+ * Plugins are loaded from their installation directory: the test is
+ * skipped when they are not installed.
+ */
+
+#include "config.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+
+#include <libprelude/prelude.h>
+
+#include "preludedb.h"
+#include "preludedb-sql.h"
+#include "preludedb-sql-settings.h"
+
+
+#define TEST_DATABASE "insert-batch.sqlite"
+#define TEST_ALERTS 4
+
+#define TEST_SKIP 77
+
+
+static int fail(const char *what, int error)
+{
+        fprintf(stderr, "%s: %s.\n", what, preludedb_strerror(error));
+        return 1;
+}
+
+
+
+/*
+ * Run the statements of a schema file, split on the semicolons found
+ * outside of quoted strings.
+ */
+static int load_schema(preludedb_sql_t *sql, const char *filename)
+{
+        int ret = 0;
+        FILE *fd;
+        char *query, *ptr, *start;
+        long size;
+        char quote = 0;
+
+        fd = fopen(filename, "r");
+        if ( ! fd )
+                return preludedb_error_from_errno(errno);
+
+        fseek(fd, 0, SEEK_END);
+        size = ftell(fd);
+        rewind(fd);
+
+        query = malloc(size + 1);
+        if ( ! query ) {
+                fclose(fd);
+                return preludedb_error_from_errno(errno);
+        }
+
+        size = fread(query, 1, size, fd);
+        query[size] = 0;
+        fclose(fd);
+
+        for ( ptr = start = query; *ptr && ret >= 0; ptr++ ) {
+                if ( quote ) {
+                        if ( *ptr == quote )
+                                quote = 0;
+                        continue;
+                }
+
+                if ( *ptr == '\'' || *ptr == '"' ) {
+                        quote = *ptr;
+                        continue;
+                }
+
+                if ( *ptr != ';' )
+                        continue;
+
+                *ptr = 0;
+                start += strspn(start, " \t\r\n");
+                if ( *start )
+                        ret = preludedb_sql_query(sql, start, NULL);
+
+                start = ptr + 1;
+        }
+
+        free(query);
+
+        return (ret < 0) ? ret : 0;
+}
+
+
+
+static int new_alert(idmef_message_t **message, unsigned int num)
+{
+        int ret;
+        char buf[64];
+
+        ret = idmef_message_new(message);
+        if ( ret < 0 )
+                return ret;
+
+        snprintf(buf, sizeof(buf), "insert-batch-%u", num);
+        ret = idmef_message_set_string(*message, "alert.messageid", buf);
+        if ( ret < 0 )
+                goto error;
+
+        snprintf(buf, sizeof(buf), "2020-01-01T00:%02u:00Z", num);
+        ret = idmef_message_set_string(*message, "alert.create_time", buf);
+        if ( ret < 0 )
+                goto error;
+
+        ret = idmef_message_set_string(*message, "alert.classification.text", "Batch insertion");
+        if ( ret < 0 )
+                goto error;
+
+        return 0;
+
+ error:
+        idmef_message_destroy(*message);
+        return ret;
+}
+
+
+
+static uint64_t get_calls(preludedb_sql_metrics_t *metrics, const char *name)
+{
+        preludedb_sql_metrics_statement_t *st = NULL;
+
+        while ( (st = preludedb_sql_metrics_get_next_statement(metrics, st)) ) {
+                if ( strcmp(preludedb_sql_metrics_statement_get_name(st), name) == 0 )
+                        return preludedb_sql_metrics_statement_get_calls(st);
+        }
+
+        return 0;
+}
+
+
+
+int main(int argc, char **argv)
+{
+        int ret;
+        ssize_t count;
+        unsigned int i;
+        char errbuf[1024];
+        uint64_t parents, children;
+        preludedb_t *db;
+        preludedb_sql_t *sql;
+        preludedb_sql_settings_t *settings;
+        preludedb_sql_metrics_t *metrics;
+        idmef_message_t *messages[TEST_ALERTS + 1];
+
+        ret = preludedb_init();
+        if ( ret < 0 ) {
+                fprintf(stderr, "skipped: %s.\n", preludedb_strerror(ret));
+                return TEST_SKIP;
+        }
+
+        unlink(TEST_DATABASE);
+
+        ret = preludedb_sql_settings_new_from_string(&settings, "type=sqlite3 file=" TEST_DATABASE);
+        if ( ret < 0 )
+                return fail("could not parse database settings", ret);
+
+        ret = preludedb_sql_new(&sql, NULL, settings);
+        if ( ret < 0 ) {
+                fprintf(stderr, "skipped: %s.\n", preludedb_strerror(ret));
+                return TEST_SKIP;
+        }
+
+        ret = load_schema(sql, TEST_SCHEMA_DIR "/sqlite.sql");
+        if ( ret < 0 )
+                return fail("could not load schema", ret);
+
+        ret = preludedb_new(&db, sql, NULL, errbuf, sizeof(errbuf));
+        if ( ret < 0 ) {
+                fprintf(stderr, "could not create database: %s.\n", errbuf);
+                return 1;
+        }
+
+        for ( i = 0; i < TEST_ALERTS; i++ ) {
+                ret = new_alert(&messages[i], i);
+                if ( ret < 0 )
+                        return fail("could not create alert", ret);
+        }
+
+        messages[TEST_ALERTS] = NULL;
+
+        preludedb_sql_reset_metrics(sql);
+
+        count = preludedb_insert_messages(db, messages, TEST_ALERTS + 1);
+        if ( count < 0 )
+                return fail("could not insert alerts", count);
+
+        ret = preludedb_sql_get_metrics(sql, &metrics);
+        if ( ret < 0 )
+                return fail("could not retrieve metrics", ret);
+
+        parents = get_calls(metrics, "insert Prelude_Alert");
+        children = get_calls(metrics, "insert Prelude_CreateTime");
+
+        preludedb_sql_metrics_destroy(metrics);
+
+        for ( i = 0; i < TEST_ALERTS; i++ )
+                idmef_message_destroy(messages[i]);
+
+        preludedb_destroy(db);
+        preludedb_sql_destroy(sql);
+        preludedb_deinit();
+
+        unlink(TEST_DATABASE);
+
+        if ( count != TEST_ALERTS || parents != TEST_ALERTS || children != 1 ) {
+                fprintf(stderr, "%zd alerts inserted, %" PRELUDE_PRIu64 " parent statements, "
+                        "%" PRELUDE_PRIu64 " create time statements: expected %u, %u and 1.\n",
+                        count, parents, children, TEST_ALERTS, TEST_ALERTS);
+                return 1;
+        }
+
+        return 0;
+}